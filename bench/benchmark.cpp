@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <thread>
+#include <fmt/format.h>
+#include <utilities/matrixKernels.h>
+#include "benchmark.h"
+
+volatile uint64_t benchmarkSink = 0;
+
+// Batches are grown by this factor until one lasts long enough
+const uint64_t BATCH_GROWTH = 10;
+
+static double measureSeconds(uint64_t iterations, const std::function<void()> &body) {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        body();
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+BenchmarkRunner::BenchmarkRunner(const std::string &filter, double minSeconds, unsigned int repetitions)
+    : filter(filter), minSeconds(minSeconds), repetitions(std::max(repetitions, 1u)) {}
+
+bool BenchmarkRunner::isSelected(const std::string &name) const {
+    return name.find(filter) != std::string::npos;
+}
+
+void BenchmarkRunner::run(const std::string &name, uint64_t itemsPerIteration, const std::function<void()> &body) {
+    if (!isSelected(name)) {
+        return;
+    }
+    std::cerr << name << "... " << std::flush;
+
+    // The first call warms up the caches and allocator, and is not counted
+    body();
+
+    double repetitionSeconds = minSeconds / repetitions;
+    uint64_t iterations = 1;
+    double seconds = measureSeconds(iterations, body);
+    while (seconds < repetitionSeconds) {
+        // Jumps straight to the expected count once the batch is long enough to extrapolate from
+        uint64_t needed = (seconds > repetitionSeconds / BATCH_GROWTH)
+            ? uint64_t(iterations * 1.2 * repetitionSeconds / seconds) + 1
+            : iterations * BATCH_GROWTH;
+        iterations = needed;
+        seconds = measureSeconds(iterations, body);
+    }
+
+    std::vector<double> nanoseconds = { seconds * 1e9 / iterations };
+    for (unsigned int repetition = 1; repetition < repetitions; repetition++) {
+        nanoseconds.push_back(measureSeconds(iterations, body) * 1e9 / iterations);
+    }
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.medianNanoseconds = nanoseconds[nanoseconds.size() / 2];
+    result.minNanoseconds = nanoseconds.front();
+    result.itemsPerSecond = itemsPerIteration * 1e9 / result.medianNanoseconds;
+    results.push_back(result);
+
+    std::cerr << fmt::format("{:.1f} ns", result.medianNanoseconds) << std::endl;
+}
+
+void BenchmarkRunner::writeJSON(std::ostream &output) const {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+
+    // Benchmark names are plain ASCII without quotes or backslashes, so nothing needs escaping.
+    // Every benchmark is single-threaded, so its CPU time is reported as the wall time.
+    output << "{\n";
+    output << "  \"context\": {\n";
+    output << fmt::format("    \"date\": \"{}\",\n", date);
+    output << "    \"executable\": \"glowbox_bench\",\n";
+    output << fmt::format("    \"num_cpus\": {},\n", std::thread::hardware_concurrency());
+    output << fmt::format("    \"library_build_type\": \"{}\",\n", buildType);
+    output << fmt::format("    \"matrix_kernel\": \"{}\",\n", matrixKernelName(bestMatrixKernel()));
+    output << fmt::format("    \"repetitions\": {}\n", repetitions);
+    output << "  },\n";
+    output << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        output << "    {\n";
+        output << fmt::format("      \"name\": \"{}\",\n", result.name);
+        output << fmt::format("      \"iterations\": {},\n", result.iterations);
+        output << fmt::format("      \"real_time\": {:.3f},\n", result.medianNanoseconds);
+        output << fmt::format("      \"cpu_time\": {:.3f},\n", result.medianNanoseconds);
+        output << fmt::format("      \"min_time\": {:.3f},\n", result.minNanoseconds);
+        output << "      \"time_unit\": \"ns\",\n";
+        output << fmt::format("      \"items_per_second\": {:.1f}\n", result.itemsPerSecond);
+        output << ((i + 1 < results.size()) ? "    },\n" : "    }\n");
+    }
+    output << "  ]\n";
+    output << "}\n";
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal microbenchmark harness for the CPU code that needs no GL context.
+// Each benchmark is run in batches long enough to time reliably, and the batches are repeated,
+// so the median and fastest batch can be told apart from noise. The results are written as JSON
+// in the layout Google Benchmark uses, so its compare.py and other existing tooling can read them.
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations;        // In each repetition
+    double medianNanoseconds;   // Per iteration, over the repetitions
+    double minNanoseconds;
+    double itemsPerSecond;      // At the median, 0 for benchmarks without items
+};
+
+// Results the compiler cannot prove unused, so the measured work is not optimised away
+extern volatile uint64_t benchmarkSink;
+
+class BenchmarkRunner {
+public:
+    // Only benchmarks whose name contains the filter are run. Every repetition lasts at least
+    // minSeconds / repetitions.
+    BenchmarkRunner(const std::string &filter, double minSeconds, unsigned int repetitions);
+
+    // Whether a benchmark would be run, to skip expensive setup for the filtered out ones
+    bool isSelected(const std::string &name) const;
+
+    // Times body, which processes itemsPerIteration items (vertices, pixels, nodes...) each call.
+    // Progress is reported on standard error, so standard output can be kept for the results.
+    void run(const std::string &name, uint64_t itemsPerIteration, const std::function<void()> &body);
+
+    void writeJSON(std::ostream &output) const;
+
+private:
+    std::string filter;
+    double minSeconds;
+    unsigned int repetitions;
+    std::vector<BenchmarkResult> results;
+
+    BenchmarkRunner(BenchmarkRunner const &) = delete;
+    BenchmarkRunner & operator =(BenchmarkRunner const &) = delete;
+};
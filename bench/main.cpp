@@ -0,0 +1,189 @@
+// Microbenchmarks of the CPU hot paths: mesh generation, image decoding, text geometry and scene graph updates.
+// Everything here runs without a window or GL context. The results are printed as JSON, see benchmark.h.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <arrrgh.hpp>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include <utilities/shapes.h>
+#include <utilities/glfont.h>
+#include <utilities/imageLoader.hpp>
+#include <utilities/matrixKernels.h>
+#include <sceneGraph.hpp>
+#include "benchmark.h"
+
+// Slices and layers of the spheres. 40 and 100 are the finest levels of the balls and the black hole.
+const int SPHERE_TESSELLATIONS[] = {16, 40, 100, 400};
+
+const int TEXT_LENGTHS[] = {16, 256, 4096};
+
+const char* PNG_FILES[] = {"charmap.png", "normal-map-debug.png"};
+
+const size_t TREE_NODE_COUNTS[] = {1000, 16000, 256000, 1000000};
+
+// Children per node of the synthetic scene graphs, which fill up level by level
+const size_t TREE_BRANCHING = 4;
+
+static void benchmarkMeshGeneration(BenchmarkRunner &runner) {
+    for (int tessellation : SPHERE_TESSELLATIONS) {
+        Mesh sphere = generateSphere(1.0f, tessellation, tessellation);
+        runner.run(fmt::format("generateSphere/{}", tessellation), sphere.vertices.size(), [&] {
+            benchmarkSink += generateSphere(1.0f, tessellation, tessellation).vertices.size();
+        });
+    }
+
+    Mesh box = cube(glm::vec3(360), glm::vec2(90), true, true);
+    runner.run("cube", box.vertices.size(), [] {
+        benchmarkSink += cube(glm::vec3(360), glm::vec2(90), true, true).vertices.size();
+    });
+
+    for (int tessellation : SPHERE_TESSELLATIONS) {
+        Mesh sphere = generateSphere(1.0f, tessellation, tessellation);
+        runner.run(fmt::format("computeTangentBasis/{}", tessellation), sphere.vertices.size(), [&] {
+            std::vector<glm::vec3> tangents;
+            std::vector<glm::vec3> bitangents;
+            computeTangentBasis(sphere.vertices, sphere.textureCoordinates, sphere.normals, tangents, bitangents);
+            benchmarkSink += tangents.size() + bitangents.size();
+        });
+    }
+}
+
+static void benchmarkImageLoading(BenchmarkRunner &runner) {
+    for (const char* file : PNG_FILES) {
+        std::string path = std::string(PROJECT_SOURCE_DIR) + "/res/textures/" + file;
+        std::vector<unsigned char> png;
+        if (lodepng::load_file(png, path) != 0) {
+            std::cerr << "Could not read " << path << ", skipping it." << std::endl;
+            continue;
+        }
+        PNGImage image = decodePNGImage(png);
+        uint64_t pixels = uint64_t(image.width) * image.height;
+
+        // With the file read, which comes from the page cache after the first time
+        runner.run(fmt::format("loadPNGFile/{}", file), pixels, [&] {
+            benchmarkSink += loadPNGFile(path).pixels.size();
+        });
+        // The decode and vertical flip alone
+        runner.run(fmt::format("decodePNGImage/{}", file), pixels, [&] {
+            benchmarkSink += decodePNGImage(png).pixels.size();
+        });
+    }
+}
+
+static void benchmarkTextGeometry(BenchmarkRunner &runner) {
+    for (int length : TEXT_LENGTHS) {
+        std::string text;
+        for (int i = 0; i < length; i++) {
+            text += char(' ' + i % 95);
+        }
+        runner.run(fmt::format("generateTextGeometryBuffer/{}", length), length, [&] {
+            benchmarkSink += generateTextGeometryBuffer(text, 1.0f / CHARMAP_GLYPH_ASPECT, 0.01f * length).vertices.size();
+        });
+    }
+}
+
+static void deleteTree(SceneNode* node) {
+    for (SceneNode* child : node->children) {
+        deleteTree(child);
+    }
+    delete node;
+}
+
+// Nodes with random transformations, each level filled before the next is started
+static SceneNode* generateTree(size_t nodeCount, std::mt19937 &random) {
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    std::vector<SceneNode*> nodes;
+    nodes.reserve(nodeCount);
+    for (size_t i = 0; i < nodeCount; i++) {
+        SceneNode* node = createSceneNode();
+        node->position = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+        node->rotation = glm::vec3(angle(random), angle(random), angle(random));
+        node->scale = glm::vec3(scale(random), scale(random), scale(random));
+        if (i > 0) {
+            addChild(nodes[(i - 1) / TREE_BRANCHING], node);
+        }
+        nodes.push_back(node);
+    }
+    return nodes.front();
+}
+
+static void benchmarkSceneGraph(BenchmarkRunner &runner) {
+    std::mt19937 random(1234);
+
+    for (size_t nodeCount : TREE_NODE_COUNTS) {
+        std::string updateName = fmt::format("updateNodeTransformations/{}", nodeCount);
+        std::string countName = fmt::format("totalChildren/{}", nodeCount);
+        if (!runner.isSelected(updateName) && !runner.isSelected(countName)) {
+            continue;
+        }
+
+        SceneNode* root = generateTree(nodeCount, random);
+        FlattenedSceneGraph graph;
+        flattenSceneGraph(root, graph);
+
+        // What updateNodeTransformations() does before its per-node-type work, which depends on the renderer
+        MatrixKernel kernel = bestMatrixKernel();
+        runner.run(updateName, nodeCount, [&] {
+            updateTransformations(graph, kernel);
+            benchmarkSink += graph.worldMatrices.size();
+        });
+        runner.run(countName, nodeCount, [&] {
+            benchmarkSink += totalChildren(root);
+        });
+
+        deleteTree(root);
+    }
+}
+
+int main(int argc, const char* argb[])
+{
+    arrrgh::parser parser("glowbox_bench", "Microbenchmarks of glowbox's CPU hot paths");
+    const auto& showHelp    = parser.add<bool>("help", "Show this help message.", 'h', arrrgh::Optional, false);
+    const auto& filter      = parser.add<std::string>("filter", "Only run the benchmarks whose name contains this.", 'f', arrrgh::Optional, "");
+    const auto& outputPath  = parser.add<std::string>("output", "Write the JSON results to this file instead of standard output.", 'o', arrrgh::Optional, "");
+    const auto& minTime     = parser.add<int>("min-time", "Milliseconds spent measuring each benchmark, over all repetitions.", 't', arrrgh::Optional, 1000);
+    const auto& repetitions = parser.add<int>("repetitions", "Times each benchmark is measured. The median is reported.", 'r', arrrgh::Optional, 5);
+
+    try
+    {
+        parser.parse(argc, argb);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error parsing arguments: " << e.what() << std::endl;
+        parser.show_usage(std::cerr);
+        exit(1);
+    }
+
+    if(showHelp.value())
+    {
+        return 0;
+    }
+
+    BenchmarkRunner runner(filter.value(), minTime.value() / 1000.0, std::max(repetitions.value(), 1));
+    benchmarkMeshGeneration(runner);
+    benchmarkImageLoading(runner);
+    benchmarkTextGeometry(runner);
+    benchmarkSceneGraph(runner);
+
+    if (outputPath.value().empty()) {
+        runner.writeJSON(std::cout);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream output(outputPath.value());
+    runner.writeJSON(output);
+    if (!output) {
+        std::cerr << "Could not write " << outputPath.value() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
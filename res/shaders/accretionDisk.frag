@@ -0,0 +1,33 @@
+#version 430 core
+
+in layout(location = 0) vec2 spriteCoordinates;
+in layout(location = 1) vec3 worldPos;
+in layout(location = 2) float orbitRadius;
+in layout(location = 3) vec3 normal;
+
+out layout(location = 0) vec4 gColor;
+out layout(location = 1) vec4 gPosition;
+out layout(location = 2) vec4 gNormal;
+out layout(location = 3) vec4 gStencil;
+
+void main()
+{
+    // Round sprites
+    float distanceSquared = dot(spriteCoordinates, spriteCoordinates);
+    if (distanceSquared > 1.0f) {
+        discard;
+    }
+
+    // Hot and white at the inner edge, cooling to deep orange further out
+    vec3 innerColor = vec3(1.0f, 0.95f, 0.85f);
+    vec3 middleColor = vec3(1.0f, 0.6f, 0.2f);
+    vec3 outerColor = vec3(0.6f, 0.15f, 0.05f);
+    float t = clamp(orbitRadius, 0.0f, 1.0f);
+    vec3 color = t < 0.5f ? mix(innerColor, middleColor, t * 2.0f) : mix(middleColor, outerColor, t * 2.0f - 1.0f);
+
+    // Particles are emissive, so the colour goes into the G-buffer as is
+    gColor = vec4(color * (1.0f - 0.5f * distanceSquared), 1.0f);
+    gPosition = vec4(worldPos, 1.0f);
+    gNormal = vec4(normalize(normal), 1.0f);
+    gStencil = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
\ No newline at end of file
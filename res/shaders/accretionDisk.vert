@@ -0,0 +1,36 @@
+#version 430 core
+
+// Lets each eye's draw go into its own layer of a stereo G-buffer. Without it, only mono can be drawn.
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+#include "uniformBlocks.glsl"
+
+// One instance per visible particle: position, and orbit radius normalised to the disk's extent
+in layout(location = 0) vec4 particle;
+
+uniform layout(location = 0) vec2 projectionScale;  // The projection matrix' x and y scale factors
+uniform layout(location = 1) float spriteRadius;
+// Which of FrameUniforms::eyes the sprites are drawn for, and its layer of the G-buffer. 0 in mono.
+uniform layout(location = 2) int eye;
+
+out layout(location = 0) vec2 spriteCoordinates;
+out layout(location = 1) vec3 worldPos;
+out layout(location = 2) float orbitRadius;
+out layout(location = 3) vec3 normal;
+
+void main()
+{
+    // Triangle strip corners of a camera-facing quad
+    spriteCoordinates = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+    worldPos = particle.xyz;
+    orbitRadius = particle.w;
+    normal = normalize(eyes[eye].position - worldPos);
+
+    // Offsetting in clip space keeps the quad facing the camera without needing the view matrix
+    gl_Position = eyes[eye].viewProjection * vec4(worldPos, 1.0f);
+    gl_Position.xy += spriteCoordinates * spriteRadius * projectionScale;
+
+#if defined(GL_ARB_shader_viewport_layer_array)
+    gl_Layer = eye;
+#endif
+}
\ No newline at end of file
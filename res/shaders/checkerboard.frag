@@ -0,0 +1,11 @@
+#version 430 core
+
+// Fills the G-buffer stencil with the checkerboard pattern (see checkerboard.h). Only half 0 is written.
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (((pixel.x + pixel.y) & 1) == 1) {
+        discard;
+    }
+}
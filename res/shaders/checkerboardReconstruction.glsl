@@ -0,0 +1,47 @@
+// Shared by the passes reading a checkerboard-rendered G-buffer (see checkerboard.h), to tell which of its
+// texels hold last frame's samples and whether those can still be used.
+// Expects the uniform blocks, gPosition, and the G_BUFFER_TEXEL, VIEWER_POS and VIEWER_VIEW_PROJECTION macros.
+
+// How far, in pixels, last frame's sample may have moved and still be reused by the checkerboard reconstruction
+#define REPROJECTION_TOLERANCE 0.5f
+
+// The four direct neighbours of a pixel, which were all drawn this frame if it was not
+struct CheckerboardNeighbours {
+    ivec2 left;
+    ivec2 right;
+    ivec2 down;
+    ivec2 up;
+};
+
+bool isDrawnThisFrame(ivec2 pixel) {
+    return checkerboardParity < 0 || ((pixel.x + pixel.y) & 1) == checkerboardParity;
+}
+
+CheckerboardNeighbours checkerboardNeighbours(ivec2 pixel) {
+    ivec2 lastPixel = ivec2(screenDimensions) - 1;
+    CheckerboardNeighbours neighbours;
+    neighbours.left  = clamp(pixel + ivec2(-1, 0), ivec2(0), lastPixel);
+    neighbours.right = clamp(pixel + ivec2(1, 0), ivec2(0), lastPixel);
+    neighbours.down  = clamp(pixel + ivec2(0, -1), ivec2(0), lastPixel);
+    neighbours.up    = clamp(pixel + ivec2(0, 1), ivec2(0), lastPixel);
+    return neighbours;
+}
+
+// Last frame's sample is reused if it would still land on this pixel,
+// and lies on the surface the neighbours show now (which fails where something moved)
+bool isLastSampleReusable(ivec2 pixel, CheckerboardNeighbours neighbours) {
+    vec3 samplePos = G_BUFFER_TEXEL(gPosition, pixel).xyz;
+    vec4 clipPos = VIEWER_VIEW_PROJECTION * vec4(samplePos, 1.0f);
+    vec2 screenPos = (clipPos.xy / clipPos.w * 0.5f + 0.5f) * screenDimensions;
+    bool samePixel = clipPos.w > 0.0f && all(lessThan(abs(screenPos - (vec2(pixel) + 0.5f)), vec2(REPROJECTION_TOLERANCE)));
+
+    vec3 leftPos = G_BUFFER_TEXEL(gPosition, neighbours.left).xyz;
+    vec3 rightPos = G_BUFFER_TEXEL(gPosition, neighbours.right).xyz;
+    vec3 downPos = G_BUFFER_TEXEL(gPosition, neighbours.down).xyz;
+    vec3 upPos = G_BUFFER_TEXEL(gPosition, neighbours.up).xyz;
+    vec3 averagePos = (leftPos + rightPos + downPos + upPos) * 0.25f;
+    float neighbourSpread = max(distance(leftPos, rightPos), distance(downPos, upPos));
+    bool sameSurface = distance(samplePos, averagePos) <= 0.5f * neighbourSpread + 0.001f * distance(VIEWER_POS, averagePos);
+
+    return samePixel && sameSurface;
+}
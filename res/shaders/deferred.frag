@@ -9,103 +9,90 @@
 #define STENCIL 5
 #define BH_NORMALS 6
 
-in layout(location = 0) vec2 textureCoordinates;
+#include "uniformBlocks.glsl"
 
-uniform layout(location = 10) vec3 eyePos;
-uniform layout(location = 14) vec3 bhPos;
-uniform layout(location = 15) vec3 bhScreenPos;
-uniform layout(location = 16) float bhRadius;
-uniform layout(location = 17) float bhScreenPercent;
-uniform layout(location = 18) vec2 screenDimensions;
-uniform layout(location = 19) int viewMode;
+in layout(location = 0) vec2 textureCoordinates;
 
-uniform layout(binding = 0) sampler2D gColor;
-uniform layout(binding = 1) sampler2D gPosition;
-uniform layout(binding = 2) sampler2D gNormal;
-uniform layout(binding = 3) sampler2D gStencil;
-uniform layout(binding = 4) sampler2D gBHNormal;
+// In stereo, the G-buffer has one layer per eye, and each is resolved from its eye (see stereo.h)
+#if defined(RENDER_STEREO)
+#define G_BUFFER_SAMPLER sampler2DArray
+#define G_BUFFER_TEXTURE(sampler, coordinates) texture(sampler, vec3(coordinates, gl_Layer))
+#define G_BUFFER_TEXEL(sampler, pixel) texelFetch(sampler, ivec3(pixel, gl_Layer), 0)
+#define VIEWER_POS eyes[gl_Layer].position
+#define VIEWER_VIEW_PROJECTION eyes[gl_Layer].viewProjection
+#else
+#define G_BUFFER_SAMPLER sampler2D
+#define G_BUFFER_TEXTURE(sampler, coordinates) texture(sampler, coordinates)
+#define G_BUFFER_TEXEL(sampler, pixel) texelFetch(sampler, pixel, 0)
+#define VIEWER_POS eyePos
+#define VIEWER_VIEW_PROJECTION viewProjection
+#endif
+
+uniform layout(binding = 0) G_BUFFER_SAMPLER gColor;
+uniform layout(binding = 1) G_BUFFER_SAMPLER gPosition;
+uniform layout(binding = 2) G_BUFFER_SAMPLER gNormal;
+uniform layout(binding = 3) G_BUFFER_SAMPLER gStencil;
+uniform layout(binding = 4) G_BUFFER_SAMPLER gBHNormal;
 
 out vec4 color;
 
-vec3 reject(vec3 from, vec3 onto) { return from - onto*(dot(from, onto)/dot(onto, onto)); }
-
-float hit = 0.0f;
-vec3 hitPos = vec3(0.0f);
-vec3 hitNormal = vec3(0.0f);
-
-void regularRender() {
-    // Sample the textures
-    vec4 modelColor = texture(gColor, textureCoordinates);
-    vec3 modelPos = texture(gPosition, textureCoordinates).rgb;
-    vec3 modelNormal = texture(gNormal, textureCoordinates).rgb;
-    float stencilVal = texture(gStencil, textureCoordinates).r;
-    vec3 bhModelNormal = texture(gBHNormal, textureCoordinates).rgb;
-    
-    color = modelColor;
-
-    // If this pixel should be affected by the black hole ...
-    if (stencilVal == 1.0f) {
-        vec3 viewModelVector = eyePos - modelPos;
-        vec3 bhModelVector = bhPos - modelPos;
+#include "checkerboardReconstruction.glsl"
 
-        float bhEHRadius = bhRadius / 2.0f;  // Event horizon radius
-
-        float distortion_simple = 1 - acos(dot(bhModelNormal, normalize(viewModelVector)));  // Note: bhModelNormal belongs to bhSphere wherever stencil is 1
-
-        if ((length(viewModelVector) < length(bhModelVector)) || (dot(viewModelVector, bhModelVector) < 0.0f)) {
-            return;
-        }
-
-        if (distortion_simple > 0.75f) {
-            color = vec4(vec3(0.0f), 1.0f);
-        }
-        else {
-            vec2 screen_modelPos = textureCoordinates * screenDimensions;
-            vec2 screen_modelBHVector = bhScreenPos.xy - screen_modelPos;
-            float screen_modelBHDist = length(screen_modelBHVector);
-            vec2 screen_modelBHVector_norm = normalize(screen_modelBHVector);
-
-            float distortion = pow(max(distortion_simple + 0.1f, 0.0f), 3.0f);
-
-            vec2 distortedUVSample = textureCoordinates + distortion * 0.5f * bhScreenPercent * screen_modelBHVector_norm;
-            color = texture(gColor, distortedUVSample);
-        }
+// With checkerboard rendering, half of the pixels were drawn last frame (see checkerboard.h)
+vec4 reconstructedColor() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 sampleColor = G_BUFFER_TEXEL(gColor, pixel);
+    if (isDrawnThisFrame(pixel)) {
+        return sampleColor;
     }
-}
 
-void main() {
-    if (viewMode == REGULAR) {
-        regularRender();
-        return;
+    CheckerboardNeighbours neighbours = checkerboardNeighbours(pixel);
+    if (isLastSampleReusable(pixel, neighbours)) {
+        return sampleColor;
     }
 
-    vec4 modelColor = texture(gColor, textureCoordinates);
-    vec3 modelPos = texture(gPosition, textureCoordinates).rgb;
-    vec3 modelNormal = texture(gNormal, textureCoordinates).rgb;
-    float stencilVal = texture(gStencil, textureCoordinates).r;
-    vec3 bhModelNormal = texture(gBHNormal, textureCoordinates).rgb;
-
-    vec3 viewModelVector = eyePos - modelPos;
+    vec4 leftColor = G_BUFFER_TEXEL(gColor, neighbours.left);
+    vec4 rightColor = G_BUFFER_TEXEL(gColor, neighbours.right);
+    vec4 downColor = G_BUFFER_TEXEL(gColor, neighbours.down);
+    vec4 upColor = G_BUFFER_TEXEL(gColor, neighbours.up);
 
-    if (viewMode == COLOR) {
-        color = modelColor;
-    }
-    else if (viewMode == POSITION) {
-        color = vec4(normalize(modelPos) * 0.5f + vec3(0.5f), 1.0f);
-    }
-    else if (viewMode == DISTANCE) {
-        float viewModelDistance = length(viewModelVector);
-        float viewModelDistance_norm = viewModelDistance / 1000.0f;  // Provided the frustum has depth 1000.0f, this is now in range (0, 1)
+    // Interpolated along whichever direction has the smaller difference, so edges stay sharp
+    return (length(leftColor - rightColor) < length(downColor - upColor))
+         ? (leftColor + rightColor) * 0.5f
+         : (downColor + upColor) * 0.5f;
+}
 
-        color = vec4(vec3(1 - viewModelDistance_norm), 1.0f);
-    }
-    else if (viewMode == NORMALS) {
-        color = vec4(modelNormal * 0.5f + vec3(0.5f), 1.0f);
-    }
-    else if (viewMode == STENCIL) {
-        color = vec4(vec3(stencilVal), 1.0f);
-    }
-    else if (viewMode == BH_NORMALS) {
-        color = vec4(bhModelNormal * 0.5f + vec3(0.5f), 1.0f);
-    }
+// The debug view modes are permutations of this shader, with the VIEW_* feature keys.
+// Without any of them, it resolves the REGULAR view.
+void main() {
+#if !defined(VIEW_COLOR) && !defined(VIEW_POSITION) && !defined(VIEW_DISTANCE) && !defined(VIEW_NORMALS) \
+    && !defined(VIEW_STENCIL) && !defined(VIEW_BH_NORMALS)
+    // Lensing is applied by lensing.frag, drawn over the black holes' footprints afterwards
+    color = reconstructedColor();
+#else
+    vec4 modelColor = G_BUFFER_TEXTURE(gColor, textureCoordinates);
+    vec3 modelPos = G_BUFFER_TEXTURE(gPosition, textureCoordinates).rgb;
+    vec3 modelNormal = G_BUFFER_TEXTURE(gNormal, textureCoordinates).rgb;
+    float stencilVal = G_BUFFER_TEXTURE(gStencil, textureCoordinates).r;
+    vec3 bhModelNormal = G_BUFFER_TEXTURE(gBHNormal, textureCoordinates).rgb;
+
+    vec3 viewModelVector = VIEWER_POS - modelPos;
+
+  #if defined(VIEW_COLOR)
+    color = modelColor;
+  #elif defined(VIEW_POSITION)
+    color = vec4(normalize(modelPos) * 0.5f + vec3(0.5f), 1.0f);
+  #elif defined(VIEW_DISTANCE)
+    float viewModelDistance = length(viewModelVector);
+    float viewModelDistance_norm = viewModelDistance / 1000.0f;  // Provided the frustum has depth 1000.0f, this is now in range (0, 1)
+
+    color = vec4(vec3(1 - viewModelDistance_norm), 1.0f);
+  #elif defined(VIEW_NORMALS)
+    color = vec4(modelNormal * 0.5f + vec3(0.5f), 1.0f);
+  #elif defined(VIEW_STENCIL)
+    color = vec4(vec3(stencilVal), 1.0f);
+  #elif defined(VIEW_BH_NORMALS)
+    color = vec4(bhModelNormal * 0.5f + vec3(0.5f), 1.0f);
+  #endif
+#endif
 }
@@ -1,4 +1,10 @@
 #version 430 core
+
+// One instance per eye in stereo, each resolving its eye's layer (see stereo.h)
+#if defined(RENDER_STEREO)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
 in layout(location = 0) vec3 position;
 in layout(location = 2) vec2 textureCoordinates_in;
 
@@ -8,4 +14,8 @@ void main()
 {
     textureCoordinates_out = textureCoordinates_in;
     gl_Position = vec4(position, 1.0);
+
+#if defined(RENDER_STEREO)
+    gl_Layer = gl_InstanceID;
+#endif
 }
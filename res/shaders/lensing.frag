@@ -0,0 +1,108 @@
+#version 430 core
+
+// Drawn over deferred.frag's output, on the screen tiles overlapped by a black hole (see lensing.h).
+// Only pixels covered by a black hole are written; the rest keep the regular pass's color.
+
+#include "uniformBlocks.glsl"
+
+// Angle in radians a ray passing right at the edge of the black hole's shadow is bent by
+#define MAX_DEFLECTION 2.5f
+
+in layout(location = 0) vec2 textureCoordinates;
+
+// In stereo, the G-buffer has one layer per eye, and both eyes lens the same black holes
+#if defined(RENDER_STEREO)
+#define G_BUFFER_SAMPLER sampler2DArray
+#define G_BUFFER_TEXEL(sampler, pixel) texelFetch(sampler, ivec3(pixel, gl_Layer), 0)
+#define VIEWER_POS eyes[gl_Layer].position
+#define VIEWER_VIEW_PROJECTION eyes[gl_Layer].viewProjection
+#else
+#define G_BUFFER_SAMPLER sampler2D
+#define G_BUFFER_TEXEL(sampler, pixel) texelFetch(sampler, pixel, 0)
+#define VIEWER_POS eyePos
+#define VIEWER_VIEW_PROJECTION viewProjection
+#endif
+
+// Mirrors BlackHoleData in lensing.cpp
+struct BlackHole {
+    vec3 position;
+    float radius;
+};
+
+layout(std430, binding = 0) readonly buffer BlackHoles { BlackHole blackHoles[]; };
+
+uniform layout(binding = 1) G_BUFFER_SAMPLER gPosition;
+uniform layout(binding = 3) G_BUFFER_SAMPLER gStencil;
+uniform layout(binding = 4) G_BUFFER_SAMPLER gBHNormal;
+
+// The scene as seen from the (first) black hole, see environmentProbe.h
+uniform layout(binding = 7) samplerCube environmentMap;
+
+out vec4 color;
+
+#include "checkerboardReconstruction.glsl"
+
+// The texel to lens this pixel from. With checkerboard rendering, a pixel not drawn this frame whose old sample
+// cannot be reused takes a neighbour's, along the direction where the surface changes least. The whole texel is
+// taken from that one neighbour, so the mask, position and normal always belong to the same black hole.
+ivec2 reconstructedTexel() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (isDrawnThisFrame(pixel)) {
+        return pixel;
+    }
+
+    CheckerboardNeighbours neighbours = checkerboardNeighbours(pixel);
+    if (isLastSampleReusable(pixel, neighbours)) {
+        return pixel;
+    }
+
+    float horizontalSpread = distance(G_BUFFER_TEXEL(gPosition, neighbours.left).xyz, G_BUFFER_TEXEL(gPosition, neighbours.right).xyz);
+    float verticalSpread = distance(G_BUFFER_TEXEL(gPosition, neighbours.down).xyz, G_BUFFER_TEXEL(gPosition, neighbours.up).xyz);
+    return (horizontalSpread < verticalSpread) ? neighbours.left : neighbours.down;
+}
+
+void main() {
+    ivec2 texel = reconstructedTexel();
+
+    // Most of a tile is usually not covered by a black hole. Each one writes its own value, see blackHoleMaskValue().
+    float stencilVal = G_BUFFER_TEXEL(gStencil, texel).r;
+    int blackHoleID = int(round((1.0f - stencilVal) * 255.0f));
+    if (stencilVal == 0.0f || blackHoleID >= blackHoles.length()) {
+        discard;
+    }
+    BlackHole blackHole = blackHoles[blackHoleID];
+
+    vec3 modelPos = G_BUFFER_TEXEL(gPosition, texel).rgb;
+    vec3 bhModelNormal = G_BUFFER_TEXEL(gBHNormal, texel).rgb;
+
+    vec3 viewModelVector = VIEWER_POS - modelPos;
+    vec3 bhModelVector = blackHole.position - modelPos;
+
+    float distortion_simple = 1 - acos(dot(bhModelNormal, normalize(viewModelVector)));  // Note: bhModelNormal belongs to the black hole wherever stencil is set
+
+    // Geometry in front of the black hole is not distorted
+    if ((length(viewModelVector) < length(bhModelVector)) || (dot(viewModelVector, bhModelVector) < 0.0f)) {
+        discard;
+    }
+
+    if (distortion_simple > 0.75f) {
+        color = vec4(vec3(0.0f), 1.0f);
+    }
+    else {
+        float distortion = pow(max(distortion_simple + 0.1f, 0.0f), 3.0f);
+
+        // The view ray is bent towards the black hole's centre, and looked up in the environment map, so the lensed
+        // image can show what is off screen or behind the black hole. The map is captured at the first black hole,
+        // and taken to be far enough away for the others to use the same directions.
+        vec3 viewDirection = normalize(modelPos - VIEWER_POS);
+        vec3 towardsCentre = blackHole.position - VIEWER_POS;
+        towardsCentre -= dot(towardsCentre, viewDirection) * viewDirection;
+        // distortion reaches 0.85^3 where the shadow starts, at distortion_simple = 0.75
+        float deflection = distortion / pow(0.85f, 3.0f) * MAX_DEFLECTION;
+        vec3 bentDirection = (length(towardsCentre) > 0.0f)
+            ? cos(deflection) * viewDirection + sin(deflection) * normalize(towardsCentre)
+            : viewDirection;
+
+        color = texture(environmentMap, bentDirection);
+    }
+}
@@ -0,0 +1,31 @@
+#version 430 core
+
+// In stereo, each tile is drawn into its eye's layer (see stereo.h)
+#if defined(RENDER_STEREO)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+// Must match LENSING_TILE_SIZE in lensing.h
+#define TILE_SIZE 32.0f
+
+#include "uniformBlocks.glsl"
+
+// Column in the low 16 bits, row in the next 15, and the eye in the highest bit
+in layout(location = 0) uint tile;
+
+out layout(location = 0) vec2 textureCoordinates_out;
+
+void main()
+{
+    // A triangle strip over the tile's four corners
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 pixel = (vec2(tile & 0xFFFFu, (tile >> 16) & 0x7FFFu) + corner) * TILE_SIZE;
+
+    // Tiles along the right and top edges reach past the screen
+    textureCoordinates_out = min(pixel, screenDimensions) / screenDimensions;
+    gl_Position = vec4(textureCoordinates_out * 2.0f - 1.0f, 0.0f, 1.0f);
+
+#if defined(RENDER_STEREO)
+    gl_Layer = int(tile >> 31);
+#endif
+}
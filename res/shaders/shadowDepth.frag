@@ -0,0 +1,14 @@
+#version 430 core
+
+// Must match SHADOW_FAR_PLANE in shadowAtlas.h
+#define SHADOW_FAR_PLANE 650.0f
+
+in layout(location = 0) vec3 worldPos;
+
+uniform layout(location = 1) vec3 lightPosition;
+
+void main()
+{
+    // Store the distance to the light rather than projected depth, so all six faces compare the same way
+    gl_FragDepth = length(worldPos - lightPosition) / SHADOW_FAR_PLANE;
+}
\ No newline at end of file
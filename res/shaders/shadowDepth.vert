@@ -0,0 +1,15 @@
+#version 430 core
+
+in layout(location = 0) vec3 position;
+
+#include "uniformBlocks.glsl"
+
+uniform layout(location = 0) mat4 faceViewProjection;
+
+out layout(location = 0) vec3 worldPos;
+
+void main()
+{
+    worldPos = vec3(modelMatrix * vec4(position, 1.0f));
+    gl_Position = faceViewProjection * vec4(worldPos, 1.0f);
+}
\ No newline at end of file
@@ -1,6 +1,11 @@
 #version 430 core
 
-#define MAX_LIGHTS 100
+#include "uniformBlocks.glsl"
+
+// Must match the constants in shadowAtlas.h
+#define SHADOW_FAR_PLANE 650.0f
+#define SHADOW_NORMAL_OFFSET 0.6f
+#define SHADOW_BIAS 0.002f
 
 // Definitions corresponding to SceneNodeType enum
 #define GEOMETRY 0
@@ -10,28 +15,50 @@
 #define POINT_LIGHT 4
 #define SPOT_LIGHT 5
 
-struct LightSource {
-    vec3 coord;
-    vec3 color;
-};
-
 in layout(location = 0) vec3 normal;
 in layout(location = 1) vec2 textureCoordinates;
 in layout(location = 2) vec3 modelPos;
 in layout(location = 3) mat3 TBN;
 
-uniform layout(location = 6) int numLights;
-uniform layout(location = 10) vec3 eyePos;
-uniform layout(location = 11) vec3 ballPos;
-uniform layout(location = 12) float ballRadius;
-uniform layout(location = 13) int renderMode;  // SceneNodeType enum values (defined above)
-uniform layout(location = 14) vec3 modelColor;
-uniform LightSource lightSource[MAX_LIGHTS];
+// Faces of the environment cube map are seen from the black hole, where it is captured,
+// and the layers of the stereo G-buffer from their eyes
+#if defined(RENDER_ENVIRONMENT)
+#define VIEWER_POS bhPos
+#elif defined(RENDER_STEREO)
+#define VIEWER_POS eyes[gl_Layer].position
+#else
+#define VIEWER_POS eyePos
+#endif
 
 uniform layout(binding = 0) sampler2D colorSampler;
 uniform layout(binding = 1) sampler2D normalMapSampler;
 uniform layout(binding = 2) sampler2D roughnessMapSampler;
 
+#if defined(RENDER_VIRTUAL_TEXTURE)
+// Must match the constants in virtualTexture.h
+#define VIRTUAL_PAGE_SIZE 128
+#define VIRTUAL_PAGE_BORDER 4
+#define VIRTUAL_CACHE_PAGES_PER_SIDE 16
+#define VIRTUAL_SLOT_SIZE (VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER)
+
+// Only fragments that survive the depth test ask for pages. Nothing here writes depth or discards.
+layout(early_fragment_tests) in;
+
+// The three samplers above hold the page caches of the layers, see virtualTexture.h.
+// Width and height of the finest level, level count, and where the material's pages start in the feedback
+uniform layout(location = 4) ivec4 virtualTexture;
+// The pixel of each 4x4 block writing feedback this frame
+uniform layout(location = 5) ivec2 feedbackPixel;
+// (cache slot x, cache slot y, level of the page in the slot) for every page, one mip level per level of pages
+uniform layout(binding = 3) usampler2D indirectionSampler;
+// A flag per page of every material, set for the pages sampled
+layout(std430, binding = 8) writeonly buffer VirtualTextureFeedback { uint requestedPages[]; };
+#endif
+
+// One cube per light: static geometry (cached), and dynamic geometry (redrawn when it moves)
+uniform layout(binding = 5) samplerCubeArrayShadow staticShadowSampler;
+uniform layout(binding = 6) samplerCubeArrayShadow dynamicShadowSampler;
+
 out layout(location = 0) vec4 gColor;
 out layout(location = 1) vec4 gPosition;
 out layout(location = 2) vec4 gNormal;
@@ -73,8 +100,6 @@ float attenCoeffC = 0.001f;
 vec3 noise = vec3(0.0f);
 
 // Shadows
-bool noShadow = false;
-float softShadowBallRadius = ballRadius + 1.5;
 float softShadowFactor = 1.0f;
 
 // Surface color
@@ -88,14 +113,31 @@ vec3 normNormal;
 // Roughness
 float roughness = 64.0f;
 
+// Where the material is sampled in the page caches, for virtual textures
+vec2 cacheCoordinates;
+
+
+// Fraction of light i reaching the fragment, according to the shadow atlas
+float shadowFactor(int i)
+{
+    // Offsetting along the normal keeps surfaces from shadowing themselves
+    vec3 lightToFragment = modelPos + normNormal * SHADOW_NORMAL_OFFSET - lightSource[i].coord;
+    float fragmentDepth = length(lightToFragment) / SHADOW_FAR_PLANE - SHADOW_BIAS;
+
+    // Nothing is stored beyond the far plane
+    if (fragmentDepth >= 1.0f) {
+        return 1.0f;
+    }
+
+    vec4 cubeCoord = vec4(lightToFragment, float(i));
+    return texture(staticShadowSampler, cubeCoord, fragmentDepth) * texture(dynamicShadowSampler, cubeCoord, fragmentDepth);
+}
+
 
 void render3D()
 {
     normNormal = normalize(fragmentNormal);  // Normalize interpolated normals
 
-    // Vector from fragment to ball -- for ball shadows
-    vec3 ballDir = ballPos - modelPos;
-
     // Ambient
     ambientColor = vec3(0.10f);
 
@@ -104,10 +146,8 @@ void render3D()
         vec3 lightDir = lightSource[i].coord - modelPos;
         vec3 normLightDir = normalize(lightDir);
 
-        // Ball shadows
-        softShadowFactor = 1.0f;
-
-        noShadow = false;
+        // Shadows from static and dynamic geometry
+        softShadowFactor = shadowFactor(i);
 
         // Attenuation
         float lightDistance = length(lightDir);
@@ -122,7 +162,7 @@ void render3D()
 
         // Specular contribution
         vec3 normReflLightDir = reflect(-normLightDir, normNormal);
-        vec3 normEyeDir = normalize(eyePos-modelPos);
+        vec3 normEyeDir = normalize(VIEWER_POS-modelPos);
 
         float specularIntensityRGB = pow(max(dot(normReflLightDir, normEyeDir), 0.0f), specularFactor);
 
@@ -140,50 +180,101 @@ void render3D()
     color = vec4(emittedColor + ambientColor + diffuseColor*diffuseCoeff + specularColor*specularCoeff + noise, 1.0f);
 }
 
+#if defined(RENDER_VIRTUAL_TEXTURE)
+ivec2 virtualPages(int mip)
+{
+    return max((virtualTexture.xy >> mip) / VIRTUAL_PAGE_SIZE, ivec2(1));
+}
+
+// Requests the page the texture coordinates fall in, and finds them in the page caches,
+// at the level the page is resident at, which is coarser than needed while it streams in
+vec2 virtualTextureCoordinates(vec2 uv)
+{
+    // Mip level from the pixel's footprint, in texels of the finest level
+    vec2 texelCoordinates = uv * vec2(virtualTexture.xy);
+    vec2 dx = dFdx(texelCoordinates);
+    vec2 dy = dFdy(texelCoordinates);
+    float lod = 0.5f * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0f));
+    int mip = min(int(lod), virtualTexture.z - 1);
+
+    vec2 wrapped = fract(uv);
+    ivec2 pages = virtualPages(mip);
+    ivec2 page = min(ivec2(wrapped * vec2(pages)), pages - 1);
+
+    if (ivec2(gl_FragCoord.xy) % 4 == feedbackPixel) {
+        int index = virtualTexture.w;
+        for (int level = 0; level < mip; level++) {
+            ivec2 levelPages = virtualPages(level);
+            index += levelPages.x * levelPages.y;
+        }
+        requestedPages[index + page.y * pages.x + page.x] = 1u;
+    }
+
+    uvec4 entry = texelFetch(indirectionSampler, page, mip);
+    int residentMip = int(entry.z);
+    ivec2 residentPages = virtualPages(residentMip);
+    // Texels covered by the page, fewer than its size on levels smaller than a page
+    vec2 pageTexels = vec2(max(virtualTexture.xy >> residentMip, ivec2(1)) / residentPages);
+    vec2 inPage = fract(wrapped * vec2(residentPages)) * pageTexels;
+    vec2 cacheTexel = vec2(entry.xy) * float(VIRTUAL_SLOT_SIZE) + float(VIRTUAL_PAGE_BORDER) + inPage;
+    return cacheTexel / float(VIRTUAL_SLOT_SIZE * VIRTUAL_CACHE_PAGES_PER_SIDE);
+}
+#endif
+
+// One of the material's textures at the fragment. The page caches have no mip levels of their own.
+vec4 sampleMaterial(sampler2D layer)
+{
+#if defined(RENDER_VIRTUAL_TEXTURE)
+    return textureLod(layer, cacheCoordinates, 0.0f);
+#else
+    return texture(layer, textureCoordinates);
+#endif
+}
+
 void render2D() {
     color = texture(colorSampler, textureCoordinates);
 }
 
 void renderNormalMapped() {
+#if defined(RENDER_VIRTUAL_TEXTURE)
+    cacheCoordinates = virtualTextureCoordinates(textureCoordinates);
+#endif
+
     // Assign surface color and normal vector from textures
-    surfaceColor = vec3(texture(colorSampler, textureCoordinates));
-    fragmentNormal = TBN * (vec3(texture(normalMapSampler, textureCoordinates)) * 2 - 1);  // "* 2 - 1" takes us from [0, 1] to [-1, 1]
+    surfaceColor = vec3(sampleMaterial(colorSampler));
+    fragmentNormal = TBN * (vec3(sampleMaterial(normalMapSampler)) * 2 - 1);  // "* 2 - 1" takes us from [0, 1] to [-1, 1]
 
     // For roughness
-    roughness = float(texture(roughnessMapSampler, textureCoordinates));
+    roughness = float(sampleMaterial(roughnessMapSampler));
     specularFactor = 5.0f / pow(roughness, 2);
 
     // Apply 3D lighting
     render3D();
 }
 
+// Each node type is drawn by its own permutation of this shader, chosen by the renderer through the
+// RENDER_2D, RENDER_NORMAL_MAPPED and RENDER_BLACK_HOLE feature keys. Without any of them, it draws GEOMETRY.
+// RENDER_VIRTUAL_TEXTURE streams a NORMAL_MAPPED node's textures in pages instead.
 void main()
-{   
-    if (renderMode == GEOMETRY) {
-        surfaceColor = modelColor;
-        render3D();
-        gColor = color;
-        gPosition = vec4(modelPos, 1.0f);
-        gNormal = vec4(normNormal, 1.0f);
-        gStencil = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    }
-    else if (renderMode == GEOMETRY_2D) {
-        render2D();
-        gColor = color;
-        gPosition = vec4(modelPos, 1.0f);
-        gNormal = vec4(normNormal, 1.0f);
-        gStencil = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    }
-    else if (renderMode == NORMAL_MAPPED) {
-        renderNormalMapped();
-        gColor = color;
-        gPosition = vec4(modelPos, 1.0f);
-        gNormal = vec4(normNormal, 1.0f);
-        gStencil = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    }
-    else if (renderMode == BLACK_HOLE) {
-        render3D();
-        gStencil = vec4(1.0f);
-        gBHNormal = vec4(normNormal, 1.0f);
-    }
+{
+#if defined(RENDER_BLACK_HOLE)
+    // Only the normal and mask are written (the other targets are masked), so lighting is skipped.
+    // The mask value telling the black holes apart is passed as the model color, see lensing.h.
+    normNormal = normalize(fragmentNormal);
+    gStencil = vec4(modelColor.r, 0.0f, 0.0f, 1.0f);
+    gBHNormal = vec4(normNormal, 1.0f);
+#else
+  #if defined(RENDER_2D)
+    render2D();
+  #elif defined(RENDER_NORMAL_MAPPED)
+    renderNormalMapped();
+  #else
+    surfaceColor = modelColor;
+    render3D();
+  #endif
+    gColor = color;
+    gPosition = vec4(modelPos, 1.0f);
+    gNormal = vec4(normNormal, 1.0f);
+    gStencil = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+#endif
 }
\ No newline at end of file
@@ -1,15 +1,22 @@
 #version 430 core
 
+// Both eyes are drawn by one instanced draw, each instance into its eye's layer (see stereo.h)
+#if defined(RENDER_STEREO)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+#include "uniformBlocks.glsl"
+
 in layout(location = 0) vec3 position;
 in layout(location = 1) vec3 normal_in;
 in layout(location = 2) vec2 textureCoordinates_in;
 in layout(location = 3) vec3 tangent_in;
 in layout(location = 4) vec3 bitangent_in;
 
-uniform layout(location = 3) mat4 modelMatrix;
-uniform layout(location = 4) mat3 normalMatrix;
-uniform layout(location = 5) mat4 MVP;
-uniform layout(location = 13) int renderMode;
+#if defined(RENDER_ENVIRONMENT)
+// The cube face being drawn, see environmentProbe.cpp
+uniform layout(location = 0) mat4 environmentViewProjection;
+#endif
 
 out layout(location = 0) vec3 normal_out;
 out layout(location = 1) vec2 textureCoordinates_out;
@@ -31,5 +38,20 @@ void main()
         normalize(mat3(modelMatrix) * normal_in)
     );
 
-    gl_Position = MVP * vec4(position, 1.0f);
+    // 2D geometry is drawn with the orthographic projection, environment cube faces with the face's,
+    // stereo eyes with the eye's, and everything else with the camera's, which is already multiplied
+    // into modelViewProjection
+#if defined(RENDER_2D)
+    gl_Position = orthoProjection * modelMatrix * vec4(position, 1.0f);
+#elif defined(RENDER_ENVIRONMENT)
+    gl_Position = environmentViewProjection * modelMatrix * vec4(position, 1.0f);
+#elif defined(RENDER_STEREO)
+    gl_Position = eyes[gl_InstanceID].viewProjection * modelMatrix * vec4(position, 1.0f);
+#else
+    gl_Position = modelViewProjection * vec4(position, 1.0f);
+#endif
+
+#if defined(RENDER_STEREO)
+    gl_Layer = gl_InstanceID;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+// The uniform blocks shared by every shader, pasted in where they #include this file (see Shader::load).
+// Mirrors the structs in uniformBuffers.h.
+
+#define MAX_LIGHTS 100
+#define MAX_EYES 2
+
+struct LightSource {
+    vec3 coord;
+    vec3 color;
+};
+
+// One per eye in stereo mode, where the camera's values below are those of the point between the eyes
+struct Eye {
+    mat4 viewProjection;
+    vec3 position;
+};
+
+// Per-frame uniforms, written once per frame into the uniform ring (see uniformBuffers.h)
+layout(std140, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    mat4 orthoProjection;
+    vec3 eyePos;
+    float bhRadius;
+    vec3 bhPos;
+    float bhScreenPercent;
+    vec3 bhScreenPos;
+    int viewMode;
+    vec2 screenDimensions;
+    int numLights;
+    int checkerboardParity;
+    LightSource lightSource[MAX_LIGHTS];
+    Eye eyes[MAX_EYES];
+};
+
+// Per-object uniforms, bound by offset into the uniform ring before each draw
+layout(std140, binding = 1) uniform ObjectUniforms {
+    mat4 modelMatrix;
+    mat4 modelViewProjection;
+    mat3 normalMatrix;
+    vec3 modelColor;
+    int renderMode;  // SceneNodeType enum values, selected by feature keys instead where it matters
+};
@@ -0,0 +1,145 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/shader.hpp>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "accretionDisk.h"
+
+// Particle state buffers, in the binding order of accretionDisk.comp
+enum ParticleBuffer {
+    POSITION_X, POSITION_Y, POSITION_Z, VELOCITY_X, VELOCITY_Y, VELOCITY_Z, PARTICLE_BUFFER_COUNT
+};
+
+const unsigned int VISIBLE_BUFFER_BINDING = 6;
+const unsigned int DRAW_COMMAND_BINDING = 7;
+const unsigned int DISK_WORK_GROUP_SIZE = 256;
+
+// Layout expected by glDrawArraysIndirect
+struct DrawArraysIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int first;
+    unsigned int baseInstance;
+};
+
+static Gloom::Shader* simulationShader;
+static Gloom::Shader* spriteShader;
+
+static GLBuffer particleBuffers[PARTICLE_BUFFER_COUNT];
+static GLBuffer visibleBuffer;
+static GLBuffer drawCommandBuffer;
+static GLVertexArray spriteVAO;
+
+static unsigned int diskParticleCount = 0;
+static bool particlesInitialised = false;
+static unsigned int frameSeed = 0;
+
+static float simulationTimeStep = 0;
+static glm::vec2 projectionScale;
+
+void initAccretionDisk(unsigned int particleCount) {
+    diskParticleCount = particleCount;
+
+    simulationShader = new Gloom::Shader();
+    simulationShader->attach("../res/shaders/accretionDisk.comp");
+    simulationShader->link();
+
+    spriteShader = new Gloom::Shader();
+    spriteShader->makeBasicShader("../res/shaders/accretionDisk.vert", "../res/shaders/accretionDisk.frag");
+
+    // Initial positions and velocities are generated by the first dispatch
+    for (GLBuffer &buffer : particleBuffers) {
+        buffer = createBuffer(GPU_MEMORY_STORAGE, "Disk particle state", particleCount * sizeof(float), nullptr, 0);
+    }
+
+    visibleBuffer = createBuffer(GPU_MEMORY_VERTEX, "Disk visible particles", particleCount * sizeof(glm::vec4), nullptr, 0);
+
+    // Four vertices per sprite; the instance count is filled in by the compute shader
+    DrawArraysIndirectCommand command = {4, 0, 0, 0};
+    drawCommandBuffer = createBuffer(GPU_MEMORY_STORAGE, "Disk draw command", sizeof(command), &command, 0);
+
+    // The compacted particles are read as an instanced vertex attribute
+    spriteVAO = createVertexArray("Disk sprites");
+    glVertexArrayVertexBuffer(spriteVAO, 0, visibleBuffer, 0, sizeof(glm::vec4));
+    glVertexArrayBindingDivisor(spriteVAO, 0, 1);
+    glEnableVertexArrayAttrib(spriteVAO, 0);
+    glVertexArrayAttribFormat(spriteVAO, 0, 4, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(spriteVAO, 0, 0);
+}
+
+void destroyAccretionDisk() {
+    for (GLBuffer &buffer : particleBuffers) {
+        buffer.reset();
+    }
+    visibleBuffer.reset();
+    drawCommandBuffer.reset();
+    spriteVAO.reset();
+
+    simulationShader->destroy();
+    spriteShader->destroy();
+    delete simulationShader;
+    delete spriteShader;
+
+    diskParticleCount = 0;
+    particlesInitialised = false;
+}
+
+unsigned int getAccretionDiskParticleCount() {
+    return diskParticleCount;
+}
+
+void updateAccretionDisk(float timeDelta, const glm::mat4 &projection) {
+    simulationTimeStep = std::min(timeDelta, DISK_MAX_TIME_STEP);
+    projectionScale = glm::vec2(projection[0][0], projection[1][1]);
+}
+
+void renderAccretionDisk(unsigned int eyeCount) {
+    if (diskParticleCount == 0) {
+        return;
+    }
+
+    PROFILE_ZONE("renderAccretionDisk");
+
+    // Reset the instance count; the dispatch appends every visible particle to it
+    glClearNamedBufferSubData(drawCommandBuffer, GL_R32UI, offsetof(DrawArraysIndirectCommand, instanceCount),
+                              sizeof(unsigned int), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    simulationShader->activate();
+
+    trackedUniform1f(0, simulationTimeStep);
+    trackedUniform1ui(1, diskParticleCount);
+    trackedUniform1i(2, !particlesInitialised);
+    trackedUniform1ui(3, frameSeed++);
+
+    for (unsigned int i = 0; i < PARTICLE_BUFFER_COUNT; i++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, particleBuffers[i]);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMAND_BINDING, drawCommandBuffer);
+
+    glDispatchCompute((diskParticleCount + DISK_WORK_GROUP_SIZE - 1) / DISK_WORK_GROUP_SIZE, 1, 1);
+    particlesInitialised = true;
+
+    // The compacted particles are consumed as vertex attributes, the instance count by the indirect draw
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    simulationShader->deactivate();
+
+    spriteShader->activate();
+
+    trackedUniform2fv(0, 1, glm::value_ptr(projectionScale));
+    trackedUniform1f(1, DISK_SPRITE_RADIUS);
+
+    trackedBindVertexArray(spriteVAO);
+    trackedBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    // The sprites are already instanced, so each eye takes a draw of its own
+    for (unsigned int eye = 0; eye < eyeCount; eye++) {
+        trackedUniform1i(2, eye);
+        trackedDrawArraysIndirect(GL_TRIANGLE_STRIP, nullptr);
+    }
+
+    spriteShader->deactivate();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Must match the definitions in accretionDisk.comp
+const float DISK_GRAVITATIONAL_PARAMETER = 98000.0f;  // G * M of the black hole, in scene units
+// The disk starts clear of the black hole's lensed sphere (bhRadius, 80), and particles reaching it are respawned
+const float DISK_INNER_RADIUS = 90.0f;
+const float DISK_OUTER_RADIUS = 160.0f;
+
+// World-space radius of every particle sprite
+const float DISK_SPRITE_RADIUS = 0.6f;
+
+// Longest time step taken in a single frame, so a stalled frame does not fling the disk apart
+const float DISK_MAX_TIME_STEP = 0.05f;
+
+// A disk of particles orbiting the black hole, simulated and drawn entirely on the GPU.
+// Every frame one compute dispatch integrates all particles, respawns those that fell in or escaped,
+// and compacts the ones inside the view frustum into an instance buffer.
+// They are then drawn as camera-facing sprites with a single indirect draw (one per eye in stereo).
+void initAccretionDisk(unsigned int particleCount);
+void destroyAccretionDisk();
+unsigned int getAccretionDiskParticleCount();
+
+void updateAccretionDisk(float timeDelta, const glm::mat4 &projection);
+
+// Simulates and draws the disk into the currently bound G-buffer. Reads the frame uniforms.
+// With more than one eye, the sprites are drawn once into each eye's layer of a stereo G-buffer.
+void renderAccretionDisk(unsigned int eyeCount);
@@ -0,0 +1,178 @@
+#include <unordered_map>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include <utilities/glutils.h>
+#include <utilities/shapes.h>
+#include <utilities/imageLoader.hpp>
+#include <utilities/profiler.h>
+#include "levelOfDetail.h"
+#include "assetRegistry.h"
+
+// Expired entries are only removed when they are looked up again, so destroying an asset never
+// touches the registry. That keeps assets still alive during static destruction safe to free.
+static std::unordered_map<uint64_t, std::weak_ptr<const MeshAsset>> meshes;
+static std::unordered_map<uint64_t, std::weak_ptr<const TextureAsset>> textures;
+
+static uint64_t requests = 0;
+static uint64_t reused = 0;
+
+ContentHash &ContentHash::addBytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return *this;
+}
+
+MeshAsset::~MeshAsset() {
+    deleteBuffer(vertexArrayID);
+}
+
+TextureAsset::~TextureAsset() {
+    deleteTexture(textureID);
+}
+
+// Returns the live asset stored under the hash, or nothing if it was never made or has been freed since
+template <typename Asset>
+static std::shared_ptr<const Asset> findAsset(std::unordered_map<uint64_t, std::weak_ptr<const Asset>> &assets, uint64_t contentHash) {
+    requests++;
+
+    auto entry = assets.find(contentHash);
+    if (entry == assets.end()) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const Asset> asset = entry->second.lock();
+    if (asset) {
+        reused++;
+    } else {
+        assets.erase(entry);
+    }
+    return asset;
+}
+
+static MeshHandle uploadMesh(uint64_t contentHash, const std::string &label, Mesh &mesh) {
+    std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>();
+    asset->contentHash = contentHash;
+    asset->label = label;
+    asset->vertexArrayID = generateBuffer(mesh, label);
+    asset->indexCount = mesh.indices.size();
+    computeBoundingBox(mesh, asset->boundingBoxMin, asset->boundingBoxMax);
+
+    meshes[contentHash] = asset;
+    return asset;
+}
+
+MeshHandle acquireMesh(uint64_t contentHash, const std::string &label, const std::function<Mesh()> &generate) {
+    MeshHandle asset = findAsset(meshes, contentHash);
+    if (asset) {
+        return asset;
+    }
+
+    Mesh mesh = generate();
+    return uploadMesh(contentHash, label, mesh);
+}
+
+MeshHandle acquireCube(glm::vec3 scale, glm::vec2 textureScale, bool tilingTextures, bool inverted, const std::string &label) {
+    uint64_t contentHash = ContentHash().add("cube").add(scale).add(textureScale).add(tilingTextures).add(inverted).value();
+    return acquireMesh(contentHash, label, [&] {
+        return cube(scale, textureScale, tilingTextures, inverted);
+    });
+}
+
+MeshHandle acquireQuad(const std::string &label) {
+    return acquireMesh(ContentHash().add("quad").value(), label, [] {
+        return generateQuad();
+    });
+}
+
+// Each level is keyed by the chain's hash and its own index.
+// The levels are generated together, and only if one of them is missing.
+static std::vector<MeshHandle> acquireLODChain(const ContentHash &chainHash, int levelCount, const std::string &label,
+                                               const std::function<std::vector<Mesh>()> &generate) {
+    std::vector<Mesh> generated;
+    std::vector<MeshHandle> levels;
+    for (int level = 0; level < levelCount; level++) {
+        uint64_t levelHash = ContentHash(chainHash).add(level).value();
+        MeshHandle asset = findAsset(meshes, levelHash);
+        if (!asset) {
+            if (generated.empty()) {
+                generated = generate();
+            }
+            // The chain stops early once the tessellation cannot be reduced any further
+            if (level >= int(generated.size())) {
+                break;
+            }
+            asset = uploadMesh(levelHash, fmt::format("{} LOD {}", label, level), generated.at(level));
+        }
+        levels.push_back(asset);
+    }
+
+    return levels;
+}
+
+std::vector<MeshHandle> acquireSphereLODChain(float radius, int slices, int layers, bool inverted, int levelCount,
+                                              const std::string &label) {
+    PROFILE_ZONE("acquireSphereLODChain");
+
+    ContentHash chainHash = ContentHash().add("sphereLODChain").add(radius).add(slices).add(layers).add(inverted);
+    return acquireLODChain(chainHash, levelCount, label, [&] {
+        return generateSphereLODChain(radius, slices, layers, inverted, levelCount);
+    });
+}
+
+std::vector<MeshHandle> acquireSimplifiedLODChain(uint64_t contentHash, int levelCount, const std::string &label,
+                                                  const std::function<Mesh()> &generate) {
+    PROFILE_ZONE("acquireSimplifiedLODChain");
+
+    ContentHash chainHash = ContentHash().add("simplifiedLODChain").add(contentHash);
+    return acquireLODChain(chainHash, levelCount, label, [&] {
+        return generateSimplifiedLODChain(generate(), levelCount);
+    });
+}
+
+TextureHandle acquireTexture(const std::string &fileName) {
+    PROFILE_ZONE("acquireTexture");
+
+    std::vector<unsigned char> png;
+    unsigned int error = lodepng::load_file(png, fileName);
+    if (error) {
+        fprintf(stderr, "Could not read %s: %s\n", fileName.c_str(), lodepng_error_text(error));
+    }
+
+    uint64_t contentHash = ContentHash().add(png.size()).addBytes(png.data(), png.size()).value();
+    TextureHandle existing = findAsset(textures, contentHash);
+    if (existing) {
+        return existing;
+    }
+
+    PNGImage image = decodePNGImage(png);
+
+    std::shared_ptr<TextureAsset> asset = std::make_shared<TextureAsset>();
+    asset->contentHash = contentHash;
+    asset->label = fileName.substr(fileName.find_last_of('/') + 1);
+    asset->textureID = setUpTexture(image, asset->label);
+    asset->width = image.width;
+    asset->height = image.height;
+
+    textures[contentHash] = asset;
+    return asset;
+}
+
+std::string formatAssetRegistryStats() {
+    unsigned int liveMeshes = 0;
+    unsigned int liveTextures = 0;
+    long handles = 0;
+    for (const auto &entry : meshes) {
+        liveMeshes += entry.second.expired() ? 0 : 1;
+        handles += entry.second.use_count();
+    }
+    for (const auto &entry : textures) {
+        liveTextures += entry.second.expired() ? 0 : 1;
+        handles += entry.second.use_count();
+    }
+
+    return fmt::format("Assets: {} meshes and {} textures shared by {} handles; {} of {} requests reused an existing one\n",
+                       liveMeshes, liveTextures, handles, reused, requests);
+}
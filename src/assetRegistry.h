@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <glm/glm.hpp>
+#include <utilities/mesh.h>
+
+// Meshes and textures shared by every node that uses them.
+// Each is keyed by a content hash: of the parameters a mesh is generated from, or of the bytes of an
+// image file. Asking for the same content again returns the resource already uploaded, however many
+// nodes use it, and it is freed once the last handle to it is gone. The CPU-side mesh is only kept
+// while it is being uploaded.
+
+// 64-bit FNV-1a over everything added to it
+class ContentHash {
+public:
+    ContentHash &addBytes(const void* data, size_t size);
+
+    template <typename T>
+    ContentHash &add(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be hashed by their bytes");
+        return addBytes(&value, sizeof(T));
+    }
+
+    ContentHash &add(const std::string &text) {
+        add(text.size());
+        return addBytes(text.data(), text.size());
+    }
+
+    ContentHash &add(const char* text) {
+        return add(std::string(text));
+    }
+
+    uint64_t value() const { return hash; }
+
+private:
+    uint64_t hash = 14695981039346656037ull;
+};
+
+struct GPUAsset {
+    virtual ~GPUAsset() = default;
+    uint64_t contentHash = 0;
+    std::string label;
+};
+
+struct MeshAsset : GPUAsset {
+    ~MeshAsset() override;
+    unsigned int vertexArrayID = 0;
+    unsigned int indexCount = 0;
+    glm::vec3 boundingBoxMin = glm::vec3(0);
+    glm::vec3 boundingBoxMax = glm::vec3(0);
+};
+
+struct TextureAsset : GPUAsset {
+    ~TextureAsset() override;
+    unsigned int textureID = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+};
+
+using MeshHandle = std::shared_ptr<const MeshAsset>;
+using TextureHandle = std::shared_ptr<const TextureAsset>;
+
+// Returns the mesh with this content hash, calling generate() to make it only if there is none yet
+MeshHandle acquireMesh(uint64_t contentHash, const std::string &label, const std::function<Mesh()> &generate);
+
+// The generators of shapes.h and levelOfDetail.h, keyed by their parameters
+MeshHandle acquireCube(glm::vec3 scale, glm::vec2 textureScale, bool tilingTextures, bool inverted, const std::string &label);
+MeshHandle acquireQuad(const std::string &label);
+std::vector<MeshHandle> acquireSphereLODChain(float radius, int slices, int layers, bool inverted, int levelCount,
+                                              const std::string &label);
+// The full-detail mesh made by generate(), keyed by contentHash, followed by its simplified levels
+std::vector<MeshHandle> acquireSimplifiedLODChain(uint64_t contentHash, int levelCount, const std::string &label,
+                                                  const std::function<Mesh()> &generate);
+
+// Keyed by the file's bytes, so the same image under two names is only uploaded once
+TextureHandle acquireTexture(const std::string &fileName);
+
+// Resources currently alive, and how many requests were served by one of them
+std::string formatAssetRegistryStats();
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <chrono>
+#include <iterator>
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <utilities/shader.hpp>
@@ -13,12 +15,31 @@
 #include <fmt/format.h>
 #include "bhSimulation.h"
 #include "sceneGraph.hpp"
+#include "occlusionCulling.h"
+#include "levelOfDetail.h"
+#include "uniformBuffers.h"
+#include "shadowAtlas.h"
+#include "environmentProbe.h"
+#include "virtualTexture.h"
+#include "accretionDisk.h"
+#include "nbodySimulation.h"
+#include "hudText.h"
+#include "assetRegistry.h"
+#include "lensing.h"
+#include "checkerboard.h"
+#include "stereo.h"
+#include "gpuTransforms.h"
+#include "frameGraph.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 #include "utilities/camera.hpp"
 
 #include "utilities/imageLoader.hpp"
 #include "utilities/glfont.h"
+#include "utilities/profiler.h"
+#include "utilities/renderStats.h"
+#include "utilities/gpuResources.h"
+#include "utilities/matrixKernels.h"
 
 // 3D geometry nodes
 SceneNode* rootNode;
@@ -29,8 +50,9 @@ std::vector<SceneNode*> ballNodes;
 // 2D geometry nodes
 SceneNode* textbox0Node;
 SceneNode* textbox1Node;
-// BH nodes
+// BH nodes. The first is bhNode, which the balls and the accretion disk orbit.
 SceneNode* bhNode;
+std::vector<SceneNode*> bhNodes;
 // Light nodes
 SceneNode* light0Node;
 SceneNode* light1Node;
@@ -49,9 +71,12 @@ std::vector<SceneNode*> lightNodes;
 float FOV = glm::radians(80.0f);
 
 // Screen-filling quad for deferred rendering
-unsigned int screenQuadVAO;
-Mesh screenQuad;
+MeshHandle screenQuad;
 
+// Render passes and their targets, declared anew every frame
+FrameGraph frameGraph;
+
+// This frame's G-buffer textures, as handed out by the frame graph. Its fboID is unused.
 Framebuffer gBuffer;
 
 unsigned int NUM_LIGHTS = 3;
@@ -59,11 +84,35 @@ unsigned int NUM_LIGHTS = 3;
 float ballRadius = 3.0f;
 float bhRadius = 80.0f;
 
+// Size of the black holes circling bhNode, relative to it, and the radius of their circle
+const float COMPANION_BH_SCALE = 0.25f;
+const float COMPANION_BH_ORBIT_RADIUS = 120.0f;
+
 // These are heap allocated, because they should not be initialised at the start of the program
 Gloom::Shader* gBufferShader;
 Gloom::Shader* deferredShader;
 Gloom::Camera* camera;
 
+// In GBufferFeature bit order
+const std::vector<std::string> G_BUFFER_FEATURE_KEYS = {
+    "RENDER_2D", "RENDER_NORMAL_MAPPED", "RENDER_BLACK_HOLE", "RENDER_ENVIRONMENT", "RENDER_VIRTUAL_TEXTURE",
+    "RENDER_STEREO"
+};
+
+// Feature keys of deferredShader: the view modes, in ViewMode order after REGULAR, which uses the permutation
+// without features, then the resolve of both layers of a stereo G-buffer
+const std::vector<std::string> DEFERRED_FEATURE_KEYS = {
+    "VIEW_COLOR", "VIEW_POSITION", "VIEW_DISTANCE", "VIEW_NORMALS", "VIEW_STENCIL", "VIEW_BH_NORMALS", "RENDER_STEREO"
+};
+const unsigned int DEFERRED_STEREO_FEATURE = 1 << 6;
+
+static unsigned int viewModeFeatures(ViewMode mode) {
+    return (mode == REGULAR) ? 0 : 1u << (mode - 1);
+}
+
+ThreadPool* threadPool;
+NBodySimulation* orbitSimulation;
+
 const glm::vec3 boxDimensions(360, 360, 360);
 
 glm::vec3 ballPosition(0.0f, 0.0f, 0.0f);
@@ -73,8 +122,20 @@ glm::vec3 bhPosition(0.0f, 0.0f, 0.0f);
 glm::mat4 perspVP;
 glm::mat4 orthoVP;
 
+// The graph does not change shape after initScene()
+FlattenedSceneGraph flattenedScene;
+
+// The nodes given ObjectUniforms (indices into flattenedScene.nodes), and their matrices for this frame
+std::vector<unsigned int> drawableNodes;
+std::vector<glm::mat4> drawableModelMatrices;
+std::vector<glm::mat4> drawableMVPMatrices;
+std::vector<NormalMatrix> drawableNormalMatrices;
+
 CommandLineOptions options;
 
+// Filled in while updating the frame, then copied into the uniform ring in one go
+FrameUniforms frameUniforms;
+
 bool mouseLeftPressed   = false;
 bool mouseLeftReleased  = false;
 bool mouseRightPressed  = false;
@@ -86,6 +147,28 @@ double totalElapsedTime = debug_startTime;
 double gameElapsedTime = debug_startTime;
 
 ViewMode viewMode = REGULAR;
+bool showStatsOverlay = false;
+bool checkerboardRendering = false;
+bool stereoRendering = false;
+
+// Replaces the measured frame time, making the simulations reproducible. A step of zero freezes them.
+bool useFixedTimeStep = false;
+double fixedTimeStep = 0;
+
+// Set while rendering one tile of a larger image, see tiledRender.h
+bool useProjectionOverride = false;
+glm::mat4 projectionOverride;
+float fieldOfViewOverride;
+
+// Occlusion culling counters and frame stats are printed this often (in frames)
+const unsigned int STATS_PRINT_INTERVAL = 300;
+unsigned int frameCount = 0;
+
+// Height of the stats overlay's characters, in pixels
+const float STATS_OVERLAY_TEXT_HEIGHT = 18.0f;
+// Weight of the newest frame in the overlay's averaged frame interval
+const double STATS_OVERLAY_SMOOTHING = 0.05;
+double smoothedFrameInterval = 0;
 
 //// A few lines to help you if you've never used c++ structs
  //struct LightSource {
@@ -132,8 +215,7 @@ std::vector<glm::vec3> basicColors = {
 
 void createBoxGrid(int numRows, int numColumns, int numLayers, float size, float distance, glm::vec3 startingCoordinates) {
     glm::vec3 dimensions = glm::vec3(size, size, size);
-    Mesh protoBox = cube(dimensions, glm::vec2(90), true, false);
-    unsigned int protoBoxVAO = generateBuffer(protoBox);
+    MeshHandle protoBox = acquireCube(dimensions, glm::vec2(90), true, false, "Grid box");
 
     boxNodes.resize(numRows*numColumns*numLayers);
     for (int row = 0; row < numRows; row++) {
@@ -142,7 +224,7 @@ void createBoxGrid(int numRows, int numColumns, int numLayers, float size, float
                 int index = row * numColumns * numLayers + column * numLayers + layer;
                 SceneNode* node = createSceneNode();
                 boxNodes.at(index) = node;
-                node->VAOIndexCount    = protoBox.indices.size();
+                node->VAOIndexCount    = protoBox->indexCount;
                 node->nodeType         = GEOMETRY;
                 node->position         = glm::vec3(row, column, layer) * glm::vec3(distance) + startingCoordinates;
                 
@@ -154,12 +236,66 @@ void createBoxGrid(int numRows, int numColumns, int numLayers, float size, float
 
 
                 rootNode->children.push_back(node);
-                node->vertexArrayObjectID = protoBoxVAO;
+                node->vertexArrayObjectID = protoBox->vertexArrayID;
+                node->boundingBoxMin = protoBox->boundingBoxMin;
+                node->boundingBoxMax = protoBox->boundingBoxMax;
+                node->assets.push_back(protoBox);
             }
         }
     }
 }
 
+// Balls orbiting the black hole, sharing the meshes of ballNode. Their motion is simulated by orbitSimulation.
+void createOrbitingBalls(int count) {
+    NBodySettings settings;
+    settings.centre = bhNode->position;
+    settings.captureRadius = bhRadius * 0.5f;
+    orbitSimulation = new NBodySimulation(settings, threadPool);
+    orbitSimulation->addOrbitingBodies(count, 100.0f, 160.0f, 20.0f, 0.25f);
+
+    ballNodes.resize(count);
+    for (int i = 0; i < count; i++) {
+        SceneNode* node = createSceneNode();
+        ballNodes.at(i) = node;
+        node->lodLevels           = ballNode->lodLevels;
+        node->vertexArrayObjectID = ballNode->vertexArrayObjectID;
+        node->VAOIndexCount       = ballNode->VAOIndexCount;
+        node->boundingBoxMin      = ballNode->boundingBoxMin;
+        node->boundingBoxMax      = ballNode->boundingBoxMax;
+        node->assets              = ballNode->assets;
+        node->scale               = glm::vec3(1.5f);
+        node->color               = basicColors.at(i % basicColors.size());
+        node->position            = orbitSimulation->position(i);
+        node->isDynamic           = true;
+        // Dozens of moving balls would have the dynamic shadow atlas redrawn every frame
+        node->castsShadows        = false;
+
+        rootNode->children.push_back(node);
+    }
+}
+
+// Smaller black holes evenly spread on a circle around bhNode, sharing its meshes
+void createCompanionBlackHoles(int count) {
+    for (int i = 0; i < count; i++) {
+        float angle = glm::radians(360.0f * float(i) / float(count));
+
+        SceneNode* node = createSceneNode();
+        bhNodes.push_back(node);
+        node->lodLevels           = bhNode->lodLevels;
+        node->vertexArrayObjectID = bhNode->vertexArrayObjectID;
+        node->VAOIndexCount       = bhNode->VAOIndexCount;
+        node->boundingBoxMin      = bhNode->boundingBoxMin;
+        node->boundingBoxMax      = bhNode->boundingBoxMax;
+        node->assets              = bhNode->assets;
+        node->nodeType            = BLACK_HOLE;
+        node->scale               = glm::vec3(COMPANION_BH_SCALE);
+        node->position            = bhNode->position + COMPANION_BH_ORBIT_RADIUS * glm::vec3(glm::cos(angle), 0.0f, glm::sin(angle));
+        node->color               = glm::vec3(blackHoleMaskValue(bhNodes.size() - 1));
+
+        rootNode->children.push_back(node);
+    }
+}
+
 // Create an NxNxN grid of lights centered around the origin, with extremes (-160, -160, -160) and (160, 160, 160)
 void createLightGrid(int N) {
     lightNodes.resize(N * N * N);
@@ -188,8 +324,26 @@ void createLightGrid(int N) {
 }
 
 void initScene(GLFWwindow* window, CommandLineOptions clOptions) {
+    PROFILE_ZONE("initScene");
+
     options = clOptions;
 
+    if (options.enableStereo) {
+        stereoRendering = isStereoSupported();
+        if (!stereoRendering) {
+            std::cout << "Stereo rendering needs GL_ARB_shader_viewport_layer_array, rendering in mono" << std::endl;
+        }
+    }
+    // Both need a single image per frame: the Hi-Z pyramid is built from one depth buffer,
+    // and the checkerboard history is not layered
+    if (stereoRendering && (options.enableOcclusionCulling || options.enableCheckerboard)) {
+        std::cout << "Occlusion culling and checkerboard rendering are disabled in stereo" << std::endl;
+        options.enableOcclusionCulling = false;
+        options.enableCheckerboard = false;
+    }
+
+    setGPUMemoryBudget(uint64_t(options.gpuMemoryBudgetMB) * 1024 * 1024);
+
     // Initialise camera object
     camera = new Gloom::Camera(glm::vec3(0, 2, 100), 15.0f, 0.005f);
     glfwSetWindowUserPointer(window, camera);
@@ -204,18 +358,19 @@ void initScene(GLFWwindow* window, CommandLineOptions clOptions) {
     glfwSetCursorPosCallback(window, cursorPosCallback);
 
     gBufferShader = new Gloom::Shader();
-    gBufferShader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/simple.frag");
+    gBufferShader->makePermutedShader({ "../res/shaders/simple.vert", "../res/shaders/simple.frag" }, G_BUFFER_FEATURE_KEYS);
 
     deferredShader = new Gloom::Shader();
-    deferredShader->makeBasicShader("../res/shaders/deferred.vert", "../res/shaders/deferred.frag");
-
-    // Create meshes
-    Mesh box = cube(boxDimensions, glm::vec2(90), true, true);
-    Mesh sphere = generateSphere(1.0, 40, 40, false);
+    deferredShader->makePermutedShader({ "../res/shaders/deferred.vert", "../res/shaders/deferred.frag" }, DEFERRED_FEATURE_KEYS);
 
-    // Fill buffers
-    unsigned int boxVAO  = generateBuffer(box);
-    unsigned int ballVAO = generateBuffer(sphere);
+    // Create meshes, or share the ones already uploaded
+    MeshHandle box = acquireCube(boxDimensions, glm::vec2(90), true, true, "Room box");
+    // The ball's coarser levels are simplified from the full sphere, rather than tessellated from scratch,
+    // so they keep its silhouette with fewer triangles
+    uint64_t ballHash = ContentHash().add("sphere").add(1.0f).add(40).add(40).add(false).value();
+    std::vector<MeshHandle> sphereLODs = acquireSimplifiedLODChain(ballHash, 4, "Ball", [] {
+        return generateSphere(1.0f, 40, 40, false);
+    });
 
     // Construct scene
     rootNode = createSceneNode();
@@ -225,15 +380,18 @@ void initScene(GLFWwindow* window, CommandLineOptions clOptions) {
     rootNode->children.push_back(boxNode);
     rootNode->children.push_back(ballNode);
 
-    boxNode->vertexArrayObjectID     = boxVAO;
-    boxNode->VAOIndexCount           = box.indices.size();
+    boxNode->vertexArrayObjectID     = box->vertexArrayID;
+    boxNode->VAOIndexCount           = box->indexCount;
     boxNode->nodeType                = NORMAL_MAPPED;
+    boxNode->boundingBoxMin          = box->boundingBoxMin;
+    boxNode->boundingBoxMax          = box->boundingBoxMax;
+    boxNode->assets.push_back(box);
     glm::vec3 boxCoordinates = glm::vec3(0, 0, 0);
     boxNode->position = { boxCoordinates };
 
-    ballNode->vertexArrayObjectID    = ballVAO;
-    ballNode->VAOIndexCount          = sphere.indices.size();
+    setUpLODChain(ballNode, sphereLODs);
     ballNode->position = { 0, 0, -100 };
+    ballNode->isDynamic = true;
     
 
     // Make box grid
@@ -242,36 +400,49 @@ void initScene(GLFWwindow* window, CommandLineOptions clOptions) {
     createBoxGrid(2, 2, 2, 20.0f, boxGridDistances, boxGridCoordinates);
 
     /* Add textures for walls */
-    // Load textures
-    PNGImage wallDiffuseImage = loadPNGFile("../res/textures/Brick03_col.png");
-    PNGImage wallNormalMapImage = loadPNGFile("../res/textures/Brick03_nrm.png");
-    PNGImage roughnessMapImage = loadPNGFile("../res/textures/Brick03_rgh.png");
-
-    // Set up and configure OpenGL textures for the wall's diffuse and normal maps
-    boxNode->textureID = setUpTexture(wallDiffuseImage);
-    boxNode->normalMapID = setUpTexture(wallNormalMapImage);
-    boxNode->roughnessMapID = setUpTexture(roughnessMapImage);
+    std::vector<std::string> wallTextures = {
+        "../res/textures/Brick03_col.png", "../res/textures/Brick03_nrm.png", "../res/textures/Brick03_rgh.png"
+    };
+
+    // The wall's diffuse, normal and roughness maps, streamed in as the pages are seen
+    initVirtualTextures();
+    boxNode->virtualMaterialID = loadVirtualMaterial("Room walls", wallTextures);
+
+    // Loaded whole if they could not be baked into pages
+    if (boxNode->virtualMaterialID < 0) {
+        TextureHandle wallDiffuse = acquireTexture(wallTextures[0]);
+        TextureHandle wallNormalMap = acquireTexture(wallTextures[1]);
+        TextureHandle roughnessMap = acquireTexture(wallTextures[2]);
+
+        boxNode->textureID = wallDiffuse->textureID;
+        boxNode->normalMapID = wallNormalMap->textureID;
+        boxNode->roughnessMapID = roughnessMap->textureID;
+        boxNode->assets.insert(boxNode->assets.end(), { wallDiffuse, wallNormalMap, roughnessMap });
+    }
     /* Add textures for walls */
 
     /* Add BH */
-    Mesh bhSphere = generateSphere(bhRadius, 100, 100, true);
-
-    unsigned int bhVAO = generateBuffer(bhSphere);
+    std::vector<MeshHandle> bhSphereLODs = acquireSphereLODChain(bhRadius, 100, 100, true, 4, "Black hole");
 
     bhNode = createSceneNode();
 
     rootNode->children.push_back(bhNode);
 
-    bhNode->vertexArrayObjectID    = bhVAO;
-    bhNode->VAOIndexCount          = bhSphere.indices.size();
+    setUpLODChain(bhNode, bhSphereLODs);
     bhNode->nodeType               = BLACK_HOLE;
     bhNode->position               = glm::vec3(0, 0, 0);
+    bhNode->color                  = glm::vec3(blackHoleMaskValue(0));
+    bhNodes.push_back(bhNode);
+
+    int blackHoleCount = std::min<int>(options.blackHoleCount, MAX_BLACK_HOLES);
+    createCompanionBlackHoles(blackHoleCount - 1);
     /* Add BH */
 
-    /* Add screen-filling quad */
-    screenQuad = generateQuad();
+    threadPool = new ThreadPool();
+    createOrbitingBalls(options.orbitingBallCount);
 
-    screenQuadVAO = generateBuffer(screenQuad);
+    /* Add screen-filling quad */
+    screenQuad = acquireQuad("Screen quad");
     /* Add screen-filling quad */
 
 
@@ -302,72 +473,262 @@ void initScene(GLFWwindow* window, CommandLineOptions clOptions) {
 
     createLightGrid(3);
 
-    gBufferShader->activate();
-    glUniform1i(6, NUM_LIGHTS);  // Note: doing this here assumes NUM_LIGHTS is constant after this
-    gBufferShader->deactivate();
+    // Note: doing this here assumes NUM_LIGHTS is constant after this
+    frameUniforms.numLights = std::min<int>(NUM_LIGHTS, MAX_LIGHTS);
     /* Add point lights */
 
     getTimeDeltaSeconds();
 
     std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
 
-    gBuffer = initGBuffer();
+    flattenSceneGraph(rootNode, flattenedScene);
+    for (size_t i = 0; i < flattenedScene.nodes.size(); i++) {
+        SceneNode* node = flattenedScene.nodes[i];
+        bool drawable = node->vertexArrayObjectID != -1
+            && node->nodeType != POINT_LIGHT && node->nodeType != SPOT_LIGHT;
+        if (drawable) {
+            drawableNodes.push_back(i);
+        }
+    }
+    drawableModelMatrices.resize(drawableNodes.size());
+    drawableMVPMatrices.resize(drawableNodes.size());
+    drawableNormalMatrices.resize(drawableNodes.size());
+
+    // The drawable nodes' ObjectUniforms stay where the compute shader writes them
+    if (options.enableGPUTransforms) {
+        initGPUTransforms(flattenedScene, drawableNodes);
+        for (size_t i = 0; i < drawableNodes.size(); i++) {
+            SceneNode* node = flattenedScene.nodes[drawableNodes[i]];
+            node->uniformOffset = getGPUObjectUniformsOffset(i);
+            node->uniformBuffer = getGPUObjectUniformsBuffer();
+        }
+    }
+
+    initLensing();
+    if (stereoRendering) {
+        initStereo();
+    }
+
+    checkerboardRendering = options.enableCheckerboard;
+
+    // Room for every node in the scene, although lights and empty nodes never use theirs, and the HUD
+    initUniformBuffers(totalChildren(rootNode) + 2);
+
+    showStatsOverlay = options.showStatsOverlay;
+    initHUDText(gBufferShader, RENDER_2D_FEATURE);
+
+    initShadowAtlas(rootNode, NUM_LIGHTS);
+    initEnvironmentProbe(rootNode, gBufferShader);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fboID);
+    if (options.particleCount > 0) {
+        initAccretionDisk(options.particleCount);
+    }
+
+    if (options.enableOcclusionCulling) {
+        initOcclusionCulling(rootNode);
+    }
+
+    if (options.enableGPUStats) {
+        initRenderStats();
+    }
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    std::cout << formatGPUMemoryReport();
+    std::cout << formatAssetRegistryStats();
 }
 
-void updateUniforms(glm::mat4 cameraTransform) {
-    /// First pass uniforms
-    // Pass camera position to fragment shader, for specular lighting
-    glm::vec3 eyePosition = glm::vec3(glm::inverse(cameraTransform) * glm::vec4(0, 0, 0, 1));
-    gBufferShader->activate();
+static void deleteSceneNodes(SceneNode* node) {
+    for (SceneNode* child : node->children) {
+        deleteSceneNodes(child);
+    }
+    delete node;
+}
 
-    glUniform3fv(10, 1, glm::value_ptr(eyePosition));
+void destroyScene() {
+    PROFILE_ZONE("destroyScene");
 
-    // For shadow calculation
-    glm::vec3 ballPos = glm::vec3(ballNode->currentTransformationMatrix * glm::vec4(0, 0, 0, 1));
-    glUniform3fv(11, 1, glm::value_ptr(ballPos));
-    glUniform1f(12, float(ballRadius));
+    // Meshes and textures are freed with the last node holding them, in deleteSceneNodes() below
+    screenQuad.reset();
+    frameGraph.releaseTextures();
+    releaseCheckerboardGBuffer();
 
-    gBufferShader->deactivate();
+    destroyHUDText();
+    if (options.particleCount > 0) {
+        destroyAccretionDisk();
+    }
+    if (options.enableOcclusionCulling) {
+        destroyOcclusionCulling();
+    }
+    destroyShadowAtlas();
+    destroyEnvironmentProbe();
+    destroyVirtualTextures();
+    if (options.enableGPUTransforms) {
+        destroyGPUTransforms();
+    }
+    destroyLensing();
+    if (stereoRendering) {
+        destroyStereo();
+        stereoRendering = false;
+    }
+    destroyUniformBuffers();
+
+    gBufferShader->destroy();
+    deferredShader->destroy();
+    delete gBufferShader;
+    delete deferredShader;
+
+    deleteSceneNodes(rootNode);
+    rootNode = nullptr;
+    flattenedScene = FlattenedSceneGraph();
+    drawableNodes.clear();
+    boxNodes.clear();
+    ballNodes.clear();
+    bhNodes.clear();
+    lightNodes.clear();
+
+    delete orbitSimulation;
+    delete threadPool;
+    delete camera;
+    camera = nullptr;
+}
 
-    /// Deferred shader uniforms
-    deferredShader->activate();
+// Window coordinates of a point, with its depth in z
+static glm::vec3 projectToScreen(const glm::mat4 &viewProjection, glm::vec3 position) {
+    glm::vec4 clipPos = viewProjection * glm::vec4(position, 1.0f);
+    glm::vec3 ndcPos = glm::vec3(clipPos) / clipPos.w;
+    float screenX = (windowWidth / 2.0f) * (ndcPos.x + 1.0f);
+    float screenY = (windowHeight / 2.0f) * (ndcPos.y + 1.0f);
+    float screenZ = (ndcPos.z + 1.0f) / 2.0f;
+    return glm::vec3(screenX, screenY, screenZ);
+}
+
+void updateUniforms(glm::mat4 cameraTransform, glm::mat4 projection, float fieldOfView) {
+    PROFILE_ZONE("updateUniforms");
 
-    glUniform3fv(10, 1, glm::value_ptr(eyePosition));
+    frameUniforms.viewProjection = perspVP;
+    frameUniforms.orthoProjection = orthoVP;
+
+    // Camera position, for specular lighting and lensing
+    glm::vec3 eyePosition = glm::vec3(glm::inverse(cameraTransform) * glm::vec4(0, 0, 0, 1));
+    frameUniforms.eyePos = eyePosition;
 
     glm::vec3 bhPos = glm::vec3(bhNode->currentTransformationMatrix * glm::vec4(0, 0, 0, 1));
-    glUniform3fv(14, 1, glm::value_ptr(bhPos));
+    frameUniforms.bhPos = bhPos;
 
-    glm::vec4 bhWorldPos = bhNode->currentTransformationMatrix * glm::vec4(0, 0, 0, 1);
-    glm::vec4 bhClipPos = perspVP * bhWorldPos;
-    glm::vec3 bhNdcPos = glm::vec3(bhClipPos) / bhClipPos.w;
-    float bhScreenX = (windowWidth / 2.0f) * (bhNdcPos.x + 1.0f);
-    float bhScreenY = (windowHeight / 2.0f) * (bhNdcPos.y + 1.0f);
-    float bhScreenZ = (bhNdcPos.z + 1.0f) / 2.0f;
-    glm::vec3 bhScreenPos = glm::vec3(bhScreenX, bhScreenY, bhScreenZ);
-    glUniform3fv(15, 1, glm::value_ptr(bhScreenPos));
+    frameUniforms.bhScreenPos = projectToScreen(perspVP, bhPos);
 
-    glUniform1f(16, bhRadius);
+    frameUniforms.bhRadius = bhRadius;
+    frameUniforms.bhScreenPercent = projectedScreenCoverage(bhRadius, glm::length(eyePosition - bhPos), fieldOfView);
 
-    float bhFrustumHeight = 2 * tan(FOV / 2.0f) * glm::length(eyePosition - bhPos);
-    float bhScreenPercent = bhRadius*2 / bhFrustumHeight;
-    glUniform1f(17, bhScreenPercent);
+    // In mono, every eye is the camera
+    glm::mat4 eyeViews[MAX_EYES];
+    if (stereoRendering) {
+        stereoEyeViews(cameraTransform, eyeViews);
+    }
+    else {
+        std::fill(std::begin(eyeViews), std::end(eyeViews), cameraTransform);
+    }
 
-    glm::vec2 screenDimensions = glm::vec2(windowWidth, windowHeight);
-    glUniform2fv(18, 1, glm::value_ptr(screenDimensions));
+    LensingView lensingViews[MAX_EYES];
+    for (unsigned int i = 0; i < MAX_EYES; i++) {
+        EyeUniforms &eye = frameUniforms.eyes[i];
+        eye.viewProjection = projection * eyeViews[i];
+        eye.position = glm::vec3(glm::inverse(eyeViews[i]) * glm::vec4(0, 0, 0, 1));
+        lensingViews[i] = { eye.viewProjection };
+    }
+    updateLensing(bhNodes, lensingViews, stereoRendering ? STEREO_EYE_COUNT : 1);
 
-    glUniform1i(19, viewMode);
+    frameUniforms.screenDimensions = glm::vec2(windowWidth, windowHeight);
+    frameUniforms.viewMode = viewMode;
+    frameUniforms.checkerboardParity = checkerboardRendering ? advanceCheckerboard() : -1;
 
-    deferredShader->deactivate();
+    // Light positions were filled in by updateNodeTransformations()
+    writeFrameUniforms(frameUniforms);
+}
+
+// Writes the matrices and material of every drawable node into the uniform ring.
+// The matrices of all of them are computed in batches first.
+void updateObjectUniforms() {
+    PROFILE_ZONE("updateObjectUniforms");
+
+    // Only the nodes that changed are uploaded, and the GPU computes the rest, see gpuTransforms.h
+    if (options.enableGPUTransforms) {
+        updateGPUTransforms(flattenedScene);
+        return;
+    }
+
+    for (size_t i = 0; i < drawableNodes.size(); i++) {
+        drawableModelMatrices[i] = flattenedScene.worldMatrices[drawableNodes[i]];
+    }
+
+    MatrixKernel kernel = bestMatrixKernel();
+    computeNormalMatrices(drawableModelMatrices.data(), drawableNormalMatrices.data(), drawableNodes.size(), kernel);
+    // 2D nodes are projected with the orthographic projection in simple.vert instead
+    multiplyMatrices(perspVP, drawableModelMatrices.data(), drawableMVPMatrices.data(), drawableNodes.size(), kernel);
+
+    for (size_t i = 0; i < drawableNodes.size(); i++) {
+        SceneNode* node = flattenedScene.nodes[drawableNodes[i]];
+
+        ObjectUniforms uniforms;
+        uniforms.modelMatrix = drawableModelMatrices[i];
+        uniforms.modelViewProjection = drawableMVPMatrices[i];
+        for (int column = 0; column < 3; column++) {
+            uniforms.normalMatrix[column] = drawableNormalMatrices[i].columns[column];
+        }
+
+        // For non-textured surface colors
+        uniforms.modelColor = node->color;
+        uniforms.renderMode = node->nodeType;
+
+        node->uniformOffset = writeObjectUniforms(uniforms);
+    }
+}
+
+// Frame rate, counters and GPU pass times of the latest measured frame, in the top left corner
+void addStatsOverlay(double frameInterval) {
+    PROFILE_ZONE("addStatsOverlay");
+
+    smoothedFrameInterval += (frameInterval - smoothedFrameInterval) * STATS_OVERLAY_SMOOTHING;
+
+    std::string text = fmt::format("{:.0f} fps, {:.2f} ms/frame\n", 1.0 / std::max(smoothedFrameInterval, 1e-6),
+                                   smoothedFrameInterval * 1000.0);
+    text += formatFrameStatsSummary(getLatestFrameStats());
+
+    if (options.enableOcclusionCulling) {
+        OcclusionStats stats = getOcclusionStats();
+        text += fmt::format("Culled {} of {} draws\n", stats.frustumCulled + stats.occludedLate, stats.tested);
+    }
+    text += fmt::format("{} orbiting balls, {} disk particles\n", ballNodes.size(), options.particleCount);
+    text += fmt::format("{} of {} black holes on screen, lensing {} tiles\n", getVisibleBlackHoleCount(), bhNodes.size(),
+                        getLensingTileCount());
+    text += fmt::format("Environment map: {} faces redrawn, {} waiting\n", getEnvironmentFacesRedrawn(),
+                        getEnvironmentFacesPending());
+    if (options.enableGPUTransforms) {
+        GPUTransformStats transforms = getGPUTransformStats();
+        text += fmt::format("GPU transforms: {} of {} nodes uploaded in {} runs, {} levels\n", transforms.nodesUploaded,
+                            transforms.nodeCount, transforms.uploads, transforms.levels);
+    }
+    VirtualTextureStats virtualTextures = getVirtualTextureStats();
+    text += fmt::format("Virtual textures: {} of {} pages resident, {} streaming, {} uploaded\n",
+                        virtualTextures.residentPages, virtualTextures.cachePages, virtualTextures.streamingPages,
+                        virtualTextures.uploadedPages);
+    text += frameGraph.formatStats();
+    text += formatGPUMemorySummary() + "\n";
+
+    addHUDText(STATS_OVERLAY_TEXT_HEIGHT, STATS_OVERLAY_TEXT_HEIGHT, STATS_OVERLAY_TEXT_HEIGHT, text);
 }
 
 void updateFrame(GLFWwindow* window) {
+    PROFILE_ZONE("updateFrame");
+
+    // Blocks if the GPU is still reading the uniforms written three frames ago
+    beginUniformFrame();
+    beginHUDFrame();
+
     // double timeDelta = getTimeDeltaSeconds();
 
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1)) {
@@ -386,13 +747,21 @@ void updateFrame(GLFWwindow* window) {
     }
 
     glm::mat4 perspProjection = glm::perspective(FOV, float(windowWidth) / float(windowHeight), 0.1f, 1000.f);
+    float fieldOfView = FOV;
+    if (useProjectionOverride) {
+        perspProjection = projectionOverride;
+        fieldOfView = fieldOfViewOverride;
+    }
     glm::mat4 orthoProjection = glm::ortho(0.0f, float(windowWidth), 0.0f, float(windowHeight), 0.1f, 350.f);
     
-    camera->updateCamera(getTimeDeltaSeconds());
+    double measuredTimeDelta = getTimeDeltaSeconds();
+    double timeDelta = measuredTimeDelta;
+    if (useFixedTimeStep) {
+        timeDelta = fixedTimeStep;
+    }
+    camera->updateCamera(timeDelta);
     glm::mat4 cameraTransform = camera->getViewMatrix();
 
-    updateUniforms(cameraTransform);
-
     perspVP = perspProjection * cameraTransform;
     orthoVP = orthoProjection;
 
@@ -400,154 +769,194 @@ void updateFrame(GLFWwindow* window) {
     ballNode->scale = glm::vec3(ballRadius);
     ballNode->rotation = { 0, totalElapsedTime*2, 0 };
 
-    updateNodeTransformations(rootNode, glm::mat4(1.0f));
-}
+    orbitSimulation->update(timeDelta);
+    for (size_t i = 0; i < ballNodes.size(); i++) {
+        ballNodes.at(i)->position = orbitSimulation->position(i);
+    }
 
-void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar) {
-    gBufferShader->activate();
+    updateNodeTransformations();
 
-    glm::mat4 transformationMatrix =
-              glm::translate(node->position)
-            * glm::translate(node->referencePoint)
-            * glm::rotate(node->rotation.y, glm::vec3(0,1,0))
-            * glm::rotate(node->rotation.x, glm::vec3(1,0,0))
-            * glm::rotate(node->rotation.z, glm::vec3(0,0,1))
-            * glm::scale(node->scale)
-            * glm::translate(-node->referencePoint);
+    // Swap in the level of detail matching each node's size on screen
+    glm::vec3 eyePosition = glm::vec3(glm::inverse(cameraTransform) * glm::vec4(0, 0, 0, 1));
+    selectLODs(rootNode, eyePosition, fieldOfView);
 
-    node->currentTransformationMatrix = transformationThusFar * transformationMatrix;
+    updateUniforms(cameraTransform, perspProjection, fieldOfView);
+    updateObjectUniforms();
 
-    switch(node->nodeType) {
-        case GEOMETRY: break;
-        case GEOMETRY_2D: break;
-        case NORMAL_MAPPED: break;
-        case BLACK_HOLE: break;
-        case POINT_LIGHT: {
-            glm::vec4 lightCoord = node->currentTransformationMatrix * glm::vec4(0, 0, 0, 1);
+    updateAccretionDisk(float(timeDelta), perspProjection);
 
-            GLint coordLocation = gBufferShader->getUniformFromName(fmt::format("lightSource[{}].coord", node->lightID));
-            GLint colorLocation = gBufferShader->getUniformFromName(fmt::format("lightSource[{}].color", node->lightID));
+    // Streams in the pages of the virtual materials seen a few frames ago
+    updateVirtualTextures();
 
-            glUniform3fv(coordLocation, 1, glm::value_ptr(lightCoord));
-            glUniform3fv(colorLocation, 1, glm::value_ptr(node->lightColor));
+    if (options.enableOcclusionCulling) {
+        updateOcclusionCulling(perspVP);
 
-            break;
+        if (frameCount % STATS_PRINT_INTERVAL == 0) {
+            OcclusionStats stats = getOcclusionStats();
+            std::cout << fmt::format("Occlusion culling: removed {} of {} draws ({} outside frustum, {} occluded), {} re-tested visible",
+                                     stats.frustumCulled + stats.occludedLate, stats.tested,
+                                     stats.frustumCulled, stats.occludedLate, stats.rescuedLate) << std::endl;
         }
-        case SPOT_LIGHT: break;
     }
 
-    gBufferShader->deactivate();
+    if (options.enableGPUStats && frameCount % STATS_PRINT_INTERVAL == 0) {
+        const FrameStats &stats = getLatestFrameStats();
+        std::cout << formatFrameStats(stats);
 
-    for(SceneNode* child : node->children) {
-        updateNodeTransformations(child, node->currentTransformationMatrix);
+        // Simulation, compaction and drawing together, as a throughput figure
+        const PassStats &particlePass = stats.passes[GPU_PASS_PARTICLES];
+        if (particlePass.measured && particlePass.gpuTimeMs > 0) {
+            std::cout << fmt::format("Accretion disk: {} particles in {:.3f} ms ({:.0f} particles/ms)",
+                                     getAccretionDiskParticleCount(), particlePass.gpuTimeMs,
+                                     getAccretionDiskParticleCount() / particlePass.gpuTimeMs) << std::endl;
+        }
     }
+
+    if (showStatsOverlay) {
+        addStatsOverlay(measuredTimeDelta);
+    }
+
+    frameCount++;
 }
 
-void renderNode(SceneNode* node) {
-    gBufferShader->activate();
+void updateNodeTransformations() {
+    PROFILE_ZONE("updateNodeTransformations");
+
+    updateTransformations(flattenedScene, bestMatrixKernel());
+
+    for (SceneNode* node : flattenedScene.nodes) {
+        switch(node->nodeType) {
+            case GEOMETRY: break;
+            case GEOMETRY_2D: break;
+            case NORMAL_MAPPED: break;
+            case BLACK_HOLE: break;
+            case POINT_LIGHT: {
+                // Lights beyond MAX_LIGHTS have no slot in the uniform array, and are left out
+                if (node->lightID < 0 || node->lightID >= int(MAX_LIGHTS)) {
+                    break;
+                }
+                LightUniforms &light = frameUniforms.lightSource[node->lightID];
+                light.coord = glm::vec3(node->currentTransformationMatrix[3]);
+                light.color = node->lightColor;
+
+                break;
+            }
+            case SPOT_LIGHT: break;
+        }
+    }
+}
 
-    // Pass model matrix
-    glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(node->currentTransformationMatrix));
+// In stereo, the G-buffer shader's permutation drawing into both layers
+static unsigned int gBufferFeatures(unsigned int features) {
+    return stereoRendering ? (features | RENDER_STEREO_FEATURE) : features;
+}
 
-    // Calculate and pass normal matrix
-    glm::mat3 normalMatrix = glm::transpose(glm::inverse(node->currentTransformationMatrix));
-    glUniformMatrix3fv(4, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+// In stereo, each draw is instanced once per eye instead
+static void drawGBufferElements(SceneNode* node, OcclusionPhase phase) {
+    if (stereoRendering) {
+        trackedDrawElementsInstanced(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr, STEREO_EYE_COUNT);
+    }
+    else {
+        drawNodeElements(node, phase);
+    }
+}
+
+void renderBlackHoles() {
+    gBufferShader->activate(gBufferFeatures(RENDER_BLACK_HOLE_FEATURE));
+
+    // Disable all textures except the stencil
+    trackedColorMaski(0, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Color (disable)
+    trackedColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Position (disable)
+    trackedColorMaski(2, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Normal (disable)
+    // Enable bhNormal texture
+    trackedColorMaski(4, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); // bhNormal (enable)
+
+    // Update the "stencil" buffer with the black holes, each writing its own value.
+    // The lensing pass is skipped when none of them survives the depth test.
+    beginBlackHoleVisibilityQuery();
+    for (SceneNode* node : bhNodes) {
+        bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
+
+        trackedBindVertexArray(node->vertexArrayObjectID);
+        drawGBufferElements(node, OCCLUSION_DISABLED);
+    }
+    endBlackHoleVisibilityQuery();
+
+    // Re-enable all textures
+    trackedColorMaski(0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    trackedColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    trackedColorMaski(2, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    // Disable bhNormal texture
+    trackedColorMaski(4, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
     gBufferShader->deactivate();
+}
+
+void renderNode(SceneNode* node, OcclusionPhase phase) {
+    // Nodes belonging to the other occlusion culling phase are skipped, but their children are not
+    if (!isDrawnInPhase(node, phase)) {
+        for(SceneNode* child : node->children) {
+            renderNode(child, phase);
+        }
+        return;
+    }
 
     switch(node->nodeType) {
         case GEOMETRY:
             if(node->vertexArrayObjectID != -1) {
-                gBufferShader->activate();
-
-                // Pass renderMode uniform
-                glUniform1i(13, GEOMETRY);
-                // Calculate MVP matrix (perspective)
-                glm::mat4 MVP = perspVP * node->currentTransformationMatrix;
-                // Pass MVP matrix
-                glUniformMatrix4fv(5, 1, GL_FALSE, glm::value_ptr(MVP));
+                gBufferShader->activate(gBufferFeatures(0));
 
-                // For non-textured surface colors -- pass surface color
-                glm::vec3 surfaceColor = node->color;
-                glUniform3fv(14, 1, glm::value_ptr(surfaceColor));
+                // Matrices, surface color and renderMode were written by updateObjectUniforms()
+                bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
 
                 // Draw the model
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+                trackedBindVertexArray(node->vertexArrayObjectID);
+                drawGBufferElements(node, phase);
 
                 gBufferShader->deactivate();
             };
             break;
         case GEOMETRY_2D:
             if(node->vertexArrayObjectID != -1) {
-                gBufferShader->activate();
+                gBufferShader->activate(gBufferFeatures(RENDER_2D_FEATURE));
 
-                // Pass renderMode uniform
-                glUniform1i(13, GEOMETRY_2D);
+                bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
                 // Bind texture unit
-                glBindTextureUnit(0, node->textureID);
-                // Calculate MVP matrix (orthogonal)
-                glm::mat4 MVP = orthoVP * node->currentTransformationMatrix;
-                // Pass MVP matrix
-                glUniformMatrix4fv(5, 1, GL_FALSE, glm::value_ptr(MVP));
+                trackedBindTextureUnit(0, node->textureID);
 
                 // Draw the model
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+                trackedBindVertexArray(node->vertexArrayObjectID);
+                drawGBufferElements(node, OCCLUSION_DISABLED);
 
                 gBufferShader->deactivate();
             };
             break;
         case NORMAL_MAPPED:
             if (node->vertexArrayObjectID != -1) {
-                gBufferShader->activate();
-
-                // Pass renderMode uniform
-                glUniform1i(13, NORMAL_MAPPED);
-                // Bind texture units
-                glBindTextureUnit(0, node->textureID);
-                glBindTextureUnit(1, node->normalMapID);
-                glBindTextureUnit(2, node->roughnessMapID);
-                // Calculate MVP matrix (perspective)
-                glm::mat4 MVP = perspVP * node->currentTransformationMatrix;
-                // Pass MVP matrix
-                glUniformMatrix4fv(5, 1, GL_FALSE, glm::value_ptr(MVP));
+                bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
+                if (node->virtualMaterialID >= 0) {
+                    gBufferShader->activate(gBufferFeatures(RENDER_NORMAL_MAPPED_FEATURE | RENDER_VIRTUAL_TEXTURE_FEATURE));
+                    bindVirtualMaterial(node->virtualMaterialID);
+                }
+                else {
+                    gBufferShader->activate(gBufferFeatures(RENDER_NORMAL_MAPPED_FEATURE));
+                    // Bind texture units
+                    trackedBindTextureUnit(0, node->textureID);
+                    trackedBindTextureUnit(1, node->normalMapID);
+                    trackedBindTextureUnit(2, node->roughnessMapID);
+                }
 
                 // Draw the model
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+                trackedBindVertexArray(node->vertexArrayObjectID);
+                drawGBufferElements(node, phase);
 
                 gBufferShader->deactivate();
             };
             break;
         case BLACK_HOLE:
-            if (node->vertexArrayObjectID != -1) {
-                gBufferShader->activate();
-
-                // Disable all textures except the stencil
-                glColorMaski(0, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Color (disable)
-                glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Position (disable)
-                glColorMaski(2, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Normal (disable)
-                // Enable bhNormal texture
-                glColorMaski(4, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); // bhNormal (enable)
-
-                // Pass renderMode uniform
-                glUniform1i(13, BLACK_HOLE);
-                // Update the "stencil" buffer with the black hole
-                glm::mat4 MVP = perspVP * bhNode->currentTransformationMatrix;
-                glUniformMatrix4fv(5, 1, GL_FALSE, glm::value_ptr(MVP));
-
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, bhNode->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
-
-                // Re-enable all textures
-                glColorMaski(0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-                glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-                glColorMaski(2, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-                // Disable bhNormal texture
-                glColorMaski(4, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-
-                gBufferShader->deactivate();
+            // All black holes are drawn where the first one is met, so a single query covers them
+            if (node == bhNode) {
+                renderBlackHoles();
             }
             break;
         case POINT_LIGHT: break;
@@ -555,56 +964,268 @@ void renderNode(SceneNode* node) {
     }
 
     for(SceneNode* child : node->children) {
-        renderNode(child);
+        renderNode(child, phase);
     }
 }
 
 void renderToGBuffer(GLFWwindow* window) {
-    gBufferShader->activate();
+    PROFILE_ZONE("renderToGBuffer");
 
-    // Set clear color to white-ish
-    glClearColor(1.0, 1.0, 1.0, 1.0);
+    gBufferShader->activate(gBufferFeatures(0));
 
-    // Re-enable bhNormal texture to clear it (hacky solution)
-    glColorMaski(4, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    // Re-disable bhNormal
-    glColorMaski(4, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    bindShadowAtlas();
 
-    renderNode(rootNode);
+    if (checkerboardRendering) {
+        // The pixels skipped this frame keep last frame's samples, for the resolve to reuse
+        glClear(GL_DEPTH_BUFFER_BIT);
+        beginCheckerboardPass();
+    }
+    else {
+        // Set clear color to white-ish
+        glClearColor(1.0, 1.0, 1.0, 1.0);
+
+        // Re-enable bhNormal texture to clear it (hacky solution)
+        trackedColorMaski(4, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Re-disable bhNormal
+        trackedColorMaski(4, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    }
+
+    if (options.enableOcclusionCulling) {
+        // Early phase: draw what is visible against last frame's Hi-Z pyramid
+        beginGPUPass(GPU_PASS_GBUFFER);
+        cullNodes(OCCLUSION_EARLY);
+        {
+            PROFILE_ZONE("renderNode (early)");
+            renderNode(rootNode, OCCLUSION_EARLY);
+        }
+        endGPUPass();
+
+        // Rebuild the pyramid from what has been drawn so far. It is also used as next frame's early pyramid.
+        beginGPUPass(GPU_PASS_HIZ);
+        buildHiZPyramid(gBuffer.depthTexture);
+        cullNodes(OCCLUSION_LATE);
+        endGPUPass();
+
+        // Late phase: draw what the early phase wrongly rejected, so nothing pops in
+        beginGPUPass(GPU_PASS_GBUFFER_LATE);
+        {
+            PROFILE_ZONE("renderNode (late)");
+            renderNode(rootNode, OCCLUSION_LATE);
+        }
+        endGPUPass();
+    }
+    else {
+        PROFILE_ZONE("renderNode");
+        beginGPUPass(GPU_PASS_GBUFFER);
+        renderNode(rootNode, OCCLUSION_DISABLED);
+        endGPUPass();
+    }
+
+    if (options.particleCount > 0) {
+        beginGPUPass(GPU_PASS_PARTICLES);
+        renderAccretionDisk(stereoRendering ? STEREO_EYE_COUNT : 1);
+        endGPUPass();
+    }
+
+    if (checkerboardRendering) {
+        endCheckerboardPass();
+    }
+
+    // Everything sampling the virtual materials has been drawn, including the environment map
+    resolveVirtualTextureFeedback();
 
     gBufferShader->deactivate();
 }
 
 void renderToScreen(GLFWwindow* window) {
-    deferredShader->activate();
+    PROFILE_ZONE("renderToScreen");
+
+    deferredShader->activate(viewModeFeatures(viewMode) | (stereoRendering ? DEFERRED_STEREO_FEATURE : 0));
     
     // Clear the screen's color and depth buffers
     glClearColor(0.3f, 0.5f, 0.8f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glBindTextureUnit(0, gBuffer.colorTexture);
-    glBindTextureUnit(1, gBuffer.posTexture);
-    glBindTextureUnit(2, gBuffer.normalTexture);
-    glBindTextureUnit(3, gBuffer.stencilTexture);
-    glBindTextureUnit(4, gBuffer.bhNormalTexture);
+    trackedBindTextureUnit(0, gBuffer.colorTexture);
+    trackedBindTextureUnit(1, gBuffer.posTexture);
+    trackedBindTextureUnit(2, gBuffer.normalTexture);
+    trackedBindTextureUnit(3, gBuffer.stencilTexture);
+    trackedBindTextureUnit(4, gBuffer.bhNormalTexture);
 
-    glBindVertexArray(screenQuadVAO);
-    glDrawElements(GL_TRIANGLES, screenQuad.indices.size(), GL_UNSIGNED_INT, nullptr);
+    // In stereo, one instance per eye resolves the eye's layer
+    trackedBindVertexArray(screenQuad->vertexArrayID);
+    if (stereoRendering) {
+        trackedDrawElementsInstanced(GL_TRIANGLES, screenQuad->indexCount, GL_UNSIGNED_INT, nullptr, STEREO_EYE_COUNT);
+    }
+    else {
+        trackedDrawElements(GL_TRIANGLES, screenQuad->indexCount, GL_UNSIGNED_INT, nullptr);
+    }
 
     deferredShader->deactivate();
 }
 
-void renderFrame(GLFWwindow* window) {
-    // Bind the gBuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fboID);
+void setCameraLookAt(glm::vec3 position, glm::vec3 target) {
+    camera->lookAt(position, target);
+}
+
+void setFixedTimeStep(double seconds) {
+    useFixedTimeStep = true;
+    fixedTimeStep = seconds;
+    // Reproducible frames cannot depend on how fast pages stream in
+    setVirtualTextureStreamingBlocking(true);
+}
+
+void useMeasuredTimeStep() {
+    useFixedTimeStep = false;
+    setVirtualTextureStreamingBlocking(false);
+}
+
+void setProjectionOverride(glm::mat4 projection, float fieldOfViewY) {
+    useProjectionOverride = true;
+    projectionOverride = projection;
+    fieldOfViewOverride = fieldOfViewY;
+}
+
+void clearProjectionOverride() {
+    useProjectionOverride = false;
+}
+
+float getFieldOfView() {
+    return FOV;
+}
+
+float getBlackHoleScreenCoverage() {
+    return frameUniforms.bhScreenPercent;
+}
 
-    // First render pass
-    renderToGBuffer(window);
+const Framebuffer &getGBuffer() {
+    return gBuffer;
+}
+
+// Declares this frame's passes. Nothing is drawn until the graph is executed.
+// None of the transient textures below share a pooled texture: the G-buffer targets are still read by the
+// deferred pass while it writes the stereo image, and the depth, the only one done before, has no later match.
+static void declareFramePasses(GLFWwindow* window) {
+    frameGraph.reset();
+
+    FrameGraphResource screen = frameGraph.importTexture("Screen", 0);
+    FrameGraphResource gBufferTargets[G_BUFFER_TARGET_COUNT];
+    // In stereo, the resolved eyes are shown side by side, under the HUD
+    FrameGraphResource resolved = screen;
+    GLsizei eyeLayers = stereoRendering ? STEREO_EYE_COUNT : 1;
+
+    // Every pass drawing the scene's nodes reads the ObjectUniforms computed here
+    if (options.enableGPUTransforms) {
+        frameGraph.addPass("Transforms", [](FrameGraphBuilder &builder) {
+            builder.setSideEffect();
+        }, [](const FrameGraph&) {
+            beginGPUPass(GPU_PASS_TRANSFORMS);
+            computeGPUTransforms(perspVP);
+            endGPUPass();
+        });
+    }
+
+    // Shadow pass, only drawing the parts of the atlas that are out of date. The atlas is a cache kept outside the graph.
+    frameGraph.addPass("Shadows", [](FrameGraphBuilder &builder) {
+        builder.setSideEffect();
+    }, [](const FrameGraph&) {
+        renderShadowAtlas();
+    });
+
+    // Environment map for the lensing, only redrawing the faces that are out of date. It is lit like the G-buffer,
+    // so it needs the shadow atlas.
+    FrameGraphResource environment = frameGraph.importTexture("Environment map", getEnvironmentMap());
+    if (viewMode == REGULAR) {
+        frameGraph.addPass("Environment", [&](FrameGraphBuilder &builder) {
+            builder.write(environment);
+        }, [](const FrameGraph&) {
+            bindShadowAtlas();
+            renderEnvironmentProbe(frameUniforms.bhPos);
+        });
+    }
+
+    // The G-buffer is transient, unless checkerboard rendering needs last frame's samples in it
+    frameGraph.addPass("G-buffer", [&](FrameGraphBuilder &builder) {
+        const Framebuffer* history = checkerboardRendering ? &acquireCheckerboardGBuffer() : nullptr;
+        for (unsigned int i = 0; i < G_BUFFER_TARGET_COUNT; i++) {
+            const GBufferTarget &target = G_BUFFER_TARGETS[i];
+            gBufferTargets[i] = history ? frameGraph.importTexture(target.label, history->*target.texture)
+                                        : builder.create(target.label, { target.internalFormat, windowWidth, windowHeight, eyeLayers });
+            builder.write(gBufferTargets[i], target.attachment);
+        }
+    }, [window](const FrameGraph&) {
+        renderToGBuffer(window);
+    });
+
+    // Deferred render pass. Reads every G-buffer target but the depth.
+    frameGraph.addPass("Deferred", [&](FrameGraphBuilder &builder) {
+        for (unsigned int i = 0; i + 1 < G_BUFFER_TARGET_COUNT; i++) {
+            builder.read(gBufferTargets[i]);
+        }
+        if (stereoRendering) {
+            resolved = builder.create("Stereo image", { GL_RGBA8, windowWidth, windowHeight, eyeLayers });
+        }
+        builder.write(resolved, GL_COLOR_ATTACHMENT0);
+    }, [window](const FrameGraph&) {
+        beginGPUPass(GPU_PASS_DEFERRED);
+        renderToScreen(window);
+        endGPUPass();
+    });
+
+    // Lensing, limited to the screen tiles the black holes cover. The debug views show the G-buffer undistorted.
+    if (viewMode == REGULAR) {
+        frameGraph.addPass("Lensing", [&](FrameGraphBuilder &builder) {
+            // Position, stencil and BH normal. The lensed colors come from the environment map.
+            for (unsigned int i : { 1u, 3u, 4u }) {
+                builder.read(gBufferTargets[i]);
+            }
+            builder.read(environment);
+            builder.write(resolved, GL_COLOR_ATTACHMENT0);
+        }, [environment](const FrameGraph &graph) {
+            trackedBindTextureUnit(ENVIRONMENT_MAP_UNIT, graph.getTexture(environment));
+            beginGPUPass(GPU_PASS_LENSING);
+            renderLensing();
+            endGPUPass();
+        });
+    }
+
+    if (stereoRendering) {
+        frameGraph.addPass("Stereo preview", [&](FrameGraphBuilder &builder) {
+            builder.read(resolved);
+            builder.write(screen, GL_COLOR_ATTACHMENT0);
+        }, [resolved](const FrameGraph &graph) {
+            presentStereo(graph.getTexture(resolved));
+        });
+    }
+
+    // Text goes on top of the lensed image, so it is never distorted
+    frameGraph.addPass("HUD", [&](FrameGraphBuilder &builder) {
+        builder.write(screen, GL_COLOR_ATTACHMENT0);
+    }, [](const FrameGraph&) {
+        renderHUD();
+    });
+
+    frameGraph.compile();
+
+    // Only once the graph has dropped the framebuffers it cached for the checkerboard G-buffer,
+    // so a texture created later under one of its names never matches them
+    if (!checkerboardRendering) {
+        releaseCheckerboardGBuffer();
+    }
+
+    for (unsigned int i = 0; i < G_BUFFER_TARGET_COUNT; i++) {
+        gBuffer.*G_BUFFER_TARGETS[i].texture = frameGraph.getTexture(gBufferTargets[i]);
+    }
+    gBuffer.fboID = 0;
+}
+
+void renderFrame(GLFWwindow* window) {
+    PROFILE_ZONE("renderFrame");
 
-    // Bind the default framebuffer (screen)
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    declareFramePasses(window);
+    frameGraph.execute();
 
-    // Deferred render pass
-    renderToScreen(window);
+    // The uniforms written for this frame are in use until the GPU gets past this point
+    endUniformFrame();
 }
\ No newline at end of file
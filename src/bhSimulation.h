@@ -1,15 +1,51 @@
 #pragma once
 
 #include <utilities/window.hpp>
+#include <utilities/glutils.h>
 #include "sceneGraph.hpp"
 
 enum ViewMode {
 	REGULAR, COLOR, POSITION, DISTANCE, NORMALS, STENCIL, BH_NORMALS
 };
 
+// Feature keys of the G-buffer shader's permutations (see simple.vert and simple.frag).
+// GEOMETRY nodes are drawn with the permutation without features.
+enum GBufferFeature {
+	RENDER_2D_FEATURE = 1 << 0,
+	RENDER_NORMAL_MAPPED_FEATURE = 1 << 1,
+	RENDER_BLACK_HOLE_FEATURE = 1 << 2,
+	RENDER_ENVIRONMENT_FEATURE = 1 << 3,  // Drawn into a face of the environment cube map, see environmentProbe.h
+	RENDER_VIRTUAL_TEXTURE_FEATURE = 1 << 4,  // NORMAL_MAPPED, with a virtual material, see virtualTexture.h
+	RENDER_STEREO_FEATURE = 1 << 5  // Instanced once per eye, into the eye's layer of the G-buffer, see stereo.h
+};
+
 extern ViewMode viewMode;
+extern bool showStatsOverlay;
+// Draws half of the G-buffer's pixels each frame, see checkerboard.h
+extern bool checkerboardRendering;
+// Draws both eyes into a layered G-buffer, see stereo.h. Set once by initScene().
+extern bool stereoRendering;
 
-void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar);
+// Recomputes every node's currentTransformationMatrix from its position, rotation and scale
+void updateNodeTransformations();
 void initScene(GLFWwindow* window, CommandLineOptions options);
+// Releases every GPU object the scene and its renderers created. Call before the context is destroyed.
+void destroyScene();
 void updateFrame(GLFWwindow* window);
-void renderFrame(GLFWwindow* window);
\ No newline at end of file
+void renderFrame(GLFWwindow* window);
+
+// Used by the golden image tests and offline rendering to render reproducible frames
+void setCameraLookAt(glm::vec3 position, glm::vec3 target);
+void setFixedTimeStep(double seconds);  // 0 freezes the simulations
+void useMeasuredTimeStep();
+const Framebuffer &getGBuffer();
+
+// Replaces the camera's projection, e.g. with an off-axis one for a single tile of a larger image.
+// fieldOfViewY is the vertical angle the window's height would span at the same pixel density,
+// used for level-of-detail selection and the lensing strength.
+void setProjectionOverride(glm::mat4 projection, float fieldOfViewY);
+void clearProjectionOverride();
+float getFieldOfView();
+
+// Radius of the black hole as a fraction of the window's height, as of the last updateFrame()
+float getBlackHoleScreenCoverage();
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <glad/glad.h>
+#include <utilities/shader.hpp>
+#include <utilities/renderStats.h>
+#include "assetRegistry.h"
+#include "checkerboard.h"
+
+// Stencil values of the two halves. Pixels whose x + y is even are in half 0.
+const GLint CHECKERBOARD_STENCIL[2] = { 1, 2 };
+
+static int parity = 1;
+
+static Framebuffer gBuffer;
+static bool gBufferCreated = false;
+
+const Framebuffer &acquireCheckerboardGBuffer() {
+    if (gBufferCreated) {
+        return gBuffer;
+    }
+
+    gBuffer = initGBuffer();
+    gBufferCreated = true;
+
+    Gloom::Shader patternShader;
+    patternShader.makeBasicShader("../res/shaders/deferred.vert", "../res/shaders/checkerboard.frag");
+    MeshHandle quad = acquireQuad("Screen quad");
+
+    // The first frames reconstruct from these, until both halves have been drawn
+    const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (GLint drawBuffer = 0; drawBuffer < 5; drawBuffer++) {
+        glClearNamedFramebufferfv(gBuffer.fboID, GL_COLOR, drawBuffer, black);
+    }
+
+    // Everything starts in half 1, then half 0 is drawn over it
+    glClearNamedFramebufferiv(gBuffer.fboID, GL_STENCIL, 0, &CHECKERBOARD_STENCIL[1]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fboID);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, CHECKERBOARD_STENCIL[0], 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+    patternShader.activate();
+    trackedBindVertexArray(quad->vertexArrayID);
+    trackedDrawElements(GL_TRIANGLES, quad->indexCount, GL_UNSIGNED_INT, nullptr);
+    patternShader.deactivate();
+    patternShader.destroy();
+
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    // The black hole normal target is only written while black holes are drawn
+    trackedColorMaski(4, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return gBuffer;
+}
+
+void releaseCheckerboardGBuffer() {
+    if (gBufferCreated) {
+        deleteGBuffer(gBuffer);
+        gBufferCreated = false;
+    }
+}
+
+int advanceCheckerboard() {
+    parity = 1 - parity;
+    return parity;
+}
+
+void beginCheckerboardPass() {
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_EQUAL, CHECKERBOARD_STENCIL[parity], 0xFF);
+}
+
+void endCheckerboardPass() {
+    glDisable(GL_STENCIL_TEST);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <utilities/glutils.h>
+
+// Checkerboard rendering of the G-buffer pass.
+// Each frame only draws every other pixel into the G-buffer, alternating between the two halves of a
+// checkerboard, which halves the shading done by simple.frag. The color targets are not cleared, so the
+// other half still holds the previous frame's samples. The resolve in deferred.frag reuses those where
+// their position shows they still belong to the same surface, and interpolates the new neighbours elsewhere.
+// The lensing pass does the same for the mask, position and normal it reads, see checkerboardReconstruction.glsl.
+// The pattern is written into the G-buffer's stencil once, so the skipped pixels are rejected before shading.
+
+// The G-buffer drawn into while checkerboard rendering is on. Unlike the frame graph's transient one, it
+// lasts from frame to frame, as it holds the samples the resolve reuses. Made, with the pattern written, on first use.
+const Framebuffer &acquireCheckerboardGBuffer();
+// Frees it, if it exists. Called every frame checkerboard rendering is off, so it only costs memory while in use.
+void releaseCheckerboardGBuffer();
+
+// Switches to the other half of the pixels, and returns it (0 or 1) for the frame uniforms
+int advanceCheckerboard();
+
+// Limits drawing into the G-buffer to this frame's half of the pixels, until endCheckerboardPass()
+void beginCheckerboardPass();
+void endCheckerboardPass();
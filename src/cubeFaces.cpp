@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "cubeFaces.h"
+
+glm::mat4 cubeFaceView(glm::vec3 position, int face) {
+    return glm::lookAt(position, position + FACE_DIRECTIONS[face], FACE_UP_VECTORS[face]);
+}
+
+glm::vec4 worldBoundingSphere(SceneNode* node) {
+    const glm::mat4 &model = node->currentTransformationMatrix;
+    glm::vec3 centre = glm::vec3(model * glm::vec4((node->boundingBoxMin + node->boundingBoxMax) * 0.5f, 1));
+
+    float maxScale = std::max(glm::length(glm::vec3(model[0])),
+                     std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    float radius = glm::length(node->boundingBoxMax - node->boundingBoxMin) * 0.5f * maxScale;
+
+    return glm::vec4(centre, radius);
+}
+
+unsigned int facesTouchedBySphere(glm::vec3 position, glm::vec4 sphere, float farPlane) {
+    glm::vec3 centre = glm::vec3(sphere) - position;
+    float radius = sphere.w;
+
+    if (glm::length(centre) - radius > farPlane) {
+        return 0;
+    }
+
+    // Each face's frustum is bounded by the four 45 degree planes between its axis and the two others
+    unsigned int faces = 0;
+    for (int face = 0; face < 6; face++) {
+        int axis = face / 2;
+        float along = (face % 2 == 0) ? centre[axis] : -centre[axis];
+        float margin = radius * 1.41421356f;
+
+        bool touches = true;
+        for (int other = 0; other < 3; other++) {
+            if (other != axis && along - std::abs(centre[other]) < -margin) {
+                touches = false;
+            }
+        }
+        if (touches) {
+            faces |= 1u << face;
+        }
+    }
+    return faces;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "sceneGraph.hpp"
+
+// Cube faces in the order OpenGL expects them: +X, -X, +Y, -Y, +Z, -Z
+const glm::vec3 FACE_DIRECTIONS[6] = {
+    glm::vec3( 1, 0, 0), glm::vec3(-1, 0, 0),
+    glm::vec3( 0, 1, 0), glm::vec3( 0,-1, 0),
+    glm::vec3( 0, 0, 1), glm::vec3( 0, 0,-1),
+};
+const glm::vec3 FACE_UP_VECTORS[6] = {
+    glm::vec3(0,-1, 0), glm::vec3(0,-1, 0),
+    glm::vec3(0, 0, 1), glm::vec3(0, 0,-1),
+    glm::vec3(0,-1, 0), glm::vec3(0,-1, 0),
+};
+const unsigned int ALL_FACES = 0x3F;
+
+// View matrix of one face of a cube map centred on position, for a 90 degree square projection
+glm::mat4 cubeFaceView(glm::vec3 position, int face);
+
+// Bounding sphere of a node's bounding box, in world space
+glm::vec4 worldBoundingSphere(SceneNode* node);
+
+// Bit mask of the faces of the cube around position that a sphere may be visible in, up to farPlane away
+unsigned int facesTouchedBySphere(glm::vec3 position, glm::vec4 sphere, float farPlane);
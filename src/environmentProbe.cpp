@@ -0,0 +1,220 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/window.hpp>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "uniformBuffers.h"
+#include "cubeFaces.h"
+#include "bhSimulation.h"
+#include "virtualTexture.h"
+#include "environmentProbe.h"
+
+// The probe sits inside the black hole, which it does not draw, so nothing else comes close
+const float ENVIRONMENT_NEAR_PLANE = 1.0f;
+const float ENVIRONMENT_FAR_PLANE = 1000.0f;
+
+// environmentViewProjection in simple.vert
+const GLint FACE_VIEW_PROJECTION_LOCATION = 0;
+
+static Gloom::Shader* shader;
+
+static GLTexture environmentMap;
+static GLTexture depthBuffer;
+static GLFramebuffer framebuffer;
+
+// Everything drawn into the faces, by the permutation drawing it
+static std::vector<SceneNode*> geometryNodes;
+static std::vector<SceneNode*> normalMappedNodes;
+static std::vector<SceneNode*> virtualTextureNodes;
+// The nodes that can make a face out of date
+static std::vector<SceneNode*> dynamicNodes;
+
+static glm::mat4 faceProjection;
+static glm::vec3 capturedPosition;
+static bool captured = false;
+
+static unsigned int staleFaces = ALL_FACES;
+// Faces a dynamic node was in when they were drawn
+static unsigned int dynamicFaces = 0;
+// Where the search for a stale face starts, so that all of them take turns
+static int nextFace = 0;
+
+// Transformations of the dynamic nodes in the previous frame
+static std::vector<glm::mat4> previousDynamicTransforms;
+
+static unsigned int facesRedrawn = 0;
+
+static void collectProbeNodes(SceneNode* node) {
+    if (node->vertexArrayObjectID != -1) {
+        if (node->nodeType == GEOMETRY) {
+            geometryNodes.push_back(node);
+        }
+        else if (node->nodeType == NORMAL_MAPPED && node->virtualMaterialID >= 0) {
+            virtualTextureNodes.push_back(node);
+        }
+        else if (node->nodeType == NORMAL_MAPPED) {
+            normalMappedNodes.push_back(node);
+        }
+        if (node->isDynamic && (node->nodeType == GEOMETRY || node->nodeType == NORMAL_MAPPED)) {
+            dynamicNodes.push_back(node);
+        }
+    }
+
+    for (SceneNode* child : node->children) {
+        collectProbeNodes(child);
+    }
+}
+
+void initEnvironmentProbe(SceneNode* rootNode, Gloom::Shader* gBufferShader) {
+    shader = gBufferShader;
+
+    environmentMap = createTexture(GL_TEXTURE_CUBE_MAP, GPU_MEMORY_RENDER_TARGET, "Environment map", 1, GL_RGBA8,
+                                   ENVIRONMENT_MAP_RESOLUTION, ENVIRONMENT_MAP_RESOLUTION);
+    glTextureParameteri(environmentMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(environmentMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(environmentMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(environmentMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Filters across the edges between faces, which would otherwise show as seams in the lensed image
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // Shared by the faces, which are drawn one at a time
+    depthBuffer = createTexture(GL_TEXTURE_2D, GPU_MEMORY_RENDER_TARGET, "Environment map depth", 1, GL_DEPTH_COMPONENT24,
+                                ENVIRONMENT_MAP_RESOLUTION, ENVIRONMENT_MAP_RESOLUTION);
+
+    framebuffer = createFramebuffer("Environment map");
+    glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthBuffer, 0);
+    // The G-buffer shader's other outputs are dropped
+    glNamedFramebufferDrawBuffer(framebuffer, GL_COLOR_ATTACHMENT0);
+
+    collectProbeNodes(rootNode);
+
+    faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, ENVIRONMENT_NEAR_PLANE, ENVIRONMENT_FAR_PLANE);
+}
+
+void destroyEnvironmentProbe() {
+    environmentMap.reset();
+    depthBuffer.reset();
+    framebuffer.reset();
+
+    geometryNodes.clear();
+    normalMappedNodes.clear();
+    virtualTextureNodes.clear();
+    dynamicNodes.clear();
+    previousDynamicTransforms.clear();
+
+    captured = false;
+    staleFaces = ALL_FACES;
+    dynamicFaces = 0;
+}
+
+static void drawNodes(const std::vector<SceneNode*> &nodes, unsigned int features, const glm::mat4 &faceViewProjection) {
+    if (nodes.empty()) {
+        return;
+    }
+
+    shader->activate(RENDER_ENVIRONMENT_FEATURE | features);
+    trackedUniformMatrix4fv(FACE_VIEW_PROJECTION_LOCATION, 1, GL_FALSE, glm::value_ptr(faceViewProjection));
+
+    for (SceneNode* node : nodes) {
+        bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
+        if (node->virtualMaterialID >= 0) {
+            // Also asks for the pages the face needs, at the face's resolution
+            bindVirtualMaterial(node->virtualMaterialID);
+        }
+        else if (node->nodeType == NORMAL_MAPPED) {
+            trackedBindTextureUnit(0, node->textureID);
+            trackedBindTextureUnit(1, node->normalMapID);
+            trackedBindTextureUnit(2, node->roughnessMapID);
+        }
+
+        trackedBindVertexArray(node->vertexArrayObjectID);
+        trackedDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+    }
+}
+
+static void renderFace(int face) {
+    glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, environmentMap, 0, face);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glm::mat4 faceViewProjection = faceProjection * cubeFaceView(capturedPosition, face);
+    drawNodes(geometryNodes, 0, faceViewProjection);
+    drawNodes(normalMappedNodes, RENDER_NORMAL_MAPPED_FEATURE, faceViewProjection);
+    drawNodes(virtualTextureNodes, RENDER_NORMAL_MAPPED_FEATURE | RENDER_VIRTUAL_TEXTURE_FEATURE, faceViewProjection);
+}
+
+void renderEnvironmentProbe(glm::vec3 probePosition) {
+    PROFILE_ZONE("renderEnvironmentProbe");
+
+    std::vector<glm::mat4> dynamicTransforms;
+    unsigned int touchedFaces = 0;
+    for (SceneNode* node : dynamicNodes) {
+        dynamicTransforms.push_back(node->currentTransformationMatrix);
+        touchedFaces |= facesTouchedBySphere(probePosition, worldBoundingSphere(node), ENVIRONMENT_FAR_PLANE);
+    }
+
+    if (!captured || probePosition != capturedPosition) {
+        staleFaces = ALL_FACES;
+        capturedPosition = probePosition;
+    }
+    else if (dynamicTransforms != previousDynamicTransforms) {
+        // Faces the dynamic nodes are in now, and faces still showing where they were
+        staleFaces |= touchedFaces | dynamicFaces;
+    }
+    previousDynamicTransforms = dynamicTransforms;
+
+    // The first capture is drawn whole, so the lensing never samples an empty face
+    unsigned int budget = captured ? ENVIRONMENT_FACES_PER_FRAME : 6;
+    facesRedrawn = 0;
+    if (staleFaces == 0) {
+        return;
+    }
+
+    beginGPUPass(GPU_PASS_ENVIRONMENT);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, ENVIRONMENT_MAP_RESOLUTION, ENVIRONMENT_MAP_RESOLUTION);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    // As in the shadow pass, both sides of every triangle are drawn, since the room is seen from the inside
+    glDisable(GL_CULL_FACE);
+
+    int firstFace = nextFace;
+    for (int i = 0; i < 6 && facesRedrawn < budget; i++) {
+        int face = (firstFace + i) % 6;
+        if (!(staleFaces & (1u << face))) {
+            continue;
+        }
+
+        renderFace(face);
+        staleFaces &= ~(1u << face);
+        dynamicFaces = (dynamicFaces & ~(1u << face)) | (touchedFaces & (1u << face));
+        nextFace = (face + 1) % 6;
+        facesRedrawn++;
+    }
+
+    shader->deactivate();
+    glEnable(GL_CULL_FACE);
+    glViewport(0, 0, windowWidth, windowHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    endGPUPass();
+
+    captured = true;
+}
+
+unsigned int getEnvironmentMap() {
+    return environmentMap;
+}
+
+unsigned int getEnvironmentFacesRedrawn() {
+    return facesRedrawn;
+}
+
+unsigned int getEnvironmentFacesPending() {
+    unsigned int pending = 0;
+    for (int face = 0; face < 6; face++) {
+        pending += (staleFaces >> face) & 1u;
+    }
+    return pending;
+}
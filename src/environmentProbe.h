@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <utilities/shader.hpp>
+#include "sceneGraph.hpp"
+
+// Edge length of every cube face, in texels
+const int ENVIRONMENT_MAP_RESOLUTION = 512;
+
+// Faces redrawn per frame at most, after the first capture
+const unsigned int ENVIRONMENT_FACES_PER_FRAME = 1;
+
+// Texture unit of the environment sampler in lensing.frag
+const unsigned int ENVIRONMENT_MAP_UNIT = 7;
+
+// The scene as seen from the black hole, as a cube map the lensing samples along the bent rays,
+// so it can show what is off screen or behind the black hole.
+// All six faces are drawn once. After that, a face is only out of date when a dynamic node is in it,
+// or was in it when the face was drawn, and has moved since. At most ENVIRONMENT_FACES_PER_FRAME
+// of those are redrawn each frame, in turn, so the cost is spread over several frames.
+// Faces are drawn with the RENDER_ENVIRONMENT permutations of the G-buffer shader.
+void initEnvironmentProbe(SceneNode* rootNode, Gloom::Shader* gBufferShader);
+void destroyEnvironmentProbe();
+
+// Brings some of the out of date faces up to date. Moving the probe makes every face out of date.
+// Uses the object uniforms written for this frame, and expects the shadow atlas bound.
+void renderEnvironmentProbe(glm::vec3 probePosition);
+
+// The cube map, to be sampled from ENVIRONMENT_MAP_UNIT
+unsigned int getEnvironmentMap();
+
+// Faces redrawn in the most recent frame, and faces still waiting
+unsigned int getEnvironmentFacesRedrawn();
+unsigned int getEnvironmentFacesPending();
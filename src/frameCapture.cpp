@@ -0,0 +1,335 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include <utilities/window.hpp>
+#include <utilities/profiler.h>
+#include <utilities/gpuResources.h>
+#include "frameCapture.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Encoding a PNG takes far longer than a frame, so several are encoded at once.
+// A Y4M stream has to be written in order, and its conversion is cheap, so it gets a single thread.
+const unsigned int MAX_PNG_ENCODER_THREADS = 6;
+
+enum SlotState {
+    SLOT_FREE,       // Ready for a new readback
+    SLOT_READING,    // Waiting for the GPU to finish copying the frame into it
+    SLOT_ENCODING    // Handed to an encoder thread
+};
+
+struct CaptureSlot {
+    GLBuffer buffer;
+    const unsigned char* pixels = nullptr;  // Persistently mapped, bottom row first, RGBA
+    GLsync fence = nullptr;
+    unsigned long long frameIndex = 0;
+    SlotState state = SLOT_FREE;
+};
+
+static bool active = false;
+static bool writeY4M = false;
+static std::string outputPath;
+static std::ofstream y4mStream;
+static int width, height;
+
+static CaptureSlot slots[CAPTURE_RING_SIZE];
+static unsigned int nextSlot = 0;
+static unsigned long long framesCaptured = 0;
+
+// Shared with the encoder threads
+static std::mutex mutex;
+static std::condition_variable jobAvailable;
+static std::condition_variable slotFreed;
+static std::deque<unsigned int> jobs;
+static bool stopping = false;
+static std::vector<std::thread> encoders;
+
+// Time the render thread spent waiting on the GPU or the encoders
+static double stallMs = 0;
+static unsigned long long stalledFrames = 0;
+
+static void writePNG(const CaptureSlot &slot) {
+    std::vector<unsigned char> rgb(size_t(width) * height * 3);
+    for (int y = 0; y < height; y++) {
+        const unsigned char* source = slot.pixels + size_t(height - 1 - y) * width * 4;
+        unsigned char* destination = &rgb[size_t(y) * width * 3];
+        for (int x = 0; x < width; x++) {
+            destination[x * 3 + 0] = source[x * 4 + 0];
+            destination[x * 3 + 1] = source[x * 4 + 1];
+            destination[x * 3 + 2] = source[x * 4 + 2];
+        }
+    }
+
+    // Fast rather than small: no filtering and a short search window
+    lodepng::State state;
+    state.info_raw.colortype = LCT_RGB;
+    state.info_raw.bitdepth = 8;
+    state.info_png.color.colortype = LCT_RGB;
+    state.info_png.color.bitdepth = 8;
+    state.encoder.auto_convert = 0;
+    state.encoder.filter_strategy = LFS_ZERO;
+    state.encoder.zlibsettings.windowsize = 1024;
+    state.encoder.zlibsettings.lazymatching = 0;
+
+    std::vector<unsigned char> png;
+    unsigned int error = lodepng::encode(png, rgb, width, height, state);
+    std::string fileName = fmt::format("{}/frame_{:06d}.png", outputPath, slot.frameIndex);
+    if (error || lodepng::save_file(png, fileName)) {
+        std::cerr << fmt::format("Frame capture: could not write {}", fileName) << std::endl;
+    }
+}
+
+// BT.601 limited range, with each chroma sample averaged over 2x2 pixels
+static void writeY4MFrame(const CaptureSlot &slot) {
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+
+    // Only ever used by the single Y4M encoder thread
+    static std::vector<unsigned char> planes;
+    planes.resize(size_t(width) * height + 2 * size_t(chromaWidth) * chromaHeight);
+    unsigned char* lumaPlane = planes.data();
+    unsigned char* uPlane = lumaPlane + size_t(width) * height;
+    unsigned char* vPlane = uPlane + size_t(chromaWidth) * chromaHeight;
+
+    auto pixel = [&](int x, int y) {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return slot.pixels + (size_t(height - 1 - y) * width + x) * 4;
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const unsigned char* p = pixel(x, y);
+            lumaPlane[size_t(y) * width + x] = (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+        }
+    }
+
+    for (int y = 0; y < chromaHeight; y++) {
+        for (int x = 0; x < chromaWidth; x++) {
+            int r = 0, g = 0, b = 0;
+            for (int corner = 0; corner < 4; corner++) {
+                const unsigned char* p = pixel(x * 2 + (corner & 1), y * 2 + (corner >> 1));
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            uPlane[size_t(y) * chromaWidth + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[size_t(y) * chromaWidth + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    y4mStream << "FRAME\n";
+    y4mStream.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+}
+
+static void encoderLoop() {
+    while (true) {
+        unsigned int slotIndex;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            slotIndex = jobs.front();
+            jobs.pop_front();
+        }
+
+        if (writeY4M) {
+            writeY4MFrame(slots[slotIndex]);
+        } else {
+            writePNG(slots[slotIndex]);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[slotIndex].state = SLOT_FREE;
+        }
+        slotFreed.notify_all();
+    }
+}
+
+// Encoder threads free slots concurrently, so the state is only read under the lock
+static SlotState slotState(const CaptureSlot &slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slot.state;
+}
+
+// Hands a slot to the encoders once the GPU has filled it. With wait, blocks until it has.
+static bool submitIfReady(CaptureSlot &slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait) {
+            return false;
+        }
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(slot.fence, 0, 1000000);
+        }
+    }
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.state = SLOT_ENCODING;
+        jobs.push_back(unsigned(&slot - slots));
+    }
+    jobAvailable.notify_one();
+    return true;
+}
+
+// Readbacks are submitted in the order they were made, so the Y4M stream stays in order
+static void submitFinishedReadbacks(bool wait) {
+    for (unsigned int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        CaptureSlot &slot = slots[(nextSlot + i) % CAPTURE_RING_SIZE];
+        if (slotState(slot) == SLOT_READING && !submitIfReady(slot, wait)) {
+            return;
+        }
+    }
+}
+
+void startFrameCapture(const std::string &path, unsigned int framesPerSecond) {
+    width = windowWidth;
+    height = windowHeight;
+    outputPath = path;
+
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    writeY4M = extension == ".y4m" || extension == ".Y4M";
+
+    if (writeY4M) {
+        y4mStream.open(path, std::ios::binary);
+        if (!y4mStream) {
+            std::cerr << fmt::format("Frame capture: could not open {}", path) << std::endl;
+            return;
+        }
+        y4mStream << fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+    } else {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    // Persistent and coherent, so the encoders can read the pixels straight from the buffers
+    GLsizeiptr frameSize = GLsizeiptr(width) * height * 4;
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (CaptureSlot &slot : slots) {
+        slot.buffer = createBuffer(GPU_MEMORY_READBACK, "Frame capture readback", frameSize, nullptr, flags);
+        slot.pixels = static_cast<const unsigned char*>(glMapNamedBufferRange(slot.buffer, 0, frameSize, flags));
+        slot.state = SLOT_FREE;
+    }
+
+    unsigned int encoderCount = 1;
+    if (!writeY4M) {
+        unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+        encoderCount = std::min(hardwareThreads - 1, MAX_PNG_ENCODER_THREADS);
+    }
+
+    stopping = false;
+    for (unsigned int i = 0; i < encoderCount; i++) {
+        encoders.emplace_back(encoderLoop);
+    }
+
+    nextSlot = 0;
+    framesCaptured = 0;
+    stallMs = 0;
+    stalledFrames = 0;
+    active = true;
+
+    std::cout << fmt::format("Capturing frames to {} ({}, {} encoder threads)", path,
+                             writeY4M ? "Y4M" : "PNG sequence", encoderCount) << std::endl;
+}
+
+bool isFrameCaptureActive() {
+    return active;
+}
+
+void captureFrame() {
+    PROFILE_ZONE("captureFrame");
+
+    submitFinishedReadbacks(false);
+
+    // Only waits when every slot is still in use, i.e. when the GPU or the encoders have fallen behind
+    CaptureSlot &slot = slots[nextSlot];
+    if (slotState(slot) != SLOT_FREE) {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+
+        // The slot about to be reused is always the oldest readback
+        if (slotState(slot) == SLOT_READING) {
+            submitIfReady(slot, true);
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFreed.wait(lock, [&] { return slot.state == SLOT_FREE; });
+        }
+
+        stallMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stalledFrames++;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frameIndex = framesCaptured++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.state = SLOT_READING;
+    }
+
+    nextSlot = (nextSlot + 1) % CAPTURE_RING_SIZE;
+}
+
+void stopFrameCapture() {
+    if (!active) {
+        return;
+    }
+
+    submitFinishedReadbacks(true);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread &encoder : encoders) {
+        encoder.join();
+    }
+    encoders.clear();
+
+    // Deleting the buffers also unmaps them
+    for (CaptureSlot &slot : slots) {
+        slot = CaptureSlot();
+    }
+
+    if (writeY4M) {
+        y4mStream.close();
+    }
+    active = false;
+
+    std::cout << fmt::format("Captured {} frames to {}. Rendering waited on capture in {} frames, for {:.1f} ms in total.",
+                             framesCaptured, outputPath, stalledFrames, stallMs) << std::endl;
+}
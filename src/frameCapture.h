@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+// Readbacks in flight or waiting to be encoded. Capture only waits when all of them are in use.
+const unsigned int CAPTURE_RING_SIZE = 8;
+
+// Records every presented frame to disk without stalling the renderer.
+// Each frame is copied into a persistently mapped pixel-pack buffer, and handed to encoder threads
+// once its fence has signalled, usually a frame or two later.
+// A path ending in .y4m is written as a single uncompressed 4:2:0 video stream, which most video
+// tools accept directly. Any other path is used as a directory for a numbered PNG sequence.
+void startFrameCapture(const std::string &path, unsigned int framesPerSecond);
+bool isFrameCaptureActive();
+
+// Reads back the back buffer of the default framebuffer. Call after rendering and before swapping.
+void captureFrame();
+
+// Waits for every captured frame to be written, and prints how long rendering was held up
+void stopFrameCapture();
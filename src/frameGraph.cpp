@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cstdio>
+#include <fmt/format.h>
+#include <utilities/profiler.h>
+#include "frameGraph.h"
+
+FrameGraphResource FrameGraphBuilder::create(const std::string &label, const FrameGraphTextureDesc &desc) {
+    graph.resources.push_back({ label, desc, false, 0, -1, -1 });
+    return FrameGraphResource(graph.resources.size() - 1);
+}
+
+void FrameGraphBuilder::read(FrameGraphResource resource) {
+    graph.passes.at(passIndex).reads.push_back(resource);
+}
+
+void FrameGraphBuilder::write(FrameGraphResource resource, GLenum attachment) {
+    graph.passes.at(passIndex).writes.push_back({ resource, attachment });
+}
+
+void FrameGraphBuilder::setSideEffect() {
+    graph.passes.at(passIndex).sideEffect = true;
+}
+
+FrameGraphResource FrameGraph::importTexture(const std::string &label, GLuint texture) {
+    resources.push_back({ label, { GL_NONE, 0, 0 }, true, texture, -1, -1 });
+    return FrameGraphResource(resources.size() - 1);
+}
+
+void FrameGraph::addPass(const std::string &name, const std::function<void(FrameGraphBuilder&)> &setup,
+                         std::function<void(const FrameGraph&)> execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+
+    FrameGraphBuilder builder(*this, passes.size() - 1);
+    setup(builder);
+}
+
+static bool readsResource(const std::vector<FrameGraphResource> &reads, FrameGraphResource resource) {
+    return std::find(reads.begin(), reads.end(), resource) != reads.end();
+}
+
+static bool writesResource(const std::vector<std::pair<FrameGraphResource, GLenum>> &writes, FrameGraphResource resource) {
+    return std::any_of(writes.begin(), writes.end(),
+                       [resource](const std::pair<FrameGraphResource, GLenum> &write) { return write.first == resource; });
+}
+
+// Two passes using the same texture, where at least one of them writes it, run in the order they were added,
+// except that a pass reading a transient texture always runs after the passes writing it. Imported textures
+// may be read before this frame's writes on purpose, to get last frame's contents. Passes with no such
+// dependency keep the order they were added in.
+void FrameGraph::sortPasses() {
+    unsigned int count = passes.size();
+    std::vector<std::vector<unsigned int>> dependents(count);
+    std::vector<unsigned int> dependencyCount(count, 0);
+    auto addDependency = [&](unsigned int before, unsigned int after) {
+        dependents[before].push_back(after);
+        dependencyCount[after]++;
+    };
+
+    for (FrameGraphResource resource = 0; resource < resources.size(); resource++) {
+        if (resources[resource].imported) {
+            continue;
+        }
+        bool read = std::any_of(passes.begin(), passes.end(), [resource](const Pass &pass) { return readsResource(pass.reads, resource); });
+        bool written = std::any_of(passes.begin(), passes.end(), [resource](const Pass &pass) { return writesResource(pass.writes, resource); });
+        if (read && !written) {
+            fprintf(stderr, "Frame graph texture %s is read, but no pass writes it.\n", resources[resource].label.c_str());
+        }
+    }
+
+    for (unsigned int first = 0; first < count; first++) {
+        for (unsigned int second = first + 1; second < count; second++) {
+            bool firstRunsBefore = false;
+            bool firstRunsAfter = false;
+            for (FrameGraphResource resource = 0; resource < resources.size(); resource++) {
+                bool firstReads = readsResource(passes[first].reads, resource);
+                bool firstWrites = writesResource(passes[first].writes, resource);
+                bool secondReads = readsResource(passes[second].reads, resource);
+                bool secondWrites = writesResource(passes[second].writes, resource);
+                if (!(firstReads || firstWrites) || !(secondReads || secondWrites) || !(firstWrites || secondWrites)) {
+                    continue;
+                }
+
+                if (!resources[resource].imported && firstReads && !firstWrites && secondWrites) {
+                    firstRunsAfter = true;
+                } else {
+                    firstRunsBefore = true;
+                }
+            }
+            if (firstRunsBefore) {
+                addDependency(first, second);
+            }
+            if (firstRunsAfter) {
+                addDependency(second, first);
+            }
+        }
+    }
+
+    // The earliest added pass whose dependencies have all run goes next
+    std::vector<unsigned int> order;
+    std::vector<bool> scheduled(count, false);
+    while (order.size() < count) {
+        unsigned int next = 0;
+        while (next < count && (scheduled[next] || dependencyCount[next] > 0)) {
+            next++;
+        }
+        if (next == count) {
+            fprintf(stderr, "Frame graph passes depend on each other in a cycle, so they run in the order they were added.\n");
+            return;
+        }
+
+        scheduled[next] = true;
+        order.push_back(next);
+        for (unsigned int dependent : dependents[next]) {
+            dependencyCount[dependent]--;
+        }
+    }
+
+    std::vector<Pass> sorted;
+    sorted.reserve(count);
+    for (unsigned int index : order) {
+        sorted.push_back(std::move(passes[index]));
+    }
+    passes.swap(sorted);
+}
+
+// Walks the passes backwards, keeping those that write something a kept pass after them uses
+void FrameGraph::cullPasses() {
+    std::vector<bool> used(resources.size(), false);
+
+    for (size_t i = passes.size(); i-- > 0;) {
+        Pass &pass = passes[i];
+
+        bool kept = pass.sideEffect;
+        for (const auto &write : pass.writes) {
+            kept = kept || resources[write.first].imported || used[write.first];
+        }
+        pass.culled = !kept;
+        if (!kept) {
+            continue;
+        }
+
+        for (FrameGraphResource resource : pass.reads) {
+            used[resource] = true;
+        }
+        // Attachments are not cleared by binding them, so what earlier passes wrote is still used
+        for (const auto &write : pass.writes) {
+            used[write.first] = true;
+        }
+    }
+}
+
+void FrameGraph::computeLifetimes() {
+    for (Resource &resource : resources) {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+
+    auto extend = [this](FrameGraphResource index, int passIndex) {
+        Resource &resource = resources[index];
+        if (resource.firstPass < 0) {
+            resource.firstPass = passIndex;
+        }
+        resource.lastPass = passIndex;
+    };
+
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (FrameGraphResource resource : passes[i].reads) {
+            extend(resource, i);
+        }
+        for (const auto &write : passes[i].writes) {
+            extend(write.first, i);
+        }
+    }
+}
+
+static bool sameTextureDesc(const FrameGraphTextureDesc &a, const FrameGraphTextureDesc &b) {
+    return a.internalFormat == b.internalFormat && a.width == b.width && a.height == b.height && a.layers == b.layers;
+}
+
+// The first free pooled texture that fits, so a frame declared like the last one gets the same textures
+GLuint FrameGraph::acquireTexture(const Resource &resource) {
+    for (PooledTexture &pooled : pool) {
+        if (!pooled.inUse && sameTextureDesc(pooled.desc, resource.desc)) {
+            pooled.inUse = true;
+            pooled.usedThisFrame = true;
+            return pooled.texture;
+        }
+    }
+
+    // Named after the first resource it holds
+    const FrameGraphTextureDesc &desc = resource.desc;
+    GLTexture texture = createTexture((desc.layers > 1) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, GPU_MEMORY_RENDER_TARGET,
+                                      resource.label, 1, desc.internalFormat, desc.width, desc.height, desc.layers);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    GLuint name = texture;
+    pool.push_back({ resource.desc, std::move(texture), true, true });
+    return name;
+}
+
+void FrameGraph::releaseTexture(GLuint texture) {
+    for (PooledTexture &pooled : pool) {
+        if (pooled.texture == texture) {
+            pooled.inUse = false;
+        }
+    }
+}
+
+// Hands out pooled textures in pass order, returning each one after its resource's last use.
+// A texture returned by one pass can be taken by a resource first used in any later pass.
+void FrameGraph::allocateTextures() {
+    for (PooledTexture &pooled : pool) {
+        pooled.inUse = false;
+        pooled.usedThisFrame = false;
+    }
+
+    for (Resource &resource : resources) {
+        if (!resource.imported) {
+            resource.texture = 0;
+        }
+    }
+
+    for (int i = 0; i < int(passes.size()); i++) {
+        for (Resource &resource : resources) {
+            if (!resource.imported && resource.firstPass == i) {
+                resource.texture = acquireTexture(resource);
+            }
+        }
+        for (Resource &resource : resources) {
+            if (!resource.imported && resource.lastPass == i) {
+                releaseTexture(resource.texture);
+            }
+        }
+    }
+
+    pool.erase(std::remove_if(pool.begin(), pool.end(), [](const PooledTexture &pooled) { return !pooled.usedThisFrame; }),
+               pool.end());
+}
+
+// Every distinct set of attachments gets its own framebuffer, kept for as long as frames keep using it
+void FrameGraph::assignFramebuffers() {
+    for (auto &entry : framebuffers) {
+        entry.second.usedThisFrame = false;
+    }
+
+    for (Pass &pass : passes) {
+        AttachmentSet attachments;
+        for (const auto &write : pass.writes) {
+            if (write.second != FRAME_GRAPH_NO_ATTACHMENT) {
+                attachments.push_back({ write.second, resources[write.first].texture });
+            }
+        }
+
+        pass.bindsFramebuffer = !pass.culled && !attachments.empty();
+        pass.framebuffer = 0;
+        if (!pass.bindsFramebuffer) {
+            continue;
+        }
+
+        // The screen is imported as texture 0, and is the default framebuffer
+        bool drawsToScreen = std::any_of(attachments.begin(), attachments.end(),
+                                         [](const std::pair<GLenum, GLuint> &attachment) { return attachment.second == 0; });
+        if (drawsToScreen) {
+            continue;
+        }
+
+        std::sort(attachments.begin(), attachments.end());
+        auto cached = framebuffers.find(attachments);
+        if (cached == framebuffers.end()) {
+            GLFramebuffer framebuffer = createFramebuffer(pass.name);
+
+            // Draw buffer i writes fragment output i, so outputs keep their location whatever else is attached
+            std::vector<GLenum> drawBuffers;
+            for (const auto &attachment : attachments) {
+                glNamedFramebufferTexture(framebuffer, attachment.first, attachment.second, 0);
+                if (attachment.first >= GL_COLOR_ATTACHMENT0 && attachment.first <= GL_COLOR_ATTACHMENT15) {
+                    unsigned int index = attachment.first - GL_COLOR_ATTACHMENT0;
+                    drawBuffers.resize(std::max<size_t>(drawBuffers.size(), index + 1), GL_NONE);
+                    drawBuffers[index] = attachment.first;
+                }
+            }
+            if (drawBuffers.empty()) {
+                glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+            } else {
+                glNamedFramebufferDrawBuffers(framebuffer, drawBuffers.size(), drawBuffers.data());
+            }
+
+            if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                fprintf(stderr, "Frame graph pass %s has an incomplete framebuffer.\n", pass.name.c_str());
+            }
+
+            cached = framebuffers.emplace(attachments, CachedFramebuffer { std::move(framebuffer), false }).first;
+        }
+
+        cached->second.usedThisFrame = true;
+        pass.framebuffer = cached->second.framebuffer;
+    }
+
+    // Also drops framebuffers holding pooled textures freed above, before their names can be reused
+    for (auto entry = framebuffers.begin(); entry != framebuffers.end();) {
+        entry = entry->second.usedThisFrame ? std::next(entry) : framebuffers.erase(entry);
+    }
+}
+
+void FrameGraph::compile() {
+    PROFILE_ZONE("FrameGraph::compile");
+
+    sortPasses();
+    cullPasses();
+    computeLifetimes();
+    allocateTextures();
+    assignFramebuffers();
+}
+
+void FrameGraph::execute() {
+    PROFILE_ZONE("FrameGraph::execute");
+
+    for (const Pass &pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+        if (pass.bindsFramebuffer) {
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        }
+        pass.execute(*this);
+    }
+}
+
+void FrameGraph::reset() {
+    resources.clear();
+    passes.clear();
+}
+
+void FrameGraph::releaseTextures() {
+    reset();
+    framebuffers.clear();
+    pool.clear();
+}
+
+GLuint FrameGraph::getTexture(FrameGraphResource resource) const {
+    return resources.at(resource).texture;
+}
+
+std::string FrameGraph::formatStats() const {
+    unsigned int culled = std::count_if(passes.begin(), passes.end(), [](const Pass &pass) { return pass.culled; });
+    unsigned int transient = std::count_if(resources.begin(), resources.end(), [](const Resource &resource) {
+        return !resource.imported && resource.firstPass >= 0;
+    });
+
+    return fmt::format("Frame graph: {} passes ({} culled), {} transient textures in {} pooled\n",
+                       passes.size(), culled, transient, pool.size());
+}
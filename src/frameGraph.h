@@ -0,0 +1,139 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <utilities/gpuResources.h>
+
+// A frame's render passes, declared with the textures they read and write, then compiled and executed.
+// Compiling orders the passes by the textures they use: a pass reading a transient texture runs after the passes
+// writing it, and otherwise passes keep the order they were added in. It then culls every pass
+// whose results nothing uses, and gives each transient texture a pooled texture for the passes
+// between its first and last use. Transient textures whose lifetimes do not overlap share a pooled texture,
+// so peak memory follows what is alive at the same time, not everything the frame declares.
+// The pool outlives the frame: a graph rebuilt the same way every frame allocates nothing after the first one,
+// and pooled textures a frame no longer uses are freed at the end of its compile().
+
+typedef unsigned int FrameGraphResource;
+
+// Passed to FrameGraphBuilder::write() for textures written without a framebuffer attachment,
+// e.g. through image stores or a framebuffer the pass binds itself
+const GLenum FRAME_GRAPH_NO_ATTACHMENT = GL_NONE;
+
+// Transient textures are single-level 2D render targets with nearest filtering.
+// With more than one layer they are 2D array textures, attached as layered targets.
+struct FrameGraphTextureDesc {
+    GLenum internalFormat;
+    GLsizei width;
+    GLsizei height;
+    GLsizei layers = 1;
+};
+
+class FrameGraph;
+
+// Declares what a pass uses, in the setup function given to FrameGraph::addPass()
+class FrameGraphBuilder {
+public:
+    // A texture that only exists while the frame is rendered. Its contents are undefined until the pass writes it.
+    FrameGraphResource create(const std::string &label, const FrameGraphTextureDesc &desc);
+    // Sampled by the pass
+    void read(FrameGraphResource resource);
+    // Rendered into at a framebuffer attachment point (GL_COLOR_ATTACHMENTi or GL_DEPTH_STENCIL_ATTACHMENT).
+    // What was there before is kept, so earlier writers are not culled.
+    void write(FrameGraphResource resource, GLenum attachment = FRAME_GRAPH_NO_ATTACHMENT);
+    // Never culled, for passes updating state outside the graph (e.g. the shadow atlas cache)
+    void setSideEffect();
+
+private:
+    friend class FrameGraph;
+    FrameGraphBuilder(FrameGraph &graph, unsigned int passIndex) : graph(graph), passIndex(passIndex) {}
+
+    FrameGraph &graph;
+    unsigned int passIndex;
+};
+
+class FrameGraph {
+public:
+    FrameGraph() = default;
+
+    // A texture owned elsewhere, which outlives the frame: history, caches, and the screen (texture 0).
+    // Passes writing an imported texture are never culled.
+    FrameGraphResource importTexture(const std::string &label, GLuint texture);
+
+    // Calls setup right away. execute is called during execute(), with the framebuffer made of the pass's
+    // attachments bound, unless the pass is culled. Passes without attachments bind what they need themselves.
+    void addPass(const std::string &name, const std::function<void(FrameGraphBuilder&)> &setup,
+                 std::function<void(const FrameGraph&)> execute);
+
+    void compile();
+    void execute();
+
+    // Forgets the passes and resources, so the next frame can be declared. The pool is kept.
+    void reset();
+    // Frees the pooled textures and framebuffers. Call before the context is destroyed.
+    void releaseTextures();
+
+    // The texture behind a resource, once compiled. Transient textures stay valid until the next compile(),
+    // but may hold another resource's contents after their last use.
+    GLuint getTexture(FrameGraphResource resource) const;
+
+    // Passes, culled passes, and transient textures against the pooled textures holding them
+    std::string formatStats() const;
+
+private:
+    friend class FrameGraphBuilder;
+
+    struct Resource {
+        std::string label;
+        FrameGraphTextureDesc desc;
+        bool imported;
+        GLuint texture;
+        int firstPass;  // Lifetime over the passes kept by compile(), -1 if no kept pass uses it
+        int lastPass;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void(const FrameGraph&)> execute;
+        std::vector<FrameGraphResource> reads;
+        std::vector<std::pair<FrameGraphResource, GLenum>> writes;
+        bool sideEffect = false;
+        bool culled = false;
+        GLuint framebuffer = 0;
+        bool bindsFramebuffer = false;
+    };
+
+    struct PooledTexture {
+        FrameGraphTextureDesc desc;
+        GLTexture texture;
+        bool inUse;
+        bool usedThisFrame;
+    };
+
+    // Attachment points and the textures bound to them, sorted
+    typedef std::vector<std::pair<GLenum, GLuint>> AttachmentSet;
+
+    struct CachedFramebuffer {
+        GLFramebuffer framebuffer;
+        bool usedThisFrame;
+    };
+
+    void sortPasses();
+    void cullPasses();
+    void computeLifetimes();
+    void allocateTextures();
+    void assignFramebuffers();
+    GLuint acquireTexture(const Resource &resource);
+    void releaseTexture(GLuint texture);
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<PooledTexture> pool;
+    std::map<AttachmentSet, CachedFramebuffer> framebuffers;
+
+    FrameGraph(FrameGraph const &) = delete;
+    FrameGraph & operator =(FrameGraph const &) = delete;
+};
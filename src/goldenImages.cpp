@@ -0,0 +1,560 @@
+#include <glad/glad.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include <utilities/window.hpp>
+#include <utilities/renderStats.h>
+#include "program.hpp"
+#include "bhSimulation.h"
+#include "accretionDisk.h"
+#include "goldenImages.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Frames rendered before measuring, letting the shadow cache, LOD selection and occlusion culling settle
+const unsigned int WARMUP_FRAMES = 4;
+// Frames whose times are averaged. The last one is the one captured.
+const unsigned int MEASURED_FRAMES = 8;
+const double FIXED_TIME_STEP = 1.0 / 60.0;
+
+// Frames rendered along each camera path of the checkerboard comparison, and how far the camera turns per frame
+const unsigned int COMPARISON_FRAMES = 24;
+const float COMPARISON_TURN_PER_FRAME = glm::radians(0.2f);
+
+// Disk sizes measured by the particle benchmark
+const unsigned int BENCHMARK_PARTICLE_COUNTS[] = {250000, 500000, 1000000, 2000000, 4000000};
+
+struct CameraPose {
+    const char* name;
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+const CameraPose CAMERA_POSES[] = {
+    {"front",  glm::vec3(0, 2, 100),     glm::vec3(0, 0, 0)},
+    {"corner", glm::vec3(140, 90, 140),  glm::vec3(0, 0, 0)},
+    {"above",  glm::vec3(0, 160, 30),    glm::vec3(0, 0, 0)},
+};
+
+// In the order of the ViewMode enum
+const char* VIEW_MODE_NAMES[] = {"regular", "color", "position", "distance", "normals", "stencil", "bh_normals"};
+
+// G-buffer attachments are stored as 16-bit images, with every channel mapped from [rangeMin, rangeMax]
+struct AttachmentCapture {
+    const char* name;
+    unsigned int Framebuffer::* texture;
+    float rangeMin;
+    float rangeMax;
+};
+
+const AttachmentCapture ATTACHMENT_CAPTURES[] = {
+    {"color",     &Framebuffer::colorTexture,     0.0f,   1.0f},
+    {"position",  &Framebuffer::posTexture,    -400.0f, 400.0f},
+    {"normal",    &Framebuffer::normalTexture,   -1.0f,   1.0f},
+    {"stencil",   &Framebuffer::stencilTexture,   0.0f,   1.0f},
+    {"bh_normal", &Framebuffer::bhNormalTexture, -1.0f,   1.0f},
+};
+
+// RGBA, with every channel in [0, 1] and the top row first
+struct GoldenImage {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<float> pixels;
+};
+
+struct FrameTiming {
+    double cpuMs = 0;    // Recording the frame's commands
+    double frameMs = 0;  // Until the GPU has finished the frame
+};
+
+struct PathResult {
+    FrameTiming timing;
+    uint64_t fragmentShaderInvocations = 0;  // In the G-buffer pass of a recent frame. Only measured with --gpu-stats.
+    GoldenImage image;                       // The last frame
+};
+
+struct Comparison {
+    bool referenceFound = false;
+    double differingFraction = 0;
+    double ssim = 0;
+    bool passed = false;
+};
+
+static void makeDirectory(const std::string &path) {
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+static void finishFrame(GLFWwindow* window) {
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+    printGLError();
+    endStatsFrame();
+}
+
+// Renders the warm-up and measured frames, leaving the last one unpresented so it can be read back
+static FrameTiming renderFrames(GLFWwindow* window) {
+    using Clock = std::chrono::steady_clock;
+
+    for (unsigned int i = 0; i < WARMUP_FRAMES; i++) {
+        beginStatsFrame();
+        updateFrame(window);
+        renderFrame(window);
+        finishFrame(window);
+    }
+
+    FrameTiming timing;
+    for (unsigned int i = 0; i < MEASURED_FRAMES; i++) {
+        beginStatsFrame();
+        Clock::time_point start = Clock::now();
+        updateFrame(window);
+        renderFrame(window);
+        Clock::time_point recorded = Clock::now();
+        glFinish();
+        Clock::time_point finished = Clock::now();
+
+        timing.cpuMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+        timing.frameMs += std::chrono::duration<double, std::milli>(finished - start).count();
+
+        if (i + 1 < MEASURED_FRAMES) {
+            finishFrame(window);
+        }
+    }
+
+    timing.cpuMs /= MEASURED_FRAMES;
+    timing.frameMs /= MEASURED_FRAMES;
+    return timing;
+}
+
+static GoldenImage readScreen();
+
+// Renders frames while the camera circles the pose's target, and reads back the last one
+static PathResult renderCameraPath(GLFWwindow* window, const CameraPose &pose) {
+    using Clock = std::chrono::steady_clock;
+
+    PathResult result;
+    glm::vec3 offset = pose.position - pose.target;
+
+    for (unsigned int i = 0; i < COMPARISON_FRAMES; i++) {
+        float angle = COMPARISON_TURN_PER_FRAME * float(i);
+        glm::vec3 turned(offset.x * std::cos(angle) - offset.z * std::sin(angle), offset.y,
+                         offset.x * std::sin(angle) + offset.z * std::cos(angle));
+        setCameraLookAt(pose.target + turned, pose.target);
+
+        beginStatsFrame();
+        Clock::time_point start = Clock::now();
+        updateFrame(window);
+        renderFrame(window);
+        Clock::time_point recorded = Clock::now();
+        glFinish();
+        Clock::time_point finished = Clock::now();
+
+        result.timing.cpuMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+        result.timing.frameMs += std::chrono::duration<double, std::milli>(finished - start).count();
+
+        if (i + 1 < COMPARISON_FRAMES) {
+            finishFrame(window);
+        }
+    }
+
+    result.timing.cpuMs /= COMPARISON_FRAMES;
+    result.timing.frameMs /= COMPARISON_FRAMES;
+
+    result.image = readScreen();
+    const FrameStats &stats = getLatestFrameStats();
+    result.fragmentShaderInvocations = stats.passes[GPU_PASS_GBUFFER].fragmentShaderInvocations
+                                     + stats.passes[GPU_PASS_GBUFFER_LATE].fragmentShaderInvocations;
+
+    finishFrame(window);
+    return result;
+}
+
+static GoldenImage readScreen() {
+    GoldenImage image;
+    image.width = windowWidth;
+    image.height = windowHeight;
+    image.pixels.resize(image.width * image.height * 4);
+
+    std::vector<unsigned char> data(image.pixels.size());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+
+    for (unsigned int y = 0; y < image.height; y++) {
+        const unsigned char* source = &data[(image.height - 1 - y) * image.width * 4];
+        float* destination = &image.pixels[y * image.width * 4];
+        for (unsigned int i = 0; i < image.width * 4; i++) {
+            destination[i] = source[i] / 255.0f;
+        }
+        // The screen's alpha is never shown, so it is left out of the comparison
+        for (unsigned int x = 0; x < image.width; x++) {
+            destination[x * 4 + 3] = 1.0f;
+        }
+    }
+
+    return image;
+}
+
+static GoldenImage readAttachment(unsigned int texture, float rangeMin, float rangeMax) {
+    GoldenImage image;
+    image.width = windowWidth;
+    image.height = windowHeight;
+    image.pixels.resize(image.width * image.height * 4);
+
+    std::vector<float> data(image.pixels.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(texture, 0, GL_RGBA, GL_FLOAT, GLsizei(data.size() * sizeof(float)), data.data());
+
+    for (unsigned int y = 0; y < image.height; y++) {
+        const float* source = &data[(image.height - 1 - y) * image.width * 4];
+        float* destination = &image.pixels[y * image.width * 4];
+        for (unsigned int i = 0; i < image.width * 4; i++) {
+            float value = (source[i] - rangeMin) / (rangeMax - rangeMin);
+            destination[i] = std::isnan(value) ? 0.0f : std::min(std::max(value, 0.0f), 1.0f);
+        }
+    }
+
+    return image;
+}
+
+static bool saveImage(const std::string &path, const GoldenImage &image, unsigned int bitDepth) {
+    std::vector<unsigned char> data;
+    data.reserve(image.pixels.size() * (bitDepth / 8));
+
+    for (float value : image.pixels) {
+        if (bitDepth == 16) {
+            // PNG stores 16-bit samples big-endian
+            unsigned int sample = (unsigned int)std::lround(value * 65535.0f);
+            data.push_back((unsigned char)(sample >> 8));
+            data.push_back((unsigned char)(sample & 0xFF));
+        } else {
+            data.push_back((unsigned char)std::lround(value * 255.0f));
+        }
+    }
+
+    unsigned int error = lodepng::encode(path, data, image.width, image.height, LCT_RGBA, bitDepth);
+    if (error) {
+        std::cerr << fmt::format("Could not write {}: {}", path, lodepng_error_text(error)) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool loadImage(const std::string &path, unsigned int bitDepth, GoldenImage &image) {
+    std::vector<unsigned char> data;
+    unsigned int error = lodepng::decode(data, image.width, image.height, path, LCT_RGBA, bitDepth);
+    if (error) {
+        return false;
+    }
+
+    image.pixels.resize(image.width * image.height * 4);
+    for (size_t i = 0; i < image.pixels.size(); i++) {
+        if (bitDepth == 16) {
+            image.pixels[i] = ((data[i * 2] << 8) | data[i * 2 + 1]) / 65535.0f;
+        } else {
+            image.pixels[i] = data[i] / 255.0f;
+        }
+    }
+    return true;
+}
+
+static float luminance(const float* pixel) {
+    return 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2];
+}
+
+// Mean structural similarity of the luminance, over non-overlapping 8x8 windows
+static double structuralSimilarity(const GoldenImage &a, const GoldenImage &b) {
+    const unsigned int WINDOW = 8;
+    const double C1 = 0.01 * 0.01;
+    const double C2 = 0.03 * 0.03;
+
+    double total = 0;
+    unsigned int windowCount = 0;
+
+    for (unsigned int windowY = 0; windowY + WINDOW <= a.height; windowY += WINDOW) {
+        for (unsigned int windowX = 0; windowX + WINDOW <= a.width; windowX += WINDOW) {
+            double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+            for (unsigned int y = windowY; y < windowY + WINDOW; y++) {
+                for (unsigned int x = windowX; x < windowX + WINDOW; x++) {
+                    size_t index = (size_t(y) * a.width + x) * 4;
+                    double valueA = luminance(&a.pixels[index]);
+                    double valueB = luminance(&b.pixels[index]);
+                    sumA += valueA;
+                    sumB += valueB;
+                    sumAA += valueA * valueA;
+                    sumBB += valueB * valueB;
+                    sumAB += valueA * valueB;
+                }
+            }
+
+            double n = WINDOW * WINDOW;
+            double meanA = sumA / n, meanB = sumB / n;
+            double varianceA = sumAA / n - meanA * meanA;
+            double varianceB = sumBB / n - meanB * meanB;
+            double covariance = sumAB / n - meanA * meanB;
+
+            total += ((2 * meanA * meanB + C1) * (2 * covariance + C2))
+                   / ((meanA * meanA + meanB * meanB + C1) * (varianceA + varianceB + C2));
+            windowCount++;
+        }
+    }
+
+    return windowCount > 0 ? total / windowCount : 1.0;
+}
+
+// Of the color channels, in dB
+static double peakSignalToNoiseRatio(const GoldenImage &a, const GoldenImage &b) {
+    double squaredError = 0;
+    for (size_t index = 0; index < a.pixels.size(); index += 4) {
+        for (int channel = 0; channel < 3; channel++) {
+            double difference = a.pixels[index + channel] - b.pixels[index + channel];
+            squaredError += difference * difference;
+        }
+    }
+
+    double meanSquaredError = squaredError / (double(a.width) * a.height * 3);
+    return meanSquaredError > 0 ? 10.0 * std::log10(1.0 / meanSquaredError) : INFINITY;
+}
+
+// Red where the images differ (brighter for larger differences), over a dimmed copy of the reference
+static GoldenImage differenceImage(const GoldenImage &actual, const GoldenImage &reference) {
+    GoldenImage difference;
+    difference.width = actual.width;
+    difference.height = actual.height;
+    difference.pixels.resize(actual.pixels.size());
+
+    for (size_t index = 0; index < actual.pixels.size(); index += 4) {
+        float maxDifference = 0;
+        for (int channel = 0; channel < 4; channel++) {
+            maxDifference = std::max(maxDifference, std::abs(actual.pixels[index + channel] - reference.pixels[index + channel]));
+        }
+
+        float background = 0.3f * luminance(&reference.pixels[index]);
+        bool differs = maxDifference > GOLDEN_PIXEL_TOLERANCE;
+        difference.pixels[index + 0] = differs ? std::min(0.5f + maxDifference * 8.0f, 1.0f) : background;
+        difference.pixels[index + 1] = differs ? 0.0f : background;
+        difference.pixels[index + 2] = differs ? 0.0f : background;
+        difference.pixels[index + 3] = 1.0f;
+    }
+
+    return difference;
+}
+
+static Comparison compareImages(const GoldenImage &actual, const GoldenImage &reference) {
+    Comparison comparison;
+    comparison.referenceFound = true;
+
+    if (actual.width != reference.width || actual.height != reference.height) {
+        comparison.differingFraction = 1;
+        return comparison;
+    }
+
+    size_t differingPixels = 0;
+    for (size_t index = 0; index < actual.pixels.size(); index += 4) {
+        for (int channel = 0; channel < 4; channel++) {
+            if (std::abs(actual.pixels[index + channel] - reference.pixels[index + channel]) > GOLDEN_PIXEL_TOLERANCE) {
+                differingPixels++;
+                break;
+            }
+        }
+    }
+
+    comparison.differingFraction = double(differingPixels) / (actual.width * actual.height);
+    comparison.ssim = structuralSimilarity(actual, reference);
+    comparison.passed = comparison.differingFraction <= GOLDEN_MAX_DIFFERING_FRACTION
+                     && comparison.ssim >= GOLDEN_MIN_SSIM;
+    return comparison;
+}
+
+bool runGoldenImageTests(GLFWwindow* window, bool updateReferences) {
+    makeDirectory(GOLDEN_OUTPUT_DIRECTORY);
+    if (updateReferences) {
+        makeDirectory(GOLDEN_REFERENCE_DIRECTORY);
+    }
+
+    std::ofstream report(GOLDEN_OUTPUT_DIRECTORY + "report.csv");
+    report << "image,cpu_ms,frame_ms,differing_fraction,ssim,result" << std::endl;
+
+    unsigned int imageCount = 0;
+    unsigned int failureCount = 0;
+    unsigned int missingCount = 0;
+
+    auto checkImage = [&](const std::string &name, const GoldenImage &image, unsigned int bitDepth, const FrameTiming &timing) {
+        std::string fileName = name + ".png";
+        imageCount++;
+        saveImage(GOLDEN_OUTPUT_DIRECTORY + fileName, image, bitDepth);
+
+        if (updateReferences) {
+            bool saved = saveImage(GOLDEN_REFERENCE_DIRECTORY + fileName, image, bitDepth);
+            failureCount += saved ? 0 : 1;
+            report << fmt::format("{},{:.3f},{:.3f},,,{}", name, timing.cpuMs, timing.frameMs, saved ? "updated" : "error") << std::endl;
+            return;
+        }
+
+        Comparison comparison;
+        GoldenImage reference;
+        if (loadImage(GOLDEN_REFERENCE_DIRECTORY + fileName, bitDepth, reference)) {
+            comparison = compareImages(image, reference);
+        }
+
+        const char* result = !comparison.referenceFound ? "missing" : comparison.passed ? "pass" : "fail";
+        missingCount += comparison.referenceFound ? 0 : 1;
+        report << fmt::format("{},{:.3f},{:.3f},{:.6f},{:.5f},{}", name, timing.cpuMs, timing.frameMs,
+                              comparison.differingFraction, comparison.ssim, result) << std::endl;
+
+        if (!comparison.passed) {
+            failureCount++;
+            std::cout << fmt::format("Golden image {}: {} ({:.4f}% of pixels differ, SSIM {:.5f})", name, result,
+                                     comparison.differingFraction * 100.0, comparison.ssim) << std::endl;
+
+            if (comparison.referenceFound && image.width == reference.width && image.height == reference.height) {
+                saveImage(GOLDEN_OUTPUT_DIRECTORY + name + "_diff.png", differenceImage(image, reference), 8);
+            }
+        }
+    };
+
+    setFixedTimeStep(FIXED_TIME_STEP);
+
+    for (const CameraPose &pose : CAMERA_POSES) {
+        setCameraLookAt(pose.position, pose.target);
+
+        for (int mode = REGULAR; mode <= BH_NORMALS; mode++) {
+            viewMode = ViewMode(mode);
+            FrameTiming timing = renderFrames(window);
+
+            checkImage(fmt::format("{}_{}", pose.name, VIEW_MODE_NAMES[mode]), readScreen(), 8, timing);
+
+            // The view mode only changes the resolve, so the G-buffer is captured once per pose
+            if (viewMode == REGULAR) {
+                for (const AttachmentCapture &capture : ATTACHMENT_CAPTURES) {
+                    GoldenImage attachment = readAttachment(getGBuffer().*capture.texture, capture.rangeMin, capture.rangeMax);
+                    checkImage(fmt::format("{}_gbuffer_{}", pose.name, capture.name), attachment, 16, timing);
+                }
+            }
+
+            finishFrame(window);
+        }
+    }
+
+    viewMode = REGULAR;
+    useMeasuredTimeStep();
+
+    if (updateReferences) {
+        std::cout << fmt::format("Golden images: wrote {} references to {}", imageCount, GOLDEN_REFERENCE_DIRECTORY) << std::endl;
+    } else if (missingCount == imageCount) {
+        std::cout << fmt::format("Golden images: no references in {}. Render them with --golden-update on a known good "
+                                 "commit and commit them", GOLDEN_REFERENCE_DIRECTORY) << std::endl;
+    } else {
+        std::cout << fmt::format("Golden images: {} of {} matched. Report written to {}report.csv",
+                                 imageCount - failureCount, imageCount, GOLDEN_OUTPUT_DIRECTORY) << std::endl;
+    }
+
+    return failureCount == 0;
+}
+
+void runCheckerboardComparison(GLFWwindow* window) {
+    makeDirectory(GOLDEN_OUTPUT_DIRECTORY);
+
+    std::ofstream report(GOLDEN_OUTPUT_DIRECTORY + "checkerboard_report.csv");
+    report << "pose,native_frame_ms,checkerboard_frame_ms,native_fragments,checkerboard_fragments,psnr_db,ssim,differing_fraction" << std::endl;
+
+    bool checkerboardWasEnabled = checkerboardRendering;
+    viewMode = REGULAR;
+    setFixedTimeStep(0.0);
+
+    for (const CameraPose &pose : CAMERA_POSES) {
+        checkerboardRendering = false;
+        PathResult native = renderCameraPath(window, pose);
+        checkerboardRendering = true;
+        PathResult checkerboard = renderCameraPath(window, pose);
+
+        Comparison comparison = compareImages(checkerboard.image, native.image);
+        double psnr = peakSignalToNoiseRatio(checkerboard.image, native.image);
+
+        saveImage(GOLDEN_OUTPUT_DIRECTORY + pose.name + "_native.png", native.image, 8);
+        saveImage(GOLDEN_OUTPUT_DIRECTORY + pose.name + "_checkerboard.png", checkerboard.image, 8);
+        saveImage(GOLDEN_OUTPUT_DIRECTORY + pose.name + "_checkerboard_diff.png", differenceImage(checkerboard.image, native.image), 8);
+
+        report << fmt::format("{},{:.3f},{:.3f},{},{},{:.2f},{:.5f},{:.6f}", pose.name, native.timing.frameMs,
+                              checkerboard.timing.frameMs, native.fragmentShaderInvocations,
+                              checkerboard.fragmentShaderInvocations, psnr, comparison.ssim,
+                              comparison.differingFraction) << std::endl;
+        std::cout << fmt::format("Checkerboard {}: {:.2f} ms instead of {:.2f} ms, PSNR {:.1f} dB, SSIM {:.5f}", pose.name,
+                                 checkerboard.timing.frameMs, native.timing.frameMs, psnr, comparison.ssim) << std::endl;
+    }
+
+    checkerboardRendering = checkerboardWasEnabled;
+    useMeasuredTimeStep();
+
+    std::cout << fmt::format("Checkerboard comparison written to {}checkerboard_report.csv", GOLDEN_OUTPUT_DIRECTORY) << std::endl;
+}
+
+void runParticleBenchmark(GLFWwindow* window) {
+    makeDirectory(GOLDEN_OUTPUT_DIRECTORY);
+
+    std::ofstream report(GOLDEN_OUTPUT_DIRECTORY + "particle_report.csv");
+    report << "particles,disk_gpu_ms,particles_per_ms,frame_ms" << std::endl;
+    std::cout << fmt::format("{:>10}  {:>12}  {:>16}  {:>10}", "Particles", "Disk GPU ms", "Particles/ms", "Frame ms") << std::endl;
+
+    unsigned int originalCount = getAccretionDiskParticleCount();
+    viewMode = REGULAR;
+    setFixedTimeStep(FIXED_TIME_STEP);
+    // Looking down on the disk, so most of it is in view
+    setCameraLookAt(CAMERA_POSES[2].position, CAMERA_POSES[2].target);
+
+    for (unsigned int particleCount : BENCHMARK_PARTICLE_COUNTS) {
+        destroyAccretionDisk();
+        initAccretionDisk(particleCount);
+
+        // Only stats of frames rendered after the warm-up, with this count, are used
+        FrameTiming timing = renderFrames(window);
+        finishFrame(window);
+        uint64_t measuredAfter = getLatestFrameStats().frameNumber;
+
+        double diskMs = 0;
+        unsigned int measuredFrames = 0;
+        for (unsigned int i = 0; i < MEASURED_FRAMES * 2 && measuredFrames < MEASURED_FRAMES; i++) {
+            beginStatsFrame();
+            updateFrame(window);
+            renderFrame(window);
+            finishFrame(window);
+
+            const FrameStats &stats = getLatestFrameStats();
+            const PassStats &diskPass = stats.passes[GPU_PASS_PARTICLES];
+            if (stats.frameNumber > measuredAfter && diskPass.measured) {
+                diskMs += diskPass.gpuTimeMs;
+                measuredFrames++;
+                measuredAfter = stats.frameNumber;
+            }
+        }
+
+        if (measuredFrames == 0) {
+            std::cout << fmt::format("{:>10}  no GPU timings available", particleCount) << std::endl;
+            continue;
+        }
+        diskMs /= measuredFrames;
+
+        report << fmt::format("{},{:.3f},{:.0f},{:.3f}", particleCount, diskMs, particleCount / diskMs, timing.frameMs) << std::endl;
+        std::cout << fmt::format("{:>10}  {:>12.3f}  {:>16.0f}  {:>10.3f}", particleCount, diskMs,
+                                 particleCount / diskMs, timing.frameMs) << std::endl;
+    }
+
+    destroyAccretionDisk();
+    initAccretionDisk(originalCount);
+    useMeasuredTimeStep();
+
+    std::cout << fmt::format("Particle benchmark written to {}particle_report.csv", GOLDEN_OUTPUT_DIRECTORY) << std::endl;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <string>
+
+// Stored references, relative to the build directory like the shaders
+const std::string GOLDEN_REFERENCE_DIRECTORY = "../res/golden/";
+// Images rendered by the last run, with difference images and a CSV report
+const std::string GOLDEN_OUTPUT_DIRECTORY = "golden_output/";
+
+// A pixel differs when one of its channels is off by more than this (as a fraction of the full range)
+const float GOLDEN_PIXEL_TOLERANCE = 4.0f / 255.0f;
+// An image fails when more of its pixels differ than this, or when its SSIM falls below the minimum
+const float GOLDEN_MAX_DIFFERING_FRACTION = 0.001f;
+const float GOLDEN_MIN_SSIM = 0.99f;
+
+// Renders the scene from a fixed set of camera poses in every view mode, with a fixed time step,
+// and compares the screen and every G-buffer attachment with the stored references.
+// The average frame time of every pose and view mode is written to the report next to the results,
+// so a single run catches both visual and performance regressions.
+// With updateReferences, the rendered images replace the references instead.
+// Returns whether every image matched.
+bool runGoldenImageTests(GLFWwindow* window, bool updateReferences);
+
+// Renders every camera pose natively and with checkerboard rendering (see checkerboard.h), while the camera
+// slowly circles the pose's target so the reconstruction has to handle motion. The simulations are frozen,
+// so both see the same scene. Frame times, shaded fragments and the differences between the two final
+// frames are written to a report in GOLDEN_OUTPUT_DIRECTORY, along with both images.
+void runCheckerboardComparison(GLFWwindow* window);
+
+// Renders the scene from a fixed camera pose with 250k to 4M particles in the accretion disk, and reports the
+// GPU time of the disk's pass (simulation, compaction and drawing) and its throughput for every count.
+// The results are printed and written to a report in GOLDEN_OUTPUT_DIRECTORY. Needs the GPU stats enabled.
+void runParticleBenchmark(GLFWwindow* window);
@@ -0,0 +1,225 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/shader.hpp>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "uniformBuffers.h"
+#include "gpuTransforms.h"
+
+// Storage block bindings of sceneHierarchy.comp and sceneObjects.comp
+const GLuint NODE_BUFFER_BINDING = 0;
+const GLuint LEVEL_ORDER_BINDING = 1;
+const GLuint WORLD_MATRIX_BINDING = 2;
+const GLuint DRAWABLE_BUFFER_BINDING = 3;
+const GLuint OBJECT_BUFFER_BINDING = 4;
+
+const unsigned int TRANSFORM_WORK_GROUP_SIZE = 64;
+
+// Mirrors SceneNode in the compute shaders (std430)
+struct GPUSceneNode {
+    glm::vec3 position;
+    int parent;
+    glm::vec3 referencePoint;
+    int renderMode;
+    glm::vec3 rotation;
+    float padding0;
+    glm::vec3 scale;
+    float padding1;
+    glm::vec3 color;
+    float padding2;
+};
+
+static Gloom::Shader* hierarchyShader;
+static Gloom::Shader* objectShader;
+
+static GLBuffer nodeBuffer;
+static GLBuffer levelOrderBuffer;
+static GLBuffer worldMatrixBuffer;
+static GLBuffer drawableBuffer;
+static GLBuffer objectBuffer;
+
+// What the node buffer holds, to tell which nodes changed
+static std::vector<GPUSceneNode> uploadedNodes;
+static std::vector<int> parents;
+// Where each level starts in the level order, with the end of the last one at the back
+static std::vector<unsigned int> levelStarts;
+
+static unsigned int drawableCount = 0;
+static GLsizeiptr objectStride;
+
+static GPUTransformStats stats;
+
+void initGPUTransforms(const FlattenedSceneGraph &graph, const std::vector<unsigned int> &drawableNodes) {
+    hierarchyShader = new Gloom::Shader();
+    hierarchyShader->attach("../res/shaders/sceneHierarchy.comp");
+    hierarchyShader->link();
+
+    objectShader = new Gloom::Shader();
+    objectShader->attach("../res/shaders/sceneObjects.comp");
+    objectShader->link();
+
+    size_t nodeCount = graph.nodes.size();
+    parents = graph.parents;
+
+    // Parents come before their children in the flattened graph, so their depth is known first
+    std::vector<unsigned int> depths(nodeCount, 0);
+    unsigned int levelCount = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        depths[i] = (parents[i] >= 0) ? depths[parents[i]] + 1 : 0;
+        levelCount = std::max(levelCount, depths[i] + 1);
+    }
+
+    std::vector<unsigned int> levelOrder(nodeCount);
+    for (size_t i = 0; i < nodeCount; i++) {
+        levelOrder[i] = i;
+    }
+    std::stable_sort(levelOrder.begin(), levelOrder.end(),
+                     [&depths](unsigned int a, unsigned int b) { return depths[a] < depths[b]; });
+
+    levelStarts.assign(levelCount + 1, nodeCount);
+    for (size_t i = nodeCount; i-- > 0;) {
+        levelStarts[depths[levelOrder[i]]] = i;
+    }
+
+    // Filled by the first updateGPUTransforms(), which finds every node changed
+    uploadedNodes.assign(nodeCount, GPUSceneNode());
+    for (GPUSceneNode &node : uploadedNodes) {
+        node.parent = -2;
+    }
+    nodeBuffer = createBuffer(GPU_MEMORY_STORAGE, "Scene node transforms", nodeCount * sizeof(GPUSceneNode), nullptr,
+                              GL_DYNAMIC_STORAGE_BIT);
+    levelOrderBuffer = createBuffer(GPU_MEMORY_STORAGE, "Scene level order", nodeCount * sizeof(unsigned int),
+                                    levelOrder.data(), 0);
+    worldMatrixBuffer = createBuffer(GPU_MEMORY_STORAGE, "Scene world matrices", nodeCount * sizeof(glm::mat4), nullptr, 0);
+
+    // Every range bound to a uniform block must start at a multiple of this
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    objectStride = (GLsizeiptr(sizeof(ObjectUniforms)) + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+    drawableCount = drawableNodes.size();
+    drawableBuffer = createBuffer(GPU_MEMORY_STORAGE, "Scene drawable nodes",
+                                  std::max<size_t>(drawableCount, 1) * sizeof(unsigned int), drawableNodes.data(), 0);
+    objectBuffer = createBuffer(GPU_MEMORY_STORAGE, "Scene object uniforms",
+                                std::max<size_t>(drawableCount, 1) * objectStride, nullptr, 0);
+
+    stats = GPUTransformStats();
+    stats.nodeCount = nodeCount;
+    stats.levels = levelCount;
+}
+
+void destroyGPUTransforms() {
+    nodeBuffer.reset();
+    levelOrderBuffer.reset();
+    worldMatrixBuffer.reset();
+    drawableBuffer.reset();
+    objectBuffer.reset();
+
+    uploadedNodes.clear();
+    parents.clear();
+    levelStarts.clear();
+    drawableCount = 0;
+
+    hierarchyShader->destroy();
+    objectShader->destroy();
+    delete hierarchyShader;
+    delete objectShader;
+}
+
+static bool sameNode(const GPUSceneNode &a, const GPUSceneNode &b) {
+    return a.position == b.position && a.referencePoint == b.referencePoint && a.rotation == b.rotation
+        && a.scale == b.scale && a.color == b.color && a.parent == b.parent && a.renderMode == b.renderMode;
+}
+
+void updateGPUTransforms(const FlattenedSceneGraph &graph) {
+    PROFILE_ZONE("updateGPUTransforms");
+
+    stats.nodesUploaded = 0;
+    stats.uploads = 0;
+
+    // Changed nodes next to each other are uploaded together. Moving nodes created together,
+    // like the orbiting balls, are next to each other in the flattened graph.
+    size_t runStart = 0;
+    size_t runLength = 0;
+    for (size_t i = 0; i <= uploadedNodes.size(); i++) {
+        bool changed = false;
+        if (i < uploadedNodes.size()) {
+            const SceneNode* sceneNode = graph.nodes[i];
+            GPUSceneNode node = {};
+            node.position = sceneNode->position;
+            node.parent = parents[i];
+            node.referencePoint = sceneNode->referencePoint;
+            node.renderMode = sceneNode->nodeType;
+            node.rotation = sceneNode->rotation;
+            node.scale = sceneNode->scale;
+            node.color = sceneNode->color;
+
+            changed = !sameNode(node, uploadedNodes[i]);
+            if (changed) {
+                uploadedNodes[i] = node;
+            }
+        }
+
+        if (changed) {
+            if (runLength == 0) {
+                runStart = i;
+            }
+            runLength++;
+        }
+        else if (runLength > 0) {
+            trackedNamedBufferSubData(nodeBuffer, runStart * sizeof(GPUSceneNode), runLength * sizeof(GPUSceneNode),
+                                      &uploadedNodes[runStart]);
+            stats.nodesUploaded += runLength;
+            stats.uploads++;
+            runLength = 0;
+        }
+    }
+}
+
+void computeGPUTransforms(const glm::mat4 &viewProjection) {
+    PROFILE_ZONE("computeGPUTransforms");
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BUFFER_BINDING, nodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LEVEL_ORDER_BINDING, levelOrderBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WORLD_MATRIX_BINDING, worldMatrixBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAWABLE_BUFFER_BINDING, drawableBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, objectBuffer);
+
+    // Each level reads the world matrices the level above it wrote
+    hierarchyShader->activate();
+    for (size_t level = 0; level + 1 < levelStarts.size(); level++) {
+        unsigned int levelSize = levelStarts[level + 1] - levelStarts[level];
+        trackedUniform1ui(0, levelStarts[level]);
+        trackedUniform1ui(1, levelSize);
+        glDispatchCompute((levelSize + TRANSFORM_WORK_GROUP_SIZE - 1) / TRANSFORM_WORK_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    hierarchyShader->deactivate();
+
+    if (drawableCount > 0) {
+        objectShader->activate();
+        trackedUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        trackedUniform1ui(1, drawableCount);
+        trackedUniform1ui(2, GLuint(objectStride / sizeof(glm::vec4)));
+        glDispatchCompute((drawableCount + TRANSFORM_WORK_GROUP_SIZE - 1) / TRANSFORM_WORK_GROUP_SIZE, 1, 1);
+        objectShader->deactivate();
+    }
+
+    // The draws read the results as uniform blocks
+    glMemoryBarrier(GL_UNIFORM_BARRIER_BIT);
+}
+
+GLuint getGPUObjectUniformsBuffer() {
+    return objectBuffer;
+}
+
+GLintptr getGPUObjectUniformsOffset(unsigned int drawableIndex) {
+    return drawableIndex * objectStride;
+}
+
+GPUTransformStats getGPUTransformStats() {
+    return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "sceneGraph.hpp"
+
+struct GPUTransformStats {
+    unsigned int nodeCount = 0;
+    unsigned int nodesUploaded = 0;  // In the most recent frame
+    unsigned int uploads = 0;        // Runs of consecutive nodes the changed ones were uploaded in
+    unsigned int levels = 0;         // Depth of the graph, one dispatch each
+};
+
+// Scene graph transformations evaluated on the GPU, for scenes where uploading every drawn node's matrices
+// each frame would take more bandwidth than the draws themselves.
+// Every node's position, rotation, scale and reference point are kept in a storage buffer, and only the nodes
+// that changed since the previous frame are uploaded again. A compute shader then evaluates the world matrices
+// one level of the graph at a time, so every parent is done before its children, and a second one writes the
+// ObjectUniforms of every drawable node into a buffer the draws bind directly. The CPU never uploads a matrix.
+
+// drawableNodes are indices into graph.nodes, as passed to the draws. The graph must not change shape afterwards.
+void initGPUTransforms(const FlattenedSceneGraph &graph, const std::vector<unsigned int> &drawableNodes);
+void destroyGPUTransforms();
+
+// Uploads the nodes whose transformation, color or type changed since the previous call
+void updateGPUTransforms(const FlattenedSceneGraph &graph);
+// Dispatches the evaluation. Every draw reading the ObjectUniforms has to come after it.
+void computeGPUTransforms(const glm::mat4 &viewProjection);
+
+// Where the ObjectUniforms of drawableNodes[drawableIndex] are, for bindObjectUniforms()
+GLuint getGPUObjectUniformsBuffer();
+GLintptr getGPUObjectUniformsOffset(unsigned int drawableIndex);
+
+GPUTransformStats getGPUTransformStats();
@@ -0,0 +1,177 @@
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <glm/glm.hpp>
+#include <utilities/window.hpp>
+#include <utilities/glfont.h>
+#include <utilities/glutils.h>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include <utilities/mappedRing.h>
+#include "sceneGraph.hpp"
+#include "assetRegistry.h"
+#include "uniformBuffers.h"
+#include "hudText.h"
+
+// Text lies between the orthographic projection's near and far planes
+const float HUD_DEPTH = -1.0f;
+
+// Extra space between lines, as a fraction of the character height
+const float HUD_LINE_SPACING = 0.15f;
+
+// Interleaved, matching attribute locations 0 and 2 of simple.vert
+struct HUDVertex {
+    glm::vec3 position;
+    glm::vec2 textureCoordinates;
+};
+
+static Gloom::Shader* hudShader;
+static unsigned int hudShaderFeatures;
+static TextureHandle charmap;
+
+static GLVertexArray vertexArray;
+static GLBuffer vertexBuffer;
+static GLBuffer indexBuffer;
+static HUDVertex* ringMemory;
+static MappedRingFences ringFences;
+
+static unsigned int glyphCount = 0;
+static bool glyphLimitReported = false;
+
+void initHUDText(Gloom::Shader* shader, unsigned int features) {
+    hudShader = shader;
+    hudShaderFeatures = features;
+
+    charmap = acquireTexture("../res/textures/charmap.png");
+
+    ringMemory = static_cast<HUDVertex*>(createMappedRing(vertexBuffer, GPU_MEMORY_VERTEX, "HUD vertex ring",
+                                                         HUD_MAX_GLYPHS * 4 * sizeof(HUDVertex)));
+
+    // Every glyph is a quad with the same index pattern, so the indices never change.
+    // The draw picks the frame's section with its base vertex.
+    std::vector<unsigned short> indices(HUD_MAX_GLYPHS * 6);
+    for (unsigned int i = 0; i < HUD_MAX_GLYPHS; i++) {
+        indices[6 * i + 0] = (unsigned short)(4 * i + 0);
+        indices[6 * i + 1] = (unsigned short)(4 * i + 1);
+        indices[6 * i + 2] = (unsigned short)(4 * i + 2);
+        indices[6 * i + 3] = (unsigned short)(4 * i + 0);
+        indices[6 * i + 4] = (unsigned short)(4 * i + 2);
+        indices[6 * i + 5] = (unsigned short)(4 * i + 3);
+    }
+    indexBuffer = createBuffer(GPU_MEMORY_INDEX, "HUD indices", indices.size() * sizeof(unsigned short), indices.data(), 0);
+
+    vertexArray = createVertexArray("HUD text");
+    glVertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, 0, sizeof(HUDVertex));
+    glVertexArrayElementBuffer(vertexArray, indexBuffer);
+
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(HUDVertex, position));
+    glVertexArrayAttribBinding(vertexArray, 0, 0);
+
+    glEnableVertexArrayAttrib(vertexArray, 2);
+    glVertexArrayAttribFormat(vertexArray, 2, 2, GL_FLOAT, GL_FALSE, offsetof(HUDVertex, textureCoordinates));
+    glVertexArrayAttribBinding(vertexArray, 2, 0);
+}
+
+void destroyHUDText() {
+    ringFences.reset();
+
+    vertexArray.reset();
+    vertexBuffer.reset();
+    indexBuffer.reset();
+    ringMemory = nullptr;
+
+    charmap.reset();
+}
+
+void beginHUDFrame() {
+    ringFences.waitForCurrentSection();
+
+    glyphCount = 0;
+}
+
+void addHUDText(float x, float y, float characterHeight, const std::string &text) {
+    float characterWidth = characterHeight * CHARMAP_GLYPH_ASPECT;
+
+    // The orthographic projection has its origin in the bottom left corner
+    float left = x;
+    float top = float(windowHeight) - y;
+
+    // Written front to back and never read, as the mapping is write-combined
+    HUDVertex* vertices = ringMemory + ringFences.currentSection() * HUD_MAX_GLYPHS * 4;
+    glm::vec2 textureCoordinates[4];
+
+    for (char character : text) {
+        if (character == '\n') {
+            left = x;
+            top -= characterHeight * (1.0f + HUD_LINE_SPACING);
+            continue;
+        }
+        if (character == ' ') {
+            left += characterWidth;
+            continue;
+        }
+        if (glyphCount == HUD_MAX_GLYPHS) {
+            if (!glyphLimitReported) {
+                fprintf(stderr, "HUD text is full (%u glyphs); dropping the rest.\n", HUD_MAX_GLYPHS);
+                glyphLimitReported = true;
+            }
+            return;
+        }
+
+        float bottom = top - characterHeight;
+        glyphTextureCoordinates(character, textureCoordinates);
+
+        HUDVertex* quad = vertices + glyphCount * 4;
+        quad[0] = { glm::vec3(left, bottom, HUD_DEPTH), textureCoordinates[0] };
+        quad[1] = { glm::vec3(left + characterWidth, bottom, HUD_DEPTH), textureCoordinates[1] };
+        quad[2] = { glm::vec3(left + characterWidth, top, HUD_DEPTH), textureCoordinates[2] };
+        quad[3] = { glm::vec3(left, top, HUD_DEPTH), textureCoordinates[3] };
+
+        glyphCount++;
+        left += characterWidth;
+    }
+}
+
+void renderHUD() {
+    PROFILE_ZONE("renderHUD");
+
+    if (glyphCount > 0) {
+        apiCounters.bytesUploaded += glyphCount * 4 * sizeof(HUDVertex);
+
+        // The vertices are already in window coordinates
+        ObjectUniforms uniforms;
+        uniforms.modelMatrix = glm::mat4(1.0f);
+        uniforms.modelViewProjection = glm::mat4(1.0f);
+        for (int column = 0; column < 3; column++) {
+            uniforms.normalMatrix[column] = glm::vec4(0.0f);
+            uniforms.normalMatrix[column][column] = 1.0f;
+        }
+        uniforms.modelColor = glm::vec3(1.0f);
+        uniforms.renderMode = GEOMETRY_2D;
+        GLintptr uniformOffset = writeObjectUniforms(uniforms);
+
+        hudShader->activate(hudShaderFeatures);
+
+        // Drawn over the finished frame, so only the glyphs' alpha decides what they cover
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        bindObjectUniforms(uniformOffset);
+        trackedBindTextureUnit(0, charmap->textureID);
+        trackedBindVertexArray(vertexArray);
+        trackedDrawElementsBaseVertex(GL_TRIANGLES, glyphCount * 6, GL_UNSIGNED_SHORT, nullptr,
+                                      ringFences.currentSection() * HUD_MAX_GLYPHS * 4);
+
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+
+        hudShader->deactivate();
+    }
+
+    // Fenced even when empty, so beginHUDFrame() always has something to wait for
+    ringFences.fenceCurrentSection();
+}
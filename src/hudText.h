@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <utilities/shader.hpp>
+
+// Glyphs that fit in one frame's section of the vertex ring. Text beyond this is dropped.
+const unsigned int HUD_MAX_GLYPHS = 4096;
+
+// Text drawn over the finished frame, such as the live stats overlay.
+// All glyph quads of a frame are written straight into a persistently mapped vertex ring, and drawn
+// with a single draw call through the GEOMETRY_2D path of the G-buffer shader. Nothing is allocated
+// or re-uploaded per string, so the text can change every frame.
+// The shader is the G-buffer shader, with the feature mask of its GEOMETRY_2D permutation.
+void initHUDText(Gloom::Shader* shader, unsigned int features);
+void destroyHUDText();
+
+// Waits until the GPU is done with the ring section about to be overwritten, and empties it
+void beginHUDFrame();
+
+// Adds text with its top left corner at (x, y), in pixels from the top left corner of the window.
+// Each '\n' starts a new line below the first.
+void addHUDText(float x, float y, float characterHeight, const std::string &text);
+
+// Draws everything added this frame into the bound framebuffer, blended over what is already there.
+// Call between beginUniformFrame() and endUniformFrame(), as it writes its own object uniforms.
+void renderHUD();
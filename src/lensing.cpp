@@ -0,0 +1,283 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include <utilities/shader.hpp>
+#include <utilities/window.hpp>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include <utilities/mappedRing.h>
+#include "lensing.h"
+
+// Storage block binding of lensing.frag
+const GLuint BLACK_HOLE_BUFFER_BINDING = 0;
+
+const unsigned int TILE_COLUMNS = (windowWidth + LENSING_TILE_SIZE - 1) / LENSING_TILE_SIZE;
+const unsigned int TILE_ROWS = (windowHeight + LENSING_TILE_SIZE - 1) / LENSING_TILE_SIZE;
+const unsigned int TILE_COUNT = TILE_COLUMNS * TILE_ROWS;
+
+// Each ring section has room for the tiles of every eye. The black holes are the same for all of them.
+const unsigned int MAX_LENSING_VIEWS = STEREO_EYE_COUNT;
+
+// Feature key of lensingShader, drawing into both layers of a stereo G-buffer
+const unsigned int LENSING_STEREO_FEATURE = 1 << 0;
+
+// The eye goes in the highest bit of a tile, see lensing.vert
+const unsigned int TILE_EYE_SHIFT = 31;
+
+// Mirrors BlackHole in lensing.frag (std430)
+struct BlackHoleData {
+    glm::vec3 position;
+    float radius;
+};
+
+// Pixels a node's bounding box covers on screen
+struct ScreenFootprint {
+    bool onScreen = false;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+static Gloom::Shader* lensingShader;
+
+// Tiles to shade, with the column in the low 16 bits, the row in the next 15 and the eye in the highest bit,
+// read as an instanced attribute
+static GLBuffer tileRing;
+static unsigned int* tileMemory;
+static GLVertexArray tileVAO;
+
+static GLBuffer blackHoleRing;
+static unsigned char* blackHoleMemory;
+static GLsizeiptr blackHoleSectionStride;
+
+// Shared by both rings, which are written and read in the same frames
+static MappedRingFences ringFences;
+
+// Whether any black hole fragment passed the depth test in the G-buffer pass
+static GLuint visibilityQuery;
+static bool visibilityQueried = false;
+
+// Which tiles at least one footprint overlaps, for every eye
+static std::vector<unsigned char> tileOverlapped;
+
+static unsigned int lensingViewCount = 1;
+static unsigned int blackHoleCount = 0;
+static unsigned int visibleBlackHoles = 0;
+static unsigned int tileCount = 0;
+
+float blackHoleMaskValue(int blackHoleID) {
+    return float(MAX_BLACK_HOLES - blackHoleID) / 255.0f;
+}
+
+void initLensing() {
+    lensingShader = new Gloom::Shader();
+    lensingShader->makePermutedShader({ "../res/shaders/lensing.vert", "../res/shaders/lensing.frag" }, { "RENDER_STEREO" });
+
+    // Every range bound to a storage block must start at a multiple of this
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    GLsizeiptr blackHoleSectionSize = MAX_BLACK_HOLES * sizeof(BlackHoleData);
+    blackHoleSectionStride = (blackHoleSectionSize + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+    tileMemory = static_cast<unsigned int*>(createMappedRing(tileRing, GPU_MEMORY_VERTEX, "Lensing tile ring",
+                                                             MAX_LENSING_VIEWS * TILE_COUNT * sizeof(unsigned int)));
+    blackHoleMemory = static_cast<unsigned char*>(createMappedRing(blackHoleRing, GPU_MEMORY_STORAGE, "Black hole ring",
+                                                                   blackHoleSectionStride));
+
+    // The corners of each tile come from gl_VertexID. The draw picks the frame's section with its base instance.
+    tileVAO = createVertexArray("Lensing tiles");
+    glVertexArrayVertexBuffer(tileVAO, 0, tileRing, 0, sizeof(unsigned int));
+    glVertexArrayBindingDivisor(tileVAO, 0, 1);
+    glEnableVertexArrayAttrib(tileVAO, 0);
+    glVertexArrayAttribIFormat(tileVAO, 0, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(tileVAO, 0, 0);
+
+    glCreateQueries(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, 1, &visibilityQuery);
+
+    tileOverlapped.assign(MAX_LENSING_VIEWS * TILE_COUNT, 0);
+}
+
+void destroyLensing() {
+    ringFences.reset();
+
+    glDeleteQueries(1, &visibilityQuery);
+
+    tileVAO.reset();
+    tileRing.reset();
+    blackHoleRing.reset();
+    tileMemory = nullptr;
+    blackHoleMemory = nullptr;
+
+    lensingShader->destroy();
+    delete lensingShader;
+}
+
+// Projects the corners of a node's bounding box. If the box reaches behind the camera, the corners
+// cannot be projected, so the footprint is the whole screen unless the box is off to one side.
+static ScreenFootprint projectScreenFootprint(SceneNode* node, const glm::mat4 &viewProjection) {
+    glm::mat4 modelViewProjection = viewProjection * node->currentTransformationMatrix;
+
+    glm::vec2 ndcMin(1.0f);
+    glm::vec2 ndcMax(-1.0f);
+    bool behindCamera = false;
+    // Corners outside each of the six clip planes
+    int outside[6] = {};
+
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 position((corner & 1) ? node->boundingBoxMax.x : node->boundingBoxMin.x,
+                           (corner & 2) ? node->boundingBoxMax.y : node->boundingBoxMin.y,
+                           (corner & 4) ? node->boundingBoxMax.z : node->boundingBoxMin.z);
+        glm::vec4 clipPosition = modelViewProjection * glm::vec4(position, 1.0f);
+
+        for (int axis = 0; axis < 3; axis++) {
+            outside[2 * axis + 0] += (clipPosition[axis] < -clipPosition.w) ? 1 : 0;
+            outside[2 * axis + 1] += (clipPosition[axis] > clipPosition.w) ? 1 : 0;
+        }
+
+        if (clipPosition.w <= 0.0f) {
+            behindCamera = true;
+            continue;
+        }
+        glm::vec2 ndcPosition = glm::vec2(clipPosition) / clipPosition.w;
+        ndcMin = glm::min(ndcMin, ndcPosition);
+        ndcMax = glm::max(ndcMax, ndcPosition);
+    }
+
+    ScreenFootprint footprint;
+    for (int plane = 0; plane < 6; plane++) {
+        if (outside[plane] == 8) {
+            return footprint;
+        }
+    }
+    if (behindCamera) {
+        ndcMin = glm::vec2(-1.0f);
+        ndcMax = glm::vec2(1.0f);
+    }
+
+    // Rounded outwards, so the edge pixels are always covered
+    glm::vec2 screenSize(windowWidth, windowHeight);
+    glm::vec2 screenMin = glm::floor((glm::clamp(ndcMin, -1.0f, 1.0f) + 1.0f) / 2.0f * screenSize);
+    glm::vec2 screenMax = glm::ceil((glm::clamp(ndcMax, -1.0f, 1.0f) + 1.0f) / 2.0f * screenSize);
+
+    footprint.x = int(screenMin.x);
+    footprint.y = int(screenMin.y);
+    footprint.width = int(screenMax.x - screenMin.x);
+    footprint.height = int(screenMax.y - screenMin.y);
+    footprint.onScreen = footprint.width > 0 && footprint.height > 0;
+    return footprint;
+}
+
+void updateLensing(const std::vector<SceneNode*> &blackHoles, const LensingView* views, unsigned int viewCount) {
+    PROFILE_ZONE("updateLensing");
+
+    ringFences.waitForCurrentSection();
+    unsigned int currentSection = ringFences.currentSection();
+
+    if (blackHoles.size() > MAX_BLACK_HOLES) {
+        fprintf(stderr, "Only the first %u of %zu black holes are lensed.\n", MAX_BLACK_HOLES, blackHoles.size());
+    }
+    blackHoleCount = std::min<unsigned int>(blackHoles.size(), MAX_BLACK_HOLES);
+    lensingViewCount = std::min(viewCount, MAX_LENSING_VIEWS);
+    visibleBlackHoles = 0;
+    visibilityQueried = false;
+
+    // Written front to back and never read, as the mapping is write-combined
+    BlackHoleData* blackHoleData = reinterpret_cast<BlackHoleData*>(blackHoleMemory + currentSection * blackHoleSectionStride);
+    for (unsigned int i = 0; i < blackHoleCount; i++) {
+        SceneNode* node = blackHoles[i];
+
+        BlackHoleData data;
+        data.position = glm::vec3(node->currentTransformationMatrix * glm::vec4(0, 0, 0, 1));
+        // Black holes are spheres, only ever scaled uniformly
+        data.radius = (node->boundingBoxMax.x - node->boundingBoxMin.x) / 2.0f
+                    * glm::length(glm::vec3(node->currentTransformationMatrix[0]));
+        blackHoleData[i] = data;
+    }
+
+    std::fill(tileOverlapped.begin(), tileOverlapped.end(), 0);
+    for (unsigned int view = 0; view < lensingViewCount; view++) {
+        const glm::mat4 &viewProjection = views[view].viewProjection;
+        unsigned char* viewTiles = &tileOverlapped[view * TILE_COUNT];
+
+        for (unsigned int i = 0; i < blackHoleCount; i++) {
+            ScreenFootprint footprint = projectScreenFootprint(blackHoles[i], viewProjection);
+            if (!footprint.onScreen) {
+                continue;
+            }
+            visibleBlackHoles++;
+
+            int firstColumn = footprint.x / int(LENSING_TILE_SIZE);
+            int lastColumn = (footprint.x + footprint.width - 1) / int(LENSING_TILE_SIZE);
+            int firstRow = footprint.y / int(LENSING_TILE_SIZE);
+            int lastRow = (footprint.y + footprint.height - 1) / int(LENSING_TILE_SIZE);
+            for (int row = firstRow; row <= lastRow; row++) {
+                for (int column = firstColumn; column <= lastColumn; column++) {
+                    viewTiles[row * TILE_COLUMNS + column] = 1;
+                }
+            }
+        }
+    }
+
+    // Tiles shared by several footprints are still only shaded once per eye
+    unsigned int* tiles = tileMemory + currentSection * MAX_LENSING_VIEWS * TILE_COUNT;
+    tileCount = 0;
+    for (unsigned int view = 0; view < lensingViewCount; view++) {
+        for (unsigned int tile = 0; tile < TILE_COUNT; tile++) {
+            if (tileOverlapped[view * TILE_COUNT + tile]) {
+                tiles[tileCount++] = (view << TILE_EYE_SHIFT) | ((tile / TILE_COLUMNS) << 16) | (tile % TILE_COLUMNS);
+            }
+        }
+    }
+
+    apiCounters.bytesUploaded += blackHoleCount * sizeof(BlackHoleData) + tileCount * sizeof(unsigned int);
+}
+
+void beginBlackHoleVisibilityQuery() {
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, visibilityQuery);
+    visibilityQueried = true;
+}
+
+void endBlackHoleVisibilityQuery() {
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+}
+
+void renderLensing() {
+    PROFILE_ZONE("renderLensing");
+
+    // Nothing was written into gStencil, or nothing of it is on screen.
+    // The section is not read then, so it can be written again next frame.
+    if (!visibilityQueried || tileCount == 0) {
+        return;
+    }
+
+    unsigned int currentSection = ringFences.currentSection();
+    lensingShader->activate(lensingViewCount > 1 ? LENSING_STEREO_FEATURE : 0);
+
+    // The tiles lie at the same depth as the screen quad drawn before them
+    glDisable(GL_DEPTH_TEST);
+
+    trackedBindBufferRange(GL_SHADER_STORAGE_BUFFER, BLACK_HOLE_BUFFER_BINDING, blackHoleRing,
+                           currentSection * blackHoleSectionStride, blackHoleCount * sizeof(BlackHoleData));
+    trackedBindVertexArray(tileVAO);
+
+    // Decided on the GPU, so the CPU never waits for the query
+    glBeginConditionalRender(visibilityQuery, GL_QUERY_WAIT);
+    trackedDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, tileCount, currentSection * MAX_LENSING_VIEWS * TILE_COUNT);
+    glEndConditionalRender();
+
+    glEnable(GL_DEPTH_TEST);
+
+    lensingShader->deactivate();
+
+    ringFences.fenceCurrentSection();
+}
+
+unsigned int getVisibleBlackHoleCount() {
+    return visibleBlackHoles;
+}
+
+unsigned int getLensingTileCount() {
+    return tileCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "sceneGraph.hpp"
+#include "stereo.h"
+
+// gStencil is 8 bits, and 0 means no black hole
+const unsigned int MAX_BLACK_HOLES = 255;
+
+// Must match lensing.vert. The screen is binned into square tiles of this many pixels.
+const unsigned int LENSING_TILE_SIZE = 32;
+
+// Gravitational lensing of any number of black holes, applied over the regular deferred resolve.
+// Every black hole writes its own value into gStencil, so each pixel only evaluates the one covering it.
+// The screen is divided into tiles, and only tiles overlapped by a black hole's projected bounding box
+// are shaded, with one instanced draw. The cost follows the area the black holes cover, not their count.
+// In stereo, the tiles of both eyes go into the same draw, each drawn into its eye's layer of the G-buffer.
+
+// The black holes are projected once per view: the camera's, or each eye's in stereo
+struct LensingView {
+    glm::mat4 viewProjection;
+};
+
+// What a black hole writes into gStencil, passed to the shader as its node color. The first one writes 1.
+float blackHoleMaskValue(int blackHoleID);
+
+void initLensing();
+void destroyLensing();
+
+// Projects the black holes to the screen of every view and bins the tiles they overlap. With more than one view,
+// the views are the eyes of a layered G-buffer, at most STEREO_EYE_COUNT of them.
+// Waits until the GPU is done with the ring section about to be overwritten.
+void updateLensing(const std::vector<SceneNode*> &blackHoles, const LensingView* views, unsigned int viewCount);
+
+// Around the G-buffer draws of all black holes. The lensing pass is skipped when none of them is visible.
+void beginBlackHoleVisibilityQuery();
+void endBlackHoleVisibilityQuery();
+
+// Draws the lensing into the current framebuffer. Expects the G-buffer textures bound to units 0-4,
+// and the environment map to ENVIRONMENT_MAP_UNIT (see environmentProbe.h).
+void renderLensing();
+
+// Black holes on screen, and tiles shaded, in the most recent frame, summed over the eyes in stereo
+unsigned int getVisibleBlackHoleCount();
+unsigned int getLensingTileCount();
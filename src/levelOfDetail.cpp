@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <utilities/glutils.h>
+#include <utilities/shapes.h>
+#include <utilities/meshSimplification.h>
+#include "levelOfDetail.h"
+
+// A node covering at least this much of the screen height is drawn at full detail.
+// Each further level halves the tessellation along both axes, so it is used at half the coverage of the previous one.
+const float LOD_FULL_DETAIL_COVERAGE = 0.5f;
+
+// Relative margin around each threshold, so nodes close to one do not switch level every frame
+const float LOD_HYSTERESIS = 0.15f;
+
+// Sphere tessellation is never reduced below this
+const int LOD_MIN_SLICES = 6;
+const int LOD_MIN_LAYERS = 4;
+
+std::vector<Mesh> generateSphereLODChain(float radius, int slices, int layers, bool inverted, int levelCount) {
+    std::vector<Mesh> levels;
+
+    for (int level = 0; level < levelCount; level++) {
+        levels.push_back(generateSphere(radius, slices, layers, inverted));
+
+        if (slices <= LOD_MIN_SLICES && layers <= LOD_MIN_LAYERS) {
+            break;
+        }
+        slices = std::max(slices / 2, LOD_MIN_SLICES);
+        layers = std::max(layers / 2, LOD_MIN_LAYERS);
+    }
+
+    return levels;
+}
+
+std::vector<Mesh> generateSimplifiedLODChain(const Mesh &mesh, int levelCount) {
+    std::vector<Mesh> levels;
+    levels.push_back(mesh);
+
+    for (int level = 1; level < levelCount; level++) {
+        Mesh simplified = simplifyMesh(levels.back(), 0.25f);
+
+        // Stop once the simplifier cannot make any more progress
+        if (simplified.indices.size() >= levels.back().indices.size()) {
+            break;
+        }
+        levels.push_back(simplified);
+    }
+
+    return levels;
+}
+
+void setUpLODChain(SceneNode* node, const std::vector<MeshHandle> &levels) {
+    node->lodLevels.clear();
+
+    float minScreenCoverage = LOD_FULL_DETAIL_COVERAGE;
+    for (unsigned int i = 0; i < levels.size(); i++) {
+        LODLevel level;
+        level.vertexArrayObjectID = levels.at(i)->vertexArrayID;
+        level.VAOIndexCount       = levels.at(i)->indexCount;
+        // The coarsest level is used no matter how small the node gets
+        level.minScreenCoverage   = (i + 1 == levels.size()) ? 0.0f : minScreenCoverage;
+        node->lodLevels.push_back(level);
+        node->assets.push_back(levels.at(i));
+
+        minScreenCoverage /= 2.0f;
+    }
+
+    node->currentLOD          = 0;
+    node->vertexArrayObjectID = node->lodLevels.at(0).vertexArrayObjectID;
+    node->VAOIndexCount       = node->lodLevels.at(0).VAOIndexCount;
+    node->boundingBoxMin      = levels.at(0)->boundingBoxMin;
+    node->boundingBoxMax      = levels.at(0)->boundingBoxMax;
+}
+
+float projectedScreenCoverage(float radius, float distance, float fieldOfViewY) {
+    float frustumHeight = 2 * tan(fieldOfViewY / 2.0f) * distance;
+    return radius * 2 / frustumHeight;
+}
+
+void selectLODs(SceneNode* node, glm::vec3 eyePosition, float fieldOfViewY) {
+    if (!node->lodLevels.empty()) {
+        // Bounding sphere of the node's bounding box, in world space
+        const glm::mat4 &model = node->currentTransformationMatrix;
+        glm::vec3 localCenter = (node->boundingBoxMin + node->boundingBoxMax) / 2.0f;
+        float localRadius = glm::length(node->boundingBoxMax - node->boundingBoxMin) / 2.0f;
+        float maxScale = std::max(glm::length(glm::vec3(model[0])),
+                         std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1));
+        float radius = localRadius * maxScale;
+        float distance = glm::length(eyePosition - center);
+
+        // Inside the bounding sphere, always use full detail
+        float coverage = distance > radius ? projectedScreenCoverage(radius, distance, fieldOfViewY) : INFINITY;
+
+        unsigned int level = node->currentLOD;
+        unsigned int coarsest = node->lodLevels.size() - 1;
+
+        // Refine while clearly above the threshold of the next finer level, coarsen while clearly below our own
+        while (level > 0 && coverage > node->lodLevels.at(level - 1).minScreenCoverage * (1.0f + LOD_HYSTERESIS)) {
+            level--;
+        }
+        while (level < coarsest && coverage < node->lodLevels.at(level).minScreenCoverage * (1.0f - LOD_HYSTERESIS)) {
+            level++;
+        }
+
+        node->currentLOD          = level;
+        node->vertexArrayObjectID = node->lodLevels.at(level).vertexArrayObjectID;
+        node->VAOIndexCount       = node->lodLevels.at(level).VAOIndexCount;
+    }
+
+    for (SceneNode* child : node->children) {
+        selectLODs(child, eyePosition, fieldOfViewY);
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <utilities/mesh.h>
+#include "sceneGraph.hpp"
+#include "assetRegistry.h"
+
+// Sphere re-tessellated with half the slices and layers for every further level
+std::vector<Mesh> generateSphereLODChain(float radius, int slices, int layers, bool inverted, int levelCount);
+// Arbitrary mesh reduced by edge collapses to a quarter of the triangles for every further level
+std::vector<Mesh> generateSimplifiedLODChain(const Mesh &mesh, int levelCount);
+
+// Assigns every level of the chain to the node, starting at the finest level. The node keeps them alive.
+void setUpLODChain(SceneNode* node, const std::vector<MeshHandle> &levels);
+
+// Fraction of the screen height covered by a sphere, seen from the given distance
+float projectedScreenCoverage(float radius, float distance, float fieldOfViewY);
+
+// Picks a level for every node with a LOD chain from its projected size on screen
+void selectLODs(SceneNode* node, glm::vec3 eyePosition, float fieldOfViewY);
@@ -1,6 +1,11 @@
 // Local headers
 #include "utilities/window.hpp"
 #include "program.hpp"
+#include "nbodyBenchmark.h"
+#include "matrixBenchmark.h"
+#include "tiledRender.h"
+#include "bhSimulation.h"
+#include "utilities/gpuResources.h"
 
 // System headers
 #include <glad/glad.h>
@@ -8,6 +13,7 @@
 
 // Standard headers
 #include <cstdlib>
+#include <algorithm>
 #include <arrrgh.hpp>
 
 
@@ -18,7 +24,7 @@ static void glfwErrorCallback(int error, const char *description)
 }
 
 
-GLFWwindow* initialise()
+GLFWwindow* initialise(bool visible)
 {
     // Initialise GLFW
     if (!glfwInit())
@@ -38,6 +44,7 @@ GLFWwindow* initialise()
     // Set additional window options
     glfwWindowHint(GLFW_RESIZABLE, windowResizable);
     glfwWindowHint(GLFW_SAMPLES, windowSamples);  // MSAA
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     // Create window using GLFW
     GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, windowTitle.c_str(), nullptr, nullptr);
@@ -70,6 +77,32 @@ int main(int argc, const char* argb[])
     const auto& showHelp       = parser.add<bool>("help", "Show this help message.", 'h', arrrgh::Optional, false);
     const auto& enableMusic    = parser.add<bool>("enable-music", "Play background music while the game is playing", 'm', arrrgh::Optional, false);
     const auto& enableAutoplay = parser.add<bool>("autoplay", "Let the game play itself automatically. Useful for testing.", 'a', arrrgh::Optional, false);
+    const auto& enableOcclusionCulling = parser.add<bool>("occlusion-culling", "Skip G-buffer draws hidden behind other geometry (Hi-Z culling).", 'c', arrrgh::Optional, false);
+    const auto& enableProfiler = parser.add<bool>("profile", "Record CPU profiler zones. Press T to write them to glowbox_trace.json.", 'p', arrrgh::Optional, false);
+    const auto& enableGPUStats = parser.add<bool>("gpu-stats", "Measure per-pass GPU times and pipeline statistics, and print frame stats periodically.", 's', arrrgh::Optional, false);
+    const auto& particleCount  = parser.add<int>("particles", "Number of particles in the black hole's accretion disk (0 disables it).", 'n', arrrgh::Optional, 250000);
+    const auto& orbitingBallCount = parser.add<int>("balls", "Number of balls orbiting the black hole, simulated on the CPU.", 'b', arrrgh::Optional, 48);
+    const auto& blackHoleCount = parser.add<int>("black-holes", "Number of black holes. Those after the first circle it (at most 255).", 'B', arrrgh::Optional, 1);
+    const auto& runGoldenTests = parser.add<bool>("golden-test", "Render fixed camera poses offscreen, compare them with the reference images and exit.", 'g', arrrgh::Optional, false);
+    const auto& updateGolden   = parser.add<bool>("golden-update", "Render fixed camera poses offscreen, store them as the new reference images and exit.", 'G', arrrgh::Optional, false);
+    const auto& capturePath    = parser.add<std::string>("capture", "Record every frame, to a .y4m video file or else a directory of PNG images.", 'r', arrrgh::Optional, "");
+    const auto& captureFPS     = parser.add<int>("capture-fps", "Frame rate of the capture. The simulation advances 1/fps seconds per frame while capturing.", 'f', arrrgh::Optional, 60);
+    const auto& tiledOutputPath = parser.add<std::string>("tiled-render", "Render one still far larger than the window, tile by tile, to this .ppm file and exit.", 'o', arrrgh::Optional, "");
+    const auto& tiledWidth     = parser.add<int>("tiled-width", "Width of the tiled still, in pixels.", 'W', arrrgh::Optional, 16384);
+    const auto& tiledHeight    = parser.add<int>("tiled-height", "Height of the tiled still, in pixels.", 'H', arrrgh::Optional, 8192);
+    const auto& tileGuard      = parser.add<int>("tile-guard", "Extra pixels rendered around every tile for the lensing to sample.", 'u', arrrgh::Optional, 160);
+    const auto& tileWorkers    = parser.add<int>("tile-workers", "Worker processes rendering tiles (0 renders them in this process).", 'w', arrrgh::Optional, 4);
+    const auto& tileWorkerIndex = parser.add<int>("tile-worker", "Internal: index of this tile worker process.", 'i', arrrgh::Optional, -1);
+    const auto& tileSharedMemory = parser.add<std::string>("tile-shm", "Internal: shared memory of the tile coordinator.", 'x', arrrgh::Optional, "");
+    const auto& showStatsOverlay = parser.add<bool>("stats-overlay", "Show frame times and render counters on screen. F3 toggles it while running.", 'O', arrrgh::Optional, false);
+    const auto& gpuMemoryBudget = parser.add<int>("vram-budget", "GPU memory budget in MB. The program exits if the scene needs more (0 for no budget).", 'v', arrrgh::Optional, 0);
+    const auto& enableCheckerboard = parser.add<bool>("checkerboard", "Shade half of the G-buffer's pixels each frame and reconstruct the rest. F4 toggles it while running.", 'k', arrrgh::Optional, false);
+    const auto& compareCheckerboard = parser.add<bool>("checkerboard-compare", "Render fixed camera paths natively and with checkerboard rendering, report the differences and exit.", 'K', arrrgh::Optional, false);
+    const auto& runParticleBenchmark = parser.add<bool>("particle-benchmark", "Measure the accretion disk's GPU time from 250k to 4M particles, then exit.", 'P', arrrgh::Optional, false);
+    const auto& enableStereo   = parser.add<bool>("stereo", "Render both eyes in one pass, shown side by side. Needs GL_ARB_shader_viewport_layer_array.", 'S', arrrgh::Optional, false);
+    const auto& enableGPUTransforms = parser.add<bool>("gpu-transforms", "Evaluate the scene graph's matrices in a compute shader, uploading only the nodes that moved.", 'T', arrrgh::Optional, false);
+    const auto& runNBodyBenchmark = parser.add<bool>("nbody-benchmark", "Measure the CPU orbit simulation from 1k to 1M bodies, then exit.", 'N', arrrgh::Optional, false);
+    const auto& runMatrixBenchmark = parser.add<bool>("matrix-benchmark", "Measure the scene graph matrix kernels against plain glm, then exit.", 'M', arrrgh::Optional, false);
 
     // If you want to add more program arguments, define them here,
     // but do not request their value here (they have not been parsed yet at this point).
@@ -91,18 +124,85 @@ int main(int argc, const char* argb[])
         return 0;
     }
 
+    // Needs no window, so it runs before one is created
+    if(runNBodyBenchmark.value())
+    {
+        runNBodyBenchmarks(std::cout);
+        return EXIT_SUCCESS;
+    }
+    if(runMatrixBenchmark.value())
+    {
+        runMatrixBenchmarks(std::cout);
+        return EXIT_SUCCESS;
+    }
+
     CommandLineOptions options;
     options.enableMusic    = enableMusic.value();
     options.enableAutoplay = enableAutoplay.value();
+    options.enableOcclusionCulling = enableOcclusionCulling.value();
+    options.enableProfiler = enableProfiler.value();
+    options.enableGPUStats = enableGPUStats.value();
+    options.particleCount  = std::max(particleCount.value(), 0);
+    options.orbitingBallCount = std::max(orbitingBallCount.value(), 0);
+    options.blackHoleCount = std::max(blackHoleCount.value(), 1);
+    options.showStatsOverlay = showStatsOverlay.value();
+    options.enableCheckerboard = enableCheckerboard.value();
+    options.runCheckerboardComparison = compareCheckerboard.value();
+    options.runParticleBenchmark = runParticleBenchmark.value();
+    options.enableStereo   = enableStereo.value();
+    options.enableGPUTransforms = enableGPUTransforms.value();
+    options.gpuMemoryBudgetMB = std::max(gpuMemoryBudget.value(), 0);
+    options.runGoldenImageTests = runGoldenTests.value();
+    options.updateGoldenImages = updateGolden.value();
+    options.capturePath    = capturePath.value();
+    options.captureFramesPerSecond = std::max(captureFPS.value(), 1);
+    options.tiledOutputPath = tiledOutputPath.value();
+    options.tiledWidth     = std::max(tiledWidth.value(), 1);
+    options.tiledHeight    = std::max(tiledHeight.value(), 1);
+    options.tileGuard      = std::max(tileGuard.value(), 0);
+    options.tileWorkerCount = std::max(tileWorkers.value(), 0);
+    options.tileWorkerIndex = tileWorkerIndex.value();
+    options.tileSharedMemoryName = tileSharedMemory.value();
+
+    // Timed by the GPU queries, with the disk enabled whatever its particle count was
+    if (options.runParticleBenchmark)
+    {
+        options.enableGPUStats = true;
+        options.particleCount = std::max(options.particleCount, 1);
+    }
 
-    // Initialise window using GLFW
-    GLFWwindow* window = initialise();
+    // The coordinator of a tiled render only starts the workers and collects their tiles, without a window of its own
+    bool tiledRender = !options.tiledOutputPath.empty();
+    if (tiledRender && options.tileWorkerIndex < 0 && options.tileWorkerCount > 0)
+    {
+        if (isMultiProcessTilingSupported())
+        {
+            return runTiledRenderCoordinator(argb[0], options);
+        }
+        std::cout << "Worker processes are not supported here, rendering all tiles in this process" << std::endl;
+        options.tileWorkerCount = 0;
+    }
+
+    // Initialise window using GLFW. The golden image tests, the checkerboard comparison, the particle benchmark and tiled rendering render without showing it.
+    bool headless = options.runGoldenImageTests || options.updateGoldenImages || options.runCheckerboardComparison
+                    || options.runParticleBenchmark || tiledRender;
+    if (headless && options.enableStereo)
+    {
+        // Those read back a single image of the window's size
+        std::cout << "Stereo rendering is not supported without a window, rendering in mono" << std::endl;
+        options.enableStereo = false;
+    }
+    GLFWwindow* window = initialise(!headless);
 
     // Run an OpenGL application using this window
-    runProgram(window, options);
+    int exitCode = runProgram(window, options);
+
+    // Anything still allocated after this is reported as a leak
+    destroyScene();
+    checkGPUResourceLeaks();
 
     // Terminate GLFW (no need to call glfwDestroyWindow)
     glfwTerminate();
 
-    return EXIT_SUCCESS;
+    return exitCode;
 }
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+#include <fmt/format.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+#include <utilities/matrixKernels.h>
+#include "matrixBenchmark.h"
+
+const size_t BENCHMARK_NODE_COUNTS[] = {1000, 16000, 256000};
+
+// Every measurement is repeated until this much time has passed, to even out the noise
+const double MIN_MEASURE_SECONDS = 0.25;
+
+// Nodes have a parent among the few nodes before them, or none every so often, like a shallow scene graph
+const int MAX_PARENT_DISTANCE = 8;
+const size_t ROOT_INTERVAL = 64;
+
+static double measureNanosecondsPerNode(size_t nodeCount, const std::function<void()> &run) {
+    using Clock = std::chrono::steady_clock;
+
+    // The first run warms up the caches
+    run();
+
+    Clock::time_point start = Clock::now();
+    unsigned int runs = 0;
+    double elapsed = 0;
+    while (elapsed < MIN_MEASURE_SECONDS) {
+        run();
+        runs++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    return elapsed * 1e9 / (double(runs) * nodeCount);
+}
+
+// Keeps the results from being optimised away
+static volatile float resultSink;
+
+static void printRow(std::ostream &output, size_t nodeCount, const char* operation, const char* kernel,
+                     double nanoseconds, double baselineNanoseconds) {
+    output << fmt::format("{:>7}  {:<16}  {:<12}  {:>10.2f}  {:>8.2f}x", nodeCount, operation, kernel,
+                          nanoseconds, baselineNanoseconds / nanoseconds) << std::endl;
+}
+
+void runMatrixBenchmarks(std::ostream &output) {
+    const MatrixKernel kernels[] = {MATRIX_KERNEL_GLM, MATRIX_KERNEL_SSE, MATRIX_KERNEL_AVX2};
+
+    output << "Scene graph matrix benchmark" << std::endl;
+    output << fmt::format("{:>7}  {:<16}  {:<12}  {:>10}  {:>9}", "Nodes", "Operation", "Kernel", "ns/node", "Speedup") << std::endl;
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    for (size_t nodeCount : BENCHMARK_NODE_COUNTS) {
+        std::vector<TransformComponents> transforms(nodeCount);
+        std::vector<int> parents(nodeCount);
+        for (size_t i = 0; i < nodeCount; i++) {
+            transforms[i] = { glm::vec3(coordinate(random), coordinate(random), coordinate(random)), glm::vec3(0),
+                              glm::vec3(angle(random), angle(random), angle(random)),
+                              glm::vec3(scale(random), scale(random), scale(random)) };
+            int nearest = std::max(int(i) - MAX_PARENT_DISTANCE, 0);
+            parents[i] = (i % ROOT_INTERVAL == 0) ? -1 : std::uniform_int_distribution<int>(nearest, int(i) - 1)(random);
+        }
+
+        std::vector<glm::mat4> local(nodeCount), world(nodeCount), products(nodeCount);
+        std::vector<glm::mat4> baselineLocal(nodeCount), baselineWorld(nodeCount);
+        std::vector<NormalMatrix> normalMatrices(nodeCount);
+        glm::mat4 viewProjection = glm::perspective(1.4f, 16.0f / 9.0f, 0.1f, 1000.0f)
+                                 * glm::lookAt(glm::vec3(0, 2, 100), glm::vec3(0), glm::vec3(0, 1, 0));
+
+        // What updateNodeTransformations() used to do for every node
+        double baseline = measureNanosecondsPerNode(nodeCount, [&] {
+            for (size_t i = 0; i < nodeCount; i++) {
+                const TransformComponents &transform = transforms[i];
+                baselineLocal[i] = glm::translate(transform.position)
+                                 * glm::translate(transform.referencePoint)
+                                 * glm::rotate(transform.rotation.y, glm::vec3(0, 1, 0))
+                                 * glm::rotate(transform.rotation.x, glm::vec3(1, 0, 0))
+                                 * glm::rotate(transform.rotation.z, glm::vec3(0, 0, 1))
+                                 * glm::scale(transform.scale)
+                                 * glm::translate(-transform.referencePoint);
+            }
+        });
+        printRow(output, nodeCount, "TRS", "glm chain", baseline, baseline);
+        printRow(output, nodeCount, "TRS", "direct", measureNanosecondsPerNode(nodeCount, [&] {
+            composeTransforms(transforms.data(), local.data(), nodeCount);
+        }), baseline);
+
+        baseline = measureNanosecondsPerNode(nodeCount, [&] {
+            for (size_t i = 0; i < nodeCount; i++) {
+                baselineWorld[i] = (parents[i] < 0) ? baselineLocal[i] : baselineWorld[parents[i]] * baselineLocal[i];
+            }
+        });
+        printRow(output, nodeCount, "Hierarchy", "glm per node", baseline, baseline);
+        for (MatrixKernel kernel : kernels) {
+            if (isMatrixKernelSupported(kernel)) {
+                printRow(output, nodeCount, "Hierarchy", matrixKernelName(kernel), measureNanosecondsPerNode(nodeCount, [&] {
+                    transformHierarchy(parents.data(), local.data(), world.data(), nodeCount, kernel);
+                }), baseline);
+            }
+        }
+
+        baseline = measureNanosecondsPerNode(nodeCount, [&] {
+            for (size_t i = 0; i < nodeCount; i++) {
+                products[i] = viewProjection * world[i];
+            }
+        });
+        printRow(output, nodeCount, "VP * M", "glm per node", baseline, baseline);
+        for (MatrixKernel kernel : kernels) {
+            if (isMatrixKernelSupported(kernel)) {
+                printRow(output, nodeCount, "VP * M", matrixKernelName(kernel), measureNanosecondsPerNode(nodeCount, [&] {
+                    multiplyMatrices(viewProjection, world.data(), products.data(), nodeCount, kernel);
+                }), baseline);
+            }
+        }
+
+        // What updateObjectUniforms() used to do for every node
+        baseline = measureNanosecondsPerNode(nodeCount, [&] {
+            for (size_t i = 0; i < nodeCount; i++) {
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(world[i]));
+                for (int column = 0; column < 3; column++) {
+                    normalMatrices[i].columns[column] = glm::vec4(normalMatrix[column], 0.0f);
+                }
+            }
+        });
+        printRow(output, nodeCount, "Normal matrix", "glm inverse", baseline, baseline);
+        for (MatrixKernel kernel : kernels) {
+            if (isMatrixKernelSupported(kernel)) {
+                printRow(output, nodeCount, "Normal matrix", matrixKernelName(kernel), measureNanosecondsPerNode(nodeCount, [&] {
+                    computeNormalMatrices(world.data(), normalMatrices.data(), nodeCount, kernel);
+                }), baseline);
+            }
+        }
+
+        resultSink = baselineWorld.back()[3][0] + products.back()[3][0] + normalMatrices.back().columns[0][0];
+    }
+}
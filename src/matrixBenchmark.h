@@ -0,0 +1,8 @@
+#pragma once
+
+#include <ostream>
+
+// Times the batched matrix kernels against the per-node glm code they replaced (seven chained matrices per
+// transformation, a full 4x4 inverse per normal matrix), from 1k to 256k nodes, with every kernel the CPU
+// supports, and prints the time per node and the speedup as a table.
+void runMatrixBenchmarks(std::ostream &output);
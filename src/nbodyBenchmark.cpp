@@ -0,0 +1,68 @@
+#include <chrono>
+#include <fmt/format.h>
+#include "nbodySimulation.h"
+#include "nbodyBenchmark.h"
+
+const size_t BENCHMARK_BODY_COUNTS[] = {1000, 4000, 16000, 64000, 256000, 1000000};
+const size_t MAX_DIRECT_BODY_COUNT = 16000;
+
+// Steps are repeated until this much time has passed, to even out the noise
+const double MIN_MEASURE_SECONDS = 1.0;
+const unsigned int MAX_MEASURED_STEPS = 50;
+
+// The disk as a whole weighs a small fraction of the black hole, whatever the number of bodies
+const float DISK_MASS_FRACTION = 0.05f;
+
+static double measureStepSeconds(size_t bodyCount, NBodyForceMethod method, NBodyKernel kernel, ThreadPool* threadPool) {
+    NBodySettings settings;
+    settings.forceMethod = method;
+    settings.kernel = kernel;
+
+    NBodySimulation simulation(settings, threadPool);
+    float bodyMass = DISK_MASS_FRACTION * settings.centralGravitationalParameter
+                   / (settings.gravitationalConstant * bodyCount);
+    simulation.addOrbitingBodies(bodyCount, 100.0f, 160.0f, bodyMass, 0.25f);
+
+    // The first step also computes the initial accelerations, so it is left out
+    simulation.step();
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    unsigned int steps = 0;
+    double elapsed = 0;
+    while (elapsed < MIN_MEASURE_SECONDS && steps < MAX_MEASURED_STEPS) {
+        simulation.step();
+        steps++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    return elapsed / steps;
+}
+
+void runNBodyBenchmarks(std::ostream &output) {
+    ThreadPool threadPool;
+
+    output << fmt::format("N-body benchmark on {} threads", threadPool.threadCount()) << std::endl;
+    output << fmt::format("{:>8}  {:<10}  {:<6}  {:>12}  {:>16}", "Bodies", "Method", "Kernel", "ms/step", "Bodies/s") << std::endl;
+
+    const NBodyKernel kernels[] = {NBODY_KERNEL_SCALAR, NBODY_KERNEL_SSE, NBODY_KERNEL_AVX2};
+
+    for (size_t bodyCount : BENCHMARK_BODY_COUNTS) {
+        for (NBodyForceMethod method : {NBODY_DIRECT, NBODY_BARNES_HUT}) {
+            if (method == NBODY_DIRECT && bodyCount > MAX_DIRECT_BODY_COUNT) {
+                continue;
+            }
+
+            for (NBodyKernel kernel : kernels) {
+                if (!isNBodyKernelSupported(kernel)) {
+                    continue;
+                }
+
+                double seconds = measureStepSeconds(bodyCount, method, kernel, &threadPool);
+                output << fmt::format("{:>8}  {:<10}  {:<6}  {:>12.3f}  {:>16.0f}",
+                                      bodyCount, method == NBODY_DIRECT ? "direct" : "Barnes-Hut",
+                                      nbodyKernelName(kernel), seconds * 1000.0, bodyCount / seconds) << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <ostream>
+
+// Times the orbit simulation for 1k to 1M bodies, with every force method and SIMD kernel the CPU supports,
+// and prints the step times and throughput as a table.
+// Direct summation is skipped for the larger counts, where a single step would take minutes.
+void runNBodyBenchmarks(std::ostream &output);
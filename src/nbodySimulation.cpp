@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <cmath>
+#include <utilities/cpuFeatures.h>
+#include <utilities/profiler.h>
+#include "nbodySimulation.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NBODY_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC accepts every intrinsic without changing the target architecture
+#define NBODY_TARGET_SSE
+#define NBODY_TARGET_AVX2
+#else
+#define NBODY_TARGET_SSE __attribute__((target("sse2")))
+#define NBODY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// Largest number of bodies in an octree leaf, and the deepest the tree may go (for coincident bodies)
+const unsigned int OCTREE_LEAF_CAPACITY = 8;
+const int OCTREE_MAX_DEPTH = 24;
+
+// Smallest number of bodies given to one thread at a time
+const size_t FORCE_CHUNK_SIZE = 64;
+const size_t INTEGRATION_CHUNK_SIZE = 4096;
+
+const char* nbodyKernelName(NBodyKernel kernel) {
+    switch (kernel) {
+        case NBODY_KERNEL_SCALAR: return "scalar";
+        case NBODY_KERNEL_SSE: return "SSE";
+        case NBODY_KERNEL_AVX2: return "AVX2";
+    }
+    return "unknown";
+}
+
+bool isNBodyKernelSupported(NBodyKernel kernel) {
+    switch (kernel) {
+        case NBODY_KERNEL_SCALAR:
+            return true;
+        case NBODY_KERNEL_SSE:
+            return cpuSupportsSSE2();
+        case NBODY_KERNEL_AVX2:
+            return cpuSupportsAVX2();
+    }
+    return false;
+}
+
+NBodyKernel bestNBodyKernel() {
+    static const NBodyKernel best = isNBodyKernelSupported(NBODY_KERNEL_AVX2) ? NBODY_KERNEL_AVX2
+                                  : isNBodyKernelSupported(NBODY_KERNEL_SSE) ? NBODY_KERNEL_SSE
+                                  : NBODY_KERNEL_SCALAR;
+    return best;
+}
+
+
+// Sums the pull of n sources (G * mass each) on a body at (px, py, pz) into acceleration
+
+static void accumulateScalar(const float* x, const float* y, const float* z, const float* m, size_t n,
+                             float px, float py, float pz, float softeningSquared, float* acceleration) {
+    float ax = 0, ay = 0, az = 0;
+    for (size_t j = 0; j < n; j++) {
+        float dx = x[j] - px;
+        float dy = y[j] - py;
+        float dz = z[j] - pz;
+        float distanceSquared = dx * dx + dy * dy + dz * dz + softeningSquared;
+        float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+        float strength = m[j] * inverseDistance * inverseDistance * inverseDistance;
+        ax += dx * strength;
+        ay += dy * strength;
+        az += dz * strength;
+    }
+    acceleration[0] += ax;
+    acceleration[1] += ay;
+    acceleration[2] += az;
+}
+
+#ifdef NBODY_X86
+
+// Approximate reciprocal square root, refined with one Newton-Raphson step to about 22 bits
+NBODY_TARGET_SSE
+static inline __m128 reciprocalSqrtSSE(__m128 value) {
+    __m128 estimate = _mm_rsqrt_ps(value);
+    __m128 halfValue = _mm_mul_ps(_mm_set1_ps(0.5f), value);
+    __m128 correction = _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfValue, _mm_mul_ps(estimate, estimate)));
+    return _mm_mul_ps(estimate, correction);
+}
+
+NBODY_TARGET_SSE
+static inline float horizontalSumSSE(__m128 value) {
+    __m128 pairs = _mm_add_ps(value, _mm_movehl_ps(value, value));
+    __m128 total = _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1));
+    return _mm_cvtss_f32(total);
+}
+
+NBODY_TARGET_SSE
+static void accumulateSSE(const float* x, const float* y, const float* z, const float* m, size_t n,
+                          float px, float py, float pz, float softeningSquared, float* acceleration) {
+    __m128 targetX = _mm_set1_ps(px);
+    __m128 targetY = _mm_set1_ps(py);
+    __m128 targetZ = _mm_set1_ps(pz);
+    __m128 softening = _mm_set1_ps(softeningSquared);
+    __m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps(), az = _mm_setzero_ps();
+
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), targetX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), targetY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), targetZ);
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                            _mm_add_ps(_mm_mul_ps(dz, dz), softening));
+        __m128 inverseDistance = reciprocalSqrtSSE(distanceSquared);
+        __m128 inverseCubed = _mm_mul_ps(inverseDistance, _mm_mul_ps(inverseDistance, inverseDistance));
+        __m128 strength = _mm_mul_ps(_mm_loadu_ps(m + j), inverseCubed);
+        ax = _mm_add_ps(ax, _mm_mul_ps(dx, strength));
+        ay = _mm_add_ps(ay, _mm_mul_ps(dy, strength));
+        az = _mm_add_ps(az, _mm_mul_ps(dz, strength));
+    }
+
+    acceleration[0] += horizontalSumSSE(ax);
+    acceleration[1] += horizontalSumSSE(ay);
+    acceleration[2] += horizontalSumSSE(az);
+
+    accumulateScalar(x + j, y + j, z + j, m + j, n - j, px, py, pz, softeningSquared, acceleration);
+}
+
+NBODY_TARGET_AVX2
+static inline __m256 reciprocalSqrtAVX2(__m256 value) {
+    __m256 estimate = _mm256_rsqrt_ps(value);
+    __m256 halfValue = _mm256_mul_ps(_mm256_set1_ps(0.5f), value);
+    __m256 correction = _mm256_fnmadd_ps(halfValue, _mm256_mul_ps(estimate, estimate), _mm256_set1_ps(1.5f));
+    return _mm256_mul_ps(estimate, correction);
+}
+
+NBODY_TARGET_AVX2
+static inline float horizontalSumAVX2(__m256 value) {
+    __m128 halves = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+    __m128 pairs = _mm_add_ps(halves, _mm_movehl_ps(halves, halves));
+    __m128 total = _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1));
+    return _mm_cvtss_f32(total);
+}
+
+NBODY_TARGET_AVX2
+static void accumulateAVX2(const float* x, const float* y, const float* z, const float* m, size_t n,
+                           float px, float py, float pz, float softeningSquared, float* acceleration) {
+    __m256 targetX = _mm256_set1_ps(px);
+    __m256 targetY = _mm256_set1_ps(py);
+    __m256 targetZ = _mm256_set1_ps(pz);
+    __m256 softening = _mm256_set1_ps(softeningSquared);
+    __m256 ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps(), az = _mm256_setzero_ps();
+
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), targetX);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), targetY);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), targetZ);
+        __m256 distanceSquared = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, softening)));
+        __m256 inverseDistance = reciprocalSqrtAVX2(distanceSquared);
+        __m256 inverseCubed = _mm256_mul_ps(inverseDistance, _mm256_mul_ps(inverseDistance, inverseDistance));
+        __m256 strength = _mm256_mul_ps(_mm256_loadu_ps(m + j), inverseCubed);
+        ax = _mm256_fmadd_ps(dx, strength, ax);
+        ay = _mm256_fmadd_ps(dy, strength, ay);
+        az = _mm256_fmadd_ps(dz, strength, az);
+    }
+
+    acceleration[0] += horizontalSumAVX2(ax);
+    acceleration[1] += horizontalSumAVX2(ay);
+    acceleration[2] += horizontalSumAVX2(az);
+
+    // The remaining few go through the 4-wide and scalar loops
+    accumulateSSE(x + j, y + j, z + j, m + j, n - j, px, py, pz, softeningSquared, acceleration);
+}
+
+#endif
+
+typedef void (*AccumulateFunction)(const float*, const float*, const float*, const float*, size_t,
+                                   float, float, float, float, float*);
+
+static AccumulateFunction accumulateFunction(NBodyKernel kernel) {
+#ifdef NBODY_X86
+    if (kernel == NBODY_KERNEL_AVX2 && isNBodyKernelSupported(NBODY_KERNEL_AVX2)) {
+        return accumulateAVX2;
+    }
+    if (kernel != NBODY_KERNEL_SCALAR && isNBodyKernelSupported(NBODY_KERNEL_SSE)) {
+        return accumulateSSE;
+    }
+#endif
+    return accumulateScalar;
+}
+
+
+NBodySimulation::NBodySimulation(const NBodySettings &settings, ThreadPool* threadPool)
+    : settings(settings), threadPool(threadPool), random(1) {}
+
+void NBodySimulation::addBody(glm::vec3 position, glm::vec3 velocity, float bodyMass) {
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    accelerationX.push_back(0);
+    accelerationY.push_back(0);
+    accelerationZ.push_back(0);
+    mass.push_back(bodyMass);
+
+    accelerationsValid = false;
+}
+
+void NBodySimulation::addOrbitingBodies(size_t count, float innerRadius, float outerRadius, float bodyMass, float maxInclination) {
+    spawnInnerRadius = innerRadius;
+    spawnOuterRadius = outerRadius;
+    spawnMaxInclination = maxInclination;
+
+    for (size_t i = 0; i < count; i++) {
+        addBody(glm::vec3(0), glm::vec3(0), bodyMass);
+        placeInOrbit(bodyCount() - 1);
+    }
+}
+
+// Puts a body on a circular orbit around the centre, ignoring the pull of the other bodies
+void NBodySimulation::placeInOrbit(size_t index) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float TWO_PI = 6.28318530718f;
+
+    // Square root, so the bodies are spread evenly over the disk's area
+    float radius = spawnInnerRadius + (spawnOuterRadius - spawnInnerRadius) * std::sqrt(unit(random));
+    float angle = TWO_PI * unit(random);
+    float inclination = spawnMaxInclination * (2.0f * unit(random) - 1.0f);
+    float ascendingNode = TWO_PI * unit(random);
+
+    // Orbit in the XZ plane, then tilted around a random axis within that plane
+    glm::vec3 radial(std::cos(angle), 0.0f, std::sin(angle));
+    glm::vec3 tangent(-radial.z, 0.0f, radial.x);
+    glm::vec3 tiltAxis(std::cos(ascendingNode), 0.0f, std::sin(ascendingNode));
+
+    auto tilt = [&](glm::vec3 v) {
+        // Rodrigues' rotation formula
+        float c = std::cos(inclination), s = std::sin(inclination);
+        return v * c + glm::cross(tiltAxis, v) * s + tiltAxis * glm::dot(tiltAxis, v) * (1.0f - c);
+    };
+
+    glm::vec3 position = settings.centre + tilt(radial) * radius;
+    glm::vec3 velocity = tilt(tangent) * std::sqrt(settings.centralGravitationalParameter / radius);
+
+    positionX.at(index) = position.x;
+    positionY.at(index) = position.y;
+    positionZ.at(index) = position.z;
+    velocityX.at(index) = velocity.x;
+    velocityY.at(index) = velocity.y;
+    velocityZ.at(index) = velocity.z;
+}
+
+glm::vec3 NBodySimulation::position(size_t index) const {
+    return glm::vec3(positionX.at(index), positionY.at(index), positionZ.at(index));
+}
+
+glm::vec3 NBodySimulation::velocity(size_t index) const {
+    return glm::vec3(velocityX.at(index), velocityY.at(index), velocityZ.at(index));
+}
+
+unsigned int NBodySimulation::update(double elapsedSeconds) {
+    timeAccumulator += elapsedSeconds;
+
+    unsigned int steps = 0;
+    while (timeAccumulator >= settings.timeStep && steps < settings.maxStepsPerUpdate) {
+        step();
+        timeAccumulator -= settings.timeStep;
+        steps++;
+    }
+
+    // Too far behind to catch up; drop the rest rather than slowing down every following frame
+    if (steps == settings.maxStepsPerUpdate) {
+        timeAccumulator = std::min(timeAccumulator, double(settings.timeStep));
+    }
+
+    return steps;
+}
+
+void NBodySimulation::step() {
+    PROFILE_ZONE("NBodySimulation::step");
+
+    if (!accelerationsValid) {
+        computeAccelerations();
+    }
+
+    float dt = settings.timeStep;
+    float halfStep = 0.5f * dt;
+
+    // Kick by half a step, then drift by a full one
+    threadPool->parallelFor(bodyCount(), INTEGRATION_CHUNK_SIZE, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            velocityX[i] += accelerationX[i] * halfStep;
+            velocityY[i] += accelerationY[i] * halfStep;
+            velocityZ[i] += accelerationZ[i] * halfStep;
+            positionX[i] += velocityX[i] * dt;
+            positionY[i] += velocityY[i] * dt;
+            positionZ[i] += velocityZ[i] * dt;
+        }
+    });
+
+    computeAccelerations();
+
+    // Second half kick, with the accelerations at the new positions
+    threadPool->parallelFor(bodyCount(), INTEGRATION_CHUNK_SIZE, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            velocityX[i] += accelerationX[i] * halfStep;
+            velocityY[i] += accelerationY[i] * halfStep;
+            velocityZ[i] += accelerationZ[i] * halfStep;
+        }
+    });
+
+    respawnCapturedBodies();
+}
+
+void NBodySimulation::computeAccelerations() {
+    bool useBarnesHut = settings.forceMethod == NBODY_BARNES_HUT
+        || (settings.forceMethod == NBODY_AUTOMATIC && bodyCount() >= settings.barnesHutThreshold);
+
+    if (useBarnesHut) {
+        computeBarnesHut();
+    } else {
+        computeDirect();
+    }
+
+    accelerationsValid = true;
+}
+
+void NBodySimulation::addCentralAcceleration(size_t begin, size_t end) {
+    float softeningSquared = settings.softening * settings.softening;
+
+    for (size_t i = begin; i < end; i++) {
+        float dx = settings.centre.x - positionX[i];
+        float dy = settings.centre.y - positionY[i];
+        float dz = settings.centre.z - positionZ[i];
+        float inverseDistance = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz + softeningSquared);
+        float strength = settings.centralGravitationalParameter * inverseDistance * inverseDistance * inverseDistance;
+        accelerationX[i] += dx * strength;
+        accelerationY[i] += dy * strength;
+        accelerationZ[i] += dz * strength;
+    }
+}
+
+void NBodySimulation::computeDirect() {
+    PROFILE_ZONE("NBodySimulation::computeDirect");
+
+    // G is folded into the masses once, instead of into every interaction
+    sortedMass.resize(bodyCount());
+    for (size_t i = 0; i < bodyCount(); i++) {
+        sortedMass[i] = settings.gravitationalConstant * mass[i];
+    }
+
+    AccumulateFunction accumulate = accumulateFunction(settings.kernel);
+    float softeningSquared = settings.softening * settings.softening;
+
+    // With softening, a body's pull on itself is zero, so it does not need to be skipped
+    threadPool->parallelFor(bodyCount(), FORCE_CHUNK_SIZE, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float acceleration[3] = {0, 0, 0};
+            accumulate(positionX.data(), positionY.data(), positionZ.data(), sortedMass.data(), bodyCount(),
+                       positionX[i], positionY[i], positionZ[i], softeningSquared, acceleration);
+            accelerationX[i] = acceleration[0];
+            accelerationY[i] = acceleration[1];
+            accelerationZ[i] = acceleration[2];
+        }
+        addCentralAcceleration(begin, end);
+    });
+}
+
+void NBodySimulation::buildOctree() {
+    PROFILE_ZONE("NBodySimulation::buildOctree");
+
+    size_t count = bodyCount();
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 p(positionX[i], positionY[i], positionZ[i]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+
+    glm::vec3 extent = boundsMax - boundsMin;
+    float halfSize = 0.5f * std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 1.001f;
+
+    sortedIndices.resize(count);
+    sortScratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        sortedIndices[i] = i;
+    }
+
+    octree.clear();
+    octreeLeaves.clear();
+    octree.reserve(2 * count / OCTREE_LEAF_CAPACITY + 8);
+    octree.resize(1);
+    buildOctreeNode(0, (boundsMin + boundsMax) * 0.5f, halfSize, 0, count, 0);
+
+    // Copy the bodies into leaf order, with G folded into the masses
+    sortedX.resize(count);
+    sortedY.resize(count);
+    sortedZ.resize(count);
+    sortedMass.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        unsigned int body = sortedIndices[i];
+        sortedX[i] = positionX[body];
+        sortedY[i] = positionY[body];
+        sortedZ[i] = positionZ[body];
+        sortedMass[i] = settings.gravitationalConstant * mass[body];
+    }
+}
+
+// Fills in octree[nodeIndex] for the bodies in sortedIndices[begin, end), splitting it if it holds too many
+void NBodySimulation::buildOctreeNode(int nodeIndex, glm::vec3 centre, float halfSize, unsigned int begin, unsigned int end, int depth) {
+    OctreeNode node;
+    node.centre = centre;
+    node.halfSize = halfSize;
+    node.firstChild = -1;
+    node.bodyBegin = begin;
+    node.bodyEnd = end;
+    node.mass = 0;
+    node.centreOfMass = glm::vec3(0);
+
+    if (end - begin <= OCTREE_LEAF_CAPACITY || depth >= OCTREE_MAX_DEPTH) {
+        glm::vec3 weightedSum(0);
+        for (unsigned int i = begin; i < end; i++) {
+            unsigned int body = sortedIndices[i];
+            weightedSum += glm::vec3(positionX[body], positionY[body], positionZ[body]) * mass[body];
+            node.mass += mass[body];
+        }
+        node.centreOfMass = node.mass > 0 ? weightedSum / node.mass : centre;
+        octree[nodeIndex] = node;
+        if (end > begin) {
+            octreeLeaves.push_back(nodeIndex);
+        }
+        return;
+    }
+
+    // Counting sort of the range into the eight octants
+    auto octantOf = [&](unsigned int body) {
+        return (positionX[body] >= centre.x ? 1 : 0)
+             | (positionY[body] >= centre.y ? 2 : 0)
+             | (positionZ[body] >= centre.z ? 4 : 0);
+    };
+
+    unsigned int octantStart[9] = {0};
+    for (unsigned int i = begin; i < end; i++) {
+        octantStart[octantOf(sortedIndices[i]) + 1]++;
+    }
+    for (int octant = 0; octant < 8; octant++) {
+        octantStart[octant + 1] += octantStart[octant];
+    }
+
+    unsigned int octantFill[8];
+    std::copy(octantStart, octantStart + 8, octantFill);
+    for (unsigned int i = begin; i < end; i++) {
+        unsigned int body = sortedIndices[i];
+        sortScratch[begin + octantFill[octantOf(body)]++] = body;
+    }
+    std::copy(sortScratch.begin() + begin, sortScratch.begin() + end, sortedIndices.begin() + begin);
+
+    // Children are stored next to each other, so a node only needs the index of the first.
+    // The vector may grow while they are built, so nodes are only accessed by index.
+    node.firstChild = int(octree.size());
+    octree.resize(octree.size() + 8);
+
+    float childHalfSize = 0.5f * halfSize;
+    glm::vec3 weightedSum(0);
+
+    for (int octant = 0; octant < 8; octant++) {
+        glm::vec3 childCentre = centre + childHalfSize * glm::vec3((octant & 1) ? 1 : -1,
+                                                                   (octant & 2) ? 1 : -1,
+                                                                   (octant & 4) ? 1 : -1);
+        int childIndex = node.firstChild + octant;
+        buildOctreeNode(childIndex, childCentre, childHalfSize,
+                        begin + octantStart[octant], begin + octantStart[octant + 1], depth + 1);
+
+        weightedSum += octree[childIndex].centreOfMass * octree[childIndex].mass;
+        node.mass += octree[childIndex].mass;
+    }
+
+    node.centreOfMass = node.mass > 0 ? weightedSum / node.mass : centre;
+    octree[nodeIndex] = node;
+}
+
+void NBodySimulation::computeBarnesHut() {
+    PROFILE_ZONE("NBodySimulation::computeBarnesHut");
+
+    buildOctree();
+
+    AccumulateFunction accumulate = accumulateFunction(settings.kernel);
+    float softeningSquared = settings.softening * settings.softening;
+    float openingAngleSquared = settings.openingAngle * settings.openingAngle;
+
+    // The tree is walked once per leaf rather than once per body, and the resulting interaction list
+    // is shared by every body in the leaf. Cells are opened based on their distance to the nearest
+    // point of the leaf, so the approximation is at least as good as for each body on its own.
+    threadPool->parallelFor(octreeLeaves.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<float> listX, listY, listZ, listMass;
+        std::vector<int> stack;
+
+        for (size_t leafIndex = begin; leafIndex < end; leafIndex++) {
+            const OctreeNode &leaf = octree[octreeLeaves[leafIndex]];
+            listX.clear();
+            listY.clear();
+            listZ.clear();
+            listMass.clear();
+
+            stack.clear();
+            stack.push_back(0);
+            while (!stack.empty()) {
+                const OctreeNode &node = octree[stack.back()];
+                stack.pop_back();
+
+                if (node.mass == 0) {
+                    continue;
+                }
+
+                if (node.firstChild == -1) {
+                    listX.insert(listX.end(), sortedX.begin() + node.bodyBegin, sortedX.begin() + node.bodyEnd);
+                    listY.insert(listY.end(), sortedY.begin() + node.bodyBegin, sortedY.begin() + node.bodyEnd);
+                    listZ.insert(listZ.end(), sortedZ.begin() + node.bodyBegin, sortedZ.begin() + node.bodyEnd);
+                    listMass.insert(listMass.end(), sortedMass.begin() + node.bodyBegin, sortedMass.begin() + node.bodyEnd);
+                    continue;
+                }
+
+                glm::vec3 offset = glm::max(glm::abs(node.centreOfMass - leaf.centre) - leaf.halfSize, glm::vec3(0));
+                float size = 2.0f * node.halfSize;
+                if (size * size < openingAngleSquared * glm::dot(offset, offset)) {
+                    listX.push_back(node.centreOfMass.x);
+                    listY.push_back(node.centreOfMass.y);
+                    listZ.push_back(node.centreOfMass.z);
+                    listMass.push_back(settings.gravitationalConstant * node.mass);
+                    continue;
+                }
+
+                for (int octant = 0; octant < 8; octant++) {
+                    stack.push_back(node.firstChild + octant);
+                }
+            }
+
+            for (unsigned int i = leaf.bodyBegin; i < leaf.bodyEnd; i++) {
+                unsigned int body = sortedIndices[i];
+                float acceleration[3] = {0, 0, 0};
+                accumulate(listX.data(), listY.data(), listZ.data(), listMass.data(), listX.size(),
+                           sortedX[i], sortedY[i], sortedZ[i], softeningSquared, acceleration);
+                accelerationX[body] = acceleration[0];
+                accelerationY[body] = acceleration[1];
+                accelerationZ[body] = acceleration[2];
+            }
+        }
+    });
+
+    threadPool->parallelFor(bodyCount(), INTEGRATION_CHUNK_SIZE, [&](size_t begin, size_t end) {
+        addCentralAcceleration(begin, end);
+    });
+}
+
+void NBodySimulation::respawnCapturedBodies() {
+    float captureRadiusSquared = settings.captureRadius * settings.captureRadius;
+
+    for (size_t i = 0; i < bodyCount(); i++) {
+        glm::vec3 offset = position(i) - settings.centre;
+        if (glm::dot(offset, offset) < captureRadiusSquared) {
+            placeInOrbit(i);
+
+            // Close enough until the next step; the pull of the other bodies is small next to the centre's
+            accelerationX[i] = accelerationY[i] = accelerationZ[i] = 0;
+            addCentralAcceleration(i, i + 1);
+        }
+    }
+}
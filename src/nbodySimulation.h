@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <utilities/threadPool.h>
+
+// Inner loops used to sum up gravitational pulls. The SIMD ones are picked at runtime, if the CPU has them.
+enum NBodyKernel {
+    NBODY_KERNEL_SCALAR, NBODY_KERNEL_SSE, NBODY_KERNEL_AVX2
+};
+
+enum NBodyForceMethod {
+    NBODY_DIRECT,       // Every body against every other body, O(N^2)
+    NBODY_BARNES_HUT,   // Distant groups of bodies approximated by their centre of mass, O(N log N)
+    NBODY_AUTOMATIC     // Direct below barnesHutThreshold bodies, Barnes-Hut above
+};
+
+const char* nbodyKernelName(NBodyKernel kernel);
+bool isNBodyKernelSupported(NBodyKernel kernel);
+NBodyKernel bestNBodyKernel();
+
+struct NBodySettings {
+    // A fixed central mass (the black hole), given as G * M
+    glm::vec3 centre = glm::vec3(0);
+    float centralGravitationalParameter = 98000.0f;
+    // Bodies coming closer than this to the centre are swallowed, and replaced by a new body in orbit
+    float captureRadius = 40.0f;
+
+    float gravitationalConstant = 1.0f;
+    // Added to every squared distance, so close encounters do not produce huge accelerations
+    float softening = 1.0f;
+
+    float timeStep = 1.0f / 120.0f;
+    // Limits the catching up done after a long frame
+    unsigned int maxStepsPerUpdate = 8;
+
+    NBodyForceMethod forceMethod = NBODY_AUTOMATIC;
+    size_t barnesHutThreshold = 2048;
+    // A cell is approximated by its centre of mass when its size divided by its distance is below this
+    float openingAngle = 0.5f;
+
+    NBodyKernel kernel = bestNBodyKernel();
+};
+
+// Gravitating bodies around a central mass, stored as structure-of-arrays and integrated with
+// kick-drift-kick leapfrog (symplectic, so orbits keep their energy over long runs) at a fixed time step.
+// The force pass is spread over a thread pool.
+class NBodySimulation {
+public:
+    NBodySimulation(const NBodySettings &settings, ThreadPool* threadPool);
+
+    void addBody(glm::vec3 position, glm::vec3 velocity, float mass);
+    // Bodies on near-circular orbits around the centre, in a disk tilted by at most maxInclination radians
+    void addOrbitingBodies(size_t count, float innerRadius, float outerRadius, float mass, float maxInclination);
+
+    // Takes as many fixed steps as fit in the elapsed time (carrying the remainder over). Returns the number taken.
+    unsigned int update(double elapsedSeconds);
+    void step();
+
+    size_t bodyCount() const { return positionX.size(); }
+    glm::vec3 position(size_t index) const;
+    glm::vec3 velocity(size_t index) const;
+
+    NBodySettings settings;
+
+private:
+    struct OctreeNode {
+        glm::vec3 centre;       // Of the cell
+        float halfSize;
+        glm::vec3 centreOfMass;
+        float mass;
+        int firstChild;         // Index of the first of eight children, or -1 for a leaf
+        unsigned int bodyBegin; // Range of the leaf's bodies in the sorted arrays
+        unsigned int bodyEnd;
+    };
+
+    void computeAccelerations();
+    void computeDirect();
+    void computeBarnesHut();
+    void buildOctree();
+    void buildOctreeNode(int nodeIndex, glm::vec3 centre, float halfSize, unsigned int begin, unsigned int end, int depth);
+    void addCentralAcceleration(size_t begin, size_t end);
+    void respawnCapturedBodies();
+    void placeInOrbit(size_t index);
+
+    ThreadPool* threadPool;
+    std::mt19937 random;
+
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> accelerationX, accelerationY, accelerationZ;
+    std::vector<float> mass;
+    bool accelerationsValid = false;
+
+    // Orbit parameters used when bodies are respawned
+    float spawnInnerRadius = 0;
+    float spawnOuterRadius = 0;
+    float spawnMaxInclination = 0;
+
+    // Barnes-Hut octree, with the bodies copied into leaf order so every leaf is a contiguous range
+    std::vector<OctreeNode> octree;
+    std::vector<int> octreeLeaves;  // Non-empty leaves, in the order of their bodies
+    std::vector<unsigned int> sortedIndices;
+    std::vector<unsigned int> sortScratch;
+    std::vector<float> sortedX, sortedY, sortedZ, sortedMass;
+
+    double timeAccumulator = 0;
+};
@@ -0,0 +1,258 @@
+#include <glad/glad.h>
+#include <vector>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/shader.hpp>
+#include <utilities/window.hpp>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "occlusionCulling.h"
+
+// Mirrors NodeData in hizCull.comp (std430)
+struct CullNodeData {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    unsigned int indexCount;
+    unsigned int padding[3];
+};
+
+// Layout expected by glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Counters are read back this many frames after they were written, so the CPU never waits on the GPU
+const unsigned int STATS_READBACK_FRAMES = 3;
+
+static Gloom::Shader* hiZBuildShader;
+static Gloom::Shader* cullShader;
+
+static std::vector<SceneNode*> cullableNodes;
+static std::vector<CullNodeData> nodeData;
+
+static GLBuffer nodeDataBuffer;
+static GLBuffer commandBuffer;     // Early phase commands, followed by late phase commands
+static GLBuffer visibilityBuffer;  // Which nodes were drawn in the early phase
+static GLBuffer counterBuffer;
+static GLBuffer statsReadbackBuffers[STATS_READBACK_FRAMES];
+static GLsync statsReadbackFences[STATS_READBACK_FRAMES];
+static unsigned int frameIndex = 0;
+
+static GLTexture hiZTexture;
+static int hiZLevels;
+
+static glm::mat4 cullViewProjection;
+static OcclusionStats latestStats;
+
+// Gives every drawable 3D node an index into the culling buffers
+static void collectCullableNodes(SceneNode* node) {
+    bool drawable = node->vertexArrayObjectID != -1
+        && (node->nodeType == GEOMETRY || node->nodeType == NORMAL_MAPPED);
+
+    if (drawable) {
+        node->cullID = cullableNodes.size();
+        cullableNodes.push_back(node);
+    }
+
+    for (SceneNode* child : node->children) {
+        collectCullableNodes(child);
+    }
+}
+
+void initOcclusionCulling(SceneNode* rootNode) {
+    hiZBuildShader = new Gloom::Shader();
+    hiZBuildShader->attach("../res/shaders/hizBuild.comp");
+    hiZBuildShader->link();
+
+    cullShader = new Gloom::Shader();
+    cullShader->attach("../res/shaders/hizCull.comp");
+    cullShader->link();
+
+    collectCullableNodes(rootNode);
+    nodeData.resize(cullableNodes.size());
+
+    nodeDataBuffer = createBuffer(GPU_MEMORY_STORAGE, "Culling node bounds",
+                                  nodeData.size() * sizeof(CullNodeData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    commandBuffer = createBuffer(GPU_MEMORY_STORAGE, "Culling draw commands",
+                                 2 * cullableNodes.size() * sizeof(DrawElementsIndirectCommand), nullptr, 0);
+    visibilityBuffer = createBuffer(GPU_MEMORY_STORAGE, "Culling visibility",
+                                    cullableNodes.size() * sizeof(unsigned int), nullptr, 0);
+    counterBuffer = createBuffer(GPU_MEMORY_STORAGE, "Culling counters", sizeof(OcclusionStats), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    for (unsigned int i = 0; i < STATS_READBACK_FRAMES; i++) {
+        statsReadbackBuffers[i] = createBuffer(GPU_MEMORY_READBACK, "Culling counter readback",
+                                               sizeof(OcclusionStats), nullptr, GL_CLIENT_STORAGE_BIT);
+        statsReadbackFences[i] = nullptr;
+    }
+
+    // Full mip chain over the G-buffer resolution, each texel holding the farthest depth below it
+    hiZLevels = int(std::floor(std::log2(float(std::max(windowWidth, windowHeight))))) + 1;
+    hiZTexture = createTexture(GL_TEXTURE_2D, GPU_MEMORY_RENDER_TARGET, "Hi-Z pyramid", hiZLevels, GL_R32F, windowWidth, windowHeight);
+    glTextureParameteri(hiZTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(hiZTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // There is no previous frame yet, so start out with nothing occluding anything
+    float farDepth = 1.0f;
+    for (int level = 0; level < hiZLevels; level++) {
+        glClearTexImage(hiZTexture, level, GL_RED, GL_FLOAT, &farDepth);
+    }
+}
+
+void updateOcclusionCulling(const glm::mat4 &viewProjection) {
+    cullViewProjection = viewProjection;
+
+    // Pick up the counters written STATS_READBACK_FRAMES frames ago, if the GPU is done with them
+    unsigned int slot = frameIndex % STATS_READBACK_FRAMES;
+    if (statsReadbackFences[slot] != nullptr) {
+        GLenum status = glClientWaitSync(statsReadbackFences[slot], 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glGetNamedBufferSubData(statsReadbackBuffers[slot], 0, sizeof(OcclusionStats), &latestStats);
+        }
+        glDeleteSync(statsReadbackFences[slot]);
+        statsReadbackFences[slot] = nullptr;
+    }
+
+    // Transform every node's bounding box into a world-space AABB
+    for (unsigned int i = 0; i < cullableNodes.size(); i++) {
+        SceneNode* node = cullableNodes.at(i);
+        glm::vec3 worldMin(INFINITY);
+        glm::vec3 worldMax(-INFINITY);
+
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 localCorner(
+                (corner & 1) ? node->boundingBoxMax.x : node->boundingBoxMin.x,
+                (corner & 2) ? node->boundingBoxMax.y : node->boundingBoxMin.y,
+                (corner & 4) ? node->boundingBoxMax.z : node->boundingBoxMin.z);
+            glm::vec3 worldCorner = glm::vec3(node->currentTransformationMatrix * glm::vec4(localCorner, 1));
+
+            worldMin = glm::min(worldMin, worldCorner);
+            worldMax = glm::max(worldMax, worldCorner);
+        }
+
+        nodeData.at(i).boundsMin = glm::vec4(worldMin, 1);
+        nodeData.at(i).boundsMax = glm::vec4(worldMax, 1);
+        nodeData.at(i).indexCount = node->VAOIndexCount;
+    }
+
+    trackedNamedBufferSubData(nodeDataBuffer, 0, nodeData.size() * sizeof(CullNodeData), nodeData.data());
+}
+
+void cullNodes(OcclusionPhase phase) {
+    if (phase == OCCLUSION_EARLY) {
+        glClearNamedBufferData(counterBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    cullShader->activate();
+
+    trackedUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(cullViewProjection));
+    trackedUniform1i(1, phase == OCCLUSION_LATE);
+    trackedUniform1ui(2, cullableNodes.size());
+
+    trackedBindTextureUnit(0, hiZTexture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, nodeDataBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibilityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counterBuffer);
+
+    glDispatchCompute((cullableNodes.size() + 63) / 64, 1, 1);
+
+    // The draw commands are consumed by glDrawElementsIndirect, the visibility flags by the late phase,
+    // and the counters by the copy into the readback buffer
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    cullShader->deactivate();
+
+    trackedBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+    if (phase == OCCLUSION_LATE) {
+        unsigned int slot = frameIndex % STATS_READBACK_FRAMES;
+        glCopyNamedBufferSubData(counterBuffer, statsReadbackBuffers[slot], 0, 0, sizeof(OcclusionStats));
+        statsReadbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frameIndex++;
+    }
+}
+
+void buildHiZPyramid(unsigned int depthTexture) {
+    hiZBuildShader->activate();
+
+    // Level 0 is a copy of the G-buffer depth, with the pixels checkerboard rendering skipped filled in by hizBuild.comp
+    trackedUniform1i(0, -1);
+    trackedBindTextureUnit(0, depthTexture);
+    glBindImageTexture(1, hiZTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((windowWidth + 7) / 8, (windowHeight + 7) / 8, 1);
+
+    // Every further level keeps the farthest depth of the texels it covers in the level above
+    for (int level = 1; level < hiZLevels; level++) {
+        int levelWidth  = std::max(windowWidth >> level, 1);
+        int levelHeight = std::max(windowHeight >> level, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        trackedUniform1i(0, level - 1);
+        glBindImageTexture(0, hiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    hiZBuildShader->deactivate();
+}
+
+bool isDrawnInPhase(SceneNode* node, OcclusionPhase phase) {
+    switch (phase) {
+        case OCCLUSION_DISABLED:
+            return true;
+        case OCCLUSION_EARLY:
+            // The BH sphere must not act as an occluder: the lensing samples what lies behind it.
+            // It is drawn after the pyramid is built, along with the 2D overlay.
+            return node->nodeType != BLACK_HOLE && node->nodeType != GEOMETRY_2D;
+        case OCCLUSION_LATE:
+            return node->cullID != -1 || node->nodeType == BLACK_HOLE || node->nodeType == GEOMETRY_2D;
+    }
+    return true;
+}
+
+void drawNodeElements(SceneNode* node, OcclusionPhase phase) {
+    if (phase == OCCLUSION_DISABLED || node->cullID == -1) {
+        trackedDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+        return;
+    }
+
+    // The culling shader has set instanceCount to 0 for nodes that should not be drawn in this phase
+    size_t commandIndex = node->cullID + (phase == OCCLUSION_LATE ? cullableNodes.size() : 0);
+    trackedDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                           (void*)(commandIndex * sizeof(DrawElementsIndirectCommand)));
+}
+
+OcclusionStats getOcclusionStats() {
+    return latestStats;
+}
+
+void destroyOcclusionCulling() {
+    for (unsigned int i = 0; i < STATS_READBACK_FRAMES; i++) {
+        if (statsReadbackFences[i] != nullptr) {
+            glDeleteSync(statsReadbackFences[i]);
+            statsReadbackFences[i] = nullptr;
+        }
+        statsReadbackBuffers[i].reset();
+    }
+
+    nodeDataBuffer.reset();
+    commandBuffer.reset();
+    visibilityBuffer.reset();
+    counterBuffer.reset();
+    hiZTexture.reset();
+
+    hiZBuildShader->destroy();
+    cullShader->destroy();
+    delete hiZBuildShader;
+    delete cullShader;
+
+    cullableNodes.clear();
+    nodeData.clear();
+}
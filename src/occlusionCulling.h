@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "sceneGraph.hpp"
+
+// The G-buffer pass is split in two when occlusion culling is enabled:
+// the early phase draws what passes against last frame's Hi-Z pyramid,
+// the late phase re-tests the rest against a pyramid built from the early phase's depth.
+enum OcclusionPhase {
+	OCCLUSION_DISABLED, OCCLUSION_EARLY, OCCLUSION_LATE
+};
+
+// Per-frame counters written by the culling shader
+struct OcclusionStats {
+	unsigned int tested        = 0;  // Nodes tested in the early phase
+	unsigned int frustumCulled = 0;  // Nodes outside the view frustum
+	unsigned int occludedEarly = 0;  // Nodes hidden behind last frame's depth
+	unsigned int rescuedLate   = 0;  // Nodes hidden in the early phase, but visible in the late phase
+	unsigned int occludedLate  = 0;  // Nodes hidden in both phases (draws removed by occlusion)
+};
+
+void initOcclusionCulling(SceneNode* rootNode);
+void destroyOcclusionCulling();
+void updateOcclusionCulling(const glm::mat4 &viewProjection);
+void cullNodes(OcclusionPhase phase);
+// From the G-buffer depth of this frame, which is a transient texture of the frame graph
+void buildHiZPyramid(unsigned int depthTexture);
+
+// Returns whether a node should be drawn in the given phase of the G-buffer pass
+bool isDrawnInPhase(SceneNode* node, OcclusionPhase phase);
+// Issues the draw call for a node whose VAO is already bound
+void drawNodeElements(SceneNode* node, OcclusionPhase phase);
+
+// Counters of the most recent frame whose results have reached the CPU
+OcclusionStats getOcclusionStats();
@@ -2,10 +2,14 @@
 #include "program.hpp"
 #include "utilities/window.hpp"
 #include "bhSimulation.h"
+#include "goldenImages.h"
+#include "frameCapture.h"
+#include "tiledRender.h"
 #include <glm/glm.hpp>
 // glm::translate, glm::rotate, glm::scale, glm::perspective
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <cstdlib>
 #include <SFML/Audio.hpp>
 #include <SFML/System/Time.hpp>
 #include <utilities/shapes.h>
@@ -13,11 +17,19 @@
 #include <utilities/shader.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <utilities/timeutils.h>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
 
 
 
-void runProgram(GLFWwindow* window, CommandLineOptions options)
+// Chrome/Perfetto trace written when pressing T, and when the program exits
+const std::string profilerTraceFile = "glowbox_trace.json";
+
+int runProgram(GLFWwindow* window, CommandLineOptions options)
 {
+    setProfilerEnabled(options.enableProfiler);
+
     // Enable depth (Z) buffer (accept "closest" fragment)
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
@@ -40,21 +52,80 @@ void runProgram(GLFWwindow* window, CommandLineOptions options)
 
 	initScene(window, options);
 
+    // A hard limit, so scenes that would not fit on the target hardware are caught early
+    if (isOverGPUMemoryBudget())
+    {
+        std::cerr << "The scene does not fit in the GPU memory budget of " << options.gpuMemoryBudgetMB << " MB" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Renders a fixed sequence of frames instead of running interactively
+    if (options.runGoldenImageTests || options.updateGoldenImages)
+    {
+        bool passed = runGoldenImageTests(window, options.updateGoldenImages);
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (options.runCheckerboardComparison)
+    {
+        runCheckerboardComparison(window);
+        return EXIT_SUCCESS;
+    }
+
+    if (options.runParticleBenchmark)
+    {
+        runParticleBenchmark(window);
+        return EXIT_SUCCESS;
+    }
+
+    if (!options.tiledOutputPath.empty())
+    {
+        return runTiledRenderWorker(window, options);
+    }
+
+    // Captured frames are evenly spaced in simulation time, so the recording plays back at the right speed
+    if (!options.capturePath.empty())
+    {
+        startFrameCapture(options.capturePath, options.captureFramesPerSecond);
+        setFixedTimeStep(1.0 / options.captureFramesPerSecond);
+    }
+
     // Rendering Loop
     while (!glfwWindowShouldClose(window))
     {
+        beginStatsFrame();
+
         updateFrame(window);
         renderFrame(window);
 
+        if (isFrameCaptureActive())
+        {
+            captureFrame();
+        }
+
         // Handle other events
         glfwPollEvents();
         handleKeyboardInput(window);
 
         // Flip buffers
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
         printGLError();
+
+        endStatsFrame();
     }
+
+    stopFrameCapture();
+
+    if (isProfilerEnabled())
+    {
+        writeChromeTrace(profilerTraceFile);
+    }
+
+    return EXIT_SUCCESS;
 }
 
 void handleKeyboardInput(GLFWwindow* window)
@@ -65,6 +136,32 @@ void handleKeyboardInput(GLFWwindow* window)
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
 
+    // Write the profiler zones recorded so far to disk, once per key press
+    static bool traceKeyWasPressed = false;
+    bool traceKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (traceKeyPressed && !traceKeyWasPressed && isProfilerEnabled())
+    {
+        writeChromeTrace(profilerTraceFile);
+    }
+    traceKeyWasPressed = traceKeyPressed;
+
+    static bool overlayKeyWasPressed = false;
+    bool overlayKeyPressed = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (overlayKeyPressed && !overlayKeyWasPressed)
+    {
+        showStatsOverlay = !showStatsOverlay;
+    }
+    overlayKeyWasPressed = overlayKeyPressed;
+
+    static bool checkerboardKeyWasPressed = false;
+    bool checkerboardKeyPressed = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+    // Both eyes share a single layered G-buffer in stereo, which has no checkerboard history
+    if (checkerboardKeyPressed && !checkerboardKeyWasPressed && !stereoRendering)
+    {
+        checkerboardRendering = !checkerboardRendering;
+    }
+    checkerboardKeyWasPressed = checkerboardKeyPressed;
+
     // Edit viewMode setting
     if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS)
     {
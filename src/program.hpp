@@ -10,8 +10,8 @@
 #include <utilities/window.hpp>
 
 
-// Main OpenGL program
-void runProgram(GLFWwindow* window, CommandLineOptions options);
+// Main OpenGL program. Returns the process exit code.
+int runProgram(GLFWwindow* window, CommandLineOptions options);
 
 
 // Function for handling keypresses
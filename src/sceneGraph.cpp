@@ -18,6 +18,39 @@ int totalChildren(SceneNode* parent) {
 	return count;
 }
 
+static void flattenNode(SceneNode* node, int parent, FlattenedSceneGraph &graph) {
+	int index = graph.nodes.size();
+	graph.nodes.push_back(node);
+	graph.parents.push_back(parent);
+
+	for (SceneNode* child : node->children) {
+		flattenNode(child, index, graph);
+	}
+}
+
+void flattenSceneGraph(SceneNode* root, FlattenedSceneGraph &graph) {
+	flattenNode(root, -1, graph);
+
+	graph.transforms.resize(graph.nodes.size());
+	graph.localMatrices.resize(graph.nodes.size());
+	graph.worldMatrices.resize(graph.nodes.size());
+}
+
+void updateTransformations(FlattenedSceneGraph &graph, MatrixKernel kernel) {
+	size_t count = graph.nodes.size();
+	for (size_t i = 0; i < count; i++) {
+		SceneNode* node = graph.nodes[i];
+		graph.transforms[i] = { node->position, node->referencePoint, node->rotation, node->scale };
+	}
+
+	composeTransforms(graph.transforms.data(), graph.localMatrices.data(), count);
+	transformHierarchy(graph.parents.data(), graph.localMatrices.data(), graph.worldMatrices.data(), count, kernel);
+
+	for (size_t i = 0; i < count; i++) {
+		graph.nodes[i]->currentTransformationMatrix = graph.worldMatrices[i];
+	}
+}
+
 // Pretty prints the current values of a SceneNode instance to stdout
 void printNode(SceneNode* node) {
 	printf(
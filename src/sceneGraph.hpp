@@ -6,17 +6,31 @@
 
 #include <stack>
 #include <vector>
+#include <memory>
 #include <cstdio>
+#include <cstddef>
 #include <stdbool.h>
 #include <cstdlib> 
 #include <ctime> 
 #include <chrono>
 #include <fstream>
 
+#include <utilities/matrixKernels.h>
+
 enum SceneNodeType {
 	GEOMETRY, GEOMETRY_2D, NORMAL_MAPPED, BLACK_HOLE, POINT_LIGHT, SPOT_LIGHT
 };
 
+// A mesh or texture shared between nodes, see assetRegistry.h
+struct GPUAsset;
+
+// One entry in a node's level-of-detail chain
+struct LODLevel {
+	int vertexArrayObjectID;
+	unsigned int VAOIndexCount;
+	float minScreenCoverage;  // Smallest fraction of the screen height the node must cover to use this level
+};
+
 struct SceneNode {
 	SceneNode() {
 		position = glm::vec3(0, 0, 0);
@@ -54,6 +68,28 @@ struct SceneNode {
 	int vertexArrayObjectID;
 	unsigned int VAOIndexCount;
 
+	// Axis-aligned bounding box of the node's mesh, in model space
+	glm::vec3 boundingBoxMin = glm::vec3(0);
+	glm::vec3 boundingBoxMax = glm::vec3(0);
+
+	// Index into the occlusion culling buffers, or -1 if the node is never culled
+	int cullID = -1;
+
+	// Offset of this frame's ObjectUniforms in the uniform ring, written before rendering
+	std::ptrdiff_t uniformOffset = 0;
+	// The buffer uniformOffset is in, when it is not the uniform ring (see gpuTransforms.h)
+	unsigned int uniformBuffer = 0;
+
+	// Dynamic nodes are redrawn into the shadow atlas when they move. All others are assumed never to move.
+	bool isDynamic = false;
+	// Nodes too small or too numerous to be worth drawing into the shadow atlas
+	bool castsShadows = true;
+
+	// Level-of-detail chain, finest level first. Empty if the node only has a single mesh.
+	// The selected level is copied into vertexArrayObjectID and VAOIndexCount every frame.
+	std::vector<LODLevel> lodLevels;
+	unsigned int currentLOD = 0;
+
 	// Node type is used to determine how to handle the contents of a node
 	SceneNodeType nodeType;
 
@@ -66,6 +102,12 @@ struct SceneNode {
 	// If the SceneNode has an associated roughness map
 	int roughnessMapID = -1;
 
+	// If the SceneNode's textures are streamed in pages (see virtualTexture.h), in place of the three IDs above
+	int virtualMaterialID = -1;
+
+	// The shared meshes and textures behind the IDs above, kept alive for as long as the node uses them
+	std::vector<std::shared_ptr<const GPUAsset>> assets;
+
 	// If the SceneNode contains a black hole
 	float innerRadius = 0.3f;  // The percentage of the radius of the sphere that is completely black
 
@@ -79,4 +121,21 @@ void addChild(SceneNode* parent, SceneNode* child);
 void printNode(SceneNode* node);
 int totalChildren(SceneNode* parent);
 
+// The scene graph in depth-first order, so parents come before their children, for the batched matrix kernels
+struct FlattenedSceneGraph {
+	std::vector<SceneNode*> nodes;
+	std::vector<int> parents;  // Index of each node's parent, -1 for the root
+
+	// Working arrays of updateTransformations()
+	std::vector<TransformComponents> transforms;
+	std::vector<glm::mat4> localMatrices;
+	std::vector<glm::mat4> worldMatrices;
+};
+
+// Appends root and everything below it. The graph must not change shape while the flattened copy is used.
+void flattenSceneGraph(SceneNode* root, FlattenedSceneGraph &graph);
+
+// Sets every node's currentTransformationMatrix from its own and its ancestors' position, rotation and scale
+void updateTransformations(FlattenedSceneGraph &graph, MatrixKernel kernel);
+
 // For more details, see SceneGraph.cpp.
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include <glad/glad.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/shader.hpp>
+#include <utilities/window.hpp>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "uniformBuffers.h"
+#include "cubeFaces.h"
+#include "shadowAtlas.h"
+
+// What has been drawn into the atlases for one light
+struct LightShadowState {
+    SceneNode* lightNode = nullptr;
+    glm::vec3 cachedPosition;
+    bool staticValid = false;
+    unsigned int dynamicFaces = 0;  // Bit mask of the faces holding dynamic geometry
+};
+
+static Gloom::Shader* shadowShader;
+
+static GLTexture staticAtlas;
+static GLTexture dynamicAtlas;
+static GLFramebuffer shadowFramebuffer;
+
+static std::vector<SceneNode*> staticCasters;
+static std::vector<SceneNode*> dynamicCasters;
+static std::vector<LightShadowState> lightStates;
+
+// Transformations of the dynamic casters when they were last drawn
+static std::vector<glm::mat4> drawnDynamicTransforms;
+
+static glm::mat4 faceProjection;
+static bool passActive = false;
+
+static void collectShadowNodes(SceneNode* node) {
+    bool caster = node->vertexArrayObjectID != -1 && node->castsShadows
+        && (node->nodeType == GEOMETRY || node->nodeType == NORMAL_MAPPED);
+
+    if (caster) {
+        (node->isDynamic ? dynamicCasters : staticCasters).push_back(node);
+    }
+
+    if (node->nodeType == POINT_LIGHT && node->lightID >= 0 && node->lightID < int(lightStates.size())) {
+        lightStates.at(node->lightID).lightNode = node;
+    }
+
+    for (SceneNode* child : node->children) {
+        collectShadowNodes(child);
+    }
+}
+
+static GLTexture createAtlas(unsigned int lightCount, const std::string &label) {
+    GLTexture atlas = createTexture(GL_TEXTURE_CUBE_MAP_ARRAY, GPU_MEMORY_RENDER_TARGET, label, 1, GL_DEPTH_COMPONENT16,
+                                    SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION, lightCount * 6);
+
+    // Hardware depth comparison, with linear filtering giving 2x2 PCF
+    glTextureParameteri(atlas, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTextureParameteri(atlas, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTextureParameteri(atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Attached as a whole, a single clear reaches every layer
+    glNamedFramebufferTexture(shadowFramebuffer, GL_DEPTH_ATTACHMENT, atlas, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFramebuffer);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return atlas;
+}
+
+void initShadowAtlas(SceneNode* rootNode, unsigned int lightCount) {
+    shadowShader = new Gloom::Shader();
+    shadowShader->makeBasicShader("../res/shaders/shadowDepth.vert", "../res/shaders/shadowDepth.frag");
+
+    shadowFramebuffer = createFramebuffer("Shadow atlas");
+    glNamedFramebufferDrawBuffer(shadowFramebuffer, GL_NONE);
+    glNamedFramebufferReadBuffer(shadowFramebuffer, GL_NONE);
+
+    staticAtlas = createAtlas(lightCount, "Static shadow atlas");
+    dynamicAtlas = createAtlas(lightCount, "Dynamic shadow atlas");
+
+    lightStates.resize(lightCount);
+    collectShadowNodes(rootNode);
+
+    faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, SHADOW_FAR_PLANE);
+}
+
+void destroyShadowAtlas() {
+    staticAtlas.reset();
+    dynamicAtlas.reset();
+    shadowFramebuffer.reset();
+
+    shadowShader->destroy();
+    delete shadowShader;
+
+    staticCasters.clear();
+    dynamicCasters.clear();
+    lightStates.clear();
+}
+
+void invalidateShadowCache() {
+    for (LightShadowState &state : lightStates) {
+        state.staticValid = false;
+    }
+}
+
+// Sets up the shadow pass the first time a face needs to be drawn this frame
+static void beginShadowPass() {
+    if (passActive) {
+        return;
+    }
+    passActive = true;
+
+    beginGPUPass(GPU_PASS_SHADOWS);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFramebuffer);
+    glViewport(0, 0, SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION);
+    // The room is seen from the inside, so both sides of every triangle have to cast shadows
+    glDisable(GL_CULL_FACE);
+    shadowShader->activate();
+}
+
+static void endShadowPass() {
+    if (!passActive) {
+        return;
+    }
+    passActive = false;
+
+    shadowShader->deactivate();
+    glEnable(GL_CULL_FACE);
+    glViewport(0, 0, windowWidth, windowHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    endGPUPass();
+}
+
+// Clears one cube face of an atlas and draws the given nodes into it
+static void renderFace(unsigned int atlas, unsigned int lightID, int face, glm::vec3 lightPosition,
+                       const std::vector<SceneNode*> &casters) {
+    beginShadowPass();
+
+    glNamedFramebufferTextureLayer(shadowFramebuffer, GL_DEPTH_ATTACHMENT, atlas, 0, lightID * 6 + face);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glm::mat4 faceViewProjection = faceProjection * cubeFaceView(lightPosition, face);
+    trackedUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(faceViewProjection));
+    trackedUniform3fv(1, 1, glm::value_ptr(lightPosition));
+
+    for (SceneNode* node : casters) {
+        bindObjectUniforms(node->uniformOffset, node->uniformBuffer);
+        trackedBindVertexArray(node->vertexArrayObjectID);
+        trackedDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+    }
+}
+
+void renderShadowAtlas() {
+    PROFILE_ZONE("renderShadowAtlas");
+
+    std::vector<glm::mat4> dynamicTransforms;
+    std::vector<glm::vec4> dynamicSpheres;
+    for (SceneNode* node : dynamicCasters) {
+        dynamicTransforms.push_back(node->currentTransformationMatrix);
+        dynamicSpheres.push_back(worldBoundingSphere(node));
+    }
+    bool dynamicMoved = drawnDynamicTransforms.empty() || dynamicTransforms != drawnDynamicTransforms;
+
+    for (unsigned int lightID = 0; lightID < lightStates.size(); lightID++) {
+        LightShadowState &state = lightStates.at(lightID);
+        if (state.lightNode == nullptr) {
+            continue;
+        }
+
+        glm::vec3 lightPosition = glm::vec3(state.lightNode->currentTransformationMatrix * glm::vec4(0, 0, 0, 1));
+        bool lightMoved = !state.staticValid || lightPosition != state.cachedPosition;
+
+        if (lightMoved) {
+            for (int face = 0; face < 6; face++) {
+                renderFace(staticAtlas, lightID, face, lightPosition, staticCasters);
+            }
+            state.cachedPosition = lightPosition;
+            state.staticValid = true;
+        }
+
+        if (lightMoved || dynamicMoved) {
+            unsigned int newFaces = 0;
+            for (const glm::vec4 &sphere : dynamicSpheres) {
+                newFaces |= facesTouchedBySphere(lightPosition, sphere, SHADOW_FAR_PLANE);
+            }
+
+            // Faces the dynamic nodes have left are cleared, faces they are in are redrawn
+            unsigned int faces = (newFaces | state.dynamicFaces) & ALL_FACES;
+            for (int face = 0; face < 6; face++) {
+                if (faces & (1u << face)) {
+                    static const std::vector<SceneNode*> noCasters;
+                    renderFace(dynamicAtlas, lightID, face, lightPosition,
+                               (newFaces & (1u << face)) ? dynamicCasters : noCasters);
+                }
+            }
+            state.dynamicFaces = newFaces;
+        }
+    }
+
+    drawnDynamicTransforms = dynamicTransforms;
+
+    endShadowPass();
+}
+
+void bindShadowAtlas() {
+    trackedBindTextureUnit(STATIC_SHADOW_UNIT, staticAtlas);
+    trackedBindTextureUnit(DYNAMIC_SHADOW_UNIT, dynamicAtlas);
+}
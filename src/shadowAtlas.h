@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sceneGraph.hpp"
+
+// Must match the definitions in simple.frag and shadowDepth.frag
+const float SHADOW_FAR_PLANE = 650.0f;
+const float SHADOW_NEAR_PLANE = 0.5f;
+
+// Edge length of every cube face, in texels
+const int SHADOW_MAP_RESOLUTION = 256;
+
+// Texture units the two atlases are bound to, as declared in simple.frag
+const unsigned int STATIC_SHADOW_UNIT = 5;
+const unsigned int DYNAMIC_SHADOW_UNIT = 6;
+
+// Omnidirectional shadows for every point light, stored as two cube map arrays with one cube per light.
+// The static atlas holds nodes that never move, and is only redrawn for lights that have moved.
+// The dynamic atlas holds nodes marked isDynamic, and is only redrawn for the cube faces they
+// cover (or covered last time) when they or the light have moved.
+// The G-buffer shader multiplies the two lookups.
+void initShadowAtlas(SceneNode* rootNode, unsigned int lightCount);
+void destroyShadowAtlas();
+
+// Brings both atlases up to date. Uses the object uniforms written for this frame.
+void renderShadowAtlas();
+
+// Forces the static atlas to be redrawn, e.g. after moving a static node
+void invalidateShadowCache();
+
+void bindShadowAtlas();
@@ -0,0 +1,63 @@
+#include <glad/glad.h>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <utilities/window.hpp>
+#include <utilities/gpuResources.h>
+#include "uniformBuffers.h"
+#include "stereo.h"
+
+static_assert(STEREO_EYE_COUNT == MAX_EYES, "Every eye needs its EyeUniforms");
+
+// One per eye, each reading one layer of the stereo image
+static GLFramebuffer eyeFramebuffers[STEREO_EYE_COUNT];
+
+bool isStereoSupported() {
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (std::strcmp(extension, "GL_ARB_shader_viewport_layer_array") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void initStereo() {
+    for (unsigned int eye = 0; eye < STEREO_EYE_COUNT; eye++) {
+        eyeFramebuffers[eye] = createFramebuffer(eye == 0 ? "Stereo left eye" : "Stereo right eye");
+    }
+}
+
+void destroyStereo() {
+    for (GLFramebuffer &framebuffer : eyeFramebuffers) {
+        framebuffer.reset();
+    }
+}
+
+void stereoEyeViews(const glm::mat4 &cameraView, glm::mat4 eyeViews[STEREO_EYE_COUNT]) {
+    // Moving an eye left in view space moves the scene right
+    for (unsigned int eye = 0; eye < STEREO_EYE_COUNT; eye++) {
+        float offset = (eye == 0 ? 0.5f : -0.5f) * STEREO_EYE_SEPARATION;
+        eyeViews[eye] = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)) * cameraView;
+    }
+}
+
+void presentStereo(unsigned int stereoTexture) {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Each eye is rendered at the window's size, and shrunk to fit its half of the window
+    GLint halfWidth = windowWidth / 2;
+    GLint height = windowHeight * halfWidth / windowWidth;
+    GLint bottom = (windowHeight - height) / 2;
+
+    for (unsigned int eye = 0; eye < STEREO_EYE_COUNT; eye++) {
+        glNamedFramebufferTextureLayer(eyeFramebuffers[eye], GL_COLOR_ATTACHMENT0, stereoTexture, 0, eye);
+        glNamedFramebufferReadBuffer(eyeFramebuffers[eye], GL_COLOR_ATTACHMENT0);
+
+        GLint left = eye * halfWidth;
+        glBlitNamedFramebuffer(eyeFramebuffers[eye], 0, 0, 0, windowWidth, windowHeight,
+                               left, bottom, left + halfWidth, bottom + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+}
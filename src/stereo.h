@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Must match MAX_EYES in uniformBlocks.glsl and uniformBuffers.h
+const unsigned int STEREO_EYE_COUNT = 2;
+
+// Distance between the eyes, in scene units. The room is 360 units across.
+const float STEREO_EYE_SEPARATION = 2.0f;
+
+// Single-pass stereo rendering, for head-mounted and dome displays.
+// Both eyes are drawn into one layered G-buffer (2D array textures, one layer per eye) in a single pass:
+// every G-buffer draw is instanced once per eye, and the vertex shader sends each instance to its eye's
+// layer with gl_Layer. The deferred resolve and the lensing then run once over both layers, reading the
+// eye's view-projection and position from FrameUniforms::eyes. Both eyes lens the same list of black holes,
+// and only the screen tiles are binned per eye (see lensing.h). The CPU submits the same draws as in mono,
+// so its cost does not double.
+// Writing gl_Layer from the vertex shader needs GL_ARB_shader_viewport_layer_array.
+
+bool isStereoSupported();
+
+void initStereo();
+void destroyStereo();
+
+// The eyes' view matrices, the camera's moved half the eye separation to either side. Left eye first.
+void stereoEyeViews(const glm::mat4 &cameraView, glm::mat4 eyeViews[STEREO_EYE_COUNT]);
+
+// Shows the two layers of a resolved stereo image side by side in the window, letterboxed.
+// A head-mounted display's compositor would take the layers as they are instead.
+void presentStereo(unsigned int stereoTexture);
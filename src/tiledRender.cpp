@@ -0,0 +1,518 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "program.hpp"
+#include "bhSimulation.h"
+#include "tiledRender.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+// Must match the planes used in updateFrame()
+const float TILE_NEAR_PLANE = 0.1f;
+const float TILE_FAR_PLANE = 1000.0f;
+
+// Largest shift of a lensed sample, in window heights per unit of black hole screen coverage.
+// From deferred.frag: the shift is 0.5 * distortion * coverage, and distortion stays below 0.85^3.
+const float MAX_LENSING_SHIFT_PER_COVERAGE = 0.5f * 0.615f;
+
+const uint32_t TILE_SHARED_MAGIC = 0x676C7431;  // "glt1"
+const unsigned int TILE_PROGRESS_INTERVAL = 16;
+
+// How the image is cut up. Computed the same way by the coordinator and every worker.
+struct TileLayout {
+    unsigned int imageWidth;
+    unsigned int imageHeight;
+    unsigned int guard;
+    unsigned int coreWidth;   // Pixels kept from each tile (less along the right and bottom edges)
+    unsigned int coreHeight;
+    unsigned int tilesX;
+    unsigned int tilesY;
+
+    unsigned int tileCount() const { return tilesX * tilesY; }
+};
+
+// One tile's kept pixels, in image coordinates with the top row first
+struct TileRect {
+    unsigned int x, y, width, height;
+};
+
+static bool computeTileLayout(const CommandLineOptions &options, TileLayout &layout) {
+    layout.imageWidth = options.tiledWidth;
+    layout.imageHeight = options.tiledHeight;
+    layout.guard = options.tileGuard;
+
+    int coreWidth = windowWidth - 2 * int(layout.guard);
+    int coreHeight = windowHeight - 2 * int(layout.guard);
+    if (coreWidth < 16 || coreHeight < 16) {
+        std::cerr << fmt::format("Tiled rendering: a guard band of {} pixels leaves no room in a {}x{} window",
+                                 layout.guard, windowWidth, windowHeight) << std::endl;
+        return false;
+    }
+
+    layout.coreWidth = coreWidth;
+    layout.coreHeight = coreHeight;
+    layout.tilesX = (layout.imageWidth + layout.coreWidth - 1) / layout.coreWidth;
+    layout.tilesY = (layout.imageHeight + layout.coreHeight - 1) / layout.coreHeight;
+    return true;
+}
+
+static TileRect tileRect(const TileLayout &layout, unsigned int tileIndex) {
+    TileRect rect;
+    rect.x = (tileIndex % layout.tilesX) * layout.coreWidth;
+    rect.y = (tileIndex / layout.tilesX) * layout.coreHeight;
+    rect.width = std::min(layout.coreWidth, layout.imageWidth - rect.x);
+    rect.height = std::min(layout.coreHeight, layout.imageHeight - rect.y);
+    return rect;
+}
+
+// The part of the full image's frustum seen through the window when the tile's kept pixels
+// sit just inside the guard band
+static glm::mat4 tileProjection(const TileLayout &layout, const TileRect &rect, float fieldOfViewY) {
+    float top = TILE_NEAR_PLANE * std::tan(fieldOfViewY / 2.0f);
+    float right = top * float(layout.imageWidth) / float(layout.imageHeight);
+
+    // Window edges in image pixels, with y pointing up as in OpenGL
+    float left = float(rect.x) - float(layout.guard);
+    float bottom = float(layout.imageHeight) - float(rect.y + rect.height) - float(layout.guard);
+
+    auto toNearPlaneX = [&](float x) { return -right + 2.0f * right * x / float(layout.imageWidth); };
+    auto toNearPlaneY = [&](float y) { return -top + 2.0f * top * y / float(layout.imageHeight); };
+
+    return glm::frustum(toNearPlaneX(left), toNearPlaneX(left + windowWidth),
+                        toNearPlaneY(bottom), toNearPlaneY(bottom + windowHeight),
+                        TILE_NEAR_PLANE, TILE_FAR_PLANE);
+}
+
+// Binary PPM, written one tile at a time at the right offsets
+class TileFileWriter {
+public:
+    bool open(const std::string &path, const TileLayout &layout) {
+        width = layout.imageWidth;
+        height = layout.imageHeight;
+
+        file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        std::string header = fmt::format("P6\n{} {}\n255\n", width, height);
+        file << header;
+        headerSize = header.size();
+
+        // Sizes the file up front, so every tile lands inside it
+        file.seekp(std::streamoff(headerSize + uint64_t(width) * height * 3 - 1));
+        file.put(0);
+        return bool(file);
+    }
+
+    // pixels holds the tile's RGB rows, top row first
+    void writeTile(const TileRect &rect, const unsigned char* pixels) {
+        for (unsigned int row = 0; row < rect.height; row++) {
+            uint64_t offset = headerSize + (uint64_t(rect.y + row) * width + rect.x) * 3;
+            file.seekp(std::streamoff(offset));
+            file.write(reinterpret_cast<const char*>(pixels + size_t(row) * rect.width * 3), rect.width * 3);
+        }
+    }
+
+    bool close() {
+        file.close();
+        return !file.fail();
+    }
+
+private:
+    std::fstream file;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    size_t headerSize = 0;
+};
+
+
+// Shared memory layout: the header, one slot per worker, then the pixel storage of each slot.
+// Every slot holds one finished tile at a time, so a worker renders its next tile while the coordinator
+// writes out the previous one.
+
+enum TileSlotState : uint32_t {
+    TILE_SLOT_EMPTY, TILE_SLOT_FULL
+};
+
+struct TileSharedHeader {
+    uint32_t magic;
+    uint32_t workerCount;
+    uint32_t tileCount;
+    uint32_t slotSize;
+    std::atomic<uint32_t> nextTile;
+};
+
+struct TileSlot {
+    std::atomic<uint32_t> state;
+    uint32_t tileIndex;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Atomics in shared memory have to be lock-free");
+
+static size_t sharedMemorySize(uint32_t workerCount, uint32_t slotSize) {
+    return sizeof(TileSharedHeader) + workerCount * (sizeof(TileSlot) + size_t(slotSize));
+}
+
+static TileSlot* sharedSlots(TileSharedHeader* header) {
+    return reinterpret_cast<TileSlot*>(header + 1);
+}
+
+static unsigned char* sharedSlotPixels(TileSharedHeader* header, uint32_t slot) {
+    unsigned char* pixelStart = reinterpret_cast<unsigned char*>(sharedSlots(header) + header->workerCount);
+    return pixelStart + size_t(slot) * header->slotSize;
+}
+
+
+// Reads the tile's kept pixels from the window, as RGB with the top row first
+static void readTile(const TileLayout &layout, const TileRect &rect, std::vector<unsigned char> &pixels) {
+    std::vector<unsigned char> rows(size_t(rect.width) * rect.height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // tileProjection() puts the kept pixels at the guard band's distance from the window's bottom left corner
+    glReadPixels(layout.guard, layout.guard, rect.width, rect.height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+
+    pixels.resize(rows.size());
+    size_t rowSize = size_t(rect.width) * 3;
+    for (unsigned int row = 0; row < rect.height; row++) {
+        std::memcpy(&pixels[row * rowSize], &rows[(rect.height - 1 - row) * rowSize], rowSize);
+    }
+}
+
+static void renderTile(GLFWwindow* window, const TileLayout &layout, const TileRect &rect) {
+    float fieldOfView = getFieldOfView();
+    // The window's height, at the full image's pixel density
+    float tileFieldOfView = 2.0f * std::atan(std::tan(fieldOfView / 2.0f) * windowHeight / layout.imageHeight);
+    setProjectionOverride(tileProjection(layout, rect, fieldOfView), tileFieldOfView);
+
+    for (unsigned int frame = 0; frame < FRAMES_PER_TILE; frame++) {
+        updateFrame(window);
+        renderFrame(window);
+        if (frame + 1 < FRAMES_PER_TILE) {
+            glfwSwapBuffers(window);
+        }
+    }
+}
+
+// The guard band only helps if lensed samples stay within it
+static void checkGuardBand(const TileLayout &layout) {
+    float maxShift = MAX_LENSING_SHIFT_PER_COVERAGE * getBlackHoleScreenCoverage() * std::max(windowWidth, windowHeight);
+    if (maxShift > layout.guard) {
+        std::cout << fmt::format("Tiled rendering: lensing may sample up to {:.0f} pixels away, beyond the {} pixel guard band. "
+                                 "Seams may show where the black hole crosses tile borders.",
+                                 maxShift, layout.guard) << std::endl;
+    }
+}
+
+// Renders identical frames in every process, then freezes the simulations
+static void settleScene(GLFWwindow* window) {
+    setFixedTimeStep(1.0 / 60.0);
+    for (unsigned int frame = 0; frame < TILE_SETTLE_FRAMES; frame++) {
+        updateFrame(window);
+        renderFrame(window);
+        glfwSwapBuffers(window);
+    }
+    setFixedTimeStep(0);
+}
+
+#ifndef _WIN32
+
+static TileSharedHeader* mapSharedMemory(const std::string &name, size_t size, bool create) {
+    int descriptor = shm_open(name.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+    if (descriptor < 0) {
+        return nullptr;
+    }
+    if (create && ftruncate(descriptor, off_t(size)) != 0) {
+        close(descriptor);
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    return memory == MAP_FAILED ? nullptr : static_cast<TileSharedHeader*>(memory);
+}
+
+bool isMultiProcessTilingSupported() {
+    return true;
+}
+
+int runTiledRenderCoordinator(const char* executablePath, const CommandLineOptions &options) {
+    TileLayout layout;
+    if (!computeTileLayout(options, layout)) {
+        return EXIT_FAILURE;
+    }
+
+    TileFileWriter writer;
+    if (!writer.open(options.tiledOutputPath, layout)) {
+        std::cerr << fmt::format("Tiled rendering: could not create {}", options.tiledOutputPath) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint32_t workerCount = std::min<uint32_t>(options.tileWorkerCount, layout.tileCount());
+    uint32_t slotSize = layout.coreWidth * layout.coreHeight * 3;
+    size_t size = sharedMemorySize(workerCount, slotSize);
+
+    std::string name = fmt::format("/glowbox_tiles_{}", getpid());
+    TileSharedHeader* header = mapSharedMemory(name, size, true);
+    if (header == nullptr) {
+        std::cerr << fmt::format("Tiled rendering: could not create shared memory {}", name) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    new (header) TileSharedHeader();
+    header->magic = TILE_SHARED_MAGIC;
+    header->workerCount = workerCount;
+    header->tileCount = layout.tileCount();
+    header->slotSize = slotSize;
+    header->nextTile.store(0);
+    for (uint32_t slot = 0; slot < workerCount; slot++) {
+        new (&sharedSlots(header)[slot]) TileSlot();
+        sharedSlots(header)[slot].state.store(TILE_SLOT_EMPTY);
+    }
+
+    std::cout << fmt::format("Rendering {}x{} as {} tiles of {}x{} (with {} pixel guard bands) on {} worker processes",
+                             layout.imageWidth, layout.imageHeight, layout.tileCount(),
+                             layout.coreWidth, layout.coreHeight, layout.guard, workerCount) << std::endl;
+
+    // Workers get the same scene options, plus their index and the shared memory's name
+    std::vector<pid_t> workers;
+    for (uint32_t worker = 0; worker < workerCount; worker++) {
+        std::vector<std::string> arguments = {
+            executablePath,
+            "--tiled-render", options.tiledOutputPath,
+            "--tiled-width", std::to_string(options.tiledWidth),
+            "--tiled-height", std::to_string(options.tiledHeight),
+            "--tile-guard", std::to_string(options.tileGuard),
+            "--tile-worker", std::to_string(worker),
+            "--tile-shm", name,
+            "--particles", std::to_string(options.particleCount),
+            "--balls", std::to_string(options.orbitingBallCount),
+            "--black-holes", std::to_string(options.blackHoleCount),
+            "--vram-budget", std::to_string(options.gpuMemoryBudgetMB),
+        };
+        if (options.enableOcclusionCulling) {
+            arguments.push_back("--occlusion-culling");
+        }
+        if (options.enableGPUTransforms) {
+            arguments.push_back("--gpu-transforms");
+        }
+
+        std::vector<char*> argv;
+        for (std::string &argument : arguments) {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        if (posix_spawnp(&pid, executablePath, nullptr, nullptr, argv.data(), environ) == 0) {
+            workers.push_back(pid);
+        } else {
+            std::cerr << fmt::format("Tiled rendering: could not start worker {}", worker) << std::endl;
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+
+    unsigned int tilesWritten = 0;
+    unsigned int runningWorkers = workers.size();
+    bool failed = workers.empty();
+
+    while (tilesWritten < layout.tileCount() && !failed) {
+        bool wroteTile = false;
+        for (uint32_t slot = 0; slot < workerCount; slot++) {
+            TileSlot &tileSlot = sharedSlots(header)[slot];
+            if (tileSlot.state.load(std::memory_order_acquire) != TILE_SLOT_FULL) {
+                continue;
+            }
+
+            writer.writeTile(tileRect(layout, tileSlot.tileIndex), sharedSlotPixels(header, slot));
+            tileSlot.state.store(TILE_SLOT_EMPTY, std::memory_order_release);
+            tilesWritten++;
+            wroteTile = true;
+
+            if (tilesWritten % TILE_PROGRESS_INTERVAL == 0) {
+                std::cout << fmt::format("Tiled rendering: {} of {} tiles written", tilesWritten, layout.tileCount()) << std::endl;
+            }
+        }
+
+        // Workers exit once there are no tiles left to take. Any exit before that is a crash.
+        for (pid_t &pid : workers) {
+            int status;
+            if (pid > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+                pid = -1;
+                runningWorkers--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                    std::cerr << "Tiled rendering: a worker process failed" << std::endl;
+                    failed = true;
+                }
+            }
+        }
+        if (runningWorkers == 0 && !wroteTile) {
+            // Tiles may have been handed back just before the last worker exited
+            bool anyFull = false;
+            for (uint32_t slot = 0; slot < workerCount; slot++) {
+                anyFull |= sharedSlots(header)[slot].state.load(std::memory_order_acquire) == TILE_SLOT_FULL;
+            }
+            failed |= !anyFull && tilesWritten < layout.tileCount();
+        }
+
+        if (!wroteTile) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    for (pid_t pid : workers) {
+        if (pid > 0) {
+            if (failed) {
+                kill(pid, SIGTERM);
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    munmap(header, size);
+    shm_unlink(name.c_str());
+
+    if (!writer.close() || failed) {
+        std::cerr << fmt::format("Tiled rendering failed after {} of {} tiles", tilesWritten, layout.tileCount()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << fmt::format("Wrote {} ({}x{}) in {:.1f} s", options.tiledOutputPath,
+                             layout.imageWidth, layout.imageHeight, seconds) << std::endl;
+    return EXIT_SUCCESS;
+}
+
+static int runSharedMemoryWorker(GLFWwindow* window, const CommandLineOptions &options, const TileLayout &layout) {
+    TileSharedHeader* header = mapSharedMemory(options.tileSharedMemoryName, sizeof(TileSharedHeader), false);
+    if (header == nullptr || header->magic != TILE_SHARED_MAGIC) {
+        std::cerr << fmt::format("Tile worker: could not open shared memory {}", options.tileSharedMemoryName) << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t size = sharedMemorySize(header->workerCount, header->slotSize);
+    munmap(header, sizeof(TileSharedHeader));
+    header = mapSharedMemory(options.tileSharedMemoryName, size, false);
+    if (header == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    uint32_t slot = options.tileWorkerIndex;
+    TileSlot &tileSlot = sharedSlots(header)[slot];
+    std::vector<unsigned char> pixels;
+    bool checkedGuardBand = slot != 0;
+
+    while (true) {
+        uint32_t tileIndex = header->nextTile.fetch_add(1);
+        if (tileIndex >= header->tileCount) {
+            break;
+        }
+
+        TileRect rect = tileRect(layout, tileIndex);
+        renderTile(window, layout, rect);
+        readTile(layout, rect, pixels);
+        glfwSwapBuffers(window);
+
+        if (!checkedGuardBand) {
+            checkGuardBand(layout);
+            checkedGuardBand = true;
+        }
+
+        // The coordinator may still be writing out the previous tile
+        while (tileSlot.state.load(std::memory_order_acquire) != TILE_SLOT_EMPTY) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::memcpy(sharedSlotPixels(header, slot), pixels.data(), pixels.size());
+        tileSlot.tileIndex = tileIndex;
+        tileSlot.state.store(TILE_SLOT_FULL, std::memory_order_release);
+    }
+
+    munmap(header, size);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+bool isMultiProcessTilingSupported() {
+    return false;
+}
+
+int runTiledRenderCoordinator(const char*, const CommandLineOptions &) {
+    std::cerr << "Tiled rendering: worker processes are not supported on this platform" << std::endl;
+    return EXIT_FAILURE;
+}
+
+static int runSharedMemoryWorker(GLFWwindow*, const CommandLineOptions &, const TileLayout &) {
+    return EXIT_FAILURE;
+}
+
+#endif
+
+int runTiledRenderWorker(GLFWwindow* window, const CommandLineOptions &options) {
+    TileLayout layout;
+    if (!computeTileLayout(options, layout)) {
+        return EXIT_FAILURE;
+    }
+
+    settleScene(window);
+
+    int result;
+    if (options.tileWorkerIndex >= 0) {
+        result = runSharedMemoryWorker(window, options, layout);
+    } else {
+        // No worker processes, so this process renders every tile and writes the file itself
+        TileFileWriter writer;
+        if (!writer.open(options.tiledOutputPath, layout)) {
+            std::cerr << fmt::format("Tiled rendering: could not create {}", options.tiledOutputPath) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << fmt::format("Rendering {}x{} as {} tiles of {}x{} (with {} pixel guard bands)",
+                                 layout.imageWidth, layout.imageHeight, layout.tileCount(),
+                                 layout.coreWidth, layout.coreHeight, layout.guard) << std::endl;
+
+        std::vector<unsigned char> pixels;
+        for (unsigned int tileIndex = 0; tileIndex < layout.tileCount(); tileIndex++) {
+            TileRect rect = tileRect(layout, tileIndex);
+            renderTile(window, layout, rect);
+            readTile(layout, rect, pixels);
+            glfwSwapBuffers(window);
+            writer.writeTile(rect, pixels.data());
+
+            if (tileIndex == 0) {
+                checkGuardBand(layout);
+            }
+        }
+
+        result = writer.close() ? EXIT_SUCCESS : EXIT_FAILURE;
+        if (result == EXIT_SUCCESS) {
+            std::cout << fmt::format("Wrote {}", options.tiledOutputPath) << std::endl;
+        }
+    }
+
+    clearProjectionOverride();
+    useMeasuredTimeStep();
+    return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <utilities/window.hpp>
+
+// Frames rendered at a fixed time step before the simulations are frozen. Every process renders the
+// same frames, so they all end up showing the same moment.
+const unsigned int TILE_SETTLE_FRAMES = 60;
+// Frames rendered for each tile. Occlusion culling and LOD selection look at the previous frame,
+// so the first one after moving to a new tile may not be right yet.
+const unsigned int FRAMES_PER_TILE = 2;
+
+// Offline rendering of stills far larger than the window, e.g. 16K for print or dome projection.
+// The image is split into tiles that each fill the window, rendered with off-axis projections
+// cut from the full image's frustum. Every tile is rendered with a guard band of extra pixels
+// around it, so the screen-space lensing near its borders can sample what lies just beyond them.
+// Only the inner part is kept.
+// The result is written as a binary PPM, tile by tile, so the whole image is never held in memory.
+
+// Whether tiles can be spread over worker processes on this platform
+bool isMultiProcessTilingSupported();
+
+// Creates the shared memory and the output file, starts the worker processes and writes the tiles
+// they hand back. Needs no window of its own. Returns the process exit code.
+int runTiledRenderCoordinator(const char* executablePath, const CommandLineOptions &options);
+
+// Renders tiles in a hidden window. As a worker process (options.tileWorkerIndex >= 0) they are handed
+// back through shared memory; otherwise every tile is rendered here and written to the file directly.
+int runTiledRenderWorker(GLFWwindow* window, const CommandLineOptions &options);
@@ -0,0 +1,100 @@
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include <utilities/mappedRing.h>
+#include "uniformBuffers.h"
+
+// The std140 offsets the shaders rely on
+static_assert(offsetof(FrameUniforms, eyePos) == 128, "FrameUniforms does not match std140");
+static_assert(offsetof(FrameUniforms, bhScreenPos) == 160, "FrameUniforms does not match std140");
+static_assert(offsetof(FrameUniforms, screenDimensions) == 176, "FrameUniforms does not match std140");
+static_assert(offsetof(FrameUniforms, lightSource) == 192, "FrameUniforms does not match std140");
+static_assert(sizeof(LightUniforms) == 32, "LightUniforms does not match std140");
+static_assert(offsetof(FrameUniforms, eyes) == 192 + MAX_LIGHTS * 32, "FrameUniforms does not match std140");
+static_assert(sizeof(EyeUniforms) == 80, "EyeUniforms does not match std140");
+static_assert(offsetof(ObjectUniforms, normalMatrix) == 128, "ObjectUniforms does not match std140");
+static_assert(offsetof(ObjectUniforms, modelColor) == 176, "ObjectUniforms does not match std140");
+static_assert(sizeof(ObjectUniforms) == 192, "ObjectUniforms does not match std140");
+
+static GLBuffer ringBuffer;
+static unsigned char* ringMemory;
+static MappedRingFences ringFences;
+
+static GLsizeiptr frameUniformsStride;
+static GLsizeiptr objectUniformsStride;
+static GLsizeiptr sectionSize;
+static unsigned int objectCapacity;
+
+static unsigned int objectsWritten = 0;
+static bool overflowReported = false;
+
+static GLsizeiptr alignUp(GLsizeiptr size, GLsizeiptr alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void initUniformBuffers(unsigned int capacity) {
+    objectCapacity = capacity;
+
+    // Every range bound to a uniform block must start at a multiple of this
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+    frameUniformsStride  = alignUp(sizeof(FrameUniforms), offsetAlignment);
+    objectUniformsStride = alignUp(sizeof(ObjectUniforms), offsetAlignment);
+    // One slot more than asked for, which the objects past the capacity share, so they never overwrite the others
+    sectionSize = frameUniformsStride + (objectCapacity + 1) * objectUniformsStride;
+
+    ringMemory = static_cast<unsigned char*>(createMappedRing(ringBuffer, GPU_MEMORY_UNIFORM, "Uniform ring", sectionSize));
+}
+
+void destroyUniformBuffers() {
+    ringFences.reset();
+
+    // Deleting the buffer also unmaps it
+    ringBuffer.reset();
+    ringMemory = nullptr;
+}
+
+void beginUniformFrame() {
+    ringFences.waitForCurrentSection();
+    objectsWritten = 0;
+    overflowReported = false;
+}
+
+void endUniformFrame() {
+    ringFences.fenceCurrentSection();
+}
+
+void writeFrameUniforms(const FrameUniforms &uniforms) {
+    GLintptr offset = ringFences.currentSection() * sectionSize;
+    std::memcpy(ringMemory + offset, &uniforms, sizeof(FrameUniforms));
+    apiCounters.bytesUploaded += sizeof(FrameUniforms);
+
+    trackedBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, ringBuffer, offset, sizeof(FrameUniforms));
+}
+
+GLintptr writeObjectUniforms(const ObjectUniforms &uniforms) {
+    unsigned int slot = objectsWritten;
+    if (objectsWritten == objectCapacity) {
+        if (!overflowReported) {
+            fprintf(stderr, "Uniform ring is full (%u objects); the objects past it share one slot this frame.\n", objectCapacity);
+            overflowReported = true;
+        }
+    }
+    else {
+        objectsWritten++;
+    }
+
+    GLintptr offset = ringFences.currentSection() * sectionSize + frameUniformsStride + slot * objectUniformsStride;
+    std::memcpy(ringMemory + offset, &uniforms, sizeof(ObjectUniforms));
+    apiCounters.bytesUploaded += sizeof(ObjectUniforms);
+
+    return offset;
+}
+
+void bindObjectUniforms(GLintptr offset, GLuint buffer) {
+    trackedBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORMS_BINDING, (buffer != 0) ? buffer : GLuint(ringBuffer),
+                           offset, sizeof(ObjectUniforms));
+}
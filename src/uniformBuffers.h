@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Must match MAX_LIGHTS in uniformBlocks.glsl
+const unsigned int MAX_LIGHTS = 100;
+// Must match MAX_EYES in uniformBlocks.glsl. The eyes of stereo mode, see stereo.h.
+const unsigned int MAX_EYES = 2;
+
+// Uniform block binding points, as declared in uniformBlocks.glsl
+const GLuint FRAME_UNIFORMS_BINDING  = 0;
+const GLuint OBJECT_UNIFORMS_BINDING = 1;
+
+// Mirrors LightSource in uniformBlocks.glsl (std140: every vec3 starts on a 16 byte boundary)
+struct LightUniforms {
+	glm::vec3 coord;
+	float padding0;
+	glm::vec3 color;
+	float padding1;
+};
+
+// Mirrors Eye in uniformBlocks.glsl (std140)
+struct EyeUniforms {
+	glm::mat4 viewProjection;
+	glm::vec3 position;
+	float padding;
+};
+
+// Mirrors the FrameUniforms block (std140). Scalars are packed into the padding after each vec3.
+struct FrameUniforms {
+	glm::mat4 viewProjection;
+	glm::mat4 orthoProjection;
+	glm::vec3 eyePos;
+	float bhRadius;
+	glm::vec3 bhPos;
+	float bhScreenPercent;
+	glm::vec3 bhScreenPos;
+	int viewMode;
+	glm::vec2 screenDimensions;
+	int numLights;
+	int checkerboardParity;  // The half of the pixels drawn this frame (see checkerboard.h), or -1 for all of them
+	LightUniforms lightSource[MAX_LIGHTS];
+	EyeUniforms eyes[MAX_EYES];  // In mono, every eye is the camera
+};
+
+// Mirrors the ObjectUniforms block (std140). A mat3 is stored as three vec4 columns.
+struct ObjectUniforms {
+	glm::mat4 modelMatrix;
+	glm::mat4 modelViewProjection;  // Unused by 2D nodes, which are projected with orthoProjection
+	glm::vec4 normalMatrix[3];
+	glm::vec3 modelColor;
+	int renderMode;
+};
+
+// Creates a persistently mapped ring holding the uniforms of three frames,
+// with room for objectCapacity ObjectUniforms per frame
+void initUniformBuffers(unsigned int objectCapacity);
+void destroyUniformBuffers();
+
+// Waits until the GPU is done with the ring section about to be overwritten
+void beginUniformFrame();
+// Fences the section written this frame and moves on to the next one
+void endUniformFrame();
+
+// Copies the frame's uniforms into the ring and binds them to FRAME_UNIFORMS_BINDING
+void writeFrameUniforms(const FrameUniforms &uniforms);
+// Copies one object's uniforms into the ring and returns their offset, to be passed to bindObjectUniforms()
+GLintptr writeObjectUniforms(const ObjectUniforms &uniforms);
+// From the ring, or from another buffer holding ObjectUniforms, such as the one written by the GPU transforms
+// (see gpuTransforms.h)
+void bindObjectUniforms(GLintptr offset, GLuint buffer = 0);
@@ -34,6 +34,18 @@ namespace Gloom
         glm::mat4 getViewMatrix() { return matView; }
 
 
+        /* Place the camera at `position`, looking towards `target` */
+        void lookAt(glm::vec3 position, glm::vec3 target)
+        {
+            glm::mat4 view = glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            cPosition   = position;
+            cQuaternion = glm::normalize(glm::quat_cast(glm::mat3(view)));
+
+            updateViewMatrix();
+        }
+
+
         /* Handle keyboard inputs from a callback mechanism */
         void handleKeyboardInputs(int key, int action)
         {
@@ -198,7 +210,7 @@ namespace Gloom
         // Variables used for bookkeeping
         GLboolean resetMouse     = true;
         GLboolean isMousePressed = false;
-        GLboolean keysInUse[512];
+        GLboolean keysInUse[512] = {};
 
         // Last cursor position
         GLfloat lastXPos = 0.0f;
@@ -0,0 +1,37 @@
+#include "cpuFeatures.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+bool cpuSupportsSSE2() {
+#if defined(CPU_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#elif defined(CPU_X86)
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+bool cpuSupportsAVX2() {
+#if defined(CPU_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osSavesAVX = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    return fma && osSavesAVX && avx2;
+#elif defined(CPU_X86)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
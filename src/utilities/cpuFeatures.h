@@ -0,0 +1,8 @@
+#pragma once
+
+// The instruction sets the SIMD kernels pick between at runtime. Always false on CPUs other than x86.
+
+// SSE2
+bool cpuSupportsSSE2();
+// AVX2 and FMA, with the OS saving the AVX registers on context switches
+bool cpuSupportsAVX2();
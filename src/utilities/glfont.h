@@ -3,4 +3,11 @@
 #include <string>
 #include "mesh.h"
 
+// charmap.png holds the first 128 ASCII characters side by side, each 29 by 39 pixels
+const float CHARMAP_GLYPH_ASPECT = 29.0f / 39.0f;  // Width over height
+
+// Texture coordinates of a character's corners, counter-clockwise from the bottom left.
+// Characters outside the map are drawn as '?'.
+void glyphTextureCoordinates(char character, glm::vec2 corners[4]);
+
 Mesh generateTextGeometryBuffer(std::string text, float characterHeightOverWidth, float totalTextWidth);
\ No newline at end of file
@@ -1,77 +1,50 @@
 #include <glad/glad.h>
 #include <program.hpp>
 #include "glutils.h"
+#include "shapes.h"
 #include <vector>
+#include <unordered_map>
+#include <fmt/format.h>
 #include "imageLoader.hpp"
+#include "profiler.h"
+#include "renderStats.h"
+#include "gpuResources.h"
+
+// Everything a vertex array made by generateBuffer() reads from, deleted together with it
+struct MeshBuffers {
+    GLVertexArray vertexArray;
+    std::vector<GLBuffer> buffers;
+};
+
+// Objects handed out by ID, owned here until deleteBuffer(), deleteTexture() or deleteGBuffer()
+static std::unordered_map<unsigned int, MeshBuffers> meshBuffers;
+static std::unordered_map<unsigned int, GLTexture> textures;
+static std::unordered_map<unsigned int, GLFramebuffer> framebuffers;
 
 template <class T>
-unsigned int generateAttribute(int id, int elementsPerEntry, std::vector<T> data, bool normalize) {
-    unsigned int bufferID;
-    glGenBuffers(1, &bufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(T), data.data(), GL_STATIC_DRAW);
+GLBuffer generateAttribute(int id, int elementsPerEntry, const std::vector<T> &data, bool normalize, const std::string &label) {
+    GLBuffer buffer = createBuffer(GPU_MEMORY_VERTEX, fmt::format("{} attribute {}", label, id),
+                                   data.size() * sizeof(T), data.data(), 0);
+    trackedBindBuffer(GL_ARRAY_BUFFER, buffer);
     glVertexAttribPointer(id, elementsPerEntry, GL_FLOAT, normalize ? GL_TRUE : GL_FALSE, sizeof(T), 0);
     glEnableVertexAttribArray(id);
-    return bufferID;
+    return buffer;
 }
 
-// Copied from https://www.opengl-tutorial.org/intermediate-tutorials/tutorial-13-normal-mapping/#vertex-shader
-void computeTangentBasis(
-    // inputs
-    std::vector<glm::vec3>& vertices,
-    std::vector<glm::vec2>& uvs,
-    std::vector<glm::vec3>& normals,
-    // outputs
-    std::vector<glm::vec3>& tangents,
-    std::vector<glm::vec3>& bitangents)
-{
-    for (unsigned int i = 0; i < vertices.size(); i += 3) {
-        // Shortcuts for vertices
-        glm::vec3& v0 = vertices[i + 0];
-        glm::vec3& v1 = vertices[i + 1];
-        glm::vec3& v2 = vertices[i + 2];
-
-        // Shortcuts for UVs
-        glm::vec2& uv0 = uvs[i + 0];
-        glm::vec2& uv1 = uvs[i + 1];
-        glm::vec2& uv2 = uvs[i + 2];
-
-        // Edges of the triangle : position delta
-        glm::vec3 deltaPos1 = v1 - v0;
-        glm::vec3 deltaPos2 = v2 - v0;
-
-        // UV delta
-        glm::vec2 deltaUV1 = uv1 - uv0;
-        glm::vec2 deltaUV2 = uv2 - uv0;
-
-        float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-        glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
-        glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
-
-        // Set the same tangent for all three vertices of the triangle.
-        // They will be merged later, in vboindexer.cpp
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
-
-        // Same thing for bitangents
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
-    }
-}
+unsigned int generateBuffer(Mesh &mesh, const std::string &label) {
+    PROFILE_ZONE("generateBuffer");
 
-unsigned int generateBuffer(Mesh &mesh) {
-    unsigned int vaoID;
-    glGenVertexArrays(1, &vaoID);
-    glBindVertexArray(vaoID);
+    MeshBuffers buffers;
+    buffers.vertexArray = createVertexArray(label);
+    unsigned int vaoID = buffers.vertexArray;
+    trackedBindVertexArray(vaoID);
 
-    generateAttribute(0, 3, mesh.vertices, false);
+    buffers.buffers.push_back(generateAttribute(0, 3, mesh.vertices, false, label));
     if (mesh.normals.size() > 0) {
-        generateAttribute(1, 3, mesh.normals, true);
+        buffers.buffers.push_back(generateAttribute(1, 3, mesh.normals, true, label));
     }
     if (mesh.textureCoordinates.size() > 0) {
-        generateAttribute(2, 2, mesh.textureCoordinates, false);
+        buffers.buffers.push_back(generateAttribute(2, 2, mesh.textureCoordinates, false, label));
     }
 
     // Add tangent and bitangent vectors (for normal mapped surfaces)
@@ -81,106 +54,97 @@ unsigned int generateBuffer(Mesh &mesh) {
         computeTangentBasis(mesh.vertices, mesh.textureCoordinates, mesh.normals, tangent, bitangent);
 
         // Tangent attribute
-        generateAttribute(3, 3, tangent, false);
+        buffers.buffers.push_back(generateAttribute(3, 3, tangent, false, label));
         // Bitangent attribute
-        generateAttribute(4, 3, bitangent, false);
+        buffers.buffers.push_back(generateAttribute(4, 3, bitangent, false, label));
     }
 
-    unsigned int indexBufferID;
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    GLBuffer indexBuffer = createBuffer(GPU_MEMORY_INDEX, label + " indices",
+                                        mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), 0);
+    trackedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    buffers.buffers.push_back(std::move(indexBuffer));
 
+    meshBuffers[vaoID] = std::move(buffers);
     return vaoID;
 }
 
-int setUpTexture(PNGImage image) {
-    unsigned int textureID = -1;
-    
+void deleteBuffer(unsigned int vaoID) {
+    meshBuffers.erase(vaoID);
+}
+
+int setUpTexture(PNGImage image, const std::string &label) {
+    PROFILE_ZONE("setUpTexture");
+
     // Generate and populate texture
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height,
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    GLTexture texture = createTexture(GL_TEXTURE_2D, GPU_MEMORY_TEXTURE, label,
+                                      fullMipChainLevels(image.width, image.height), GL_RGBA8, image.width, image.height);
+    glTextureSubImage2D(texture, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    apiCounters.bytesUploaded += uint64_t(image.width) * image.height * 4;
 
     // Anti-aliasing settings
-    glGenerateMipmap(GL_TEXTURE_2D);
+    glGenerateTextureMipmap(texture);
     // -- minification
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
     // -- magnification
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    unsigned int textureID = texture;
+    textures[textureID] = std::move(texture);
+    return textureID;
+}
+
+void deleteTexture(unsigned int textureID) {
+    textures.erase(textureID);
+}
+
+// A window-sized texture attached to the framebuffer, owned until deleteGBuffer()
+static unsigned int createRenderTarget(unsigned int framebufferID, GLenum attachment, GLenum internalFormat, const std::string &label) {
+    GLTexture texture = createTexture(GL_TEXTURE_2D, GPU_MEMORY_RENDER_TARGET, label, 1, internalFormat, windowWidth, windowHeight);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glNamedFramebufferTexture(framebufferID, attachment, texture, 0);
 
+    unsigned int textureID = texture;
+    textures[textureID] = std::move(texture);
     return textureID;
 }
 
 // https://learnopengl.com/Advanced-Lighting/Deferred-Shading
+const GBufferTarget G_BUFFER_TARGETS[G_BUFFER_TARGET_COUNT] = {
+    { "G-buffer color",     GL_COLOR_ATTACHMENT0, GL_RGBA8,   &Framebuffer::colorTexture },
+    { "G-buffer position",  GL_COLOR_ATTACHMENT1, GL_RGBA16F, &Framebuffer::posTexture },
+    { "G-buffer normal",    GL_COLOR_ATTACHMENT2, GL_RGBA16F, &Framebuffer::normalTexture },
+    { "G-buffer stencil",   GL_COLOR_ATTACHMENT3, GL_R8,      &Framebuffer::stencilTexture },
+    { "G-buffer BH normal", GL_COLOR_ATTACHMENT4, GL_RGBA16F, &Framebuffer::bhNormalTexture },
+    // A texture rather than a renderbuffer, so the Hi-Z pyramid can be built from it.
+    // Its stencil holds the checkerboard pattern, see checkerboard.h.
+    { "G-buffer depth",     GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH32F_STENCIL8, &Framebuffer::depthTexture },
+};
+
 Framebuffer initGBuffer() {
-    unsigned int gBufferID;
-    glGenFramebuffers(1, &gBufferID);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBufferID);
-    unsigned int gColor, gPosition, gNormal, gStencil, gBHNormal, gDepth;
-
-    // - color buffer
-    glGenTextures(1, &gColor);
-    glBindTexture(GL_TEXTURE_2D, gColor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gColor, 0);
-
-    // - position color buffer
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gPosition, 0);
-  
-    // - normal color buffer
-    glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gNormal, 0);
-
-    // - stencil texture
-    glGenTextures(1, &gStencil);
-    glBindTexture(GL_TEXTURE_2D, gStencil);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, windowWidth, windowHeight, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, gStencil, 0);
-
-    // - black hole normal buffer
-    glGenTextures(1, &gBHNormal);
-    glBindTexture(GL_TEXTURE_2D, gBHNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, gBHNormal, 0);
-
-    // - depth renderbuffer
-    glGenRenderbuffers(1, &gDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, gDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, windowWidth, windowHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gDepth);
-    
-    // - tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
-    glDrawBuffers(5, attachments);
+    GLFramebuffer gBuffer = createFramebuffer("G-buffer");
+    unsigned int gBufferID = gBuffer;
 
-    // - rebind the default framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
     Framebuffer framebuffer;
-
     framebuffer.fboID = gBufferID;
-    framebuffer.colorTexture = gColor;
-    framebuffer.posTexture = gPosition;
-    framebuffer.normalTexture = gNormal;
-    framebuffer.stencilTexture = gStencil;
-    framebuffer.bhNormalTexture = gBHNormal;
+    for (const GBufferTarget &target : G_BUFFER_TARGETS) {
+        framebuffer.*target.texture = createRenderTarget(gBufferID, target.attachment, target.internalFormat, target.label);
+    }
+
+    // - tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
+    unsigned int attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+    glNamedFramebufferDrawBuffers(gBufferID, 5, attachments);
+
+    framebuffers[gBufferID] = std::move(gBuffer);
 
     return framebuffer;
+}
+
+void deleteGBuffer(Framebuffer &framebuffer) {
+    for (unsigned int textureID : { framebuffer.colorTexture, framebuffer.posTexture, framebuffer.normalTexture,
+                                    framebuffer.stencilTexture, framebuffer.bhNormalTexture, framebuffer.depthTexture }) {
+        deleteTexture(textureID);
+    }
+    framebuffers.erase(framebuffer.fboID);
+    framebuffer = Framebuffer();
 }
\ No newline at end of file
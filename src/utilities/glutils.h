@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include "mesh.h"
 #include "imageLoader.hpp"
 
@@ -10,8 +11,26 @@ typedef struct Framebuffer {
     unsigned int normalTexture;   // Normal attachment texture ID
     unsigned int stencilTexture;  // Stencil attachment texture ID
     unsigned int bhNormalTexture; // BH normal attachment texture ID
+    unsigned int depthTexture;    // Depth attachment texture ID
 } Framebuffer;
 
-unsigned int generateBuffer(Mesh &mesh);
-int setUpTexture(PNGImage image);
-Framebuffer initGBuffer();
\ No newline at end of file
+// One render target of the G-buffer
+struct GBufferTarget {
+    const char* label;
+    unsigned int attachment;              // Framebuffer attachment point, which is also the fragment output for colors
+    unsigned int internalFormat;
+    unsigned int Framebuffer::*texture;   // Where its texture ID is kept
+};
+
+// The G-buffer's targets, in attachment order with the depth last
+const unsigned int G_BUFFER_TARGET_COUNT = 6;
+extern const GBufferTarget G_BUFFER_TARGETS[G_BUFFER_TARGET_COUNT];
+
+// The returned IDs stay valid until they are deleted again. Their memory is counted in gpuResources.h.
+unsigned int generateBuffer(Mesh &mesh, const std::string &label = "Mesh");
+// Also deletes the vertex and index buffers made for the vertex array
+void deleteBuffer(unsigned int vaoID);
+int setUpTexture(PNGImage image, const std::string &label = "Texture");
+void deleteTexture(unsigned int textureID);
+Framebuffer initGBuffer();
+void deleteGBuffer(Framebuffer &framebuffer);
\ No newline at end of file
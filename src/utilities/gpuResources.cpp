@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
+#include "gpuResources.h"
+#include "renderStats.h"
+
+// Allocations listed by name in the memory report
+const unsigned int REPORT_LARGEST_ALLOCATIONS = 8;
+
+const char* GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_CATEGORY_COUNT] = {
+    "Vertex", "Index", "Texture", "Render target", "Uniform", "Storage", "Readback"
+};
+const char* GL_OBJECT_TYPE_NAMES[] = { "buffer", "texture", "framebuffer", "vertex array" };
+
+struct GPUAllocation {
+    GLObjectType type;
+    GLuint name;
+    GPUMemoryCategory category;
+    uint64_t bytes;
+    std::string label;
+};
+
+static std::unordered_map<uint64_t, GPUAllocation> allocations;
+static uint64_t categoryUsage[GPU_MEMORY_CATEGORY_COUNT] = {};
+static uint64_t totalUsage = 0;
+static uint64_t peakUsage = 0;
+static uint64_t budget = 0;
+static bool budgetReported = false;
+
+// Set by checkGPUResourceLeaks(), after which the context may no longer exist
+static bool contextReleased = false;
+
+static uint64_t allocationKey(GLObjectType type, GLuint name) {
+    return (uint64_t(type) << 32) | name;
+}
+
+static std::string formatBytes(uint64_t bytes) {
+    if (bytes >= 1024 * 1024) {
+        return fmt::format("{:.1f} MB", bytes / (1024.0 * 1024.0));
+    }
+    return fmt::format("{:.1f} KB", bytes / 1024.0);
+}
+
+static void registerAllocation(GLObjectType type, GLuint name, GPUMemoryCategory category, uint64_t bytes, const std::string &label) {
+    allocations[allocationKey(type, name)] = { type, name, category, bytes, label };
+    categoryUsage[category] += bytes;
+    totalUsage += bytes;
+    peakUsage = std::max(peakUsage, totalUsage);
+
+    if (budget > 0 && totalUsage > budget && !budgetReported) {
+        fprintf(stderr, "GPU memory budget exceeded by %s (%s): %s of %s in use.\n", label.c_str(),
+                formatBytes(bytes).c_str(), formatBytes(totalUsage).c_str(), formatBytes(budget).c_str());
+        budgetReported = true;
+    }
+}
+
+static void deleteGLObject(GLObjectType type, GLuint name) {
+    if (name == 0 || contextReleased) {
+        return;
+    }
+
+    auto allocation = allocations.find(allocationKey(type, name));
+    if (allocation != allocations.end()) {
+        categoryUsage[allocation->second.category] -= allocation->second.bytes;
+        totalUsage -= allocation->second.bytes;
+        allocations.erase(allocation);
+    }
+
+    switch (type) {
+        case GL_OBJECT_BUFFER: glDeleteBuffers(1, &name); break;
+        case GL_OBJECT_TEXTURE: glDeleteTextures(1, &name); break;
+        case GL_OBJECT_FRAMEBUFFER: glDeleteFramebuffers(1, &name); break;
+        case GL_OBJECT_VERTEX_ARRAY: glDeleteVertexArrays(1, &name); break;
+    }
+}
+
+template <GLObjectType type>
+void GLHandle<type>::reset() {
+    deleteGLObject(type, name);
+    name = 0;
+}
+
+template class GLHandle<GL_OBJECT_BUFFER>;
+template class GLHandle<GL_OBJECT_TEXTURE>;
+template class GLHandle<GL_OBJECT_FRAMEBUFFER>;
+template class GLHandle<GL_OBJECT_VERTEX_ARRAY>;
+
+// Bytes per texel of the sized internal formats used here. Three-component formats are assumed padded to four.
+static unsigned int texelSizeInBytes(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_R8: return 1;
+        case GL_R16F: case GL_RG8: case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGB8: case GL_RGBA8: case GL_RGBA8UI: case GL_SRGB8_ALPHA8: case GL_R32F: case GL_R32UI: case GL_RG16F:
+        case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8: return 4;
+        case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+        case GL_RGB32F: case GL_RGBA32F: return 16;
+    }
+    fprintf(stderr, "Unknown texture format 0x%x; its memory is not counted.\n", internalFormat);
+    return 0;
+}
+
+GLsizei fullMipChainLevels(GLsizei width, GLsizei height) {
+    GLsizei levels = 1;
+    while ((width | height) >> levels) {
+        levels++;
+    }
+    return levels;
+}
+
+GLBuffer createBuffer(GPUMemoryCategory category, const std::string &label, GLsizeiptr size, const void* data, GLbitfield flags) {
+    GLuint name;
+    glCreateBuffers(1, &name);
+    glNamedBufferStorage(name, size, data, flags);
+    if (data != nullptr) {
+        apiCounters.bytesUploaded += size;
+    }
+
+    registerAllocation(GL_OBJECT_BUFFER, name, category, uint64_t(size), label);
+    return GLBuffer(name);
+}
+
+GLTexture createTexture(GLenum target, GPUMemoryCategory category, const std::string &label,
+                        GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth) {
+    GLuint name;
+    glCreateTextures(target, 1, &name);
+    if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP) {
+        glTextureStorage2D(name, levels, internalFormat, width, height);
+    } else {
+        glTextureStorage3D(name, levels, internalFormat, width, height, depth);
+    }
+
+    // Array layers, including the six faces of every cube, are not shrunk by the mip chain
+    uint64_t layers = (target == GL_TEXTURE_CUBE_MAP) ? 6 : uint64_t(depth);
+    uint64_t texels = 0;
+    for (GLsizei level = 0; level < levels; level++) {
+        texels += uint64_t(std::max(width >> level, 1)) * std::max(height >> level, 1) * layers;
+    }
+
+    registerAllocation(GL_OBJECT_TEXTURE, name, category, texels * texelSizeInBytes(internalFormat), label);
+    return GLTexture(name);
+}
+
+GLFramebuffer createFramebuffer(const std::string &label) {
+    GLuint name;
+    glCreateFramebuffers(1, &name);
+
+    registerAllocation(GL_OBJECT_FRAMEBUFFER, name, GPU_MEMORY_RENDER_TARGET, 0, label);
+    return GLFramebuffer(name);
+}
+
+GLVertexArray createVertexArray(const std::string &label) {
+    GLuint name;
+    glCreateVertexArrays(1, &name);
+
+    registerAllocation(GL_OBJECT_VERTEX_ARRAY, name, GPU_MEMORY_VERTEX, 0, label);
+    return GLVertexArray(name);
+}
+
+uint64_t getGPUMemoryUsage(GPUMemoryCategory category) {
+    return categoryUsage[category];
+}
+
+uint64_t getTotalGPUMemoryUsage() {
+    return totalUsage;
+}
+
+uint64_t getPeakGPUMemoryUsage() {
+    return peakUsage;
+}
+
+void setGPUMemoryBudget(uint64_t bytes) {
+    budget = bytes;
+    budgetReported = false;
+}
+
+bool isOverGPUMemoryBudget() {
+    return budget > 0 && totalUsage > budget;
+}
+
+std::string formatGPUMemoryReport() {
+    std::string text = fmt::format("GPU memory: {} in {} objects (peak {}", formatBytes(totalUsage),
+                                   allocations.size(), formatBytes(peakUsage));
+    if (budget > 0) {
+        text += fmt::format(", budget {}", formatBytes(budget));
+    }
+    text += ")\n";
+
+    for (unsigned int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++) {
+        text += fmt::format("  {:<14} {:>10}\n", GPU_MEMORY_CATEGORY_NAMES[category], formatBytes(categoryUsage[category]));
+    }
+
+    std::vector<const GPUAllocation*> largest;
+    for (const auto &entry : allocations) {
+        largest.push_back(&entry.second);
+    }
+    unsigned int listed = std::min<unsigned int>(REPORT_LARGEST_ALLOCATIONS, largest.size());
+    std::partial_sort(largest.begin(), largest.begin() + listed, largest.end(),
+                      [](const GPUAllocation* a, const GPUAllocation* b) { return a->bytes > b->bytes; });
+
+    text += "  Largest:\n";
+    for (unsigned int i = 0; i < listed; i++) {
+        text += fmt::format("    {:>10}  {} ({})\n", formatBytes(largest[i]->bytes), largest[i]->label,
+                            GPU_MEMORY_CATEGORY_NAMES[largest[i]->category]);
+    }
+
+    return text;
+}
+
+std::string formatGPUMemorySummary() {
+    return fmt::format("VRAM {}: vertex {}, index {}, textures {}, targets {}", formatBytes(totalUsage),
+                       formatBytes(categoryUsage[GPU_MEMORY_VERTEX]), formatBytes(categoryUsage[GPU_MEMORY_INDEX]),
+                       formatBytes(categoryUsage[GPU_MEMORY_TEXTURE]), formatBytes(categoryUsage[GPU_MEMORY_RENDER_TARGET]));
+}
+
+unsigned int checkGPUResourceLeaks() {
+    for (const auto &entry : allocations) {
+        const GPUAllocation &allocation = entry.second;
+        fprintf(stderr, "Leaked %s %u: %s (%s, %s)\n", GL_OBJECT_TYPE_NAMES[allocation.type], allocation.name,
+                allocation.label.c_str(), GPU_MEMORY_CATEGORY_NAMES[allocation.category], formatBytes(allocation.bytes).c_str());
+    }
+
+    unsigned int leaks = allocations.size();
+    if (leaks == 0) {
+        printf("All GPU resources were released (peak usage %s).\n", formatBytes(peakUsage).c_str());
+    }
+
+    contextReleased = true;
+    return leaks;
+}
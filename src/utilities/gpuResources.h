@@ -0,0 +1,92 @@
+#pragma once
+
+// System headers
+#include <glad/glad.h>
+
+// Standard headers
+#include <cstdint>
+#include <string>
+
+// What an allocation is used for, as listed in the memory report
+enum GPUMemoryCategory {
+    GPU_MEMORY_VERTEX,         // Vertex attributes and instance data
+    GPU_MEMORY_INDEX,          // Index buffers
+    GPU_MEMORY_TEXTURE,        // Sampled textures loaded from disk
+    GPU_MEMORY_RENDER_TARGET,  // Textures rendered into: the G-buffer, shadow maps, the Hi-Z pyramid
+    GPU_MEMORY_UNIFORM,        // Uniform rings
+    GPU_MEMORY_STORAGE,        // Buffers written by compute shaders, including indirect draw commands
+    GPU_MEMORY_READBACK,       // Buffers the CPU reads results from
+    GPU_MEMORY_CATEGORY_COUNT
+};
+
+enum GLObjectType {
+    GL_OBJECT_BUFFER, GL_OBJECT_TEXTURE, GL_OBJECT_FRAMEBUFFER, GL_OBJECT_VERTEX_ARRAY
+};
+
+// Every buffer, texture, framebuffer and vertex array created through this file is recorded in a
+// central registry with its size in bytes, until it is deleted again. Framebuffers and vertex arrays
+// hold no memory of their own, but are recorded so they show up in the leak check.
+// Sizes are computed from the requested storage, so they are a lower bound on what the driver allocates.
+
+// Owns one GL object, deleting it and removing it from the registry when destroyed. Move-only.
+// Converts to the object name, so it can be passed straight to GL functions.
+template <GLObjectType type>
+class GLHandle {
+public:
+    GLHandle() = default;
+    explicit GLHandle(GLuint name) : name(name) {}
+    GLHandle(GLHandle &&other) noexcept : name(other.name) { other.name = 0; }
+    GLHandle &operator=(GLHandle &&other) noexcept {
+        if (this != &other) {
+            reset();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+    ~GLHandle() { reset(); }
+
+    void reset();
+    GLuint get() const { return name; }
+    operator GLuint() const { return name; }
+
+private:
+    GLuint name = 0;
+};
+
+using GLBuffer      = GLHandle<GL_OBJECT_BUFFER>;
+using GLTexture     = GLHandle<GL_OBJECT_TEXTURE>;
+using GLFramebuffer = GLHandle<GL_OBJECT_FRAMEBUFFER>;
+using GLVertexArray = GLHandle<GL_OBJECT_VERTEX_ARRAY>;
+
+// Immutable buffer storage (glNamedBufferStorage), optionally filled with data
+GLBuffer createBuffer(GPUMemoryCategory category, const std::string &label, GLsizeiptr size, const void* data, GLbitfield flags);
+// Immutable texture storage (glTextureStorage2D/3D). Depth is the layer count of array textures, 1 otherwise.
+GLTexture createTexture(GLenum target, GPUMemoryCategory category, const std::string &label,
+                        GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth = 1);
+GLFramebuffer createFramebuffer(const std::string &label);
+GLVertexArray createVertexArray(const std::string &label);
+
+// Mip levels of a full chain down to 1x1
+GLsizei fullMipChainLevels(GLsizei width, GLsizei height);
+
+// Bytes held in one category, or in all of them
+uint64_t getGPUMemoryUsage(GPUMemoryCategory category);
+uint64_t getTotalGPUMemoryUsage();
+uint64_t getPeakGPUMemoryUsage();
+
+// Allocations pushing the total over the budget are reported as errors. 0 means no budget.
+void setGPUMemoryBudget(uint64_t bytes);
+bool isOverGPUMemoryBudget();
+
+// Totals per category, followed by the largest allocations
+std::string formatGPUMemoryReport();
+// One line, for the on-screen overlay
+std::string formatGPUMemorySummary();
+
+// Call once everything has been deleted, before the context is destroyed.
+// Lists whatever is still registered, and returns the number of leaked objects.
+// Handles destroyed after this point no longer touch GL, as the context may be gone.
+unsigned int checkGPUResourceLeaks();
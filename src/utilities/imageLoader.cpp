@@ -1,16 +1,29 @@
 #include "imageLoader.hpp"
 #include <iostream>
+#include "profiler.h"
 
 // Original source: https://raw.githubusercontent.com/lvandeve/lodepng/master/examples/example_decode.cpp
 PNGImage loadPNGFile(std::string fileName)
 {
+	PROFILE_ZONE("loadPNGFile");
+
 	std::vector<unsigned char> png;
-	std::vector<unsigned char> pixels; //the raw pixels
-	unsigned int width, height;
 
 	//load and decode
 	unsigned error = lodepng::load_file(png, fileName);
-	if(!error) error = lodepng::decode(pixels, width, height, png);
+	if(error) std::cout << "decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
+
+	return decodePNGImage(png);
+}
+
+PNGImage decodePNGImage(const std::vector<unsigned char> &png)
+{
+	PROFILE_ZONE("decodePNGImage");
+
+	std::vector<unsigned char> pixels; //the raw pixels
+	unsigned int width = 0, height = 0;
+
+	unsigned error = lodepng::decode(pixels, width, height, png);
 
 	//if there's an error, display it
 	if(error) std::cout << "decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
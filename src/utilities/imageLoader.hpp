@@ -11,3 +11,5 @@ typedef struct PNGImage {
 } PNGImage;
 
 PNGImage loadPNGFile(std::string fileName);
+// Decodes a PNG file already read into memory, flipped so its first row is the bottom one
+PNGImage decodePNGImage(const std::vector<unsigned char> &png);
@@ -0,0 +1,45 @@
+#include "mappedRing.h"
+
+// Nanoseconds to wait for a fence before checking again
+const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+void* createMappedRing(GLBuffer &buffer, GPUMemoryCategory category, const std::string &label, GLsizeiptr sectionSize) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = MAPPED_RING_FRAMES * sectionSize;
+    buffer = createBuffer(category, label, size, nullptr, flags);
+    return glMapNamedBufferRange(buffer, 0, size, flags);
+}
+
+void MappedRingFences::waitForCurrentSection() {
+    GLsync &fence = fences[section];
+    if (fence == nullptr) {
+        return;
+    }
+
+    // Only the first wait flushes, so the fence is sure to be submitted
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum status = glClientWaitSync(fence, waitFlags, FENCE_WAIT_TIMEOUT);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED) {
+            break;
+        }
+        waitFlags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void MappedRingFences::fenceCurrentSection() {
+    fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    section = (section + 1) % MAPPED_RING_FRAMES;
+}
+
+void MappedRingFences::reset() {
+    for (GLsync &fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    section = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include "gpuResources.h"
+
+// Per-frame data streamed to the GPU through persistently mapped rings. The CPU writes one section of a ring
+// while the GPU may still be reading the sections of the frames before it, and a fence per section tells
+// when it is safe to overwrite again. Several rings written in the same frames can share one set of fences.
+
+const unsigned int MAPPED_RING_FRAMES = 3;
+
+// Creates a buffer holding MAPPED_RING_FRAMES sections of sectionSize bytes, and returns its mapping.
+// The mapping is coherent, so writes through it are visible to the GPU without explicit flushes. It is
+// write-combined, so it should be written front to back and never read. Deleting the buffer unmaps it.
+void* createMappedRing(GLBuffer &buffer, GPUMemoryCategory category, const std::string &label, GLsizeiptr sectionSize);
+
+class MappedRingFences {
+public:
+    // The section the CPU writes this frame
+    unsigned int currentSection() const { return section; }
+
+    // Waits until the GPU is done with the current section, before it is overwritten
+    void waitForCurrentSection();
+    // Fences the commands reading the current section and moves on to the next one
+    void fenceCurrentSection();
+    // Deletes the fences, before the context is destroyed
+    void reset();
+
+private:
+    GLsync fences[MAPPED_RING_FRAMES] = {};
+    unsigned int section = 0;
+};
@@ -0,0 +1,274 @@
+#include <cmath>
+#include "cpuFeatures.h"
+#include "matrixKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MATRIX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC accepts every intrinsic without changing the target architecture
+#define MATRIX_TARGET_SSE
+#define MATRIX_TARGET_AVX2
+#else
+#define MATRIX_TARGET_SSE __attribute__((target("sse2")))
+#define MATRIX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+const char* matrixKernelName(MatrixKernel kernel) {
+    switch (kernel) {
+        case MATRIX_KERNEL_GLM: return "glm";
+        case MATRIX_KERNEL_SSE: return "SSE";
+        case MATRIX_KERNEL_AVX2: return "AVX2";
+    }
+    return "unknown";
+}
+
+bool isMatrixKernelSupported(MatrixKernel kernel) {
+    switch (kernel) {
+        case MATRIX_KERNEL_GLM:
+            return true;
+        case MATRIX_KERNEL_SSE:
+            return cpuSupportsSSE2();
+        case MATRIX_KERNEL_AVX2:
+            return cpuSupportsAVX2();
+    }
+    return false;
+}
+
+MatrixKernel bestMatrixKernel() {
+    static const MatrixKernel best = isMatrixKernelSupported(MATRIX_KERNEL_AVX2) ? MATRIX_KERNEL_AVX2
+                                   : isMatrixKernelSupported(MATRIX_KERNEL_SSE) ? MATRIX_KERNEL_SSE
+                                   : MATRIX_KERNEL_GLM;
+    return best;
+}
+
+void composeTransforms(const TransformComponents* components, glm::mat4* matrices, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const TransformComponents &transform = components[i];
+        float sinX = std::sin(transform.rotation.x), cosX = std::cos(transform.rotation.x);
+        float sinY = std::sin(transform.rotation.y), cosY = std::cos(transform.rotation.y);
+        float sinZ = std::sin(transform.rotation.z), cosZ = std::cos(transform.rotation.z);
+
+        // Columns of rotateY * rotateX * rotateZ, each scaled along its own axis
+        glm::vec3 column0 = glm::vec3(cosY * cosZ + sinY * sinX * sinZ, cosX * sinZ, cosY * sinX * sinZ - sinY * cosZ) * transform.scale.x;
+        glm::vec3 column1 = glm::vec3(sinY * sinX * cosZ - cosY * sinZ, cosX * cosZ, sinY * sinZ + cosY * sinX * cosZ) * transform.scale.y;
+        glm::vec3 column2 = glm::vec3(sinY * cosX, -sinX, cosY * cosX) * transform.scale.z;
+
+        // The reference point is the one point the rotation and scale leave in place
+        glm::vec3 translation = transform.position + transform.referencePoint
+                              - (column0 * transform.referencePoint.x + column1 * transform.referencePoint.y
+                                 + column2 * transform.referencePoint.z);
+
+        matrices[i] = glm::mat4(glm::vec4(column0, 0.0f), glm::vec4(column1, 0.0f), glm::vec4(column2, 0.0f),
+                                glm::vec4(translation, 1.0f));
+    }
+}
+
+static void normalMatrixGLM(const glm::mat4 &matrix, NormalMatrix &normalMatrix) {
+    glm::vec3 a(matrix[0]), b(matrix[1]), c(matrix[2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float inverseDeterminant = 1.0f / glm::dot(a, bc);
+
+    normalMatrix.columns[0] = glm::vec4(bc * inverseDeterminant, 0.0f);
+    normalMatrix.columns[1] = glm::vec4(glm::cross(c, a) * inverseDeterminant, 0.0f);
+    normalMatrix.columns[2] = glm::vec4(glm::cross(a, b) * inverseDeterminant, 0.0f);
+}
+
+#ifdef MATRIX_X86
+
+// Every column of the product is a sum of the left matrix's columns, weighted by one column of the right matrix
+MATRIX_TARGET_SSE
+static inline void multiplySSE(__m128 left0, __m128 left1, __m128 left2, __m128 left3, const float* right, float* product) {
+    for (int column = 0; column < 4; column++) {
+        const float* weights = right + 4 * column;
+        __m128 result = _mm_mul_ps(left0, _mm_set1_ps(weights[0]));
+        result = _mm_add_ps(result, _mm_mul_ps(left1, _mm_set1_ps(weights[1])));
+        result = _mm_add_ps(result, _mm_mul_ps(left2, _mm_set1_ps(weights[2])));
+        result = _mm_add_ps(result, _mm_mul_ps(left3, _mm_set1_ps(weights[3])));
+        _mm_storeu_ps(product + 4 * column, result);
+    }
+}
+
+// Two columns of the product at a time, the left matrix's columns repeated in both halves
+MATRIX_TARGET_AVX2
+static inline void multiplyAVX2(__m256 left0, __m256 left1, __m256 left2, __m256 left3, const float* right, float* product) {
+    for (int column = 0; column < 4; column += 2) {
+        __m256 weights = _mm256_loadu_ps(right + 4 * column);
+        __m256 result = _mm256_mul_ps(left0, _mm256_permute_ps(weights, 0x00));
+        result = _mm256_fmadd_ps(left1, _mm256_permute_ps(weights, 0x55), result);
+        result = _mm256_fmadd_ps(left2, _mm256_permute_ps(weights, 0xAA), result);
+        result = _mm256_fmadd_ps(left3, _mm256_permute_ps(weights, 0xFF), result);
+        _mm256_storeu_ps(product + 4 * column, result);
+    }
+}
+
+MATRIX_TARGET_SSE
+static void transformHierarchySSE(const int* parents, const glm::mat4* local, glm::mat4* world, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (parents[i] < 0) {
+            world[i] = local[i];
+            continue;
+        }
+        const float* parent = &world[parents[i]][0][0];
+        multiplySSE(_mm_loadu_ps(parent), _mm_loadu_ps(parent + 4), _mm_loadu_ps(parent + 8), _mm_loadu_ps(parent + 12),
+                    &local[i][0][0], &world[i][0][0]);
+    }
+}
+
+MATRIX_TARGET_AVX2
+static void transformHierarchyAVX2(const int* parents, const glm::mat4* local, glm::mat4* world, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (parents[i] < 0) {
+            world[i] = local[i];
+            continue;
+        }
+        const __m128* parent = reinterpret_cast<const __m128*>(&world[parents[i]][0][0]);
+        multiplyAVX2(_mm256_broadcast_ps(parent), _mm256_broadcast_ps(parent + 1), _mm256_broadcast_ps(parent + 2),
+                     _mm256_broadcast_ps(parent + 3), &local[i][0][0], &world[i][0][0]);
+    }
+}
+
+MATRIX_TARGET_SSE
+static void multiplyMatricesSSE(const glm::mat4 &left, const glm::mat4* right, glm::mat4* products, size_t count) {
+    const float* columns = &left[0][0];
+    __m128 left0 = _mm_loadu_ps(columns), left1 = _mm_loadu_ps(columns + 4);
+    __m128 left2 = _mm_loadu_ps(columns + 8), left3 = _mm_loadu_ps(columns + 12);
+
+    for (size_t i = 0; i < count; i++) {
+        multiplySSE(left0, left1, left2, left3, &right[i][0][0], &products[i][0][0]);
+    }
+}
+
+MATRIX_TARGET_AVX2
+static void multiplyMatricesAVX2(const glm::mat4 &left, const glm::mat4* right, glm::mat4* products, size_t count) {
+    const __m128* columns = reinterpret_cast<const __m128*>(&left[0][0]);
+    __m256 left0 = _mm256_broadcast_ps(columns), left1 = _mm256_broadcast_ps(columns + 1);
+    __m256 left2 = _mm256_broadcast_ps(columns + 2), left3 = _mm256_broadcast_ps(columns + 3);
+
+    for (size_t i = 0; i < count; i++) {
+        multiplyAVX2(left0, left1, left2, left3, &right[i][0][0], &products[i][0][0]);
+    }
+}
+
+// a * b.yzx - a.yzx * b gives the cross product in zxy order. The w lanes cancel out to 0.
+MATRIX_TARGET_SSE
+static inline __m128 crossSSE(__m128 a, __m128 b) {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 crossZXY = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(crossZXY, crossZXY, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// The sum of all four lanes, in every lane
+MATRIX_TARGET_SSE
+static inline __m128 horizontalSumSSE(__m128 value) {
+    __m128 pairs = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+MATRIX_TARGET_SSE
+static void computeNormalMatricesSSE(const glm::mat4* matrices, NormalMatrix* normalMatrices, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const float* columns = &matrices[i][0][0];
+        __m128 a = _mm_loadu_ps(columns), b = _mm_loadu_ps(columns + 4), c = _mm_loadu_ps(columns + 8);
+
+        __m128 bc = crossSSE(b, c);
+        __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), horizontalSumSSE(_mm_mul_ps(a, bc)));
+
+        float* normal = &normalMatrices[i].columns[0][0];
+        _mm_storeu_ps(normal, _mm_mul_ps(bc, inverseDeterminant));
+        _mm_storeu_ps(normal + 4, _mm_mul_ps(crossSSE(c, a), inverseDeterminant));
+        _mm_storeu_ps(normal + 8, _mm_mul_ps(crossSSE(a, b), inverseDeterminant));
+    }
+}
+
+// The same as crossSSE() and horizontalSumSSE(), on two matrices at once, one in each half
+MATRIX_TARGET_AVX2
+static inline __m256 crossAVX2(__m256 a, __m256 b) {
+    __m256 aYZX = _mm256_permute_ps(a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m256 bYZX = _mm256_permute_ps(b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m256 crossZXY = _mm256_fmsub_ps(a, bYZX, _mm256_mul_ps(aYZX, b));
+    return _mm256_permute_ps(crossZXY, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+MATRIX_TARGET_AVX2
+static inline __m256 horizontalSumAVX2(__m256 value) {
+    __m256 pairs = _mm256_add_ps(value, _mm256_permute_ps(value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm256_add_ps(pairs, _mm256_permute_ps(pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+MATRIX_TARGET_AVX2
+static inline __m256 loadColumnPairAVX2(const glm::mat4 &first, const glm::mat4 &second, int column) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&first[column][0])), _mm_loadu_ps(&second[column][0]), 1);
+}
+
+MATRIX_TARGET_AVX2
+static inline void storeColumnPairAVX2(NormalMatrix &first, NormalMatrix &second, int column, __m256 value) {
+    _mm_storeu_ps(&first.columns[column][0], _mm256_castps256_ps128(value));
+    _mm_storeu_ps(&second.columns[column][0], _mm256_extractf128_ps(value, 1));
+}
+
+MATRIX_TARGET_AVX2
+static void computeNormalMatricesAVX2(const glm::mat4* matrices, NormalMatrix* normalMatrices, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256 a = loadColumnPairAVX2(matrices[i], matrices[i + 1], 0);
+        __m256 b = loadColumnPairAVX2(matrices[i], matrices[i + 1], 1);
+        __m256 c = loadColumnPairAVX2(matrices[i], matrices[i + 1], 2);
+
+        __m256 bc = crossAVX2(b, c);
+        __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), horizontalSumAVX2(_mm256_mul_ps(a, bc)));
+
+        storeColumnPairAVX2(normalMatrices[i], normalMatrices[i + 1], 0, _mm256_mul_ps(bc, inverseDeterminant));
+        storeColumnPairAVX2(normalMatrices[i], normalMatrices[i + 1], 1, _mm256_mul_ps(crossAVX2(c, a), inverseDeterminant));
+        storeColumnPairAVX2(normalMatrices[i], normalMatrices[i + 1], 2, _mm256_mul_ps(crossAVX2(a, b), inverseDeterminant));
+    }
+
+    // An odd matrix out
+    computeNormalMatricesSSE(matrices + i, normalMatrices + i, count - i);
+}
+
+#endif
+
+void transformHierarchy(const int* parents, const glm::mat4* local, glm::mat4* world, size_t count, MatrixKernel kernel) {
+    switch (kernel) {
+#ifdef MATRIX_X86
+        case MATRIX_KERNEL_SSE: transformHierarchySSE(parents, local, world, count); return;
+        case MATRIX_KERNEL_AVX2: transformHierarchyAVX2(parents, local, world, count); return;
+#endif
+        default: break;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        world[i] = (parents[i] < 0) ? local[i] : world[parents[i]] * local[i];
+    }
+}
+
+void multiplyMatrices(const glm::mat4 &left, const glm::mat4* right, glm::mat4* products, size_t count, MatrixKernel kernel) {
+    switch (kernel) {
+#ifdef MATRIX_X86
+        case MATRIX_KERNEL_SSE: multiplyMatricesSSE(left, right, products, count); return;
+        case MATRIX_KERNEL_AVX2: multiplyMatricesAVX2(left, right, products, count); return;
+#endif
+        default: break;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        products[i] = left * right[i];
+    }
+}
+
+void computeNormalMatrices(const glm::mat4* matrices, NormalMatrix* normalMatrices, size_t count, MatrixKernel kernel) {
+    switch (kernel) {
+#ifdef MATRIX_X86
+        case MATRIX_KERNEL_SSE: computeNormalMatricesSSE(matrices, normalMatrices, count); return;
+        case MATRIX_KERNEL_AVX2: computeNormalMatricesAVX2(matrices, normalMatrices, count); return;
+#endif
+        default: break;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        normalMatrixGLM(matrices[i], normalMatrices[i]);
+    }
+}
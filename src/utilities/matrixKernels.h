@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Batched matrix operations on arrays of scene nodes. The SIMD kernels are picked at runtime, if the CPU has them.
+// The glm kernel runs everywhere, and gives the same results up to rounding.
+// Matrices are glm's column-major mat4, so the arrays can be used with glm directly.
+enum MatrixKernel {
+    MATRIX_KERNEL_GLM, MATRIX_KERNEL_SSE, MATRIX_KERNEL_AVX2
+};
+
+const char* matrixKernelName(MatrixKernel kernel);
+bool isMatrixKernelSupported(MatrixKernel kernel);
+MatrixKernel bestMatrixKernel();
+
+// A node's transformation relative to its parent, as stored in SceneNode
+struct TransformComponents {
+    glm::vec3 position;
+    glm::vec3 referencePoint;
+    glm::vec3 rotation;  // Radians about each axis, applied in the order Z, X, Y
+    glm::vec3 scale;
+};
+
+// A mat3 stored as three vec4 columns, as in ObjectUniforms
+struct NormalMatrix {
+    glm::vec4 columns[3];
+};
+
+// translate(position + referencePoint) * rotateY * rotateX * rotateZ * scale(scale) * translate(-referencePoint),
+// written out directly instead of multiplying seven matrices. The sines and cosines take most of the time,
+// so every kernel shares this one.
+void composeTransforms(const TransformComponents* components, glm::mat4* matrices, size_t count);
+
+// world[i] = world[parents[i]] * local[i], or just local[i] where parents[i] is -1.
+// Parents must come before their children, as in a depth-first traversal.
+void transformHierarchy(const int* parents, const glm::mat4* local, glm::mat4* world, size_t count, MatrixKernel kernel);
+
+// products[i] = left * right[i], e.g. the view-projection times every model matrix
+void multiplyMatrices(const glm::mat4 &left, const glm::mat4* right, glm::mat4* products, size_t count, MatrixKernel kernel);
+
+// transpose(inverse(mat3(matrices[i]))), from the cross products of the columns rather than a full 4x4 inverse
+void computeNormalMatrices(const glm::mat4* matrices, NormalMatrix* normalMatrices, size_t count, MatrixKernel kernel);
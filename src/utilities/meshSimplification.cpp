@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include "meshSimplification.h"
+
+// Border edges get an extra plane quadric with this weight, so mesh outlines are kept in place
+const double BORDER_WEIGHT = 1000.0;
+
+// A collapse is rejected if it turns any remaining triangle further than this (cosine of the angle)
+const float MAX_NORMAL_CHANGE = 0.2f;
+
+namespace {
+
+// Symmetric 4x4 matrix summing the squared distances to a set of planes (Garland & Heckbert)
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    Quadric() {}
+
+    // Quadric of the plane dot(normal, p) + d = 0
+    Quadric(glm::vec3 normal, float d, double weight) {
+        double a = normal.x, b = normal.y, c = normal.z;
+        a2 = weight * a * a; ab = weight * a * b; ac = weight * a * c; ad = weight * a * d;
+        b2 = weight * b * b; bc = weight * b * c; bd = weight * b * d;
+        c2 = weight * c * c; cd = weight * c * d;
+        d2 = weight * d * d;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+        b2 += other.b2; bc += other.bc; bd += other.bd;
+        c2 += other.c2; cd += other.cd;
+        d2 += other.d2;
+        return *this;
+    }
+
+    // Sum of squared distances from the point to every plane in the quadric
+    double evaluate(glm::vec3 p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z
+             + d2;
+    }
+};
+
+// Moving vertex "from" onto vertex "to". The versions detect entries made stale by later collapses.
+struct EdgeCollapse {
+    double cost;
+    unsigned int from;
+    unsigned int to;
+    unsigned int fromVersion;
+    unsigned int toVersion;
+
+    bool operator>(const EdgeCollapse &other) const { return cost > other.cost; }
+};
+
+}
+
+Mesh simplifyMesh(const Mesh &mesh, float targetRatio) {
+    bool hasNormals = mesh.normals.size() == mesh.vertices.size();
+    bool hasUVs = mesh.textureCoordinates.size() == mesh.vertices.size();
+
+    // Weld corners sharing a position, normal and UV, since every triangle comes with its own three vertices.
+    // Corners that only share a position lie on a UV seam or hard edge, and stay separate vertices.
+    std::map<std::array<float, 8>, unsigned int> vertexIDs;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<std::array<unsigned int, 3>> triangles;
+
+    for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        std::array<unsigned int, 3> triangle;
+
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int index = mesh.indices.at(i + corner);
+            glm::vec3 position = mesh.vertices.at(index);
+            glm::vec3 normal = hasNormals ? mesh.normals.at(index) : glm::vec3(0);
+            glm::vec2 uv = hasUVs ? mesh.textureCoordinates.at(index) : glm::vec2(0);
+            std::array<float, 8> key = {{ position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y }};
+
+            auto existing = vertexIDs.find(key);
+            if (existing == vertexIDs.end()) {
+                existing = vertexIDs.emplace(key, positions.size()).first;
+                positions.push_back(position);
+                normals.push_back(normal);
+                uvs.push_back(uv);
+            }
+            triangle[corner] = existing->second;
+        }
+
+        // Welding can leave zero-area triangles behind (e.g. at sphere poles)
+        if (triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[0] != triangle[2]) {
+            triangles.push_back(triangle);
+        }
+    }
+
+    unsigned int vertexCount = positions.size();
+
+    // Seam vertices are never moved, since their twins on the other side of the seam would stay behind and open a crack
+    std::map<std::array<float, 3>, unsigned int> positionUses;
+    for (glm::vec3 position : positions) {
+        positionUses[{{ position.x, position.y, position.z }}]++;
+    }
+    std::vector<bool> seamVertex(vertexCount);
+    for (unsigned int vertex = 0; vertex < vertexCount; vertex++) {
+        glm::vec3 position = positions.at(vertex);
+        seamVertex.at(vertex) = positionUses.at({{ position.x, position.y, position.z }}) > 1;
+    }
+
+    std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+
+    for (unsigned int t = 0; t < triangles.size(); t++) {
+        const std::array<unsigned int, 3> &triangle = triangles.at(t);
+        glm::vec3 p0 = positions.at(triangle[0]);
+        glm::vec3 cross = glm::cross(positions.at(triangle[1]) - p0, positions.at(triangle[2]) - p0);
+        float doubleArea = glm::length(cross);
+
+        for (int corner = 0; corner < 3; corner++) {
+            vertexTriangles.at(triangle[corner]).push_back(t);
+
+            unsigned int a = triangle[corner];
+            unsigned int b = triangle[(corner + 1) % 3];
+            edgeUses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+        }
+
+        if (doubleArea > 0.0f) {
+            glm::vec3 normal = cross / doubleArea;
+            Quadric plane(normal, -glm::dot(normal, p0), 0.5 * doubleArea);
+            for (int corner = 0; corner < 3; corner++) {
+                quadrics.at(triangle[corner]) += plane;
+            }
+        }
+    }
+
+    // Constrain border edges with a plane perpendicular to their triangle
+    for (const std::array<unsigned int, 3> &triangle : triangles) {
+        glm::vec3 p0 = positions.at(triangle[0]);
+        glm::vec3 faceNormal = glm::cross(positions.at(triangle[1]) - p0, positions.at(triangle[2]) - p0);
+
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int a = triangle[corner];
+            unsigned int b = triangle[(corner + 1) % 3];
+            if (edgeUses.at(std::make_pair(std::min(a, b), std::max(a, b))) != 1) {
+                continue;
+            }
+
+            glm::vec3 edge = positions.at(b) - positions.at(a);
+            glm::vec3 borderNormal = glm::cross(edge, faceNormal);
+            if (glm::length(borderNormal) == 0.0f) {
+                continue;
+            }
+            borderNormal = glm::normalize(borderNormal);
+
+            Quadric border(borderNormal, -glm::dot(borderNormal, positions.at(a)), BORDER_WEIGHT * glm::dot(edge, edge));
+            quadrics.at(a) += border;
+            quadrics.at(b) += border;
+        }
+    }
+
+    std::vector<bool> vertexAlive(vertexCount, true);
+    std::vector<unsigned int> vertexVersions(vertexCount, 0);
+    std::vector<bool> triangleAlive(triangles.size(), true);
+    std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, std::greater<EdgeCollapse>> collapses;
+
+    // Queue the cheaper direction of collapsing the edge between a and b that leaves seam vertices in place
+    auto queueEdge = [&](unsigned int a, unsigned int b) {
+        if (seamVertex.at(a) && seamVertex.at(b)) {
+            return;
+        }
+
+        Quadric combined = quadrics.at(a);
+        combined += quadrics.at(b);
+
+        double costOntoB = combined.evaluate(positions.at(b));
+        double costOntoA = combined.evaluate(positions.at(a));
+
+        if (seamVertex.at(b) || (!seamVertex.at(a) && costOntoB <= costOntoA)) {
+            collapses.push({costOntoB, a, b, vertexVersions.at(a), vertexVersions.at(b)});
+        } else {
+            collapses.push({costOntoA, b, a, vertexVersions.at(b), vertexVersions.at(a)});
+        }
+    };
+
+    for (const auto &edge : edgeUses) {
+        queueEdge(edge.first.first, edge.first.second);
+    }
+
+    // Moving "from" onto "to" must not fold any of the triangles that survive the collapse
+    auto collapseFlipsTriangle = [&](unsigned int from, unsigned int to) {
+        for (unsigned int t : vertexTriangles.at(from)) {
+            const std::array<unsigned int, 3> &triangle = triangles.at(t);
+            if (!triangleAlive.at(t) || std::find(triangle.begin(), triangle.end(), to) != triangle.end()) {
+                continue;
+            }
+
+            glm::vec3 corners[3];
+            for (int corner = 0; corner < 3; corner++) {
+                corners[corner] = positions.at(triangle[corner]);
+            }
+            glm::vec3 normalBefore = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+            for (int corner = 0; corner < 3; corner++) {
+                if (triangle[corner] == from) {
+                    corners[corner] = positions.at(to);
+                }
+            }
+            glm::vec3 normalAfter = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+            float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+            if (lengths == 0.0f || glm::dot(normalBefore, normalAfter) < MAX_NORMAL_CHANGE * lengths) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t liveTriangles = triangles.size();
+    size_t targetTriangles = std::max<size_t>(1, size_t(float(triangles.size()) * targetRatio));
+
+    while (liveTriangles > targetTriangles && !collapses.empty()) {
+        EdgeCollapse collapse = collapses.top();
+        collapses.pop();
+
+        unsigned int from = collapse.from;
+        unsigned int to = collapse.to;
+
+        if (!vertexAlive.at(from) || !vertexAlive.at(to)
+            || collapse.fromVersion != vertexVersions.at(from)
+            || collapse.toVersion != vertexVersions.at(to)) {
+            continue;
+        }
+        if (collapseFlipsTriangle(from, to)) {
+            continue;
+        }
+
+        // Triangles along the edge disappear, the rest of from's triangles are moved over to "to"
+        for (unsigned int t : vertexTriangles.at(from)) {
+            if (!triangleAlive.at(t)) {
+                continue;
+            }
+
+            std::array<unsigned int, 3> &triangle = triangles.at(t);
+            if (std::find(triangle.begin(), triangle.end(), to) != triangle.end()) {
+                triangleAlive.at(t) = false;
+                liveTriangles--;
+                continue;
+            }
+
+            std::replace(triangle.begin(), triangle.end(), from, to);
+            vertexTriangles.at(to).push_back(t);
+        }
+
+        vertexAlive.at(from) = false;
+        vertexTriangles.at(from).clear();
+        quadrics.at(to) += quadrics.at(from);
+        vertexVersions.at(to)++;
+
+        // Drop dead triangles from the survivor, and requeue the edges around it with the merged quadric
+        std::vector<unsigned int> &survivorTriangles = vertexTriangles.at(to);
+        survivorTriangles.erase(std::remove_if(survivorTriangles.begin(), survivorTriangles.end(),
+                                               [&](unsigned int t) { return !triangleAlive.at(t); }),
+                                survivorTriangles.end());
+
+        std::set<unsigned int> neighbours;
+        for (unsigned int t : survivorTriangles) {
+            for (unsigned int vertex : triangles.at(t)) {
+                if (vertex != to) {
+                    neighbours.insert(vertex);
+                }
+            }
+        }
+        for (unsigned int neighbour : neighbours) {
+            queueEdge(to, neighbour);
+        }
+    }
+
+    // Unweld again, giving every remaining triangle its own three vertices
+    Mesh simplified;
+    for (unsigned int t = 0; t < triangles.size(); t++) {
+        if (!triangleAlive.at(t)) {
+            continue;
+        }
+
+        for (unsigned int vertex : triangles.at(t)) {
+            simplified.indices.push_back(simplified.vertices.size());
+            simplified.vertices.push_back(positions.at(vertex));
+            if (hasNormals) {
+                simplified.normals.push_back(normals.at(vertex));
+            }
+            if (hasUVs) {
+                simplified.textureCoordinates.push_back(uvs.at(vertex));
+            }
+        }
+    }
+
+    return simplified;
+}
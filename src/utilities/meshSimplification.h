@@ -0,0 +1,8 @@
+#pragma once
+#include "mesh.h"
+
+// Reduces the mesh to roughly targetRatio of its triangles by collapsing edges,
+// cheapest first according to their quadric error.
+// Vertices along UV seams and hard edges are kept in place, so the attributes on either side still meet.
+// Like every mesh in this project, the result has three unique vertices per triangle.
+Mesh simplifyMesh(const Mesh &mesh, float targetRatio);
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include "profiler.h"
+
+// Events per thread kept between two trace writes; older ones are overwritten
+const uint64_t PROFILER_RING_CAPACITY = 1 << 16;
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// One slot of the ring, guarded as a seqlock. While event number i is being written into it, sequence is
+// 2 * i + 1, and once it is complete 2 * i + 2, so a reader can tell both a torn slot and a lapped one.
+struct ProfileEventSlot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+// Single producer (the owning thread), single consumer (writeChromeTrace)
+struct ProfilerThreadBuffer {
+    std::vector<ProfileEventSlot> events = std::vector<ProfileEventSlot>(PROFILER_RING_CAPACITY);
+    std::atomic<uint64_t> writeIndex{0};
+    uint64_t readIndex = 0;  // Only touched by the consumer, under registryMutex
+    unsigned int threadID;
+};
+
+std::atomic<bool> profilerEnabled{false};
+
+static std::mutex registryMutex;
+static std::vector<ProfilerThreadBuffer*> threadBuffers;
+static thread_local ProfilerThreadBuffer* currentThreadBuffer = nullptr;
+
+void setProfilerEnabled(bool enabled) {
+    profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isProfilerEnabled() {
+    return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+uint64_t profilerTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Buffers are registered on a thread's first event and live until the program exits,
+// so events from finished threads can still be written out
+static ProfilerThreadBuffer* getThreadBuffer() {
+    if (currentThreadBuffer == nullptr) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        currentThreadBuffer = new ProfilerThreadBuffer();
+        currentThreadBuffer->threadID = threadBuffers.size() + 1;
+        threadBuffers.push_back(currentThreadBuffer);
+    }
+    return currentThreadBuffer;
+}
+
+void recordProfileEvent(const char* name, uint64_t start, uint64_t end) {
+    ProfilerThreadBuffer* buffer = getThreadBuffer();
+
+    uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+    ProfileEventSlot &slot = buffer->events[index % PROFILER_RING_CAPACITY];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+// Copies event number index out of the ring. Fails if the producer is writing that slot, or has already reused it.
+static bool readProfileEvent(const ProfilerThreadBuffer &buffer, uint64_t index, ProfileEvent &event) {
+    const ProfileEventSlot &slot = buffer.events[index % PROFILER_RING_CAPACITY];
+
+    uint64_t sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.start = slot.start.load(std::memory_order_relaxed);
+    event.end = slot.end.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t sequenceAfter = slot.sequence.load(std::memory_order_relaxed);
+
+    return sequenceBefore == 2 * index + 2 && sequenceAfter == sequenceBefore;
+}
+
+bool writeChromeTrace(const std::string &fileName) {
+    std::vector<std::pair<unsigned int, ProfileEvent>> events;
+
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        for (ProfilerThreadBuffer* buffer : threadBuffers) {
+            uint64_t writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+            uint64_t readIndex = buffer->readIndex;
+
+            // The producer has lapped us; the oldest events are gone
+            if (writeIndex - readIndex > PROFILER_RING_CAPACITY) {
+                readIndex = writeIndex - PROFILER_RING_CAPACITY;
+            }
+
+            // Events the producer overwrote, or is overwriting, while we were copying are dropped
+            for (uint64_t i = readIndex; i < writeIndex; i++) {
+                ProfileEvent event;
+                if (readProfileEvent(*buffer, i, event)) {
+                    events.emplace_back(buffer->threadID, event);
+                }
+            }
+
+            buffer->readIndex = writeIndex;
+        }
+    }
+
+    std::ofstream file(fileName);
+    if (!file) {
+        fprintf(stderr, "Could not write profiler trace to \"%s\".\n", fileName.c_str());
+        return false;
+    }
+
+    uint64_t epoch = UINT64_MAX;
+    for (const auto &event : events) {
+        epoch = std::min(epoch, event.second.start);
+    }
+
+    // Chrome trace event format, with complete ("X") events in microseconds
+    file << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < events.size(); i++) {
+        const ProfileEvent &event = events.at(i).second;
+        file << fmt::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}{}\n",
+                            event.name, events.at(i).first,
+                            (event.start - epoch) / 1000.0, (event.end - event.start) / 1000.0,
+                            i + 1 < events.size() ? "," : "");
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+    printf("Wrote %zu profiler events to %s\n", events.size(), fileName.c_str());
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU instrumentation. Zones are always compiled in; while the profiler is disabled,
+// a zone costs a single relaxed atomic load.
+//
+// Each thread records completed zones into its own lock-free ring buffer.
+// writeChromeTrace() drains all of them into a JSON file for chrome://tracing or ui.perfetto.dev.
+
+extern std::atomic<bool> profilerEnabled;
+
+void setProfilerEnabled(bool enabled);
+bool isProfilerEnabled();
+
+// Nanoseconds on a monotonic clock
+uint64_t profilerTimestamp();
+void recordProfileEvent(const char* name, uint64_t start, uint64_t end);
+
+// Writes every event recorded since the previous call. Returns false if the file could not be written.
+bool writeChromeTrace(const std::string &fileName);
+
+class ProfileZone {
+public:
+    // The name must outlive the profiler; in practice, a string literal
+    explicit ProfileZone(const char* name)
+        : name(name), start(profilerEnabled.load(std::memory_order_relaxed) ? profilerTimestamp() : 0) {}
+
+    ~ProfileZone() {
+        if (start != 0) {
+            recordProfileEvent(name, start, profilerTimestamp());
+        }
+    }
+
+private:
+    const char* name;
+    uint64_t start;
+
+    ProfileZone(ProfileZone const &) = delete;
+    ProfileZone & operator =(ProfileZone const &) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
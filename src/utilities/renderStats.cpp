@@ -0,0 +1,224 @@
+#include <chrono>
+#include <fmt/format.h>
+#include "renderStats.h"
+
+// GPU results are read this many frames after they were recorded, so reading them never stalls
+const unsigned int GPU_STATS_LATENCY = 4;
+
+// Pipeline statistics gathered for every pass, in the order of the PassStats fields
+const GLenum PIPELINE_STATISTICS[] = {
+    GL_VERTICES_SUBMITTED_ARB,
+    GL_PRIMITIVES_SUBMITTED_ARB,
+    GL_VERTEX_SHADER_INVOCATIONS_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+    GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+    GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+};
+const unsigned int PIPELINE_STATISTIC_COUNT = sizeof(PIPELINE_STATISTICS) / sizeof(PIPELINE_STATISTICS[0]);
+
+const char* GPU_PASS_NAMES[GPU_PASS_COUNT] = { "Transforms", "Shadows", "Environment", "G-buffer", "Hi-Z", "G-buffer (late)", "Particles", "Deferred", "Lensing" };
+
+// Query objects and CPU-side results of one in-flight frame
+struct StatsFrameSlot {
+    GLuint timeQueries[GPU_PASS_COUNT];
+    GLuint statisticQueries[GPU_PASS_COUNT][PIPELINE_STATISTIC_COUNT];
+    bool passRecorded[GPU_PASS_COUNT];
+    bool pending = false;
+    FrameStats stats;
+};
+
+APICounters apiCounters;
+
+static bool gpuQueriesEnabled = false;
+static bool pipelineStatisticsSupported = false;
+static StatsFrameSlot frameSlots[GPU_STATS_LATENCY];
+static FrameStats latestFrameStats;
+static uint64_t frameNumber = 0;
+static std::chrono::steady_clock::time_point frameStartTime;
+
+void initRenderStats() {
+    gpuQueriesEnabled = true;
+    pipelineStatisticsSupported = GLAD_GL_ARB_pipeline_statistics_query != 0;
+    if (!pipelineStatisticsSupported) {
+        fprintf(stderr, "ARB_pipeline_statistics_query is not supported; only GPU times will be measured.\n");
+    }
+
+    for (StatsFrameSlot &slot : frameSlots) {
+        glGenQueries(GPU_PASS_COUNT, slot.timeQueries);
+        if (pipelineStatisticsSupported) {
+            for (unsigned int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+                glGenQueries(PIPELINE_STATISTIC_COUNT, slot.statisticQueries[pass]);
+            }
+        }
+    }
+}
+
+// Reads the results of a slot if all of them have arrived. Returns false if any are still in flight.
+static bool collectSlot(StatsFrameSlot &slot) {
+    for (unsigned int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        if (!slot.passRecorded[pass]) {
+            continue;
+        }
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(slot.timeQueries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+
+        if (pipelineStatisticsSupported) {
+            for (unsigned int i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+                glGetQueryObjectuiv(slot.statisticQueries[pass][i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    for (unsigned int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        PassStats &passStats = slot.stats.passes[pass];
+        passStats = PassStats();
+        if (!slot.passRecorded[pass]) {
+            continue;
+        }
+
+        GLuint64 elapsedNanoseconds = 0;
+        glGetQueryObjectui64v(slot.timeQueries[pass], GL_QUERY_RESULT, &elapsedNanoseconds);
+        passStats.measured = true;
+        passStats.gpuTimeMs = elapsedNanoseconds / 1.0e6;
+
+        if (pipelineStatisticsSupported) {
+            GLuint64 results[PIPELINE_STATISTIC_COUNT];
+            for (unsigned int i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+                glGetQueryObjectui64v(slot.statisticQueries[pass][i], GL_QUERY_RESULT, &results[i]);
+            }
+            passStats.verticesSubmitted         = results[0];
+            passStats.primitivesSubmitted       = results[1];
+            passStats.vertexShaderInvocations   = results[2];
+            passStats.fragmentShaderInvocations = results[3];
+            passStats.clippingInputPrimitives   = results[4];
+            passStats.clippingOutputPrimitives  = results[5];
+        }
+    }
+
+    return true;
+}
+
+void beginStatsFrame() {
+    StatsFrameSlot &slot = frameSlots[frameNumber % GPU_STATS_LATENCY];
+
+    // This slot was last used GPU_STATS_LATENCY frames ago. If the GPU is still not done with it,
+    // its frame is dropped rather than waited for.
+    if (slot.pending && collectSlot(slot)) {
+        latestFrameStats = slot.stats;
+    }
+
+    slot.pending = false;
+    for (bool &recorded : slot.passRecorded) {
+        recorded = false;
+    }
+
+    apiCounters = APICounters();
+    frameStartTime = std::chrono::steady_clock::now();
+}
+
+void endStatsFrame() {
+    StatsFrameSlot &slot = frameSlots[frameNumber % GPU_STATS_LATENCY];
+
+    slot.stats.frameNumber = frameNumber;
+    slot.stats.api = apiCounters;
+    slot.stats.cpuFrameTimeMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - frameStartTime).count();
+    slot.pending = true;
+
+    frameNumber++;
+}
+
+void beginGPUPass(GPUPass pass) {
+    if (!gpuQueriesEnabled) {
+        return;
+    }
+
+    StatsFrameSlot &slot = frameSlots[frameNumber % GPU_STATS_LATENCY];
+    slot.passRecorded[pass] = true;
+
+    glBeginQuery(GL_TIME_ELAPSED, slot.timeQueries[pass]);
+    if (pipelineStatisticsSupported) {
+        for (unsigned int i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+            glBeginQuery(PIPELINE_STATISTICS[i], slot.statisticQueries[pass][i]);
+        }
+    }
+}
+
+void endGPUPass() {
+    if (!gpuQueriesEnabled) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    if (pipelineStatisticsSupported) {
+        for (unsigned int i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+            glEndQuery(PIPELINE_STATISTICS[i]);
+        }
+    }
+}
+
+const FrameStats &getLatestFrameStats() {
+    return latestFrameStats;
+}
+
+std::string formatFrameStats(const FrameStats &stats) {
+    std::string text = fmt::format("Frame {}: CPU {:.2f} ms, {} draws, {} state changes, {} bytes uploaded\n",
+                                   stats.frameNumber, stats.cpuFrameTimeMs, stats.api.drawCalls,
+                                   stats.api.stateChanges(), stats.api.bytesUploaded);
+
+    for (unsigned int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        const PassStats &passStats = stats.passes[pass];
+        if (!passStats.measured) {
+            continue;
+        }
+
+        text += fmt::format("  {:<16} GPU {:.3f} ms, {} vertices, {} primitives, {} VS / {} FS invocations, clipping {} -> {}\n",
+                            GPU_PASS_NAMES[pass], passStats.gpuTimeMs,
+                            passStats.verticesSubmitted, passStats.primitivesSubmitted,
+                            passStats.vertexShaderInvocations, passStats.fragmentShaderInvocations,
+                            passStats.clippingInputPrimitives, passStats.clippingOutputPrimitives);
+    }
+
+    return text;
+}
+
+std::string formatFrameStatsSummary(const FrameStats &stats) {
+    std::string text = fmt::format("CPU {:.2f} ms, {} draws, {} state changes, {:.1f} KB uploaded\n",
+                                   stats.cpuFrameTimeMs, stats.api.drawCalls, stats.api.stateChanges(),
+                                   stats.api.bytesUploaded / 1024.0);
+
+    for (unsigned int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        const PassStats &passStats = stats.passes[pass];
+        if (!passStats.measured) {
+            continue;
+        }
+
+        text += fmt::format("{:<16} {:.3f} ms\n", GPU_PASS_NAMES[pass], passStats.gpuTimeMs);
+    }
+
+    return text;
+}
+
+unsigned int pixelSizeInBytes(GLenum format, GLenum type) {
+    unsigned int components = 0;
+    switch (format) {
+        case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG: components = 2; break;
+        case GL_RGB: case GL_BGR: components = 3; break;
+        case GL_RGBA: case GL_BGRA: components = 4; break;
+    }
+
+    switch (type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+    }
+    return 0;
+}
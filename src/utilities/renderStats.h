@@ -0,0 +1,214 @@
+#pragma once
+
+// System headers
+#include <glad/glad.h>
+
+// Standard headers
+#include <cstdint>
+#include <string>
+
+// Passes measured with GPU queries. Queries of the same type cannot nest, so neither can passes.
+// With occlusion culling, the G-buffer pass is split around the Hi-Z pyramid build and culling.
+// The shadow and environment passes are only recorded in frames where part of their cube maps is redrawn.
+enum GPUPass {
+    GPU_PASS_TRANSFORMS, GPU_PASS_SHADOWS, GPU_PASS_ENVIRONMENT, GPU_PASS_GBUFFER, GPU_PASS_HIZ, GPU_PASS_GBUFFER_LATE, GPU_PASS_PARTICLES, GPU_PASS_DEFERRED, GPU_PASS_LENSING, GPU_PASS_COUNT
+};
+
+// GPU metrics of one pass, from GL_TIME_ELAPSED and ARB_pipeline_statistics_query
+struct PassStats {
+    bool measured = false;
+    double gpuTimeMs = 0;
+    uint64_t verticesSubmitted = 0;
+    uint64_t primitivesSubmitted = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t fragmentShaderInvocations = 0;
+    uint64_t clippingInputPrimitives = 0;
+    uint64_t clippingOutputPrimitives = 0;
+};
+
+// CPU-side counts of the GL calls made through the tracked* wrappers below
+struct APICounters {
+    uint64_t drawCalls = 0;
+    uint64_t indicesSubmitted = 0;
+    uint64_t programBinds = 0;
+    uint64_t vertexArrayBinds = 0;
+    uint64_t textureBinds = 0;
+    uint64_t uniformUpdates = 0;
+    uint64_t otherStateChanges = 0;
+    uint64_t bytesUploaded = 0;
+
+    uint64_t stateChanges() const {
+        return programBinds + vertexArrayBinds + textureBinds + uniformUpdates + otherStateChanges;
+    }
+};
+
+struct FrameStats {
+    uint64_t frameNumber = 0;
+    double cpuFrameTimeMs = 0;
+    PassStats passes[GPU_PASS_COUNT];
+    APICounters api;
+};
+
+// Counters of the frame currently being recorded
+extern APICounters apiCounters;
+
+// Enables the GPU queries. The CPU-side counters are always kept.
+void initRenderStats();
+// Collects GPU results that have become available and starts counting a new frame
+void beginStatsFrame();
+void endStatsFrame();
+void beginGPUPass(GPUPass pass);
+void endGPUPass();
+
+// Most recent frame whose GPU queries have completed (a few frames behind the current one)
+const FrameStats &getLatestFrameStats();
+std::string formatFrameStats(const FrameStats &stats);
+// Shorter, one line per measured pass, for the on-screen overlay
+std::string formatFrameStatsSummary(const FrameStats &stats);
+
+
+// Thin wrappers around the GL calls issued while rendering, counting them as they go
+
+inline void trackedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    apiCounters.drawCalls++;
+    apiCounters.indicesSubmitted += count;
+    glDrawElements(mode, count, type, indices);
+}
+
+inline void trackedDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex) {
+    apiCounters.drawCalls++;
+    apiCounters.indicesSubmitted += count;
+    glDrawElementsBaseVertex(mode, count, type, indices, baseVertex);
+}
+
+inline void trackedDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                        GLsizei instanceCount) {
+    apiCounters.drawCalls++;
+    apiCounters.indicesSubmitted += count * instanceCount;
+    glDrawElementsInstanced(mode, count, type, indices, instanceCount);
+}
+
+inline void trackedDrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount,
+                                                   GLuint baseInstance) {
+    apiCounters.drawCalls++;
+    glDrawArraysInstancedBaseInstance(mode, first, count, instanceCount, baseInstance);
+}
+
+// The index count is only known on the GPU, so it is not counted here
+inline void trackedDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect) {
+    apiCounters.drawCalls++;
+    glDrawElementsIndirect(mode, type, indirect);
+}
+
+// As above, the instance count is only known on the GPU
+inline void trackedDrawArraysIndirect(GLenum mode, const void* indirect) {
+    apiCounters.drawCalls++;
+    glDrawArraysIndirect(mode, indirect);
+}
+
+inline void trackedUseProgram(GLuint program) {
+    apiCounters.programBinds++;
+    glUseProgram(program);
+}
+
+inline void trackedBindVertexArray(GLuint vertexArray) {
+    apiCounters.vertexArrayBinds++;
+    glBindVertexArray(vertexArray);
+}
+
+inline void trackedBindTextureUnit(GLuint unit, GLuint texture) {
+    apiCounters.textureBinds++;
+    glBindTextureUnit(unit, texture);
+}
+
+inline void trackedBindTexture(GLenum target, GLuint texture) {
+    apiCounters.textureBinds++;
+    glBindTexture(target, texture);
+}
+
+inline void trackedBindBuffer(GLenum target, GLuint buffer) {
+    apiCounters.otherStateChanges++;
+    glBindBuffer(target, buffer);
+}
+
+inline void trackedBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    apiCounters.otherStateChanges++;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+inline void trackedColorMaski(GLuint buffer, GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+    apiCounters.otherStateChanges++;
+    glColorMaski(buffer, r, g, b, a);
+}
+
+inline void trackedUniform1i(GLint location, GLint value) {
+    apiCounters.uniformUpdates++;
+    glUniform1i(location, value);
+}
+
+inline void trackedUniform1ui(GLint location, GLuint value) {
+    apiCounters.uniformUpdates++;
+    glUniform1ui(location, value);
+}
+
+inline void trackedUniform2i(GLint location, GLint x, GLint y) {
+    apiCounters.uniformUpdates++;
+    glUniform2i(location, x, y);
+}
+
+inline void trackedUniform4i(GLint location, GLint x, GLint y, GLint z, GLint w) {
+    apiCounters.uniformUpdates++;
+    glUniform4i(location, x, y, z, w);
+}
+
+inline void trackedUniform1f(GLint location, GLfloat value) {
+    apiCounters.uniformUpdates++;
+    glUniform1f(location, value);
+}
+
+inline void trackedUniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+    apiCounters.uniformUpdates++;
+    apiCounters.bytesUploaded += count * 2 * sizeof(GLfloat);
+    glUniform2fv(location, count, value);
+}
+
+inline void trackedUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    apiCounters.uniformUpdates++;
+    apiCounters.bytesUploaded += count * 3 * sizeof(GLfloat);
+    glUniform3fv(location, count, value);
+}
+
+inline void trackedUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    apiCounters.uniformUpdates++;
+    apiCounters.bytesUploaded += count * 9 * sizeof(GLfloat);
+    glUniformMatrix3fv(location, count, transpose, value);
+}
+
+inline void trackedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    apiCounters.uniformUpdates++;
+    apiCounters.bytesUploaded += count * 16 * sizeof(GLfloat);
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+inline void trackedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    if (data != nullptr) {
+        apiCounters.bytesUploaded += size;
+    }
+    glBufferData(target, size, data, usage);
+}
+
+inline void trackedNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+    apiCounters.bytesUploaded += size;
+    glNamedBufferSubData(buffer, offset, size, data);
+}
+
+// Size in bytes of one pixel of client data in the given format and type (0 if unknown)
+unsigned int pixelSizeInBytes(GLenum format, GLenum type);
+
+inline void trackedTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                              GLint border, GLenum format, GLenum type, const void* pixels) {
+    if (pixels != nullptr) {
+        apiCounters.bytesUploaded += uint64_t(width) * height * pixelSizeInBytes(format, type);
+    }
+    glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+}
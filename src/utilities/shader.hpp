@@ -6,10 +6,17 @@
 #include <glad/glad.h>
 
 // Standard headers
+#include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
+
+// Local headers
+#include "profiler.h"
+#include "renderStats.h"
 
 
 namespace Gloom
@@ -23,32 +30,104 @@ namespace Gloom
         GLint  mStatus;
         GLint  mLength;
 
+        // Programs built by makePermutedShader(), keyed by their feature mask.
+        // mProgram is the one without features.
+        std::vector<std::string>         mFilenames;
+        std::vector<std::string>         mFeatures;
+        std::map<unsigned int, GLuint>   mPermutations;
+
     public:
         Shader() {
             mProgram = glCreateProgram();
         }
 
         // Public member functions
-        void   activate()   { glUseProgram(mProgram); }
-        void   deactivate() { glUseProgram(0); }
+        void   activate()   { trackedUseProgram(mProgram); }
+        void   deactivate() { trackedUseProgram(0); }
         GLuint get()        { return mProgram; }
-        void   destroy()    { glDeleteProgram(mProgram); }
+
+        void destroy()
+        {
+            for (auto const &permutation : mPermutations)
+                if (permutation.second != mProgram)
+                    glDeleteProgram(permutation.second);
+            mPermutations.clear();
+            glDeleteProgram(mProgram);
+        }
 
         /* Attach a shader to the current shader program */
         void attach(std::string const &filename)
         {
+            attach(mProgram, filename, "");
+        }
+
+
+        /* Builds the program from the given shader files, with the feature keys they test with
+           #ifdef. Feature i is bit (1 << i) of the masks given to activate() and get(): each set
+           bit #defines its key in every file, and the program for a mask is compiled the first
+           time it is asked for, then kept. The program without features is compiled right away. */
+        void makePermutedShader(std::vector<std::string> const &filenames,
+                                std::vector<std::string> const &features)
+        {
+            assert(features.size() <= 32);
+            mFilenames = filenames;
+            mFeatures = features;
+
+            for (auto const &filename : mFilenames)
+                attach(mProgram, filename, "");
+            link(mProgram);
+            mPermutations[0] = mProgram;
+        }
+
+        /* The program specialized for a feature mask, compiled now if this is its first use */
+        GLuint get(unsigned int features)
+        {
+            auto permutation = mPermutations.find(features);
+            if (permutation != mPermutations.end())
+                return permutation->second;
+
+            PROFILE_ZONE("Shader::compilePermutation");
+
+            std::string defines;
+            for (unsigned int i = 0; i < mFeatures.size(); i++)
+                if (features & (1u << i))
+                    defines += "#define " + mFeatures[i] + "\n";
+
+            GLuint program = glCreateProgram();
+            for (auto const &filename : mFilenames)
+                attach(program, filename, defines);
+            link(program);
+
+            mPermutations[features] = program;
+            return program;
+        }
+
+        void activate(unsigned int features) { trackedUseProgram(get(features)); }
+
+        /* Programs compiled so far, counting the one without features */
+        unsigned int permutationCount() { return mPermutations.size(); }
+
+
+        /* Attach a shader to a shader program, with the given #define lines
+           inserted after its #version line */
+        void attach(GLuint program, std::string const &filename, std::string const &defines)
+        {
+            PROFILE_ZONE("Shader::attach");
+
             // Load GLSL Shader from source
-            std::ifstream fd(filename.c_str());
-            if (fd.fail())
-            {
-                fprintf(stderr,
-                    "Something went wrong when attaching the Shader file at \"%s\".\n"
-                    "The file may not exist or is currently inaccessible.\n",
-                    filename.c_str());
+            std::string src;
+            if (!load(filename, src))
                 return;
+
+            // #version must come first, and #line keeps the line numbers
+            // of compile errors pointing into the file
+            if (!defines.empty())
+            {
+                auto version = src.find("#version");
+                auto lineEnd = (version == std::string::npos) ? 0 : src.find('\n', version) + 1;
+                auto line = std::count(src.begin(), src.begin() + lineEnd, '\n') + 1;
+                src.insert(lineEnd, defines + "#line " + std::to_string(line) + "\n");
             }
-            auto src = std::string(std::istreambuf_iterator<char>(fd),
-                                  (std::istreambuf_iterator<char>()));
 
             // Create shader object
             const char * source = src.c_str();
@@ -69,24 +148,72 @@ namespace Gloom
             assert(mStatus);
 
             // Attach shader and free allocated memory
-            glAttachShader(mProgram, shader);
+            glAttachShader(program, shader);
             glDeleteShader(shader);
         }
 
 
+        /* Reads a shader file, replacing every #include "file" line with the contents of that file,
+           found next to the one including it. GLSL has no #include of its own. The #line directives
+           around each included file keep the line numbers of compile errors pointing into it. */
+        bool load(std::string const &filename, std::string &src)
+        {
+            std::ifstream fd(filename.c_str());
+            if (fd.fail())
+            {
+                fprintf(stderr,
+                    "Something went wrong when attaching the Shader file at \"%s\".\n"
+                    "The file may not exist or is currently inaccessible.\n",
+                    filename.c_str());
+                return false;
+            }
+
+            auto slash = filename.find_last_of('/');
+            auto directory = (slash == std::string::npos) ? std::string() : filename.substr(0, slash + 1);
+
+            std::string line;
+            for (int number = 1; std::getline(fd, line); number++)
+            {
+                auto directive = line.find_first_not_of(" \t");
+                if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+                {
+                    src += line + "\n";
+                    continue;
+                }
+
+                auto nameStart = line.find('"', directive) + 1;
+                auto nameEnd = line.find('"', nameStart);
+                std::string included;
+                if (nameStart == 0 || nameEnd == std::string::npos
+                    || !load(directory + line.substr(nameStart, nameEnd - nameStart), included))
+                    return false;
+
+                src += "#line 1\n" + included + "#line " + std::to_string(number + 1) + "\n";
+            }
+            return true;
+        }
+
+
         /* Links all attached shaders together into a shader program */
         void link()
         {
+            link(mProgram);
+        }
+
+        void link(GLuint program)
+        {
+            PROFILE_ZONE("Shader::link");
+
             // Link all attached shaders
-            glLinkProgram(mProgram);
+            glLinkProgram(program);
 
             // Display errors
-            glGetProgramiv(mProgram, GL_LINK_STATUS, &mStatus);
+            glGetProgramiv(program, GL_LINK_STATUS, &mStatus);
             if (!mStatus)
             {
-                glGetProgramiv(mProgram, GL_INFO_LOG_LENGTH, &mLength);
+                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &mLength);
                 std::unique_ptr<char[]> buffer(new char[mLength]);
-                glGetProgramInfoLog(mProgram, mLength, nullptr, buffer.get());
+                glGetProgramInfoLog(program, mLength, nullptr, buffer.get());
                 fprintf(stderr, "%s\n", buffer.get());
             }
 
@@ -259,3 +259,65 @@ Mesh generateQuad() {
     mesh.textureCoordinates = uvs;
     return mesh;
 }
+
+// Finds the smallest axis-aligned box containing every vertex of the mesh
+void computeBoundingBox(const Mesh &mesh, glm::vec3 &minCorner, glm::vec3 &maxCorner) {
+    if (mesh.vertices.empty()) {
+        minCorner = glm::vec3(0);
+        maxCorner = glm::vec3(0);
+        return;
+    }
+
+    minCorner = mesh.vertices.at(0);
+    maxCorner = mesh.vertices.at(0);
+    for (const glm::vec3 &vertex : mesh.vertices) {
+        minCorner = glm::min(minCorner, vertex);
+        maxCorner = glm::max(maxCorner, vertex);
+    }
+}
+
+// Copied from https://www.opengl-tutorial.org/intermediate-tutorials/tutorial-13-normal-mapping/#vertex-shader
+void computeTangentBasis(
+    // inputs
+    std::vector<glm::vec3>& vertices,
+    std::vector<glm::vec2>& uvs,
+    std::vector<glm::vec3>& normals,
+    // outputs
+    std::vector<glm::vec3>& tangents,
+    std::vector<glm::vec3>& bitangents)
+{
+    for (unsigned int i = 0; i < vertices.size(); i += 3) {
+        // Shortcuts for vertices
+        glm::vec3& v0 = vertices[i + 0];
+        glm::vec3& v1 = vertices[i + 1];
+        glm::vec3& v2 = vertices[i + 2];
+
+        // Shortcuts for UVs
+        glm::vec2& uv0 = uvs[i + 0];
+        glm::vec2& uv1 = uvs[i + 1];
+        glm::vec2& uv2 = uvs[i + 2];
+
+        // Edges of the triangle : position delta
+        glm::vec3 deltaPos1 = v1 - v0;
+        glm::vec3 deltaPos2 = v2 - v0;
+
+        // UV delta
+        glm::vec2 deltaUV1 = uv1 - uv0;
+        glm::vec2 deltaUV2 = uv2 - uv0;
+
+        float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
+        glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+        glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
+
+        // Set the same tangent for all three vertices of the triangle.
+        // They will be merged later, in vboindexer.cpp
+        tangents.push_back(tangent);
+        tangents.push_back(tangent);
+        tangents.push_back(tangent);
+
+        // Same thing for bitangents
+        bitangents.push_back(bitangent);
+        bitangents.push_back(bitangent);
+        bitangents.push_back(bitangent);
+    }
+}
@@ -4,4 +4,9 @@
 Mesh cube(glm::vec3 scale = glm::vec3(1), glm::vec2 textureScale = glm::vec2(1), bool tilingTextures = false, bool inverted = false, glm::vec3 textureScale3d = glm::vec3(1));
 Mesh generateBox(float width, float height, float depth, bool flipFaces = false);
 Mesh generateSphere(float radius, int slices, int layers, bool flipFaces = false);
-Mesh generateQuad();
\ No newline at end of file
+Mesh generateQuad();
+void computeBoundingBox(const Mesh &mesh, glm::vec3 &minCorner, glm::vec3 &maxCorner);
+
+// Treats every three consecutive vertices as a triangle, and appends its tangent and bitangent once per vertex
+void computeTangentBasis(std::vector<glm::vec3>& vertices, std::vector<glm::vec2>& uvs, std::vector<glm::vec3>& normals,
+                         std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents);
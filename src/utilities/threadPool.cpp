@@ -0,0 +1,97 @@
+#include <algorithm>
+#include "threadPool.h"
+
+// Chunks handed out per thread, so threads finishing early can pick up some of the remaining work
+const size_t CHUNKS_PER_THREAD = 4;
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minChunkSize, const std::function<void(size_t, size_t)> &body) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t targetChunks = size_t(threadCount()) * CHUNKS_PER_THREAD;
+    size_t size = std::max(std::max(minChunkSize, size_t(1)), (count + targetChunks - 1) / targetChunks);
+
+    // Not worth waking anyone up for
+    if (workers.empty() || size >= count) {
+        body(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentBody = &body;
+        itemCount = count;
+        chunkSize = size;
+        nextChunk = 0;
+        chunkCount = (count + size - 1) / size;
+        chunksDone = 0;
+        generation++;
+    }
+    workAvailable.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this] { return chunksDone == chunkCount; });
+    currentBody = nullptr;
+}
+
+// Takes chunks of the current loop until there are none left
+void ThreadPool::runChunks() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (currentBody != nullptr && nextChunk < chunkCount) {
+        size_t chunk = nextChunk++;
+        const std::function<void(size_t, size_t)> &body = *currentBody;
+        lock.unlock();
+
+        size_t begin = chunk * chunkSize;
+        body(begin, std::min(begin + chunkSize, itemCount));
+
+        lock.lock();
+        chunksDone++;
+        if (chunksDone == chunkCount) {
+            workDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long long seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks();
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for data-parallel loops. The calling thread takes part in the work,
+// so a pool with one thread runs everything inline.
+class ThreadPool {
+public:
+    // threadCount includes the calling thread. 0 picks one per hardware thread.
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    unsigned int threadCount() const { return unsigned(workers.size()) + 1; }
+
+    // Calls body(begin, end) on disjoint ranges covering [0, count), and returns once all of them are done.
+    // Ranges are at least minChunkSize long, so small loops are not spread thinner than they are worth.
+    void parallelFor(size_t count, size_t minChunkSize, const std::function<void(size_t, size_t)> &body);
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+
+    // The loop currently being run, guarded by mutex
+    const std::function<void(size_t, size_t)>* currentBody = nullptr;
+    size_t itemCount = 0;
+    size_t chunkSize = 0;
+    size_t nextChunk = 0;
+    size_t chunkCount = 0;
+    size_t chunksDone = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator =(ThreadPool const &) = delete;
+};
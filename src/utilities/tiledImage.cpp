@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "profiler.h"
+#include "tiledImage.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+uint32_t tiledMipWidth(const TiledImageHeader &header, uint32_t mip) {
+    return std::max(header.width >> mip, 1u);
+}
+
+uint32_t tiledMipHeight(const TiledImageHeader &header, uint32_t mip) {
+    return std::max(header.height >> mip, 1u);
+}
+
+uint32_t tiledPagesX(const TiledImageHeader &header, uint32_t mip) {
+    return std::max(tiledMipWidth(header, mip) / header.pageSize, 1u);
+}
+
+uint32_t tiledPagesY(const TiledImageHeader &header, uint32_t mip) {
+    return std::max(tiledMipHeight(header, mip) / header.pageSize, 1u);
+}
+
+uint32_t tiledFirstPage(const TiledImageHeader &header, uint32_t mip) {
+    uint32_t first = 0;
+    for (uint32_t level = 0; level < mip; level++) {
+        first += tiledPagesX(header, level) * tiledPagesY(header, level);
+    }
+    return first;
+}
+
+uint32_t tiledPageCount(const TiledImageHeader &header) {
+    return tiledFirstPage(header, header.mipCount);
+}
+
+size_t tiledPageBytes(const TiledImageHeader &header) {
+    size_t side = header.pageSize + 2 * header.pageBorder;
+    return side * side * 4;
+}
+
+static uint32_t nextPowerOfTwo(uint32_t value) {
+    uint32_t power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
+
+static int wrapCoordinate(int coordinate, int size) {
+    return ((coordinate % size) + size) % size;
+}
+
+// Bilinear resampling with wrapping, as the textures tile
+static PNGImage resizeImage(const PNGImage &image, uint32_t width, uint32_t height) {
+    PNGImage resized;
+    resized.width = width;
+    resized.height = height;
+    resized.pixels.resize(size_t(width) * height * 4);
+
+    for (uint32_t y = 0; y < height; y++) {
+        float sourceY = (y + 0.5f) * image.height / height - 0.5f;
+        int y0 = int(std::floor(sourceY));
+        float fy = sourceY - y0;
+        for (uint32_t x = 0; x < width; x++) {
+            float sourceX = (x + 0.5f) * image.width / width - 0.5f;
+            int x0 = int(std::floor(sourceX));
+            float fx = sourceX - x0;
+
+            const unsigned char* corners[4];
+            for (int corner = 0; corner < 4; corner++) {
+                int cornerX = wrapCoordinate(x0 + (corner & 1), image.width);
+                int cornerY = wrapCoordinate(y0 + (corner >> 1), image.height);
+                corners[corner] = &image.pixels[(size_t(cornerY) * image.width + cornerX) * 4];
+            }
+            for (int channel = 0; channel < 4; channel++) {
+                float bottom = corners[0][channel] + (corners[1][channel] - corners[0][channel]) * fx;
+                float top = corners[2][channel] + (corners[3][channel] - corners[2][channel]) * fx;
+                resized.pixels[(size_t(y) * width + x) * 4 + channel] = (unsigned char)(bottom + (top - bottom) * fy + 0.5f);
+            }
+        }
+    }
+    return resized;
+}
+
+// The next coarser level, each texel the average of the 2x2 below it
+static PNGImage halveImage(const PNGImage &image) {
+    PNGImage half;
+    half.width = std::max(image.width / 2, 1u);
+    half.height = std::max(image.height / 2, 1u);
+    half.pixels.resize(size_t(half.width) * half.height * 4);
+
+    for (uint32_t y = 0; y < half.height; y++) {
+        uint32_t rows[2] = { std::min(2 * y, image.height - 1), std::min(2 * y + 1, image.height - 1) };
+        for (uint32_t x = 0; x < half.width; x++) {
+            uint32_t columns[2] = { std::min(2 * x, image.width - 1), std::min(2 * x + 1, image.width - 1) };
+            for (int channel = 0; channel < 4; channel++) {
+                unsigned int sum = 0;
+                for (uint32_t row : rows) {
+                    for (uint32_t column : columns) {
+                        sum += image.pixels[(size_t(row) * image.width + column) * 4 + channel];
+                    }
+                }
+                half.pixels[(size_t(y) * half.width + x) * 4 + channel] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return half;
+}
+
+bool bakeTiledImage(const PNGImage &image, uint64_t sourceHash, uint32_t pageSize, uint32_t pageBorder,
+                    const std::string &fileName) {
+    PROFILE_ZONE("bakeTiledImage");
+
+    if (image.width == 0 || image.height == 0) {
+        return false;
+    }
+
+    PNGImage level = image;
+    if (level.width != nextPowerOfTwo(level.width) || level.height != nextPowerOfTwo(level.height)) {
+        level = resizeImage(level, nextPowerOfTwo(level.width), nextPowerOfTwo(level.height));
+    }
+
+    TiledImageHeader header;
+    header.width = level.width;
+    header.height = level.height;
+    header.pageSize = pageSize;
+    header.pageBorder = pageBorder;
+    header.sourceHash = sourceHash;
+    header.mipCount = 1;
+    while (std::max(tiledMipWidth(header, header.mipCount - 1), tiledMipHeight(header, header.mipCount - 1)) > pageSize) {
+        header.mipCount++;
+    }
+
+    // Written under another name first, so an interrupted bake never leaves a file that looks complete.
+    // The name is the process's own, as the worker processes of a tiled render may bake the same file at once.
+    std::string temporaryName = fileName + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    int side = int(pageSize + 2 * pageBorder);
+    std::vector<unsigned char> page(tiledPageBytes(header));
+    for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+        if (mip > 0) {
+            level = halveImage(level);
+        }
+
+        for (uint32_t pageY = 0; pageY < tiledPagesY(header, mip); pageY++) {
+            for (uint32_t pageX = 0; pageX < tiledPagesX(header, mip); pageX++) {
+                int originX = int(pageX * pageSize) - int(pageBorder);
+                int originY = int(pageY * pageSize) - int(pageBorder);
+                for (int y = 0; y < side; y++) {
+                    int sourceY = wrapCoordinate(originY + y, level.height);
+                    for (int x = 0; x < side; x++) {
+                        int sourceX = wrapCoordinate(originX + x, level.width);
+                        const unsigned char* texel = &level.pixels[(size_t(sourceY) * level.width + sourceX) * 4];
+                        std::copy(texel, texel + 4, &page[(size_t(y) * side + x) * 4]);
+                    }
+                }
+                file.write(reinterpret_cast<const char*>(page.data()), page.size());
+            }
+        }
+    }
+
+    file.close();
+    if (!file) {
+        std::remove(temporaryName.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    // Renaming onto an existing file fails here. There are no worker processes to race with on Windows.
+    std::remove(fileName.c_str());
+#endif
+    // Replaces the file in one step, so other processes read either the old file or the complete new one
+    if (std::rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+        std::remove(temporaryName.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool isValidHeader(const TiledImageHeader &header) {
+    return header.magic == TILED_IMAGE_MAGIC && header.version == TILED_IMAGE_VERSION
+        && header.width > 0 && header.height > 0 && header.pageSize > 0 && header.mipCount > 0;
+}
+
+bool readTiledImageHeader(const std::string &fileName, TiledImageHeader &header) {
+    std::ifstream file(fileName, std::ios::binary);
+    return file.read(reinterpret_cast<char*>(&header), sizeof(header)) && isValidHeader(header);
+}
+
+bool TiledImageReader::open(const std::string &fileName) {
+    file.close();
+    file.clear();
+    file.open(fileName, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) || !isValidHeader(fileHeader)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool TiledImageReader::readPage(uint32_t mip, uint32_t x, uint32_t y, std::vector<unsigned char> &pixels) {
+    if (!file.is_open() || mip >= fileHeader.mipCount
+        || x >= tiledPagesX(fileHeader, mip) || y >= tiledPagesY(fileHeader, mip)) {
+        return false;
+    }
+
+    size_t pageBytes = tiledPageBytes(fileHeader);
+    size_t page = tiledFirstPage(fileHeader, mip) + size_t(y) * tiledPagesX(fileHeader, mip) + x;
+    pixels.resize(pageBytes);
+
+    file.clear();
+    file.seekg(std::streamoff(sizeof(TiledImageHeader) + page * pageBytes));
+    return bool(file.read(reinterpret_cast<char*>(pixels.data()), pageBytes));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "imageLoader.hpp"
+
+// Images stored as square RGBA8 pages, one mip level after another, so any page can be read on its own.
+// Every page is surrounded by a border of the texels around it (wrapping at the image's edges),
+// which lets a page be filtered bilinearly wherever it ends up in a texture atlas.
+//
+// File layout: a TiledImageHeader, then the pages of every mip level, finest first,
+// each level row by row from the bottom. All pages have the same size, including those of the
+// coarse levels smaller than a page, whose remaining texels repeat the level.
+
+const uint32_t TILED_IMAGE_MAGIC = 0x54564247;  // "GBVT"
+const uint32_t TILED_IMAGE_VERSION = 1;
+
+struct TiledImageHeader {
+    uint32_t magic = TILED_IMAGE_MAGIC;
+    uint32_t version = TILED_IMAGE_VERSION;
+    uint32_t width = 0;        // Of the finest level. Powers of two, as images are resized to those when baked.
+    uint32_t height = 0;
+    uint32_t pageSize = 0;     // Texels along a page's side, without its border
+    uint32_t pageBorder = 0;   // Texels of border on every side
+    uint32_t mipCount = 0;     // Down to the first level that fits in a single page
+    uint32_t padding = 0;
+    uint64_t sourceHash = 0;   // Of the image the file was baked from, to tell when it is out of date
+};
+
+// Sizes of one mip level, in texels and in pages
+uint32_t tiledMipWidth(const TiledImageHeader &header, uint32_t mip);
+uint32_t tiledMipHeight(const TiledImageHeader &header, uint32_t mip);
+uint32_t tiledPagesX(const TiledImageHeader &header, uint32_t mip);
+uint32_t tiledPagesY(const TiledImageHeader &header, uint32_t mip);
+// Pages in all levels finer than this one, which is where the level starts in the file
+uint32_t tiledFirstPage(const TiledImageHeader &header, uint32_t mip);
+uint32_t tiledPageCount(const TiledImageHeader &header);
+// Bytes of one page, including its border
+size_t tiledPageBytes(const TiledImageHeader &header);
+
+// Writes the image as a tiled file, resized to powers of two if it is not, with its mip levels box filtered.
+// Returns false if the file could not be written.
+bool bakeTiledImage(const PNGImage &image, uint64_t sourceHash, uint32_t pageSize, uint32_t pageBorder,
+                    const std::string &fileName);
+
+// Reads the header of a tiled file, or returns false if it is missing or not one
+bool readTiledImageHeader(const std::string &fileName, TiledImageHeader &header);
+
+// Reads pages of one tiled file. Each reader has its own file handle, so readers can be used
+// from different threads, but a single reader cannot.
+class TiledImageReader {
+public:
+    bool open(const std::string &fileName);
+    bool isOpen() const { return file.is_open(); }
+    const TiledImageHeader &header() const { return fileHeader; }
+
+    // Reads the page at (x, y) of a mip level into pixels, resizing it to tiledPageBytes()
+    bool readPage(uint32_t mip, uint32_t x, uint32_t y, std::vector<unsigned char> &pixels);
+
+private:
+    std::ifstream file;
+    TiledImageHeader fileHeader;
+};
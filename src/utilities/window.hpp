@@ -16,4 +16,29 @@ const int         windowSamples   = 4;
 struct CommandLineOptions {
     bool enableMusic;
     bool enableAutoplay;
+    bool enableOcclusionCulling;
+    bool enableProfiler;
+    bool enableGPUStats;
+    int particleCount;
+    int orbitingBallCount;
+    int blackHoleCount;
+    bool showStatsOverlay;
+    bool enableCheckerboard;
+    bool enableStereo;
+    bool enableGPUTransforms;
+    bool runCheckerboardComparison;
+    bool runParticleBenchmark;
+    int gpuMemoryBudgetMB;  // 0 for no budget
+    bool runGoldenImageTests;
+    bool updateGoldenImages;
+    std::string capturePath;
+    int captureFramesPerSecond;
+    std::string tiledOutputPath;
+    int tiledWidth;
+    int tiledHeight;
+    int tileGuard;
+    int tileWorkerCount;
+    // Only set for worker processes started by the tiled rendering coordinator
+    int tileWorkerIndex;
+    std::string tileSharedMemoryName;
 };
\ No newline at end of file
@@ -0,0 +1,581 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include <utilities/imageLoader.hpp>
+#include <utilities/tiledImage.h>
+#include <utilities/profiler.h>
+#include <utilities/renderStats.h>
+#include <utilities/gpuResources.h>
+#include "assetRegistry.h"
+#include "virtualTexture.h"
+
+// Frames between writing the feedback and reading it back, so the GPU is done with it by then
+const unsigned int FEEDBACK_READBACK_FRAMES = 3;
+
+// How long a blocking readback waits for the GPU, in nanoseconds
+const GLuint64 BLOCKING_READBACK_TIMEOUT = 1000000000;
+
+// A cache slot holds one page with its border
+const unsigned int SLOT_SIZE = VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER;
+const unsigned int CACHE_SIZE = SLOT_SIZE * VIRTUAL_CACHE_PAGES_PER_SIDE;
+const unsigned int CACHE_SLOT_COUNT = VIRTUAL_CACHE_PAGES_PER_SIDE * VIRTUAL_CACHE_PAGES_PER_SIDE;
+
+const char* LAYER_NAMES[VIRTUAL_LAYER_COUNT] = { "color", "normal", "roughness" };
+
+// virtualTexture and feedbackPixel in simple.frag
+const GLint VIRTUAL_TEXTURE_LOCATION = 4;
+const GLint FEEDBACK_PIXEL_LOCATION = 5;
+
+// The pixel of every 4x4 block writing feedback, frame by frame. Consecutive frames are far apart,
+// so small surfaces are found within a few frames.
+const int FEEDBACK_PIXEL_ORDER[16][2] = {
+    {0, 0}, {2, 2}, {2, 0}, {0, 2}, {1, 1}, {3, 3}, {3, 1}, {1, 3},
+    {1, 0}, {3, 2}, {3, 0}, {1, 2}, {0, 1}, {2, 3}, {2, 1}, {0, 3}
+};
+
+struct PageRequest {
+    int material;
+    uint32_t mip;
+    uint32_t x;
+    uint32_t y;
+    // Tiled files of the layers, as the worker cannot look at the materials
+    std::vector<std::string> files;
+};
+
+struct LoadedPage {
+    PageRequest request;
+    std::vector<unsigned char> layers[VIRTUAL_LAYER_COUNT];
+    bool valid = false;
+};
+
+struct VirtualMaterial {
+    std::string label;
+    std::vector<std::string> tiledFiles;
+    TiledImageHeader header;
+    unsigned int feedbackOffset = 0;       // Where its pages start in the feedback buffer
+    std::vector<int> pageSlots;            // Cache slot of every page, or -1
+    std::vector<bool> pageStreaming;       // Requested, and not in the cache yet
+    GLTexture indirection;
+    bool indirectionDirty = true;
+};
+
+struct CacheSlot {
+    int material = -1;
+    uint32_t page = 0;
+    uint64_t lastUsedFrame = 0;
+    bool pinned = false;
+};
+
+static std::vector<VirtualMaterial> materials;
+
+static GLTexture cacheLayers[VIRTUAL_LAYER_COUNT];
+static std::vector<CacheSlot> cacheSlots;
+
+static GLBuffer feedbackBuffer;
+static GLBuffer feedbackReadbackBuffers[FEEDBACK_READBACK_FRAMES];
+static GLsync feedbackReadbackFences[FEEDBACK_READBACK_FRAMES];
+static unsigned int feedbackPageCount = 0;
+static std::vector<unsigned int> feedback;
+
+static uint64_t frameIndex = 0;
+static bool streamingBlocking = false;
+static unsigned int uploadedPages = 0;
+
+// The worker thread and its queues, guarded by workerMutex
+static std::thread worker;
+static std::mutex workerMutex;
+static std::condition_variable workAvailable;
+static std::condition_variable workDone;
+static std::deque<PageRequest> pendingRequests;
+static std::vector<LoadedPage> loadedPages;
+static unsigned int pagesInProgress = 0;
+static bool stopping = false;
+
+static uint32_t pageIndex(const TiledImageHeader &header, uint32_t mip, uint32_t x, uint32_t y) {
+    return tiledFirstPage(header, mip) + y * tiledPagesX(header, mip) + x;
+}
+
+static bool readPageLayers(std::map<std::string, TiledImageReader> &readers, LoadedPage &page) {
+    const PageRequest &request = page.request;
+    for (unsigned int layer = 0; layer < VIRTUAL_LAYER_COUNT; layer++) {
+        TiledImageReader &reader = readers[request.files[layer]];
+        if (!reader.isOpen() && !reader.open(request.files[layer])) {
+            return false;
+        }
+        if (!reader.readPage(request.mip, request.x, request.y, page.layers[layer])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads requested pages from disk, one at a time, most urgent first
+static void workerLoop() {
+    std::map<std::string, TiledImageReader> readers;
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+    while (true) {
+        workAvailable.wait(lock, [] { return stopping || !pendingRequests.empty(); });
+        if (stopping) {
+            return;
+        }
+
+        LoadedPage page;
+        page.request = std::move(pendingRequests.front());
+        pendingRequests.pop_front();
+        pagesInProgress++;
+        lock.unlock();
+
+        page.valid = readPageLayers(readers, page);
+
+        lock.lock();
+        loadedPages.push_back(std::move(page));
+        pagesInProgress--;
+        workDone.notify_all();
+    }
+}
+
+void initVirtualTextures() {
+    for (unsigned int layer = 0; layer < VIRTUAL_LAYER_COUNT; layer++) {
+        cacheLayers[layer] = createTexture(GL_TEXTURE_2D, GPU_MEMORY_TEXTURE,
+                                           fmt::format("Virtual texture cache ({})", LAYER_NAMES[layer]),
+                                           1, GL_RGBA8, CACHE_SIZE, CACHE_SIZE);
+        // Pages are only ever sampled at their own resolution. The borders keep filtering within a slot.
+        glTextureParameteri(cacheLayers[layer], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(cacheLayers[layer], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(cacheLayers[layer], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(cacheLayers[layer], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    cacheSlots.assign(CACHE_SLOT_COUNT, CacheSlot());
+
+    for (GLsync &fence : feedbackReadbackFences) {
+        fence = nullptr;
+    }
+
+    stopping = false;
+    worker = std::thread(workerLoop);
+}
+
+static void deleteFeedbackFences() {
+    for (GLsync &fence : feedbackReadbackFences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
+
+void destroyVirtualTextures() {
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    pendingRequests.clear();
+    loadedPages.clear();
+
+    deleteFeedbackFences();
+    for (GLBuffer &buffer : feedbackReadbackBuffers) {
+        buffer.reset();
+    }
+    feedbackBuffer.reset();
+    feedback.clear();
+    feedbackPageCount = 0;
+
+    for (GLTexture &layer : cacheLayers) {
+        layer.reset();
+    }
+    cacheSlots.clear();
+    materials.clear();
+    frameIndex = 0;
+}
+
+// Room for one flag per page of every material, all cleared
+static void resizeFeedbackBuffers() {
+    deleteFeedbackFences();
+    feedback.assign(feedbackPageCount, 0);
+
+    GLsizeiptr size = feedbackPageCount * sizeof(unsigned int);
+    feedbackBuffer = createBuffer(GPU_MEMORY_STORAGE, "Virtual texture feedback", size, feedback.data(), 0);
+    for (GLBuffer &buffer : feedbackReadbackBuffers) {
+        buffer = createBuffer(GPU_MEMORY_READBACK, "Virtual texture feedback readback", size, nullptr, GL_CLIENT_STORAGE_BIT);
+    }
+}
+
+// The slot a new page goes into: an empty one, or else the one least recently used.
+// Slots holding pages used in the latest feedback are not taken, nor are the pinned ones.
+static int findCacheSlot() {
+    int leastRecentlyUsed = -1;
+    for (unsigned int slot = 0; slot < cacheSlots.size(); slot++) {
+        const CacheSlot &cacheSlot = cacheSlots[slot];
+        if (cacheSlot.material < 0) {
+            return slot;
+        }
+        if (cacheSlot.pinned || cacheSlot.lastUsedFrame == frameIndex) {
+            continue;
+        }
+        if (leastRecentlyUsed < 0 || cacheSlot.lastUsedFrame < cacheSlots[leastRecentlyUsed].lastUsedFrame) {
+            leastRecentlyUsed = slot;
+        }
+    }
+    return leastRecentlyUsed;
+}
+
+// Copies a page into the cache, evicting whatever was in its slot. Returns false if the cache is full.
+static bool insertPage(const LoadedPage &page, bool pinned) {
+    int slot = findCacheSlot();
+    if (slot < 0) {
+        return false;
+    }
+
+    CacheSlot &cacheSlot = cacheSlots[slot];
+    if (cacheSlot.material >= 0) {
+        VirtualMaterial &evicted = materials[cacheSlot.material];
+        evicted.pageSlots[cacheSlot.page] = -1;
+        evicted.indirectionDirty = true;
+    }
+
+    int slotX = slot % VIRTUAL_CACHE_PAGES_PER_SIDE;
+    int slotY = slot / VIRTUAL_CACHE_PAGES_PER_SIDE;
+    for (unsigned int layer = 0; layer < VIRTUAL_LAYER_COUNT; layer++) {
+        glTextureSubImage2D(cacheLayers[layer], 0, slotX * SLOT_SIZE, slotY * SLOT_SIZE, SLOT_SIZE, SLOT_SIZE,
+                            GL_RGBA, GL_UNSIGNED_BYTE, page.layers[layer].data());
+        apiCounters.bytesUploaded += page.layers[layer].size();
+    }
+
+    const PageRequest &request = page.request;
+    VirtualMaterial &material = materials[request.material];
+    uint32_t index = pageIndex(material.header, request.mip, request.x, request.y);
+    material.pageSlots[index] = slot;
+    material.indirectionDirty = true;
+
+    cacheSlot.material = request.material;
+    cacheSlot.page = index;
+    cacheSlot.lastUsedFrame = frameIndex;
+    cacheSlot.pinned = pinned;
+    return true;
+}
+
+// The tiled file baked from a PNG file, next to it. Baked again if the PNG file has changed since.
+static bool prepareTiledFile(const std::string &fileName, std::string &tiledFile, TiledImageHeader &header) {
+    std::vector<unsigned char> png;
+    unsigned int error = lodepng::load_file(png, fileName);
+    if (error) {
+        fprintf(stderr, "Could not read %s: %s\n", fileName.c_str(), lodepng_error_text(error));
+        return false;
+    }
+
+    tiledFile = fileName.substr(0, fileName.find_last_of('.')) + ".vtex";
+    uint64_t sourceHash = ContentHash().add(png.size()).addBytes(png.data(), png.size()).value();
+    if (readTiledImageHeader(tiledFile, header) && header.sourceHash == sourceHash
+        && header.pageSize == VIRTUAL_PAGE_SIZE && header.pageBorder == VIRTUAL_PAGE_BORDER) {
+        return true;
+    }
+
+    std::cout << fmt::format("Baking {} into {}x{} pages", fileName, VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_SIZE) << std::endl;
+    PNGImage image = decodePNGImage(png);
+    if (!bakeTiledImage(image, sourceHash, VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_BORDER, tiledFile)
+        || !readTiledImageHeader(tiledFile, header)) {
+        fprintf(stderr, "Could not write %s\n", tiledFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Whether every level is made of whole pages, or fits in one, and the indirection texture has a level for each.
+// The page counts round down, so otherwise the texels past the last whole page are lost, and simple.frag
+// reads more texels than a page holds. Always true for files from bakeTiledImage(), which makes both sides
+// powers of two.
+static bool hasWholePages(const TiledImageHeader &header) {
+    for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+        uint32_t width = tiledMipWidth(header, mip);
+        uint32_t height = tiledMipHeight(header, mip);
+        if ((width > header.pageSize && width % header.pageSize != 0)
+            || (height > header.pageSize && height % header.pageSize != 0)) {
+            return false;
+        }
+    }
+    return header.mipCount <= uint32_t(fullMipChainLevels(tiledPagesX(header, 0), tiledPagesY(header, 0)));
+}
+
+int loadVirtualMaterial(const std::string &label, const std::vector<std::string> &layerFiles) {
+    PROFILE_ZONE("loadVirtualMaterial");
+
+    if (layerFiles.size() != VIRTUAL_LAYER_COUNT) {
+        fprintf(stderr, "Virtual material %s needs %u layers, not %zu\n", label.c_str(), VIRTUAL_LAYER_COUNT, layerFiles.size());
+        return -1;
+    }
+
+    VirtualMaterial material;
+    material.label = label;
+    for (unsigned int layer = 0; layer < VIRTUAL_LAYER_COUNT; layer++) {
+        std::string tiledFile;
+        TiledImageHeader header;
+        if (!prepareTiledFile(layerFiles[layer], tiledFile, header)) {
+            return -1;
+        }
+        if (!hasWholePages(header)) {
+            fprintf(stderr, "Virtual material %s: %s is %ux%u, which does not divide into %ux%u pages\n", label.c_str(),
+                    tiledFile.c_str(), header.width, header.height, header.pageSize, header.pageSize);
+            return -1;
+        }
+        if (layer == 0) {
+            material.header = header;
+        }
+        else if (header.width != material.header.width || header.height != material.header.height) {
+            fprintf(stderr, "The layers of virtual material %s differ in size\n", label.c_str());
+            return -1;
+        }
+        material.tiledFiles.push_back(tiledFile);
+    }
+
+    TiledImageHeader header = material.header;
+    uint32_t pageCount = tiledPageCount(header);
+    material.feedbackOffset = feedbackPageCount;
+    material.pageSlots.assign(pageCount, -1);
+    material.pageStreaming.assign(pageCount, false);
+
+    // One texel per page, with a mip level per level of pages
+    material.indirection = createTexture(GL_TEXTURE_2D, GPU_MEMORY_TEXTURE, label + " indirection", header.mipCount,
+                                         GL_RGBA8UI, tiledPagesX(header, 0), tiledPagesY(header, 0));
+    glTextureParameteri(material.indirection, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(material.indirection, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    int materialID = int(materials.size());
+    materials.push_back(std::move(material));
+
+    feedbackPageCount += pageCount;
+    resizeFeedbackBuffers();
+
+    // The coarsest level is the fallback for every other page, so it is read right away and kept
+    LoadedPage coarsest;
+    coarsest.request = { materialID, header.mipCount - 1, 0, 0, materials[materialID].tiledFiles };
+    std::map<std::string, TiledImageReader> readers;
+    if (!readPageLayers(readers, coarsest) || !insertPage(coarsest, true)) {
+        fprintf(stderr, "Could not load the coarsest page of virtual material %s\n", label.c_str());
+    }
+
+    return materialID;
+}
+
+// Requests every page in the feedback that is not in the cache, together with the coarser pages covering it,
+// and marks the resident ones as used. Requests still waiting from earlier frames are replaced.
+static void requestPages() {
+    std::vector<PageRequest> requests;
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+    for (const PageRequest &request : pendingRequests) {
+        VirtualMaterial &material = materials[request.material];
+        material.pageStreaming[pageIndex(material.header, request.mip, request.x, request.y)] = false;
+    }
+    pendingRequests.clear();
+
+    for (unsigned int materialID = 0; materialID < materials.size(); materialID++) {
+        VirtualMaterial &material = materials[materialID];
+        const TiledImageHeader &header = material.header;
+
+        for (uint32_t mip = 0; mip < header.mipCount; mip++) {
+            for (uint32_t y = 0; y < tiledPagesY(header, mip); y++) {
+                for (uint32_t x = 0; x < tiledPagesX(header, mip); x++) {
+                    if (feedback[material.feedbackOffset + pageIndex(header, mip, x, y)] == 0) {
+                        continue;
+                    }
+
+                    for (uint32_t level = mip; level < header.mipCount; level++) {
+                        uint32_t levelX = std::min(x >> (level - mip), tiledPagesX(header, level) - 1);
+                        uint32_t levelY = std::min(y >> (level - mip), tiledPagesY(header, level) - 1);
+                        uint32_t index = pageIndex(header, level, levelX, levelY);
+                        if (material.pageSlots[index] >= 0) {
+                            cacheSlots[material.pageSlots[index]].lastUsedFrame = frameIndex;
+                        }
+                        else if (!material.pageStreaming[index]) {
+                            material.pageStreaming[index] = true;
+                            requests.push_back({ int(materialID), level, levelX, levelY, material.tiledFiles });
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Coarse pages first, as they cover more of the screen and stand in for the finer ones
+    std::stable_sort(requests.begin(), requests.end(), [](const PageRequest &a, const PageRequest &b) {
+        return a.mip > b.mip;
+    });
+    pendingRequests.assign(requests.begin(), requests.end());
+    lock.unlock();
+    workAvailable.notify_all();
+}
+
+// Picks up the feedback written FEEDBACK_READBACK_FRAMES frames ago, if the GPU is done with it
+static void readFeedback() {
+    GLsync &fence = feedbackReadbackFences[frameIndex % FEEDBACK_READBACK_FRAMES];
+    if (fence == nullptr) {
+        return;
+    }
+
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, streamingBlocking ? BLOCKING_READBACK_TIMEOUT : 0);
+    bool ready = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    glDeleteSync(fence);
+    fence = nullptr;
+    if (!ready) {
+        return;
+    }
+
+    glGetNamedBufferSubData(feedbackReadbackBuffers[frameIndex % FEEDBACK_READBACK_FRAMES], 0,
+                            feedbackPageCount * sizeof(unsigned int), feedback.data());
+    requestPages();
+}
+
+// Copies finished pages into the cache, at most VIRTUAL_PAGES_UPLOADED_PER_FRAME unless blocking
+static void uploadLoadedPages() {
+    std::vector<LoadedPage> finished;
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        if (streamingBlocking) {
+            workDone.wait(lock, [] { return pendingRequests.empty() && pagesInProgress == 0; });
+        }
+
+        size_t count = streamingBlocking ? loadedPages.size()
+                                         : std::min<size_t>(loadedPages.size(), VIRTUAL_PAGES_UPLOADED_PER_FRAME);
+        std::move(loadedPages.begin(), loadedPages.begin() + count, std::back_inserter(finished));
+        loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+    }
+
+    for (const LoadedPage &page : finished) {
+        const PageRequest &request = page.request;
+        VirtualMaterial &material = materials[request.material];
+        uint32_t index = pageIndex(material.header, request.mip, request.x, request.y);
+        material.pageStreaming[index] = false;
+
+        // Pages that could not be read, or found no room, are requested again if they are still seen
+        if (page.valid && material.pageSlots[index] < 0 && insertPage(page, false)) {
+            uploadedPages++;
+        }
+    }
+}
+
+// Rewrites the indirection texture of every material whose pages have come or gone.
+// Each entry holds (slot x, slot y, mip level of the page in the slot), and missing pages repeat the entry
+// of the page covering them one level up.
+static void updateIndirection() {
+    for (VirtualMaterial &material : materials) {
+        if (!material.indirectionDirty) {
+            continue;
+        }
+        material.indirectionDirty = false;
+
+        const TiledImageHeader &header = material.header;
+        std::vector<unsigned char> coarser;
+        for (int mip = int(header.mipCount) - 1; mip >= 0; mip--) {
+            uint32_t pagesX = tiledPagesX(header, mip);
+            uint32_t pagesY = tiledPagesY(header, mip);
+            std::vector<unsigned char> entries(size_t(pagesX) * pagesY * 4, 0);
+
+            for (uint32_t y = 0; y < pagesY; y++) {
+                for (uint32_t x = 0; x < pagesX; x++) {
+                    unsigned char* entry = &entries[(size_t(y) * pagesX + x) * 4];
+                    int slot = material.pageSlots[pageIndex(header, mip, x, y)];
+                    if (slot >= 0) {
+                        entry[0] = (unsigned char)(slot % VIRTUAL_CACHE_PAGES_PER_SIDE);
+                        entry[1] = (unsigned char)(slot / VIRTUAL_CACHE_PAGES_PER_SIDE);
+                        entry[2] = (unsigned char)mip;
+                        entry[3] = 255;
+                    }
+                    else if (!coarser.empty()) {
+                        uint32_t coarserPagesX = tiledPagesX(header, mip + 1);
+                        uint32_t coarserX = std::min(x / 2, coarserPagesX - 1);
+                        uint32_t coarserY = std::min(y / 2, tiledPagesY(header, mip + 1) - 1);
+                        const unsigned char* covering = &coarser[(size_t(coarserY) * coarserPagesX + coarserX) * 4];
+                        std::copy(covering, covering + 4, entry);
+                    }
+                }
+            }
+
+            glTextureSubImage2D(material.indirection, mip, 0, 0, pagesX, pagesY, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                                entries.data());
+            apiCounters.bytesUploaded += entries.size();
+            coarser = std::move(entries);
+        }
+    }
+}
+
+void updateVirtualTextures() {
+    PROFILE_ZONE("updateVirtualTextures");
+
+    if (materials.empty()) {
+        return;
+    }
+
+    frameIndex++;
+    uploadedPages = 0;
+
+    readFeedback();
+    uploadLoadedPages();
+    updateIndirection();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIRTUAL_FEEDBACK_BINDING, feedbackBuffer);
+}
+
+void bindVirtualMaterial(int materialID) {
+    const VirtualMaterial &material = materials.at(materialID);
+
+    for (unsigned int layer = 0; layer < VIRTUAL_LAYER_COUNT; layer++) {
+        trackedBindTextureUnit(layer, cacheLayers[layer]);
+    }
+    trackedBindTextureUnit(VIRTUAL_INDIRECTION_UNIT, material.indirection);
+
+    trackedUniform4i(VIRTUAL_TEXTURE_LOCATION, material.header.width, material.header.height,
+                     material.header.mipCount, material.feedbackOffset);
+    const int* feedbackPixel = FEEDBACK_PIXEL_ORDER[frameIndex % 16];
+    trackedUniform2i(FEEDBACK_PIXEL_LOCATION, feedbackPixel[0], feedbackPixel[1]);
+}
+
+void resolveVirtualTextureFeedback() {
+    if (materials.empty()) {
+        return;
+    }
+
+    unsigned int slot = frameIndex % FEEDBACK_READBACK_FRAMES;
+    if (feedbackReadbackFences[slot] != nullptr) {
+        glDeleteSync(feedbackReadbackFences[slot]);
+    }
+
+    // The flags are written by fragment shaders, and read by the copy
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLsizeiptr size = feedbackPageCount * sizeof(unsigned int);
+    glCopyNamedBufferSubData(feedbackBuffer, feedbackReadbackBuffers[slot], 0, 0, size);
+    feedbackReadbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    unsigned int zero = 0;
+    glClearNamedBufferData(feedbackBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void setVirtualTextureStreamingBlocking(bool blocking) {
+    streamingBlocking = blocking;
+}
+
+VirtualTextureStats getVirtualTextureStats() {
+    VirtualTextureStats stats;
+    stats.cachePages = cacheSlots.size();
+    for (const CacheSlot &slot : cacheSlots) {
+        stats.residentPages += (slot.material >= 0) ? 1 : 0;
+    }
+    for (const VirtualMaterial &material : materials) {
+        stats.streamingPages += std::count(material.pageStreaming.begin(), material.pageStreaming.end(), true);
+    }
+    stats.uploadedPages = uploadedPages;
+    return stats;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Must match the constants in simple.frag
+const unsigned int VIRTUAL_PAGE_SIZE = 128;
+const unsigned int VIRTUAL_PAGE_BORDER = 4;
+// The page cache is a square of this many pages per side, shared by every material
+const unsigned int VIRTUAL_CACHE_PAGES_PER_SIDE = 16;
+
+// Color, normal and roughness, sampled from texture units 0, 1 and 2 like the textures of other NORMAL_MAPPED nodes
+const unsigned int VIRTUAL_LAYER_COUNT = 3;
+// Texture unit of the indirection texture, and binding of the feedback buffer, in simple.frag
+const unsigned int VIRTUAL_INDIRECTION_UNIT = 3;
+const unsigned int VIRTUAL_FEEDBACK_BINDING = 8;
+
+// Pages copied into the cache per frame at most, so a sudden turn of the camera cannot stall a frame
+const unsigned int VIRTUAL_PAGES_UPLOADED_PER_FRAME = 16;
+
+struct VirtualTextureStats {
+    unsigned int residentPages = 0;   // In the cache, out of cachePages
+    unsigned int cachePages = 0;
+    unsigned int streamingPages = 0;  // Requested by the feedback, and not in the cache yet
+    unsigned int uploadedPages = 0;   // Copied into the cache in the most recent frame
+};
+
+// Sparse virtual texturing for large material sets.
+// Materials are stored on disk as tiled files (see tiledImage.h), baked next to their PNG files the first
+// time they are used. Only the pages the G-buffer pass actually samples are kept on the GPU, in a fixed-size
+// page cache, so memory follows what is visible rather than the size of the materials.
+//  - The G-buffer shader writes the pages and mip levels it samples into a feedback buffer, from a
+//    rotating sixteenth of the pixels. The buffer is read back a few frames later, without stalling.
+//  - A worker thread reads the missing pages from disk. Finished pages are copied into the least
+//    recently used cache slots, a few per frame.
+//  - Each material's indirection texture maps its pages to cache slots. Pages that are not resident yet
+//    map to the slot of the nearest coarser page that is, so sampling never waits for the disk.
+//    The coarsest level is a single page, which is loaded up front and never evicted.
+void initVirtualTextures();
+// Stops the worker thread and frees the cache and every material
+void destroyVirtualTextures();
+
+// Loads a material from one PNG file per layer, in VIRTUAL_LAYER_COUNT order, which must have the same size.
+// Returns the ID to store in SceneNode::virtualMaterialID, or -1 if a layer could not be read.
+int loadVirtualMaterial(const std::string &label, const std::vector<std::string> &layerFiles);
+
+// Picks up the feedback that has reached the CPU, requests the missing pages, and copies finished
+// pages into the cache. Call once per frame, before anything is drawn.
+void updateVirtualTextures();
+// Binds a material's layers and indirection texture, and sets its uniforms in the active
+// RENDER_VIRTUAL_TEXTURE permutation of the G-buffer shader
+void bindVirtualMaterial(int materialID);
+// Queues the copy of this frame's feedback to the CPU. Call once everything sampling the materials is drawn.
+void resolveVirtualTextureFeedback();
+
+// When blocking, every requested page is loaded and copied into the cache before the next frame is drawn,
+// so frames rendered for comparison or capture do not depend on how fast the disk is
+void setVirtualTextureStreamingBlocking(bool blocking);
+
+VirtualTextureStats getVirtualTextureStats();